@@ -26,41 +26,92 @@ const int JSON_MINOR_VERSION = 18;
 JsonObjects::JsonObjects() {
     toplevel = new Util::JsonObject();
     meta = new Util::JsonObject();
-    header_types = insert_array_field(toplevel, "header_types");
-    headers = insert_array_field(toplevel, "headers");
-    header_stacks = insert_array_field(toplevel, "header_stacks");
-    header_union_types = insert_array_field(toplevel, "header_union_types");
-    header_unions = insert_array_field(toplevel, "header_unions");
-    header_union_stacks = insert_array_field(toplevel, "header_union_stacks");
-    field_lists = insert_array_field(toplevel, "field_lists");
-    errors = insert_array_field(toplevel, "errors");
-    enums = insert_array_field(toplevel, "enums");
-    parsers = insert_array_field(toplevel, "parsers");
-    parse_vsets = insert_array_field(toplevel, "parse_vsets");
-    deparsers = insert_array_field(toplevel, "deparsers");
-    meter_arrays = insert_array_field(toplevel, "meter_arrays");
-    counters = insert_array_field(toplevel, "counter_arrays");
-    register_arrays = insert_array_field(toplevel, "register_arrays");
-    calculations = insert_array_field(toplevel, "calculations");
-    learn_lists = insert_array_field(toplevel, "learn_lists");
-    actions = insert_array_field(toplevel, "actions");
-    pipelines = insert_array_field(toplevel, "pipelines");
-    checksums = insert_array_field(toplevel, "checksums");
-    force_arith = insert_array_field(toplevel, "force_arith");
-    externs = insert_array_field(toplevel, "extern_instances");
-    field_aliases = insert_array_field(toplevel, "field_aliases");
+    header_types = insert_section("header_types");
+    headers = insert_section("headers");
+    header_stacks = insert_section("header_stacks");
+    header_union_types = insert_section("header_union_types");
+    header_unions = insert_section("header_unions");
+    header_union_stacks = insert_section("header_union_stacks");
+    field_lists = insert_section("field_lists");
+    errors = insert_section("errors");
+    enums = insert_section("enums");
+    parsers = insert_section("parsers");
+    parse_vsets = insert_section("parse_vsets");
+    deparsers = insert_section("deparsers");
+    meter_arrays = insert_section("meter_arrays");
+    counters = insert_section("counter_arrays");
+    register_arrays = insert_section("register_arrays");
+    calculations = insert_section("calculations");
+    learn_lists = insert_section("learn_lists");
+    actions = insert_section("actions");
+    pipelines = insert_section("pipelines");
+    checksums = insert_section("checksums");
+    force_arith = insert_section("force_arith");
+    externs = insert_section("extern_instances");
+    field_aliases = insert_section("field_aliases");
 }
 
-Util::JsonArray*
-JsonObjects::get_field_list_contents(unsigned id) const {
-    for (auto e : *field_lists) {
-        auto obj = e->to<Util::JsonObject>();
-        auto val = obj->get("id")->to<Util::JsonValue>();
-        if (val != nullptr && val->isNumber() && val->getInt() == static_cast<int>(id)) {
-            return obj->get("elements")->to<Util::JsonArray>();
+void JsonArrayIndex::update() const {
+    for (; indexed < array->size(); indexed++) {
+        auto obj = array->at(indexed)->to<Util::JsonObject>();
+        if (obj == nullptr)
+            continue;
+        if (auto name = obj->get("name")) {
+            auto val = name->to<Util::JsonValue>();
+            if (val != nullptr && val->isString())
+                byName.emplace(val->getString(), obj);
+        }
+        if (auto id = obj->get("id")) {
+            auto val = id->to<Util::JsonValue>();
+            if (val != nullptr && val->isNumber())
+                byId.emplace(static_cast<unsigned>(val->getInt()), obj);
         }
     }
-    return nullptr;
+}
+
+Util::JsonObject* JsonArrayIndex::find(cstring name) const {
+    update();
+    auto it = byName.find(name);
+    return it == byName.end() ? nullptr : it->second;
+}
+
+Util::JsonObject* JsonArrayIndex::find(unsigned id) const {
+    update();
+    auto it = byId.find(id);
+    return it == byId.end() ? nullptr : it->second;
+}
+
+/// Insert a top-level json array under key 'name', and index its objects.
+Util::JsonArray*
+JsonObjects::insert_section(cstring name) {
+    auto result = insert_array_field(toplevel, name);
+    indexes.emplace(result, JsonArrayIndex(result));
+    return result;
+}
+
+const JsonArrayIndex&
+JsonObjects::get_index(const Util::JsonArray* section) const {
+    auto it = indexes.find(section);
+    BUG_CHECK(it != indexes.end(), "not a top-level json array");
+    return it->second;
+}
+
+Util::JsonObject*
+JsonObjects::find_by_name(const Util::JsonArray* section, cstring name) const {
+    return get_index(section).find(name);
+}
+
+Util::JsonObject*
+JsonObjects::find_by_id(const Util::JsonArray* section, unsigned id) const {
+    return get_index(section).find(id);
+}
+
+Util::JsonArray*
+JsonObjects::get_field_list_contents(unsigned id) const {
+    auto obj = find_by_id(field_lists, id);
+    if (obj == nullptr)
+        return nullptr;
+    return obj->get("elements")->to<Util::JsonArray>();
 }
 
 Util::JsonObject*
@@ -133,14 +184,10 @@ JsonObjects::add_meta_info() {
  */
 unsigned
 JsonObjects::add_header_type(const cstring& name, Util::JsonArray*& fields, unsigned max_length) {
-    std::string sname(name, name.size());
-    auto header_type_id_it = header_type_id.find(sname);
-    if (header_type_id_it != header_type_id.end()) {
-        return header_type_id_it->second;
-    }
+    if (auto existing = find_by_name(header_types, name))
+        return existing->get("id")->to<Util::JsonValue>()->getInt();
     auto header_type = new Util::JsonObject();
     unsigned id = BMV2::nextId("header_types");
-    header_type_id[sname] = id;
     header_type->emplace("name", name);
     header_type->emplace("id", id);
     if (fields != nullptr) {
@@ -157,13 +204,10 @@ JsonObjects::add_header_type(const cstring& name, Util::JsonArray*& fields, unsi
 
 unsigned
 JsonObjects::add_union_type(const cstring& name, Util::JsonArray*& fields) {
-    std::string sname(name, name.size());
-    auto it = union_type_id.find(sname);
-    if (it != union_type_id.end())
-        return it->second;
+    if (auto existing = find_by_name(header_union_types, name))
+        return existing->get("id")->to<Util::JsonValue>()->getInt();
     auto union_type = new Util::JsonObject();
     unsigned id = BMV2::nextId("header_union_types");
-    union_type_id[sname] = id;
     union_type->emplace("name", name);
     union_type->emplace("id", id);
     if (fields != nullptr) {
@@ -180,14 +224,10 @@ JsonObjects::add_union_type(const cstring& name, Util::JsonArray*& fields) {
 /// Create a header type with empty field list.
 unsigned
 JsonObjects::add_header_type(const cstring& name) {
-    std::string sname(name, name.size());
-    auto header_type_id_it = header_type_id.find(sname);
-    if (header_type_id_it != header_type_id.end()) {
-        return header_type_id_it->second;
-    }
+    if (auto existing = find_by_name(header_types, name))
+        return existing->get("id")->to<Util::JsonValue>()->getInt();
     auto header_type = new Util::JsonObject();
     unsigned id = BMV2::nextId("header_types");
-    header_type_id[sname] = id;
     header_type->emplace("name", name);
     header_type->emplace("id", id);
     auto temp = new Util::JsonArray();
@@ -201,9 +241,10 @@ JsonObjects::add_header_type(const cstring& name) {
 void
 JsonObjects::add_header_field(const cstring& name, Util::JsonArray*& field) {
     CHECK_NULL(field);
-    Util::JsonObject* headerType = find_object_by_name(header_types, name);
+    Util::JsonObject* headerType = find_by_name(header_types, name);
+    BUG_CHECK(headerType != nullptr, "header '%1%' not found", name);
     Util::JsonArray* fields = headerType->get("fields")->to<Util::JsonArray>();
-    BUG_CHECK(fields != nullptr, "header '%1%' not found", name);
+    CHECK_NULL(fields);
     fields->append(field);
 }
 
@@ -299,7 +340,7 @@ void
 JsonObjects::add_enum(const cstring& enum_name, const cstring& entry_name,
                       const unsigned entry_value) {
     // look up enum in json by name
-    Util::JsonObject* enum_json = find_object_by_name(enums, enum_name);
+    Util::JsonObject* enum_json = find_by_name(enums, enum_name);
     if (enum_json == nullptr) {  // first entry in a new enum
         enum_json = new Util::JsonObject();
         enum_json->emplace("name", enum_name);
@@ -330,8 +371,6 @@ JsonObjects::add_parser(const cstring& name) {
     auto parse_states = new Util::JsonArray();
     parser->emplace("parse_states", parse_states);
     parsers->append(parser);
-
-    map_parser.emplace(id, parser);
     return id;
 }
 
@@ -339,9 +378,9 @@ JsonObjects::add_parser(const cstring& name) {
 /// return the id of the parser state
 unsigned
 JsonObjects::add_parser_state(const unsigned parser_id, const cstring& state_name) {
-    if (map_parser.find(parser_id) == map_parser.end())
+    auto parser = find_by_id(parsers, parser_id);
+    if (parser == nullptr)
         BUG("parser %1% not found.", parser_id);
-    auto parser = map_parser[parser_id];
     auto states = parser->get("parse_states")->to<Util::JsonArray>();
     auto state = new Util::JsonObject();
     unsigned state_id = BMV2::nextId("parse_states");
@@ -366,9 +405,8 @@ JsonObjects::add_parser_transition(const unsigned state_id, Util::IJson* transit
     auto state = map_parser_state[state_id];
     auto transitions = state->get("transitions")->to<Util::JsonArray>();
     CHECK_NULL(transitions);
-    auto trans = transition->to<Util::JsonObject>();
-    CHECK_NULL(trans);
-    transitions->append(trans);
+    CHECK_NULL(transition);
+    transitions->append(transition);
 }
 
 void
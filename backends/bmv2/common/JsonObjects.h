@@ -18,15 +18,49 @@ limitations under the License.
 #define BACKENDS_BMV2_COMMON_JSONOBJECTS_H_
 
 #include <map>
+#include <unordered_map>
 #include "lib/json.h"
 #include "lib/ordered_map.h"
 
 namespace BMV2 {
 
+/// Indexes the objects of a json array by their "name" and "id" members.
+/// The arrays are only ever appended to, and converters append to them
+/// directly, so the index catches up with the new elements when queried.
+/// An object must have its name and id when it is looked up, or when an
+/// object appended after it is.
+class JsonArrayIndex {
+    const Util::JsonArray* array;
+    mutable size_t indexed = 0;  // elements of 'array' already in the maps
+    mutable std::unordered_map<cstring, Util::JsonObject*> byName;
+    mutable std::unordered_map<unsigned, Util::JsonObject*> byId;
+
+    void update() const;
+
+ public:
+    explicit JsonArrayIndex(const Util::JsonArray* array) : array(array) {}
+    /// The first object called 'name', or nullptr.
+    Util::JsonObject* find(cstring name) const;
+    /// The first object with 'id', or nullptr.
+    Util::JsonObject* find(unsigned id) const;
+};
+
 class JsonObjects {
+    /// Indexes of the top-level arrays that hold named objects.
+    std::unordered_map<const Util::JsonArray*, JsonArrayIndex> indexes;
+    std::unordered_map<unsigned, Util::JsonObject*> map_parser_state;
+
+    Util::JsonArray* insert_section(cstring name);
+    const JsonArrayIndex& get_index(const Util::JsonArray* section) const;
+
  public:
+    /// Scans 'array'; use find_by_name for the top-level arrays.
     static Util::JsonObject* find_object_by_name(Util::JsonArray* array,
                                                  const cstring& name);
+    /// The object called 'name' in the top-level array 'section', or nullptr.
+    Util::JsonObject* find_by_name(const Util::JsonArray* section, cstring name) const;
+    /// The object with 'id' in the top-level array 'section', or nullptr.
+    Util::JsonObject* find_by_id(const Util::JsonArray* section, unsigned id) const;
 
     void add_program_info(const cstring& name);
     void add_meta_info();
@@ -63,9 +97,6 @@ class JsonObjects {
     // Given a field list id returns the array of values called "elements"
     Util::JsonArray* get_field_list_contents(unsigned id) const;
 
-    std::map<unsigned, Util::JsonObject*> map_parser;
-    std::map<unsigned, Util::JsonObject*> map_parser_state;
-
     Util::JsonObject* toplevel;
     Util::JsonObject* meta;
     Util::JsonArray* actions;
@@ -83,8 +114,6 @@ class JsonObjects {
     Util::JsonArray* header_union_types;
     Util::JsonArray* header_unions;
     Util::JsonArray* header_union_stacks;
-    ordered_map<std::string, unsigned> header_type_id;
-    ordered_map<std::string, unsigned> union_type_id;
     Util::JsonArray* learn_lists;
     Util::JsonArray* meter_arrays;
     Util::JsonArray* parsers;
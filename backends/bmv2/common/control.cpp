@@ -27,48 +27,53 @@ void ControlConverter::convertTableEntries(const IR::P4Table *table,
     auto entriesList = table->getEntries();
     if (entriesList == nullptr) return;
 
-    auto entries = mkArrayField(jsonTable, "entries");
+    // Constant entries can be numerous and are not changed once converted,
+    // so they are written directly instead of being built as JsonObjects.
+    auto entries = new Util::JsonFragment();
+    auto &json = entries->writer();
+    json.beginArray();
     int entryPriority = 1;  // default priority is defined by index position
     for (auto e : entriesList->entries) {
-        auto entry = new Util::JsonObject();
-        entry->emplace_non_null("source_info", e->sourceInfoJsonObj());
+        json.beginObject();
+        if (auto sourceInfo = e->sourceInfoJsonObj())
+            json.key("source_info").value(sourceInfo);
 
         auto keyset = e->getKeys();
-        auto matchKeys = mkArrayField(entry, "match_key");
+        json.key("match_key").beginArray();
         int keyIndex = 0;
         for (auto k : keyset->components) {
-            auto key = new Util::JsonObject();
+            json.beginObject();
             auto tableKey = table->getKey()->keyElements.at(keyIndex);
             auto keyWidth = tableKey->expression->type->width_bits();
             auto k8 = ROUNDUP(keyWidth, 8);
             auto matchType = getKeyMatchType(tableKey);
-            key->emplace("match_type", matchType);
+            json.key("match_type").value(matchType);
             if (matchType == corelib.exactMatch.name) {
                 if (k->is<IR::Constant>())
-                    key->emplace("key", stringRepr(k->to<IR::Constant>()->value, k8));
+                    json.key("key").value(stringRepr(k->to<IR::Constant>()->value, k8));
                 else if (k->is<IR::BoolLiteral>())
                     // booleans are converted to ints
-                    key->emplace("key", stringRepr(k->to<IR::BoolLiteral>()->value ? 1 : 0, k8));
+                    json.key("key").value(stringRepr(k->to<IR::BoolLiteral>()->value ? 1 : 0, k8));
                 else
                     ::error(ErrorType::ERR_UNSUPPORTED, "exact key expression", k);
             } else if (matchType == corelib.ternaryMatch.name) {
                 if (k->is<IR::Mask>()) {
                     auto km = k->to<IR::Mask>();
-                    key->emplace("key", stringRepr(km->left->to<IR::Constant>()->value, k8));
-                    key->emplace("mask", stringRepr(km->right->to<IR::Constant>()->value, k8));
+                    json.key("key").value(stringRepr(km->left->to<IR::Constant>()->value, k8));
+                    json.key("mask").value(stringRepr(km->right->to<IR::Constant>()->value, k8));
                 } else if (k->is<IR::Constant>()) {
-                    key->emplace("key", stringRepr(k->to<IR::Constant>()->value, k8));
-                    key->emplace("mask", stringRepr(Util::mask(keyWidth), k8));
+                    json.key("key").value(stringRepr(k->to<IR::Constant>()->value, k8));
+                    json.key("mask").value(stringRepr(Util::mask(keyWidth), k8));
                 } else if (k->is<IR::DefaultExpression>()) {
-                    key->emplace("key", stringRepr(0, k8));
-                    key->emplace("mask", stringRepr(0, k8));
+                    json.key("key").value(stringRepr(0, k8));
+                    json.key("mask").value(stringRepr(0, k8));
                 } else {
                     ::error(ErrorType::ERR_UNSUPPORTED, "ternary key expression", k);
                 }
             } else if (matchType == corelib.lpmMatch.name) {
                 if (k->is<IR::Mask>()) {
                     auto km = k->to<IR::Mask>();
-                    key->emplace("key", stringRepr(km->left->to<IR::Constant>()->value, k8));
+                    json.key("key").value(stringRepr(km->left->to<IR::Constant>()->value, k8));
                     auto trailing_zeros = [](unsigned long n) { return n ? __builtin_ctzl(n) : 0; };
                     auto count_ones = [](unsigned long n) { return n ? __builtin_popcountl(n) : 0;};
                     auto mask = static_cast<unsigned long>(km->right->to<IR::Constant>()->value);
@@ -76,38 +81,38 @@ void ControlConverter::convertTableEntries(const IR::P4Table *table,
                     if (len + count_ones(mask) != keyWidth)  // any remaining 0s in the prefix?
                         ::error(ErrorType::ERR_INVALID, "mask for LPM key", k);
                     else
-                        key->emplace("prefix_length", keyWidth - len);
+                        json.key("prefix_length").value(keyWidth - len);
                 } else if (k->is<IR::Constant>()) {
-                    key->emplace("key", stringRepr(k->to<IR::Constant>()->value, k8));
-                    key->emplace("prefix_length", keyWidth);
+                    json.key("key").value(stringRepr(k->to<IR::Constant>()->value, k8));
+                    json.key("prefix_length").value(keyWidth);
                 } else if (k->is<IR::DefaultExpression>()) {
-                    key->emplace("key", stringRepr(0, k8));
-                    key->emplace("prefix_length", 0);
+                    json.key("key").value(stringRepr(0, k8));
+                    json.key("prefix_length").value(0);
                 } else {
                     ::error(ErrorType::ERR_UNSUPPORTED, "LPM key expression", k);
                 }
             } else if (matchType == "range") {
                 if (k->is<IR::Range>()) {
                     auto kr = k->to<IR::Range>();
-                    key->emplace("start", stringRepr(kr->left->to<IR::Constant>()->value, k8));
-                    key->emplace("end", stringRepr(kr->right->to<IR::Constant>()->value, k8));
+                    json.key("start").value(stringRepr(kr->left->to<IR::Constant>()->value, k8));
+                    json.key("end").value(stringRepr(kr->right->to<IR::Constant>()->value, k8));
                 } else if (k->is<IR::Constant>()) {
-                    key->emplace("start", stringRepr(k->to<IR::Constant>()->value, k8));
-                    key->emplace("end", stringRepr(k->to<IR::Constant>()->value, k8));
+                    json.key("start").value(stringRepr(k->to<IR::Constant>()->value, k8));
+                    json.key("end").value(stringRepr(k->to<IR::Constant>()->value, k8));
                 } else if (k->is<IR::DefaultExpression>()) {
-                    key->emplace("start", stringRepr(0, k8));
-                    key->emplace("end", stringRepr((1 << keyWidth)-1, k8));  // 2^N -1
+                    json.key("start").value(stringRepr(0, k8));
+                    json.key("end").value(stringRepr((1 << keyWidth)-1, k8));  // 2^N -1
                 } else {
                     ::error(ErrorType::ERR_UNSUPPORTED, "range key expression", k);
                 }
             } else {
                 ::error(ErrorType::ERR_UNKNOWN, "key match type '%2%' for key %1%", k, matchType);
             }
-            matchKeys->append(key);
+            json.endObject();
             keyIndex++;
         }
+        json.endArray();
 
-        auto action = new Util::JsonObject();
         auto actionRef = e->getAction();
         if (!actionRef->is<IR::MethodCallExpression>())
             ::error(ErrorType::ERR_INVALID, "Invalid action %1% in entries list.", actionRef);
@@ -118,12 +123,14 @@ void ControlConverter::convertTableEntries(const IR::P4Table *table,
         unsigned id = get(ctxt->structure->ids, actionDecl, INVALID_ACTION_ID);
         BUG_CHECK(id != INVALID_ACTION_ID,
                   "Could not find id for %1%", actionDecl);
-        action->emplace("action_id", id);
-        auto actionData = mkArrayField(action, "action_data");
+        json.key("action_entry").beginObject();
+        json.key("action_id").value(id);
+        json.key("action_data").beginArray(true);
         for (auto arg : *actionCall->arguments) {
-            actionData->append(stringRepr(arg->expression->to<IR::Constant>()->value, 0));
+            json.value(stringRepr(arg->expression->to<IR::Constant>()->value, 0));
         }
-        entry->emplace("action_entry", action);
+        json.endArray();
+        json.endObject();
 
         auto priorityAnnotation = e->getAnnotation("priority");
         if (priorityAnnotation != nullptr) {
@@ -134,14 +141,16 @@ void ControlConverter::convertTableEntries(const IR::P4Table *table,
             if (!priValue->is<IR::Constant>())
                 ::error(ErrorType::ERR_INVALID, "Invalid priority value %1%. Must be constant.",
                         priorityAnnotation->expr);
-            entry->emplace("priority", priValue->to<IR::Constant>()->value);
+            json.key("priority").value(priValue->to<IR::Constant>()->value);
         } else {
-            entry->emplace("priority", entryPriority);
+            json.key("priority").value(entryPriority);
         }
         entryPriority += 1;
 
-        entries->append(entry);
+        json.endObject();
     }
+    json.endArray();
+    jsonTable->emplace("entries", entries);
 }
 
 
@@ -199,10 +199,11 @@ ExternConverter::createFieldList(ConversionContext* ctxt,
                                  const IR::Expression* expr, cstring group,
                                  cstring listName, Util::JsonArray* field_lists) {
     auto fl = new Util::JsonObject();
-    field_lists->append(fl);
     int id = nextId(group);
     fl->emplace("id", id);
     fl->emplace("name", listName);
+    // named before it is appended, so that it gets indexed
+    field_lists->append(fl);
     fl->emplace_non_null("source_info", expr->sourceInfoJsonObj());
     auto elements = mkArrayField(fl, "elements");
     addToFieldList(ctxt, expr, elements);
@@ -74,9 +74,17 @@ cstring stringRepr(big_int value, unsigned bytes) {
     return sign + "0x" + filler + r.str();
 }
 
-unsigned nextId(cstring group) {
+static std::map<cstring, unsigned>& idCounters() {
     static std::map<cstring, unsigned> counters;
-    return counters[group]++;
+    return counters;
+}
+
+unsigned nextId(cstring group) {
+    return idCounters()[group]++;
+}
+
+void resetIds() {
+    idCounters().clear();
 }
 
 }  // namespace BMV2
@@ -102,6 +102,8 @@ Util::JsonObject* mkPrimitive(cstring name, Util::JsonArray* appendTo);
 Util::JsonObject* mkPrimitive(cstring name);
 cstring stringRepr(big_int value, unsigned bytes = 0);
 unsigned nextId(cstring group);
+/// Starts the ids of all groups from 0 again, for the next compilation.
+void resetIds();
 
 }  // namespace BMV2
 
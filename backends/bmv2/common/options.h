@@ -28,8 +28,9 @@ class BMV2Options : public CompilerOptions {
     bool emitExterns = false;
     // file to output to
     cstring outputFile = nullptr;
-    // read from json
+    // read from json, or from a binary dump if loadIRFromBinary is also set
     bool loadIRFromJson = false;
+    bool loadIRFromBinary = false;
 
     BMV2Options() {
         registerOption("--emit-externs", nullptr,
@@ -43,6 +44,13 @@ class BMV2Options : public CompilerOptions {
                 [this](const char* arg) { loadIRFromJson = true; file = arg; return true; },
                 "Use IR representation from JsonFile dumped previously,"\
                 "the compilation starts with reduced midEnd.");
+        registerOption("--fromBinary", "file",
+                [this](const char* arg) {
+                    loadIRFromJson = loadIRFromBinary = true;
+                    file = arg;
+                    return true; },
+                "Use IR representation dumped previously with --toBinary,\n"
+                "the compilation starts with reduced midEnd.");
     }
 };
 
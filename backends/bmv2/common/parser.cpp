@@ -364,16 +364,16 @@ unsigned ParserConverter::combine(const IR::Expression* keySet,
     }
 }
 
-Util::IJson* ParserConverter::stateName(IR::ID state) {
+cstring ParserConverter::stateName(IR::ID state) {
     if (state.name == IR::ParserState::accept) {
-        return Util::JsonValue::null;
+        return cstring();
     } else if (state.name == IR::ParserState::reject) {
         ::warning(ErrorType::WARN_UNSUPPORTED,
                   "Explicit transition to %1% not supported on this target",
                   state);
-        return Util::JsonValue::null;
+        return cstring();
     } else {
-        return new Util::JsonValue(state.name);
+        return state.name;
     }
 }
 
@@ -382,31 +382,34 @@ ParserConverter::convertSelectExpression(const IR::SelectExpression* expr) {
     std::vector<Util::IJson*> result;
     auto se = expr->to<IR::SelectExpression>();
     for (auto sc : se->selectCases) {
-        auto trans = new Util::JsonObject();
+        auto trans = new Util::JsonFragment();
+        auto &json = trans->writer();
         big_int value, mask;
         bool is_vset;
         cstring vset_name;
         unsigned bytes = combine(sc->keyset, se->select, value, mask, is_vset, vset_name);
+        json.beginObject();
         if (is_vset) {
-            trans->emplace("type", "parse_vset");
-            trans->emplace("value", vset_name);
-            trans->emplace("mask", mask);
-            trans->emplace("next_state", stateName(sc->state->path->name));
+            json.key("type").value("parse_vset");
+            json.key("value").value(vset_name);
+            json.key("mask").value(mask);
+            json.key("next_state").value(stateName(sc->state->path->name));
         } else {
             if (mask == 0) {
-                trans->emplace("value", "default");
-                trans->emplace("mask", Util::JsonValue::null);
-                trans->emplace("next_state", stateName(sc->state->path->name));
+                json.key("value").value("default");
+                json.key("mask").null();
+                json.key("next_state").value(stateName(sc->state->path->name));
             } else {
-                trans->emplace("type", "hexstr");
-                trans->emplace("value", stringRepr(value, bytes));
+                json.key("type").value("hexstr");
+                json.key("value").value(stringRepr(value, bytes));
                 if (mask == -1)
-                    trans->emplace("mask", Util::JsonValue::null);
+                    json.key("mask").null();
                 else
-                    trans->emplace("mask", stringRepr(mask, bytes));
-                trans->emplace("next_state", stateName(sc->state->path->name));
+                    json.key("mask").value(stringRepr(mask, bytes));
+                json.key("next_state").value(stateName(sc->state->path->name));
             }
         }
+        json.endObject();
         result.push_back(trans);
     }
     return result;
@@ -422,19 +425,23 @@ ParserConverter::convertSelectKey(const IR::SelectExpression* expr) {
 
 Util::IJson*
 ParserConverter::convertPathExpression(const IR::PathExpression* pe) {
-    auto trans = new Util::JsonObject();
-    trans->emplace("value", "default");
-    trans->emplace("mask", Util::JsonValue::null);
-    trans->emplace("next_state", stateName(pe->path->name));
+    auto trans = new Util::JsonFragment();
+    trans->writer().beginObject()
+        .key("value").value("default")
+        .key("mask").null()
+        .key("next_state").value(stateName(pe->path->name))
+        .endObject();
     return trans;
 }
 
 Util::IJson*
 ParserConverter::createDefaultTransition() {
-    auto trans = new Util::JsonObject();
-    trans->emplace("value", "default");
-    trans->emplace("mask", Util::JsonValue::null);
-    trans->emplace("next_state", Util::JsonValue::null);
+    auto trans = new Util::JsonFragment();
+    trans->writer().beginObject()
+        .key("value").value("default")
+        .key("mask").null()
+        .key("next_state").null()
+        .endObject();
     return trans;
 }
 
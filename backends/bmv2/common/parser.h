@@ -37,7 +37,8 @@ class ParserConverter : public Inspector {
     void convertSimpleKey(const IR::Expression* keySet, big_int& value, big_int& mask) const;
     unsigned combine(const IR::Expression* keySet, const IR::ListExpression* select,
                      big_int& value, big_int& mask, bool& is_vset, cstring& vset_name) const;
-    Util::IJson* stateName(IR::ID state);
+    /// Null for accept and reject, which bmv2 writes as a null next state.
+    cstring stateName(IR::ID state);
     Util::IJson* convertParserStatement(const IR::StatOrDecl* stat);
     Util::IJson* convertSelectKey(const IR::SelectExpression* expr);
     Util::IJson* convertPathExpression(const IR::PathExpression* expr);
@@ -21,6 +21,7 @@ limitations under the License.
 #include "ir/ir.h"
 #include "control-plane/p4RuntimeSerializer.h"
 #include "frontends/common/applyOptionsPragmas.h"
+#include "frontends/common/compileServer.h"
 #include "frontends/common/parseInput.h"
 #include "frontends/p4/frontend.h"
 #include "lib/error.h"
@@ -34,11 +35,10 @@ limitations under the License.
 #include "backends/bmv2/psa_switch/version.h"
 #include "backends/bmv2/psa_switch/options.h"
 #include "ir/json_loader.h"
+#include "ir/binary_loader.h"
 #include "fstream"
 
-int main(int argc, char *const argv[]) {
-    setup_gc_logging();
-
+static int compile(int argc, char *const argv[]) {
     AutoCompileContext autoPsaSwitchContext(new BMV2::PsaSwitchContext);
     auto& options = BMV2::PsaSwitchContext::get().options();
     options.langVersion = CompilerOptions::FrontendVersion::P4_16;
@@ -78,6 +78,16 @@ int main(int argc, char *const argv[]) {
         }
         if (program == nullptr || ::errorCount() > 0)
             return 1;
+    } else if (options.loadIRFromBinary) {
+        BinaryLoader loader(options.file);
+        const IR::Node *node = nullptr;
+        loader >> node;
+        if (!loader.valid())
+            return 1;
+        if (node == nullptr || !(program = node->to<IR::P4Program>())) {
+            ::error("%s is not a P4Program in binary form", options.file);
+            return 1;
+        }
     } else {
         std::filebuf fb;
         if (fb.open(options.file, std::ios::in) == nullptr) {
@@ -107,6 +117,8 @@ int main(int argc, char *const argv[]) {
             return 1;
         if (options.dumpJsonFile)
             JSONGenerator(*openFile(options.dumpJsonFile, true), true) << program << std::endl;
+        if (options.dumpBinaryFile)
+            BinaryWriter(*openFile(options.dumpBinaryFile, true), true) << program;
     } catch (const std::exception &bug) {
         std::cerr << bug.what() << std::endl;
         return 1;
@@ -138,3 +150,14 @@ int main(int argc, char *const argv[]) {
 
     return ::errorCount() > 0;
 }
+
+int main(int argc, char *const argv[]) {
+    setup_gc_logging();
+
+    if (auto socket = P4::CompileServer::serverSocket(argc, argv)) {
+        P4::CompileServer server(argv[0], compile);
+        server.addResetHook(BMV2::resetIds);
+        return server.serve(socket);
+    }
+    return compile(argc, argv);
+}
@@ -77,6 +77,21 @@ EBPFTable::EBPFTable(const EBPFProgram* program, const IR::TableBlock* table,
     actionList = table->container->getActionList();
 }
 
+bool EBPFTable::isLPMKey(const IR::KeyElement* element) const {
+    auto mtdecl = program->refMap->getDeclaration(element->matchType->path, true);
+    auto matchType = mtdecl->getNode()->to<IR::Declaration_ID>();
+    return matchType->name.name == P4::P4CoreLibrary::instance.lpmMatch.name;
+}
+
+bool EBPFTable::isLPMTable() const {
+    if (keyGenerator == nullptr)
+        return false;
+    for (auto c : keyGenerator->keyElements)
+        if (isLPMKey(c))
+            return true;
+    return false;
+}
+
 void EBPFTable::emitKeyType(CodeBuilder* builder) {
     builder->emitIndent();
     builder->appendFormat("struct %s ", keyTypeName.c_str());
@@ -104,10 +119,31 @@ void EBPFTable::emitKeyType(CodeBuilder* builder) {
             fieldNumber++;
         }
 
-        // Emit key in decreasing order size - this way there will be no gaps
-        for (auto it = ordered.rbegin(); it != ordered.rend(); ++it) {
-            auto c = it->second;
+        // The keys of an LPM trie are a struct bpf_lpm_trie_key: the prefix
+        // length, followed by data which is matched bit by bit from the
+        // start.  The lpm field therefore comes last, and is stored in
+        // network order (see emitKey).
+        const IR::KeyElement* lpmKey = nullptr;
+        if (isLPMTable()) {
+            builder->emitIndent();
+            builder->append("u32 prefixlen;");
+            builder->newline();
+            for (auto it = ordered.begin(); it != ordered.end(); ++it) {
+                if (isLPMKey(it->second)) {
+                    lpmKey = it->second;
+                    ordered.erase(it);
+                    break;
+                }
+            }
+        }
 
+        // Emit key in decreasing order size - this way there will be no gaps
+        std::vector<const IR::KeyElement*> fields;
+        for (auto it = ordered.rbegin(); it != ordered.rend(); ++it)
+            fields.push_back(it->second);
+        if (lpmKey != nullptr)
+            fields.push_back(lpmKey);
+        for (auto c : fields) {
             auto ebpfType = ::get(keyTypes, c);
             builder->emitIndent();
             cstring fieldName = ::get(keyFieldNames, c);
@@ -126,6 +162,9 @@ void EBPFTable::emitKeyType(CodeBuilder* builder) {
     }
 
     builder->blockEnd(false);
+    // The trie matches every byte of the data, so there must be no padding.
+    if (isLPMTable())
+        builder->append(" __attribute__((packed))");
     builder->endOfStatement(true);
 }
 
@@ -243,9 +282,7 @@ void EBPFTable::emitInstance(CodeBuilder* builder) {
 
         // If any key field is LPM we will generate an LPM table
         for (auto it : keyGenerator->keyElements) {
-            auto mtdecl = program->refMap->getDeclaration(it->matchType->path, true);
-            auto matchType = mtdecl->getNode()->to<IR::Declaration_ID>();
-            if (matchType->name.name == P4::P4CoreLibrary::instance.lpmMatch.name) {
+            if (isLPMKey(it)) {
                 if (tableKind == TableLPMTrie) {
                     ::error(ErrorType::ERR_UNSUPPORTED,
                             "only one LPM field allowed", it->matchType);
@@ -303,12 +340,31 @@ void EBPFTable::emitKey(CodeBuilder* builder, cstring keyName) {
             builder->appendFormat("memcpy(&%s.%s, &", keyName.c_str(), fieldName.c_str());
             codeGen->visit(c->expression);
             builder->appendFormat(", %d)", scalar->bytesRequired());
+        } else if (scalar != nullptr && isLPMKey(c)) {
+            // The prefix starts at the most significant bit, so the value
+            // is aligned to the left of the field, in network order.
+            unsigned size = scalar->alignment() * 8;
+            cstring swap = size == 16 ? "htons" : size == 32 ? "htonl" :
+                    size == 64 ? "htonll" : "";
+            builder->appendFormat("%s.%s = %s((", keyName.c_str(), fieldName.c_str(),
+                                  swap.c_str());
+            scalar->emit(builder);
+            builder->append(")(");
+            codeGen->visit(c->expression);
+            builder->appendFormat(") << %d)", size - scalar->width);
         } else {
             builder->appendFormat("%s.%s = ", keyName.c_str(), fieldName.c_str());
             codeGen->visit(c->expression);
         }
         builder->endOfStatement(true);
     }
+    if (isLPMTable()) {
+        // Lookups match the whole key.
+        builder->emitIndent();
+        builder->appendFormat("%s.prefixlen = (sizeof(%s) - sizeof(u32)) * 8",
+                              keyName.c_str(), keyName.c_str());
+        builder->endOfStatement(true);
+    }
 }
 
 void EBPFTable::emitAction(CodeBuilder* builder, cstring valueName) {
@@ -409,6 +465,10 @@ void EBPFTable::emitInitializer(CodeBuilder* builder) {
     auto entries = t->getEntries();
     if (entries == nullptr)
         return;
+    if (isLPMTable()) {
+        ::error(ErrorType::ERR_UNSUPPORTED, "%1%: entries of LPM tables", entries);
+        return;
+    }
 
     builder->emitIndent();
     builder->blockStart();
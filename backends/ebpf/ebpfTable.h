@@ -63,6 +63,10 @@ class EBPFTable final : public EBPFTableBase {
     void emitKey(CodeBuilder* builder, cstring keyName);
     void emitAction(CodeBuilder* builder, cstring valueName);
     void emitInitializer(CodeBuilder* builder);
+    // True if a key field uses lpm matching; such tables are LPM tries.
+    bool isLPMTable() const;
+    // True if element is the lpm field of the key.
+    bool isLPMKey(const IR::KeyElement* element) const;
 };
 
 class EBPFCounterTable final : public EBPFTableBase {
@@ -19,7 +19,9 @@ Implementation of userlevel eBPF map structure. Emulates the linux kernel bpf ma
 */
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <unistd.h>     // sysconf()
 #include "ebpf_map.h"
 
 enum bpf_flags {
@@ -59,9 +61,10 @@ int bpf_map_update_elem(struct bpf_map **map, void *key, unsigned int key_size,
         tmp_map = (struct bpf_map *) malloc(sizeof(struct bpf_map));
         tmp_map->key = malloc(key_size);
         memcpy(tmp_map->key, key, key_size);
+        tmp_map->value = malloc(value_size);
         HASH_ADD_KEYPTR(hh, *map, tmp_map->key, key_size, tmp_map);
     }
-    tmp_map->value = malloc(value_size);
+    /* Update the value in place, as the program may hold a pointer to it */
     memcpy(tmp_map->value, value, value_size);
     return EXIT_SUCCESS;
 }
@@ -89,3 +92,279 @@ int bpf_map_delete_map(struct bpf_map *map) {
     free(map);
     return EXIT_SUCCESS;
 }
+
+unsigned int bpf_current_cpu = 0;
+
+unsigned int bpf_num_possible_cpus(void) {
+    static unsigned int num_cpus = 0;
+    if (num_cpus == 0) {
+        long conf = sysconf(_SC_NPROCESSORS_CONF);
+        num_cpus = conf > 0 ? (unsigned int) conf : 1;
+    }
+    return num_cpus;
+}
+
+/* Array maps */
+
+struct bpf_array {
+    unsigned int value_size;
+    unsigned int max_entries;
+    size_t stride;          // the value size, rounded up to BPF_VALUE_ALIGN
+    char values[];
+};
+
+struct bpf_array *bpf_array_create(unsigned int value_size, unsigned int max_entries) {
+    if (value_size == 0 || max_entries == 0)
+        return NULL;
+    size_t stride = BPF_VALUE_ROUND(value_size);
+    struct bpf_array *array = calloc(1, sizeof(struct bpf_array) + stride * max_entries);
+    if (array == NULL)
+        return NULL;
+    array->value_size = value_size;
+    array->max_entries = max_entries;
+    array->stride = stride;
+    return array;
+}
+
+void *bpf_array_lookup_elem(struct bpf_array *array, void *key) {
+    uint32_t index = *(uint32_t *) key;
+    if (index >= array->max_entries)
+        return NULL;
+    return array->values + index * array->stride;
+}
+
+int bpf_array_update_elem(struct bpf_array *array, void *key, void *value, unsigned long long flags) {
+    void *elem = bpf_array_lookup_elem(array, key);
+    if (elem == NULL || check_flags(elem, flags))
+        return EXIT_FAILURE;
+    memcpy(elem, value, array->value_size);
+    return EXIT_SUCCESS;
+}
+
+void bpf_array_delete(struct bpf_array *array) {
+    free(array);
+}
+
+/* Longest prefix match tries, following the kernel implementation */
+
+#define LPM_DATA_SIZE_MAX 256
+
+struct lpm_trie_node {
+    struct lpm_trie_node *child[2];
+    uint32_t prefixlen;
+    bool intermediate;      // only joins its children, and has no value
+    uint8_t data[];         // the prefix, followed by the value
+};
+
+struct bpf_lpm_trie {
+    struct lpm_trie_node *root;
+    unsigned int data_size;
+    unsigned int value_size;
+    size_t value_offset;    // of the value in the nodes, after the prefix and aligned
+    unsigned int max_entries;
+    unsigned int n_entries;
+};
+
+static inline unsigned int extract_bit(const uint8_t *data, uint32_t index) {
+    return (data[index / 8] >> (7 - index % 8)) & 1;
+}
+
+/* The number of leading bits of the node prefix and the key which are equal,
+ * up to the shortest of the two prefixes. */
+static uint32_t longest_prefix_match(const struct bpf_lpm_trie *trie,
+                                     const struct lpm_trie_node *node,
+                                     const struct bpf_lpm_trie_key *key) {
+    uint32_t limit = node->prefixlen < key->prefixlen ? node->prefixlen : key->prefixlen;
+    uint32_t prefixlen = 0;
+    for (unsigned int i = 0; i < trie->data_size && prefixlen < limit; i++) {
+        uint8_t diff = node->data[i] ^ key->data[i];
+        if (diff != 0) {
+            prefixlen += __builtin_clz(diff) - 24;
+            break;
+        }
+        prefixlen += 8;
+    }
+    return prefixlen < limit ? prefixlen : limit;
+}
+
+static inline void *lpm_trie_node_value(const struct bpf_lpm_trie *trie,
+                                        struct lpm_trie_node *node) {
+    return (char *) node + trie->value_offset;
+}
+
+static struct lpm_trie_node *lpm_trie_node_alloc(const struct bpf_lpm_trie *trie,
+                                                 const void *value) {
+    size_t size = offsetof(struct lpm_trie_node, data) + trie->data_size;
+    if (value != NULL)
+        size = trie->value_offset + trie->value_size;
+    struct lpm_trie_node *node = malloc(size);
+    if (node == NULL)
+        return NULL;
+    node->child[0] = node->child[1] = NULL;
+    node->intermediate = value == NULL;
+    if (value != NULL)
+        memcpy(lpm_trie_node_value(trie, node), value, trie->value_size);
+    return node;
+}
+
+struct bpf_lpm_trie *bpf_lpm_trie_create(unsigned int key_size, unsigned int value_size, unsigned int max_entries) {
+    unsigned int header = offsetof(struct bpf_lpm_trie_key, data);
+    if (key_size <= header || key_size - header > LPM_DATA_SIZE_MAX ||
+        value_size == 0 || max_entries == 0)
+        return NULL;
+    struct bpf_lpm_trie *trie = calloc(1, sizeof(struct bpf_lpm_trie));
+    if (trie == NULL)
+        return NULL;
+    trie->data_size = key_size - header;
+    trie->value_size = value_size;
+    trie->value_offset = BPF_VALUE_ROUND(offsetof(struct lpm_trie_node, data) + trie->data_size);
+    trie->max_entries = max_entries;
+    return trie;
+}
+
+void *bpf_lpm_trie_lookup_elem(struct bpf_lpm_trie *trie, void *key) {
+    const struct bpf_lpm_trie_key *lpm_key = key;
+    const uint32_t max_prefixlen = trie->data_size * 8;
+    struct lpm_trie_node *found = NULL;
+    /* Walk down the nodes whose prefix the key matches, remembering the last
+     * one with a value */
+    for (struct lpm_trie_node *node = trie->root; node != NULL;) {
+        uint32_t matchlen = longest_prefix_match(trie, node, lpm_key);
+        if (matchlen == max_prefixlen) {
+            found = node;
+            break;
+        }
+        if (matchlen < node->prefixlen)
+            break;
+        if (!node->intermediate)
+            found = node;
+        node = node->child[extract_bit(lpm_key->data, node->prefixlen)];
+    }
+    if (found == NULL)
+        return NULL;
+    return lpm_trie_node_value(trie, found);
+}
+
+int bpf_lpm_trie_update_elem(struct bpf_lpm_trie *trie, void *key, void *value, unsigned long long flags) {
+    const struct bpf_lpm_trie_key *lpm_key = key;
+    if (lpm_key->prefixlen > trie->data_size * 8 || flags > USER_BPF_EXIST)
+        return EXIT_FAILURE;
+
+    /* Find the node where the prefix is, or where it diverges from the trie */
+    struct lpm_trie_node *node, **slot = &trie->root;
+    uint32_t matchlen = 0;
+    while ((node = *slot) != NULL) {
+        matchlen = longest_prefix_match(trie, node, lpm_key);
+        if (node->prefixlen != matchlen ||
+            node->prefixlen == lpm_key->prefixlen ||
+            node->prefixlen == trie->data_size * 8)
+            break;
+        slot = &node->child[extract_bit(lpm_key->data, node->prefixlen)];
+    }
+
+    /* The prefix exists: update its value in place */
+    bool same_prefix = node != NULL && node->prefixlen == matchlen &&
+                       node->prefixlen == lpm_key->prefixlen;
+    if (same_prefix && !node->intermediate) {
+        if (check_flags(node, flags))
+            return EXIT_FAILURE;
+        memcpy(lpm_trie_node_value(trie, node), value, trie->value_size);
+        return EXIT_SUCCESS;
+    }
+    if (check_flags(NULL, flags) || trie->n_entries == trie->max_entries)
+        return EXIT_FAILURE;
+
+    struct lpm_trie_node *new_node = lpm_trie_node_alloc(trie, value);
+    if (new_node == NULL)
+        return EXIT_FAILURE;
+    new_node->prefixlen = lpm_key->prefixlen;
+    memcpy(new_node->data, lpm_key->data, trie->data_size);
+    trie->n_entries++;
+
+    if (node == NULL) {
+        /* A new leaf */
+        *slot = new_node;
+    } else if (same_prefix) {
+        /* The prefix is that of an intermediate node, which gets the value */
+        new_node->child[0] = node->child[0];
+        new_node->child[1] = node->child[1];
+        *slot = new_node;
+        free(node);
+    } else if (matchlen == lpm_key->prefixlen) {
+        /* The new prefix is a prefix of the node */
+        new_node->child[extract_bit(node->data, matchlen)] = node;
+        *slot = new_node;
+    } else {
+        /* The two prefixes diverge: join them with an intermediate node */
+        struct lpm_trie_node *im_node = lpm_trie_node_alloc(trie, NULL);
+        if (im_node == NULL) {
+            free(new_node);
+            trie->n_entries--;
+            return EXIT_FAILURE;
+        }
+        im_node->prefixlen = matchlen;
+        memcpy(im_node->data, node->data, trie->data_size);
+        unsigned int bit = extract_bit(lpm_key->data, matchlen);
+        im_node->child[bit] = new_node;
+        im_node->child[!bit] = node;
+        *slot = im_node;
+    }
+    return EXIT_SUCCESS;
+}
+
+int bpf_lpm_trie_delete_elem(struct bpf_lpm_trie *trie, void *key) {
+    const struct bpf_lpm_trie_key *lpm_key = key;
+    if (lpm_key->prefixlen > trie->data_size * 8)
+        return EXIT_FAILURE;
+
+    /* Find the node, with the slot of its parent */
+    struct lpm_trie_node *node, *parent = NULL;
+    struct lpm_trie_node **trim = &trie->root, **trim_parent = trim;
+    uint32_t matchlen = 0;
+    while ((node = *trim) != NULL) {
+        matchlen = longest_prefix_match(trie, node, lpm_key);
+        if (node->prefixlen != matchlen || node->prefixlen == lpm_key->prefixlen)
+            break;
+        parent = node;
+        trim_parent = trim;
+        trim = &node->child[extract_bit(lpm_key->data, node->prefixlen)];
+    }
+    if (node == NULL || node->prefixlen != matchlen ||
+        node->prefixlen != lpm_key->prefixlen || node->intermediate)
+        return EXIT_FAILURE;
+    trie->n_entries--;
+
+    if (node->child[0] != NULL && node->child[1] != NULL) {
+        /* The node still joins its children */
+        node->intermediate = true;
+        return EXIT_SUCCESS;
+    }
+    if (parent != NULL && parent->intermediate &&
+        node->child[0] == NULL && node->child[1] == NULL) {
+        /* The parent is left with a single child, which replaces it */
+        *trim_parent = parent->child[parent->child[0] == node];
+        free(parent);
+        free(node);
+        return EXIT_SUCCESS;
+    }
+    /* The node has at most one child, which replaces it */
+    *trim = node->child[node->child[0] == NULL];
+    free(node);
+    return EXIT_SUCCESS;
+}
+
+static void lpm_trie_node_delete(struct lpm_trie_node *node) {
+    while (node != NULL) {
+        lpm_trie_node_delete(node->child[0]);
+        struct lpm_trie_node *next = node->child[1];
+        free(node);
+        node = next;
+    }
+}
+
+void bpf_lpm_trie_delete(struct bpf_lpm_trie *trie) {
+    if (trie == NULL)
+        return;
+    lpm_trie_node_delete(trie->root);
+    free(trie);
+}
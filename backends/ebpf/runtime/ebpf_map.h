@@ -15,13 +15,16 @@ limitations under the License.
 */
 
 /*
- * This file defines a library of simple hashmap operations which emulate the behavior
- * of the kernel ebpf map API. This library is currently not thread-safe.
+ * This file defines a library of simple map operations which emulate the behavior
+ * of the kernel ebpf map API: hash maps, arrays, and longest prefix match tries.
+ * Per-CPU maps are hash maps and arrays whose values hold one value for each CPU.
+ * This library is currently not thread-safe.
  */
 
 #ifndef BACKENDS_EBPF_RUNTIME_EBPF_MAP_H_
 #define BACKENDS_EBPF_RUNTIME_EBPF_MAP_H_
 
+#include <linux/bpf.h>        // struct bpf_lpm_trie_key
 #include "contrib/uthash.h"  // exports string.h, stddef.h, and stdlib.h
 
 struct bpf_map {
@@ -67,5 +70,94 @@ int bpf_map_delete_elem(struct bpf_map *map, void *key, unsigned int key_size);
  */
 int bpf_map_delete_map(struct bpf_map *map);
 
+/**
+ * @brief The number of CPUs which per-CPU maps hold a value for.
+ * @details Like in the kernel, this is the number of possible CPUs.
+ */
+unsigned int bpf_num_possible_cpus(void);
+
+/* The CPU the program runs on, which selects its values in per-CPU maps */
+extern unsigned int bpf_current_cpu;
+
+/* Like in the kernel, the values of arrays, tries and per-CPU maps start at
+ * 8-byte boundaries, so that programs can read them as 64-bit words */
+#define BPF_VALUE_ALIGN 8
+#define BPF_VALUE_ROUND(size) (((size) + BPF_VALUE_ALIGN - 1) & ~(size_t) (BPF_VALUE_ALIGN - 1))
+
+/*
+ * An array of max_entries values of the same size, indexed by a u32 key.
+ * All the values exist from the start, initialized to zero, and each one
+ * starts at a multiple of BPF_VALUE_ALIGN.
+ */
+struct bpf_array;
+
+/**
+ * @brief Allocate an array with the given number of values.
+ * @return NULL if the array cannot be allocated.
+ */
+struct bpf_array *bpf_array_create(unsigned int value_size, unsigned int max_entries);
+
+/**
+ * @brief Find a value based on its index.
+ * @return NULL if the index is out of bounds.
+ */
+void *bpf_array_lookup_elem(struct bpf_array *array, void *key);
+
+/**
+ * @brief Update a value in the array.
+ * @details As all the values exist, BPF_NOEXIST always fails.
+ *
+ * @return EXIT_FAILURE if the index is out of bounds or the flags are invalid.
+ */
+int bpf_array_update_elem(struct bpf_array *array, void *key, void *value, unsigned long long flags);
+
+/**
+ * @brief Delete the array with all its values.
+ */
+void bpf_array_delete(struct bpf_array *array);
+
+/*
+ * A longest prefix match trie. The keys are struct bpf_lpm_trie_key: a u32
+ * prefix length followed by the data, whose first prefixlen bits are matched,
+ * in network order. As in the kernel, the trie is path-compressed: each node
+ * holds a prefix, and a chain of nodes with a single child is a single node.
+ */
+struct bpf_lpm_trie;
+
+/**
+ * @brief Allocate an empty trie.
+ * @details The key size includes the prefix length, and must leave between
+ * 1 and 256 bytes of data, like in the kernel.
+ *
+ * @return NULL if the sizes are invalid.
+ */
+struct bpf_lpm_trie *bpf_lpm_trie_create(unsigned int key_size, unsigned int value_size, unsigned int max_entries);
+
+/**
+ * @brief Find the value of the longest prefix matching a key.
+ * @details The prefix length of the key bounds the length of the match.
+ *
+ * @return NULL if no prefix matches.
+ */
+void *bpf_lpm_trie_lookup_elem(struct bpf_lpm_trie *trie, void *key);
+
+/**
+ * @brief Add/Update the value of a prefix.
+ * @return EXIT_FAILURE if the prefix is too long, the flags reject the
+ * update, or the trie is full.
+ */
+int bpf_lpm_trie_update_elem(struct bpf_lpm_trie *trie, void *key, void *value, unsigned long long flags);
+
+/**
+ * @brief Delete a prefix and its value.
+ * @return EXIT_FAILURE if the prefix does not exist.
+ */
+int bpf_lpm_trie_delete_elem(struct bpf_lpm_trie *trie, void *key);
+
+/**
+ * @brief Delete the trie with all its prefixes and values.
+ */
+void bpf_lpm_trie_delete(struct bpf_lpm_trie *trie);
+
 
 #endif  // BACKENDS_EBPF_RUNTIME_EBPF_MAP_H_
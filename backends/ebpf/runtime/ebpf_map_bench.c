@@ -0,0 +1,118 @@
+/*
+Copyright 2018 VMware, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/* Microbenchmarks of the userspace map types. Each benchmark fills a table
+  through the registry, then times the lookups and updates of the program,
+  which access the table directly. Build and run with
+  make -f runtime.mk map_bench
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>       // clock_gettime()
+#include "ebpf_registry.h"
+
+#define ENTRIES 4096
+#define OPERATIONS 10000000
+
+struct lpm_key {
+    uint32_t prefixlen;
+    uint8_t addr[4];
+};
+
+/* The keys of the operations, which are spread over the entries */
+static uint32_t next_key(uint32_t i) {
+    return (i * 2654435761u) % ENTRIES;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *operation, double elapsed, uint64_t checksum) {
+    printf("%-12s %-7s %6.1f ns/op  (checksum %llu)\n", name, operation,
+           elapsed * 1e9 / OPERATIONS, (unsigned long long) checksum);
+}
+
+/* Lookups and updates of a table with u32 keys */
+static void bench_u32(const char *name, unsigned int type) {
+    struct bpf_table tbl = { (char *) name, type, sizeof(uint32_t), sizeof(uint64_t), ENTRIES, { NULL } };
+    if (registry_add(&tbl) != EXIT_SUCCESS)
+        return;
+    for (uint32_t key = 0; key < ENTRIES; key++) {
+        uint64_t value = key;
+        registry_update_bound(&tbl, &key, &value, BPF_ANY);
+    }
+
+    uint64_t checksum = 0;
+    double start = now();
+    for (uint32_t i = 0; i < OPERATIONS; i++) {
+        uint32_t key = next_key(i);
+        uint64_t *value = registry_lookup_bound_elem(&tbl, &key);
+        checksum += *value;
+    }
+    report(name, "lookup", now() - start, checksum);
+
+    start = now();
+    for (uint32_t i = 0; i < OPERATIONS; i++) {
+        uint32_t key = next_key(i);
+        uint64_t value = i;
+        registry_update_bound(&tbl, &key, &value, BPF_EXIST);
+    }
+    report(name, "update", now() - start, 0);
+    registry_delete_tbl(name);
+}
+
+/* Lookups of addresses in a table of prefixes of lengths 8 to 32 */
+static void bench_lpm(const char *name) {
+    struct bpf_table tbl = { (char *) name, BPF_MAP_TYPE_LPM_TRIE,
+                             sizeof(struct lpm_key), sizeof(uint64_t), ENTRIES, { NULL } };
+    if (registry_add(&tbl) != EXIT_SUCCESS)
+        return;
+    for (uint32_t i = 0; i < ENTRIES; i++) {
+        uint32_t addr = i * 2654435761u;
+        struct lpm_key key = { 8 + i % 25, { addr >> 24, addr >> 16, addr >> 8, addr } };
+        uint64_t value = i;
+        registry_update_bound(&tbl, &key, &value, BPF_ANY);
+    }
+
+    uint64_t checksum = 0, found = 0;
+    double start = now();
+    for (uint32_t i = 0; i < OPERATIONS; i++) {
+        uint32_t addr = next_key(i) * 2654435761u + (i & 0xff);
+        struct lpm_key key = { 32, { addr >> 24, addr >> 16, addr >> 8, addr } };
+        uint64_t *value = registry_lookup_bound_elem(&tbl, &key);
+        if (value != NULL) {
+            checksum += *value;
+            found++;
+        }
+    }
+    report(name, "lookup", now() - start, checksum);
+    printf("%-12s %llu of %d addresses matched a prefix\n", name,
+           (unsigned long long) found, OPERATIONS);
+    registry_delete_tbl(name);
+}
+
+int main(void) {
+    bench_u32("hash", BPF_MAP_TYPE_HASH);
+    bench_u32("array", BPF_MAP_TYPE_ARRAY);
+    bench_u32("percpu_hash", BPF_MAP_TYPE_PERCPU_HASH);
+    bench_u32("percpu_array", BPF_MAP_TYPE_PERCPU_ARRAY);
+    bench_lpm("lpm_trie");
+    return EXIT_SUCCESS;
+}
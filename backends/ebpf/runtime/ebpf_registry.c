@@ -18,6 +18,7 @@ limitations under the License.
 Implementation of ebpf registry. Intended to provide a common access interface between control and data plane. Emulates the linux userspace API which can access the kernel eBPF map using string and integer identifiers.
 */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include "ebpf_registry.h"
 
@@ -40,6 +41,99 @@ static int table_indexer = 0;
 static registry_entry *reg_tables_name = NULL;
 static registry_entry *reg_tables_id = NULL;
 
+static bool is_percpu(const struct bpf_table *tbl) {
+    return tbl->type == BPF_MAP_TYPE_PERCPU_HASH || tbl->type == BPF_MAP_TYPE_PERCPU_ARRAY;
+}
+
+/* The offset of the value of a CPU in the values of per-CPU tables, which
+ * start at BPF_VALUE_ALIGN boundaries like in the kernel */
+static size_t cpu_offset(const struct bpf_table *tbl, unsigned int cpu) {
+    return (size_t) cpu * BPF_VALUE_ROUND(tbl->value_size);
+}
+
+/* The size of the values in the map, which hold a value for each CPU
+ * in per-CPU tables */
+static unsigned int elem_size(const struct bpf_table *tbl) {
+    if (is_percpu(tbl))
+        return cpu_offset(tbl, bpf_num_possible_cpus());
+    return tbl->value_size;
+}
+
+static int create_map(struct bpf_table *tbl) {
+    switch (tbl->type) {
+    case BPF_MAP_TYPE_UNSPEC:
+    case BPF_MAP_TYPE_HASH:
+    case BPF_MAP_TYPE_PERCPU_HASH:
+        /* uthash allocates the map with its first entry */
+        tbl->bpf_map = NULL;
+        return EXIT_SUCCESS;
+    case BPF_MAP_TYPE_ARRAY:
+    case BPF_MAP_TYPE_PERCPU_ARRAY:
+        if (tbl->key_size != sizeof(uint32_t))
+            return EXIT_FAILURE;
+        tbl->bpf_array = bpf_array_create(elem_size(tbl), tbl->max_entries);
+        return tbl->bpf_array ? EXIT_SUCCESS : EXIT_FAILURE;
+    case BPF_MAP_TYPE_LPM_TRIE:
+        tbl->bpf_lpm_trie = bpf_lpm_trie_create(tbl->key_size, tbl->value_size, tbl->max_entries);
+        return tbl->bpf_lpm_trie ? EXIT_SUCCESS : EXIT_FAILURE;
+    default:
+        return EXIT_FAILURE;
+    }
+}
+
+static void delete_map(struct bpf_table *tbl) {
+    switch (tbl->type) {
+    case BPF_MAP_TYPE_ARRAY:
+    case BPF_MAP_TYPE_PERCPU_ARRAY:
+        bpf_array_delete(tbl->bpf_array);
+        tbl->bpf_array = NULL;
+        break;
+    case BPF_MAP_TYPE_LPM_TRIE:
+        bpf_lpm_trie_delete(tbl->bpf_lpm_trie);
+        tbl->bpf_lpm_trie = NULL;
+        break;
+    default:
+        bpf_map_delete_map(tbl->bpf_map);
+        /* the program may still hold the table */
+        tbl->bpf_map = NULL;
+    }
+}
+
+/* The value of a key, for all the CPUs in per-CPU tables */
+static void *lookup_elem(struct bpf_table *tbl, void *key) {
+    switch (tbl->type) {
+    case BPF_MAP_TYPE_ARRAY:
+    case BPF_MAP_TYPE_PERCPU_ARRAY:
+        if (tbl->bpf_array == NULL)
+            return NULL;
+        return bpf_array_lookup_elem(tbl->bpf_array, key);
+    case BPF_MAP_TYPE_LPM_TRIE:
+        if (tbl->bpf_lpm_trie == NULL)
+            return NULL;
+        return bpf_lpm_trie_lookup_elem(tbl->bpf_lpm_trie, key);
+    default:
+        /* the map is empty if nothing was inserted yet */
+        return bpf_map_lookup_elem(tbl->bpf_map, key, tbl->key_size);
+    }
+}
+
+/* Update the value of a key, for all the CPUs in per-CPU tables */
+static int update_elem(struct bpf_table *tbl, void *key, void *value, unsigned long long flags) {
+    switch (tbl->type) {
+    case BPF_MAP_TYPE_ARRAY:
+    case BPF_MAP_TYPE_PERCPU_ARRAY:
+        if (tbl->bpf_array == NULL)
+            return EXIT_FAILURE;
+        return bpf_array_update_elem(tbl->bpf_array, key, value, flags);
+    case BPF_MAP_TYPE_LPM_TRIE:
+        if (tbl->bpf_lpm_trie == NULL)
+            return EXIT_FAILURE;
+        return bpf_lpm_trie_update_elem(tbl->bpf_lpm_trie, key, value, flags);
+    default:
+        return bpf_map_update_elem(&tbl->bpf_map, key, tbl->key_size, value, elem_size(tbl), flags);
+    }
+}
+
 static registry_entry *find_register(const char *name) {
     if (strlen(name) > MAX_TABLE_NAME_LENGTH){
         fprintf(stderr, "Error: Key name %s exceeds maximum size %d", name, MAX_TABLE_NAME_LENGTH);
@@ -62,6 +156,10 @@ int registry_add(struct bpf_table *tbl) {
         fprintf(stderr, "Error: Key name %s exceeds maximum size %d", tbl->name, MAX_TABLE_NAME_LENGTH);
         return EXIT_FAILURE;
     }
+    if (create_map(tbl) != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: Cannot create table %s of type %u\n", tbl->name, tbl->type);
+        return EXIT_FAILURE;
+    }
     /* Add the table */
     tmp_reg = malloc(sizeof(registry_entry));
     if (!tmp_reg) {
@@ -83,20 +181,16 @@ void registry_delete() {
     registry_entry *curr_tbl, *tmp_tbl;
     HASH_ITER(h_name, reg_tables_name, curr_tbl, tmp_tbl) {
         HASH_DELETE(h_name, reg_tables_name, curr_tbl);
-        bpf_map_delete_map(curr_tbl->tbl->bpf_map);
-        free(curr_tbl);
-    }
-    curr_tbl = NULL;
-    tmp_tbl = NULL;
-    HASH_ITER(h_id, reg_tables_id, curr_tbl, tmp_tbl) {
         HASH_DELETE(h_id, reg_tables_id, curr_tbl);
+        delete_map(curr_tbl->tbl);
+        free(curr_tbl);
     }
 }
 
 int registry_delete_tbl(const char *name) {
     registry_entry *tmp_reg = find_register(name);
     if (tmp_reg != NULL) {
-        bpf_map_delete_map(tmp_reg->tbl->bpf_map);
+        delete_map(tmp_reg->tbl);
         HASH_DELETE(h_name, reg_tables_name, tmp_reg);
         HASH_DELETE(h_id, reg_tables_id, tmp_reg);
         free(tmp_reg);
@@ -125,8 +219,7 @@ int registry_update_table(const char *name, void *key, void *value, unsigned lon
     if (tmp_tbl == NULL)
         /* not found, return */
         return EXIT_FAILURE;
-    bpf_map_update_elem(&tmp_tbl->bpf_map, key, tmp_tbl->key_size, value, tmp_tbl->value_size, flags);
-    return EXIT_SUCCESS;
+    return update_elem(tmp_tbl, key, value, flags);
 }
 
 int registry_update_table_id(int tbl_id, void *key, void *value, unsigned long long flags) {
@@ -134,8 +227,7 @@ int registry_update_table_id(int tbl_id, void *key, void *value, unsigned long l
     if (tmp_tbl == NULL)
         /* not found, return */
         return EXIT_FAILURE;
-    bpf_map_update_elem(&tmp_tbl->bpf_map, key, tmp_tbl->key_size, value, tmp_tbl->value_size, flags);
-    return EXIT_SUCCESS;
+    return update_elem(tmp_tbl, key, value, flags);
 }
 
 void *registry_lookup_table_elem(const char *name, void *key) {
@@ -143,8 +235,7 @@ void *registry_lookup_table_elem(const char *name, void *key) {
     if (tmp_tbl == NULL)
         /* not found, return */
         return NULL;
-    if (tmp_tbl->bpf_map)
-    return bpf_map_lookup_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size);
+    return lookup_elem(tmp_tbl, key);
 }
 
 void *registry_lookup_table_elem_id(int tbl_id, void *key) {
@@ -152,8 +243,35 @@ void *registry_lookup_table_elem_id(int tbl_id, void *key) {
     if (tmp_tbl == NULL)
         /* not found, return */
         return NULL;
-    if (tmp_tbl->bpf_map)
-    return bpf_map_lookup_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size);
+    return lookup_elem(tmp_tbl, key);
+}
+
+void *registry_lookup_bound_elem(struct bpf_table *tbl, void *key) {
+    char *values = lookup_elem(tbl, key);
+    if (values == NULL || !is_percpu(tbl))
+        return values;
+    return values + cpu_offset(tbl, bpf_current_cpu);
+}
+
+int registry_update_bound(struct bpf_table *tbl, void *key, void *value, unsigned long long flags) {
+    if (!is_percpu(tbl))
+        return update_elem(tbl, key, value, flags);
+    /* Only the value of the current CPU changes */
+    char *values = lookup_elem(tbl, key);
+    if (values != NULL) {
+        if (flags == BPF_NOEXIST)
+            return EXIT_FAILURE;
+        memcpy(values + cpu_offset(tbl, bpf_current_cpu), value, tbl->value_size);
+        return EXIT_SUCCESS;
+    }
+    /* A new entry, where the other CPUs have zero values */
+    values = calloc(1, elem_size(tbl));
+    if (values == NULL)
+        return EXIT_FAILURE;
+    memcpy(values + cpu_offset(tbl, bpf_current_cpu), value, tbl->value_size);
+    int ret = update_elem(tbl, key, values, flags);
+    free(values);
+    return ret;
 }
 
 int registry_get_id(const char *name) {
@@ -32,25 +32,36 @@ limitations under the License.
  * @brief A helper structure used to describe attributes.
  * @details This structure describes various properties of the ebpf table
  * such as key and value size and the maximum amount of entries possible.
- * In userspace, this space is theoretically unlimited.
- * This table definition points to an actual hashmap managed by uthash,
- * the relation is many-to-one.
+ * In userspace, this space is theoretically unlimited for hash maps.
+ * The type is one of the BPF_MAP_TYPE values of linux/bpf.h; the hash,
+ * array, LPM trie, and per-CPU hash and array types are supported, and an
+ * unspecified type is a hash map. The values of a per-CPU table hold
+ * value_size bytes for each CPU. The program only accesses the value of the
+ * CPU it runs on, while the registry accesses the values of all CPUs, like
+ * the kernel API does.
+ * This table definition points to the actual map, which is allocated when
+ * the table is added to the registry; the relation is many-to-one.
  * "name" should not exceed VAR_SIZE. Functions using bpf_table also assume
  * that "name" is a conventional null-terminated string.
  */
 struct bpf_table {
     char *name;                 // table name longer than VAR_SIZE is not accessed
-    unsigned int type;          // currently only hashmap is supported
+    unsigned int type;          // the type of the map
     unsigned int key_size;      // size of the key structure
     unsigned int value_size;    // size of the value structure
     unsigned int max_entries;   // Maximum of possible entries
-    struct bpf_map *bpf_map;    // Pointer to the actual hash map
+    union {
+        struct bpf_map *bpf_map;            // Pointer to the actual hash map
+        struct bpf_array *bpf_array;        // Pointer to the array
+        struct bpf_lpm_trie *bpf_lpm_trie;  // Pointer to the LPM trie
+    };
 };
 
 /**
  * @brief Adds a new table to the registry.
  * @details Adds a new table to the shared registry and assigns
  * an id to it. This operation uses a char name stored in "table" as a key.
+ * Also allocates the map of the table, according to its type.
   * @return EXIT_FAILURE if map already exists or cannot be added.
  */
 int registry_add(struct bpf_table *tbl);
@@ -96,20 +107,20 @@ struct bpf_table *registry_lookup_table_id(int tbl_id);
 int registry_get_id(const char *name);
 
 /**
- * @brief Insert a key/value pair into the hashmap.
+ * @brief Insert a key/value pair into a table.
  * @details A safe wrapper function to update a bpf map.
  * If the map can be found and exists, this function calls
- * the bpf_map_update_elem function to insert an entry.
+ * the update function of its map to insert an entry.
  * This operation uses a char name as the key.
  * @return EXIT_FAILURE if map cannot be found.
  */
 int registry_update_table(const char *name, void *key, void *value, unsigned long long flags);
 
 /**
- * @brief Insert a key/value pair into the hashmap.
+ * @brief Insert a key/value pair into a table.
  * @details A safe wrapper function to update a bpf map.
  * If the map can be found and exists, this function calls
- * the bpf_map_update_elem function to insert an entry.
+ * the update function of its map to insert an entry.
  * This operation uses an integer as the key.
  * @return EXIT_FAILURE if map cannot be found.
  */
@@ -117,9 +128,9 @@ int registry_update_table_id(int tbl_id, void *key, void *value, unsigned long l
 
 /**
  * @brief Retrieve a value from a bpf map through the registry.
- * @details A wrapper function to retrieve a value from a hash map
+ * @details A wrapper function to retrieve a value from a table
  * where only the name is known. The function looks up the identifier
- * in the registry and calls bpf_map_lookup_elem on the retrieved list.
+ * in the registry and calls the lookup function of its map.
  * If there is no table, this function also returns NULL.
  * This operation uses a char name as the key.
  * @return NULL if the value cannot be found.
@@ -128,13 +139,34 @@ void *registry_lookup_table_elem(const char *name, void *key);
 
 /**
  * @brief Retrieve a value from a bpf map through the registry.
- * @details A wrapper function to retrieve a value from a hash map
+ * @details A wrapper function to retrieve a value from a table
  * where only the name is known. The function looks up the identifier
- * in the registry and calls bpf_map_lookup_elem on the retrieved list.
+ * in the registry and calls the lookup function of its map.
  * If there is no table, this function also returns NULL.
  * This operation uses an integer as the key.
  * @return NULL if the value cannot be found.
  */
 void *registry_lookup_table_elem_id(int tbl_id, void *key);
 
+/**
+ * @brief Retrieve a value from a table bound to the program.
+ * @details The program holds its tables directly, and adds them to the
+ * registry at initialization. Lookups then go straight to the map of the
+ * table, without going through the registry.
+ * If the table has been deleted from the registry, its map is empty
+ * and this function returns NULL.
+ * For per-CPU tables, this is the value of the current CPU.
+ * @return NULL if the value cannot be found.
+ */
+void *registry_lookup_bound_elem(struct bpf_table *tbl, void *key);
+
+/**
+ * @brief Insert a key/value pair into a table bound to the program.
+ * @details Like registry_lookup_bound_elem, this goes straight to the
+ * map of the table, which must be in the registry. For per-CPU tables,
+ * this updates the value of the current CPU.
+ * @return EXIT_FAILURE if the update operation fails.
+ */
+int registry_update_bound(struct bpf_table *tbl, void *key, void *value, unsigned long long flags);
+
 #endif  // BACKENDS_EBPF_RUNTIME_EBPF_REGISTRY_H_
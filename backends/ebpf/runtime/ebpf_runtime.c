@@ -34,6 +34,11 @@ limitations under the License.
 #define DELIM   '_'
 
 static int debug = 0;
+/* If not zero, the number of times the packets are fed into the program
+ * to measure its throughput, instead of recording its output. */
+static uint32_t bench_rounds = 0;
+/* Stream the packets from the input files, instead of loading them all */
+static int stream = 0;
 
 void usage(char *name) {
     fprintf(stderr, "This program expects a pcap file pattern, "
@@ -41,9 +46,15 @@ void usage(char *name) {
             "in the order given by the packet time,"
             "then feeds the individual packets into a filter function, "
             "and returns the output.\n");
-    fprintf(stderr, "Usage: %s [-d] -f file.pcap -n num_pcaps\n", name);
+    fprintf(stderr, "Usage: %s [-d] [-s | -b rounds] -f file.pcap -n num_pcaps\n", name);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "\t-d: Turn on debug messages\n");
+    fprintf(stderr, "\t-b: Benchmark the program, feeding it the packets "
+            "the given number of times, and report the packets per second "
+            "instead of writing the output\n");
+    fprintf(stderr, "\t-s: Stream the packets from the input files in batches, "
+            "instead of loading all of them in memory, and report the "
+            "packets per second\n");
     fprintf(stderr, "\t-f: The input pcap file\n");
     fprintf(stderr, "\t-n: Specifies the number of input pcap files\n");
     exit(EXIT_FAILURE);
@@ -67,8 +78,6 @@ static pcap_list_t *get_packets(const char *pcap_base, uint16_t num_pcaps, pcap_
 void launch_runtime(const char *pcap_name, uint16_t num_pcaps) {
     if (num_pcaps == 0)
         return;
-    /* Initialize the list of input packets */
-    pcap_list_t *input_list = allocate_pkt_list();
 
     /* Create the basic pcap filename from the input */
     const char *suffix = strrchr(pcap_name, DELIM);
@@ -81,12 +90,23 @@ void launch_runtime(const char *pcap_name, uint16_t num_pcaps) {
     char pcap_base[baselen + 1];
     snprintf(pcap_base, baselen + 1 , "%s", pcap_name);
 
+    if (stream) {
+        /* Run the "program" on the packets as they are read */
+        STREAM(ebpf_filter, pcap_base, num_pcaps, PCAPIN, debug);
+        return;
+    }
+    /* Initialize the list of input packets */
+    pcap_list_t *input_list = allocate_pkt_list();
     /* Open all matching pcap files retrieve a merged list of packets */
     input_list = get_packets(pcap_base, num_pcaps, input_list);
     /* Sort the list */
     sort_pcap_list(input_list);
-    /* Run the "program" and retrieve output lists */
-    RUN(ebpf_filter, pcap_base, num_pcaps, input_list, debug);
+    if (bench_rounds > 0)
+        /* Measure the throughput of the "program" */
+        BENCH(ebpf_filter, input_list, bench_rounds, debug);
+    else
+        /* Run the "program" and retrieve output lists */
+        RUN(ebpf_filter, pcap_base, num_pcaps, input_list, debug);
     /* Delete the list of input packets */
     delete_list(input_list);
 }
@@ -97,11 +117,14 @@ int main(int argc, char **argv) {
     int c;
     opterr = 0;
 
-    while ((c = getopt (argc, argv, "dn:f:")) != -1) {
+    while ((c = getopt (argc, argv, "dsn:f:b:")) != -1) {
         switch (c) {
             case 'd':
             debug = 1;
             break;
+            case 's':
+                stream = 1;
+            break;
             case 'n':
                 num_pcaps = (int)strtol(optarg, (char **)NULL, 10);
                 if (num_pcaps < 0 || num_pcaps > UINT16_MAX) {
@@ -114,6 +137,17 @@ int main(int argc, char **argv) {
             case 'f':
                 pcap_name = optarg;
             break;
+            case 'b': {
+                long rounds = strtol(optarg, (char **)NULL, 10);
+                if (rounds <= 0 || rounds > UINT32_MAX) {
+                    fprintf(stderr,
+                        "Number of benchmark rounds out of bounds! Maximum is %u\n",
+                        UINT32_MAX);
+                    return EXIT_FAILURE;
+                }
+                bench_rounds = (uint32_t)rounds;
+            }
+            break;
             case '?':
                 if (optopt == 'f')
                     fprintf(stderr, "The input trace file is missing. "
@@ -131,7 +165,7 @@ int main(int argc, char **argv) {
     }
 
     /* Check if there was actually any file or number input */
-    if (!pcap_name || num_pcaps == -1)
+    if (!pcap_name || num_pcaps == -1 || (stream && bench_rounds > 0))
         usage(argv[0]);
 
     INIT_EBPF_TABLES(debug);
@@ -31,6 +31,11 @@ void run_and_record_output(pcap_list_t *pkt_list, char *pcap_base, uint16_t num_
 
 #define RUN(ebpf_filter, pcap_base, num_pcaps, input_list, debug) \
     run_and_record_output(input_list, pcap_base, num_pcaps, debug)
+/* The program runs in the kernel, where it cannot be timed from here */
+#define STREAM(ebpf_filter, pcap_base, num_pcaps, suffix, debug) \
+    fprintf(stderr, "Streaming is not supported by the kernel target\n")
+#define BENCH(ebpf_filter, input_list, rounds, debug) \
+    fprintf(stderr, "Benchmarking is not supported by the kernel target\n")
 #define INIT_EBPF_TABLES(debug)
 #define DELETE_EBPF_TABLES(debug)
 
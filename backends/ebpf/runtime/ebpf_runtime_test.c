@@ -18,10 +18,28 @@ limitations under the License.
 #include <ctype.h>      // isprint()
 #include <string.h>     // memcpy()
 #include <stdlib.h>     // malloc()
+#include <time.h>       // clock_gettime()
 #include "ebpf_test.h"
 #include "ebpf_runtime_test.h"
 
 #define PCAPOUT "_out.pcap"
+/* The number of packets fed to the filter at once when streaming */
+#define PKT_BATCH_SIZE 256
+/* The size of the output buffer of each interface when streaming */
+#define PCAP_OUT_BUFFER_SIZE (1 << 20)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report_throughput(uint64_t total, double elapsed) {
+    printf("Processed %llu packets in %.3f s: %.0f packets/s, %.1f ns/packet\n",
+           (unsigned long long) total, elapsed,
+           elapsed > 0 ? total / elapsed : 0.0,
+           total > 0 ? elapsed * 1e9 / total : 0.0);
+}
 
 /**
  * @brief Feed a list packets into an eBPF program.
@@ -80,24 +98,94 @@ void *run_and_record_output(packet_filter ebpf_filter, const char *pcap_base, pc
     delete_array(output_array);
 }
 
+/**
+ * @brief Measure the throughput of an eBPF program.
+ * @details Feeds the list of packets into the filter function the given
+ * number of times, without recording any output, and reports the packets
+ * processed per second. The packets are not copied, so the filter sees the
+ * changes it made to them in previous rounds, as feed_packets does.
+ *
+ * @param pkt_list A list of input packets running through the filter.
+ * @param rounds The number of times the list is fed into the filter.
+ */
+void benchmark_filter(packet_filter ebpf_filter, pcap_list_t *pkt_list, uint32_t rounds, int debug) {
+    uint32_t list_len = get_pkt_list_length(pkt_list);
+    uint64_t passed = 0;
+    double start = now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t i = 0; i < list_len; i++) {
+            struct sk_buff skb;
+            pcap_pkt *input_pkt = get_packet(pkt_list, i);
+            skb.data = (void *) input_pkt->data;
+            skb.len = input_pkt->pcap_hdr.len;
+            passed += ebpf_filter(&skb) != 0;
+        }
+    }
+    double elapsed = now() - start;
+    if (debug)
+        printf("%llu of the packets passed the filter\n", (unsigned long long) passed);
+    report_throughput((uint64_t) list_len * rounds, elapsed);
+}
+
+/**
+ * @brief Stream the packets of the input files through an eBPF program.
+ * @details Like run_and_record_output, but the input files are merged on the
+ * fly, and the packets are fed to the filter in batches, without copying
+ * them. The packets surviving the filter go through bounded buffers to the
+ * output files. Reports the packets processed per second, including the
+ * time spent reading and writing the files.
+ *
+ * @param pcap_base The base name of the input and output files.
+ * @param num_pcaps The number of input files.
+ * @param suffix The suffix of the input files.
+ */
+void stream_and_record_output(packet_filter ebpf_filter, const char *pcap_base,
+                              uint16_t num_pcaps, const char *suffix, int debug) {
+    pcap_stream_t *stream = open_pcap_stream(pcap_base, num_pcaps, suffix);
+    if (stream == NULL)
+        exit(EXIT_FAILURE);
+    pcap_writer_t *writer = open_pcap_writer(pcap_base, PCAPOUT, PCAP_OUT_BUFFER_SIZE);
+    pcap_pkt batch[PKT_BATCH_SIZE];
+    int results[PKT_BATCH_SIZE];
+    uint64_t total = 0;
+    uint32_t num_pkts;
+    double start = now();
+    while ((num_pkts = read_pkt_batch(stream, batch, PKT_BATCH_SIZE)) > 0) {
+        for (uint32_t i = 0; i < num_pkts; i++) {
+            struct sk_buff skb;
+            skb.data = (void *) batch[i].data;
+            skb.len = batch[i].pcap_hdr.caplen;
+            results[i] = ebpf_filter(&skb);
+        }
+        for (uint32_t i = 0; i < num_pkts; i++) {
+            if (debug)
+                printf("Result of the eBPF parsing is: %d\n", results[i]);
+            if (results[i] != 0 && write_pkt(writer, &batch[i]) != EXIT_SUCCESS)
+                exit(EXIT_FAILURE);
+        }
+        total += num_pkts;
+    }
+    close_pcap_writer(writer);
+    double elapsed = now() - start;
+    close_pcap_stream(stream);
+    report_throughput(total, elapsed);
+}
+
 void init_ebpf_tables(int debug) {
-    /* Initialize the registry of shared tables */
-    struct bpf_table* current = tables;
-    while (current->name != NULL) {
+    /* Initialize the registry of shared tables. This binds each table of the
+     * program to its map, so the program never looks up the registry. */
+    for (struct bpf_table **current = EBPF_TABLES_BEGIN; current < EBPF_TABLES_END; current++) {
         if (debug)
-            printf("Adding table %s\n", current->name);
-        BPF_OBJ_PIN(current, current->name);
-        current++;
+            printf("Adding table %s\n", (*current)->name);
+        BPF_OBJ_PIN(*current, (*current)->name);
     }
 }
 
 void delete_ebpf_tables(int debug) {
     /* Delete all the remaining tables in the user program */
-    struct bpf_table* current = tables;
-    while (current->name != NULL) {
+    for (struct bpf_table **current = EBPF_TABLES_BEGIN; current < EBPF_TABLES_END; current++) {
         if (debug)
-            printf("Deleting table %s\n", current->name);
-        registry_delete_tbl(current->name);
-        current++;
+            printf("Deleting table %s\n", (*current)->name);
+        registry_delete_tbl((*current)->name);
     }
 }
\ No newline at end of file
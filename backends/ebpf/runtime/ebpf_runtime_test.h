@@ -29,11 +29,18 @@ limitations under the License.
 typedef int (*packet_filter)(SK_BUFF* s);
 
 void *run_and_record_output(packet_filter ebpf_filter, const char *pcap_base, pcap_list_t *pkt_list, int debug);
+void stream_and_record_output(packet_filter ebpf_filter, const char *pcap_base,
+                              uint16_t num_pcaps, const char *suffix, int debug);
+void benchmark_filter(packet_filter ebpf_filter, pcap_list_t *pkt_list, uint32_t rounds, int debug);
 void init_ebpf_tables(int debug);
 void delete_ebpf_tables(int debug);
 
 #define RUN(ebpf_filter, pcap_base, num_pcaps, input_list, debug) \
     run_and_record_output(ebpf_filter, pcap_base, input_list, debug)
+#define STREAM(ebpf_filter, pcap_base, num_pcaps, suffix, debug) \
+    stream_and_record_output(ebpf_filter, pcap_base, num_pcaps, suffix, debug)
+#define BENCH(ebpf_filter, input_list, rounds, debug) \
+    benchmark_filter(ebpf_filter, input_list, rounds, debug)
 #define INIT_EBPF_TABLES(debug) init_ebpf_tables(debug)
 #define DELETE_EBPF_TABLES(debug) delete_ebpf_tables(debug)
 
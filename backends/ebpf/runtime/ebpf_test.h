@@ -50,18 +50,25 @@ struct sk_buff {
 };
 
 #define SK_BUFF struct sk_buff
-#define REGISTER_START() \
-struct bpf_table tables[] = {
+
+/*
+ * Like the maps of a kernel program, each table is a global variable, so the
+ * program accesses it directly instead of looking up its name in the registry
+ * for every packet. A pointer to each table is placed in the "ebpf_tables"
+ * section, where init_ebpf_tables finds them all to add them to the registry.
+ */
+#define REGISTER_START()
 #define REGISTER_TABLE(NAME, TYPE, KEY_SIZE, VALUE_SIZE, MAX_ENTRIES) \
-    { MAP_PATH"/"#NAME, TYPE, KEY_SIZE, VALUE_SIZE, MAX_ENTRIES, NULL },
-#define REGISTER_END() \
-    { 0, 0, 0, 0, 0 } \
-};
+    struct bpf_table NAME = \
+        { MAP_PATH"/"#NAME, TYPE, KEY_SIZE, VALUE_SIZE, MAX_ENTRIES, { NULL } }; \
+    static struct bpf_table *NAME##_entry \
+        __attribute__((section("ebpf_tables"), used)) = &NAME;
+#define REGISTER_END()
 
 #define BPF_MAP_LOOKUP_ELEM(table, key) \
-    registry_lookup_table_elem(MAP_PATH"/"#table, key)
+    registry_lookup_bound_elem(&table, key)
 #define BPF_MAP_UPDATE_ELEM(table, key, value, flags) \
-    registry_update_table(MAP_PATH"/"#table, key, value, flags)
+    registry_update_bound(&table, key, value, flags)
 #define BPF_USER_MAP_UPDATE_ELEM(index, key, value, flags)\
     registry_update_table_id(index, key, value, flags)
 #define BPF_OBJ_PIN(table, name) registry_add(table)
@@ -77,8 +84,14 @@ static inline void print_n_bytes(void *receiveBuffer, int num) {
     printf("\n");
 }
 
-/* These should be automatically generated and included in the generated x.h header file */
-extern struct bpf_table tables[];
+/* The bounds of the "ebpf_tables" section, defined by the linker.
+ * They are weak, as a program without tables has no such section. */
+extern struct bpf_table *__start_ebpf_tables[] __attribute__((weak));
+extern struct bpf_table *__stop_ebpf_tables[] __attribute__((weak));
+#define EBPF_TABLES_BEGIN __start_ebpf_tables
+#define EBPF_TABLES_END __stop_ebpf_tables
+
+/* This should be automatically generated and included in the generated x.h header file */
 extern int ebpf_filter(struct sk_buff *skb);
 
 #endif  // BACKENDS_EBPF_RUNTIME_EBPF_USER_H_
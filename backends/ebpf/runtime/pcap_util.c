@@ -16,6 +16,11 @@ limitations under the License.
 
 #include <stdlib.h>     // EXIT_SUCCESS, EXIT_FAILURE
 #include <string.h>     // memcpy()
+#include <stdbool.h>    // bool
+#include <fcntl.h>      // open()
+#include <unistd.h>     // close()
+#include <sys/mman.h>   // mmap()
+#include <sys/stat.h>   // fstat()
 #include "pcap_util.h"
 
 #define DLT_EN10MB 1        // Ethernet Link Type, see also 'man pcap-linktype'
@@ -253,4 +258,293 @@ char *generate_pcap_name(const char *pcap_base, int index, const char *suffix) {
         exit(EXIT_FAILURE);
     }
     return pcap_name;
-}
\ No newline at end of file
+}
+
+/* The classic pcap format, see also 'man pcap-savefile' */
+#define PCAP_MAGIC          0xa1b2c3d4  // microsecond timestamps
+#define PCAP_MAGIC_NSEC     0xa1b23c4d  // nanosecond timestamps
+#define PCAP_FILE_HDR_LEN   24
+#define PCAP_REC_HDR_LEN    16
+/* The mapped data of a file is released in chunks of this size once read */
+#define PCAP_RELEASE_CHUNK  (8 << 20)
+
+/* A mapped input file, with the next packet to read from it */
+struct pcap_file {
+    uint8_t *base;
+    size_t size;
+    size_t offset;      // the start of the packet after the next one
+    size_t released;    // the end of the data released so far
+    bool swapped;       // the file was written with the other byte order
+    bool nsec;          // the timestamps are in nanoseconds
+    bool finished;      // all the packets have been read
+    pcap_pkt next;
+};
+
+struct pcap_stream {
+    struct pcap_file *files;
+    uint16_t num_files;
+    /* A heap of the files which have packets left, ordered by their next
+       packet: the first one has the earliest packet */
+    uint16_t *heap;
+    uint16_t heap_len;
+};
+
+static uint32_t read_u32(const struct pcap_file *file, const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return file->swapped ? __builtin_bswap32(value) : value;
+}
+
+/* Parse the next packet of the file. Returns false at the end of the file. */
+static bool read_next_pkt(struct pcap_file *file) {
+    if (file->size - file->offset < PCAP_REC_HDR_LEN) {
+        file->finished = true;
+        return false;
+    }
+    const uint8_t *rec = file->base + file->offset;
+    uint32_t caplen = read_u32(file, rec + 8);
+    if (file->size - file->offset - PCAP_REC_HDR_LEN < caplen) {
+        fprintf(stderr, "Warning: Truncated packet at the end of a pcap file\n");
+        file->finished = true;
+        return false;
+    }
+    pcap_pkt *pkt = &file->next;
+    pkt->pcap_hdr.ts.tv_sec = read_u32(file, rec);
+    pkt->pcap_hdr.ts.tv_usec = read_u32(file, rec + 4);
+    if (file->nsec)
+        pkt->pcap_hdr.ts.tv_usec /= 1000;
+    pkt->pcap_hdr.caplen = caplen;
+    pkt->pcap_hdr.len = read_u32(file, rec + 12);
+    pkt->data = (char *) rec + PCAP_REC_HDR_LEN;
+    file->offset += PCAP_REC_HDR_LEN + caplen;
+    return true;
+}
+
+static int open_pcap_file(struct pcap_file *file, const char *pcap_file_name) {
+    int fd = open(pcap_file_name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open pcap file! %s \n", pcap_file_name);
+        perror("open");
+        return EXIT_FAILURE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < PCAP_FILE_HDR_LEN) {
+        fprintf(stderr, "Error: %s is not a pcap file\n", pcap_file_name);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    file->size = st.st_size;
+    file->base = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file->base == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    madvise(file->base, file->size, MADV_SEQUENTIAL);
+
+    uint32_t magic;
+    memcpy(&magic, file->base, sizeof(magic));
+    file->swapped = magic == __builtin_bswap32(PCAP_MAGIC) ||
+                    magic == __builtin_bswap32(PCAP_MAGIC_NSEC);
+    if (file->swapped)
+        magic = __builtin_bswap32(magic);
+    if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NSEC) {
+        fprintf(stderr, "Error: %s is not in the classic pcap format\n", pcap_file_name);
+        munmap(file->base, file->size);
+        return EXIT_FAILURE;
+    }
+    file->nsec = magic == PCAP_MAGIC_NSEC;
+    file->offset = PCAP_FILE_HDR_LEN;
+    file->released = 0;
+    return EXIT_SUCCESS;
+}
+
+/* Rank the next packets of two files by timestamp, then interface */
+static bool pkt_before(const struct pcap_stream *stream, uint16_t f1, uint16_t f2) {
+    const pcap_pkt *p1 = &stream->files[f1].next;
+    const pcap_pkt *p2 = &stream->files[f2].next;
+    if (p1->pcap_hdr.ts.tv_sec != p2->pcap_hdr.ts.tv_sec)
+        return p1->pcap_hdr.ts.tv_sec < p2->pcap_hdr.ts.tv_sec;
+    if (p1->pcap_hdr.ts.tv_usec != p2->pcap_hdr.ts.tv_usec)
+        return p1->pcap_hdr.ts.tv_usec < p2->pcap_hdr.ts.tv_usec;
+    return f1 < f2;
+}
+
+static void sift_down(pcap_stream_t *stream, uint16_t pos) {
+    uint16_t *heap = stream->heap;
+    for (;;) {
+        uint32_t smallest = pos, left = 2 * pos + 1, right = left + 1;
+        if (left < stream->heap_len && pkt_before(stream, heap[left], heap[smallest]))
+            smallest = left;
+        if (right < stream->heap_len && pkt_before(stream, heap[right], heap[smallest]))
+            smallest = right;
+        if (smallest == pos)
+            return;
+        uint16_t tmp = heap[pos];
+        heap[pos] = heap[smallest];
+        heap[smallest] = tmp;
+        pos = smallest;
+    }
+}
+
+pcap_stream_t *open_pcap_stream(const char *pcap_base, uint16_t num_pcaps, const char *suffix) {
+    pcap_stream_t *stream = calloc(1, sizeof(pcap_stream_t));
+    stream->files = calloc(num_pcaps, sizeof(struct pcap_file));
+    stream->heap = calloc(num_pcaps, sizeof(uint16_t));
+    if (stream->files == NULL || stream->heap == NULL) {
+        fprintf(stderr, "Fatal: Failed to allocate the stream of %u files!\n", num_pcaps);
+        exit(EXIT_FAILURE);
+    }
+    for (uint16_t i = 0; i < num_pcaps; i++) {
+        char *pcap_in_name = generate_pcap_name(pcap_base, i, suffix);
+        int ret = open_pcap_file(&stream->files[i], pcap_in_name);
+        free(pcap_in_name);
+        if (ret != EXIT_SUCCESS) {
+            close_pcap_stream(stream);
+            return NULL;
+        }
+        stream->num_files++;
+        stream->files[i].next.ifindex = i;
+        if (read_next_pkt(&stream->files[i]))
+            stream->heap[stream->heap_len++] = i;
+    }
+    for (int i = stream->heap_len / 2 - 1; i >= 0; i--)
+        sift_down(stream, i);
+    return stream;
+}
+
+uint32_t read_pkt_batch(pcap_stream_t *stream, pcap_pkt *batch, uint32_t max_pkts) {
+    /* The packets of the previous batch are done with: release the chunks
+       of data before the next packets, so only the data being read stays
+       in memory */
+    for (uint16_t i = 0; i < stream->num_files; i++) {
+        struct pcap_file *file = &stream->files[i];
+        size_t done = file->size;
+        if (!file->finished)
+            done = (size_t) (file->next.data - (char *) file->base) - PCAP_REC_HDR_LEN;
+        done &= ~((size_t) PCAP_RELEASE_CHUNK - 1);
+        if (done > file->released) {
+            madvise(file->base + file->released, done - file->released, MADV_DONTNEED);
+            file->released = done;
+        }
+    }
+
+    uint32_t num_pkts = 0;
+    while (num_pkts < max_pkts && stream->heap_len > 0) {
+        struct pcap_file *file = &stream->files[stream->heap[0]];
+        batch[num_pkts++] = file->next;
+        if (!read_next_pkt(file))
+            stream->heap[0] = stream->heap[--stream->heap_len];
+        sift_down(stream, 0);
+    }
+    return num_pkts;
+}
+
+void close_pcap_stream(pcap_stream_t *stream) {
+    for (uint16_t i = 0; i < stream->num_files; i++)
+        munmap(stream->files[i].base, stream->files[i].size);
+    free(stream->files);
+    free(stream->heap);
+    free(stream);
+}
+
+/* The output file of an interface, with the packets not written yet */
+struct pcap_out {
+    pcap_t *handle;
+    pcap_dumper_t *dumper;
+    uint8_t *buffer;        // struct pcap_pkthdr followed by the data, for each packet
+    size_t used;
+};
+
+struct pcap_writer {
+    const char *pcap_base;
+    const char *suffix;
+    size_t buffer_size;
+    struct pcap_out *outs;
+    uint16_t len;
+};
+
+pcap_writer_t *open_pcap_writer(const char *pcap_base, const char *suffix, size_t buffer_size) {
+    pcap_writer_t *writer = calloc(1, sizeof(pcap_writer_t));
+    writer->pcap_base = pcap_base;
+    writer->suffix = suffix;
+    writer->buffer_size = buffer_size;
+    return writer;
+}
+
+static int open_pcap_out(pcap_writer_t *writer, struct pcap_out *out, iface_index index) {
+    char *pcap_out_name = generate_pcap_name(writer->pcap_base, index, writer->suffix);
+    out->handle = pcap_open_dead(DLT_EN10MB, UINT16_MAX);
+    if (out->handle == NULL) {
+        fprintf(stderr, "Error: Failed to open pcap file!\n");
+        free(pcap_out_name);
+        return EXIT_FAILURE;
+    }
+    out->dumper = pcap_dump_open(out->handle, pcap_out_name);
+    free(pcap_out_name);
+    if (out->dumper == NULL) {
+        pcap_perror(out->handle, "Error: Failed to create pcap output file ");
+        pcap_close(out->handle);
+        out->handle = NULL;
+        return EXIT_FAILURE;
+    }
+    out->buffer = malloc(writer->buffer_size);
+    out->used = 0;
+    return EXIT_SUCCESS;
+}
+
+static void flush_pcap_out(struct pcap_out *out) {
+    size_t pos = 0;
+    while (pos < out->used) {
+        struct pcap_pkthdr hdr;
+        memcpy(&hdr, out->buffer + pos, sizeof(hdr));
+        pos += sizeof(hdr);
+        pcap_dump((unsigned char *) out->dumper, &hdr, out->buffer + pos);
+        pos += hdr.caplen;
+    }
+    out->used = 0;
+}
+
+int write_pkt(pcap_writer_t *writer, const pcap_pkt *pkt) {
+    if (pkt->ifindex >= writer->len) {
+        writer->outs = realloc(writer->outs, (pkt->ifindex + 1) * sizeof(struct pcap_out));
+        if (writer->outs == NULL) {
+            fprintf(stderr, "Fatal: Failed to expand the "
+                "output files with size %u !\n", writer->len);
+            exit(EXIT_FAILURE);
+        }
+        memset(writer->outs + writer->len, 0,
+               (pkt->ifindex + 1 - writer->len) * sizeof(struct pcap_out));
+        writer->len = pkt->ifindex + 1;
+    }
+    struct pcap_out *out = &writer->outs[pkt->ifindex];
+    if (out->dumper == NULL && open_pcap_out(writer, out, pkt->ifindex) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    size_t pkt_size = sizeof(struct pcap_pkthdr) + pkt->pcap_hdr.caplen;
+    if (out->used + pkt_size > writer->buffer_size)
+        flush_pcap_out(out);
+    if (pkt_size > writer->buffer_size) {
+        /* Too large to be buffered */
+        pcap_dump((unsigned char *) out->dumper, &pkt->pcap_hdr, (unsigned char *) pkt->data);
+        return EXIT_SUCCESS;
+    }
+    memcpy(out->buffer + out->used, &pkt->pcap_hdr, sizeof(struct pcap_pkthdr));
+    memcpy(out->buffer + out->used + sizeof(struct pcap_pkthdr), pkt->data, pkt->pcap_hdr.caplen);
+    out->used += pkt_size;
+    return EXIT_SUCCESS;
+}
+
+void close_pcap_writer(pcap_writer_t *writer) {
+    for (uint16_t i = 0; i < writer->len; i++) {
+        struct pcap_out *out = &writer->outs[i];
+        if (out->dumper == NULL && open_pcap_out(writer, out, i) != EXIT_SUCCESS)
+            continue;
+        flush_pcap_out(out);
+        pcap_close(out->handle);
+        pcap_dump_close(out->dumper);
+        free(out->buffer);
+    }
+    free(writer->outs);
+    free(writer);
+}
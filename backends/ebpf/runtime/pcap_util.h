@@ -224,4 +224,81 @@ void sort_pcap_list(pcap_list_t *pkt_list);
  */
 char *generate_pcap_name(const char *pcap_base, int index, const char *suffix);
 
+/* Streaming replay.
+   Instead of reading all the packets in memory, the input files are mapped in
+   memory and merged on the fly by timestamp, and the output packets are
+   buffered in bounded buffers, so the memory used does not grow with the
+   size of the trace. Each input file is expected to be in timestamp order,
+   as captures are. Only the classic pcap format is supported.
+ */
+
+struct pcap_stream;
+struct pcap_writer;
+typedef struct pcap_stream pcap_stream_t;
+typedef struct pcap_writer pcap_writer_t;
+
+/**
+ * @brief Open the input files of all the interfaces for streaming.
+ * @details Maps in memory the files generated by generate_pcap_name()
+ * for the indexes up to num_pcaps. The mappings are private: the packets
+ * may be changed without changing the files.
+ *
+ * @param pcap_base The file base name.
+ * @param num_pcaps The number of files, one for each interface.
+ * @param suffix  Filename suffix (e.g., _in.pcap)
+ *
+ * @return A handle to the stream. Null if a file cannot be opened or is
+ * not a pcap file.
+ */
+pcap_stream_t *open_pcap_stream(const char *pcap_base, uint16_t num_pcaps, const char *suffix);
+
+/**
+ * @brief Retrieve the next packets of all the files, in timestamp order.
+ * @details Fills the batch with the next packets, which are merged from all
+ * the files; packets with the same timestamp are ordered by interface index.
+ * The data of the packets points into the mapped files, and only remains
+ * valid until the next call.
+ *
+ * @param batch The array which receives the packets.
+ * @param max_pkts The size of the array.
+ *
+ * @return The number of packets in the batch, 0 at the end of the files.
+ */
+uint32_t read_pkt_batch(pcap_stream_t *stream, pcap_pkt *batch, uint32_t max_pkts);
+
+/**
+ * @brief Unmap the files and delete the stream.
+ */
+void close_pcap_stream(pcap_stream_t *stream);
+
+/**
+ * @brief Create a writer of packets to the output files of all interfaces.
+ * @details The file of an interface is created when its first packet is
+ * written, and packets are copied to a buffer of the given size for each
+ * interface, which is written to the file when it is full.
+ *
+ * @param pcap_base The file base name.
+ * @param suffix  Filename suffix (e.g., _out.pcap)
+ * @param buffer_size The size in bytes of the buffer of each interface.
+ *
+ * @return A handle to the writer.
+ */
+pcap_writer_t *open_pcap_writer(const char *pcap_base, const char *suffix, size_t buffer_size);
+
+/**
+ * @brief Write a packet to the file of its interface.
+ * @details The packet is copied, so it may be changed or released afterwards.
+ *
+ * @return EXIT_FAILURE if the output file cannot be created.
+ */
+int write_pkt(pcap_writer_t *writer, const pcap_pkt *pkt);
+
+/**
+ * @brief Write all the buffered packets and close the files.
+ * @details As when the output lists are written, this also creates an empty
+ * file for each interface below the highest one which had packets.
+ * The writer is deleted.
+ */
+void close_pcap_writer(pcap_writer_t *writer);
+
 #endif  // BACKENDS_EBPF_RUNTIME_EBPF_PCAP_UTIL_H_
\ No newline at end of file
@@ -59,6 +59,13 @@ $(BPFNAME).c: $(P4FILE)
 	fi;
 	$(P4C) --Werror $(P4INCLUDE) --target $(TARGET) -o $@ $< $(P4ARGS)
 
+# Microbenchmarks of the userspace map types
+.PHONY: map_bench
+map_bench: $(SRCDIR)/ebpf_map_bench.c $(SRCDIR)/ebpf_registry.c $(SRCDIR)/ebpf_map.c
+	@mkdir -p $(BUILDDIR)
+	$(GCC) $(CFLAGS) -I./$(SRCDIR) $^ -o $(BUILDDIR)/$@
+	$(BUILDDIR)/$@
+
 .PHONY: clean
 clean:
 	@echo "Deleting build folder"
@@ -0,0 +1,246 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <dirent.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "lib/error.h"
+#include "test/gtest/helpers.h"
+
+#include "backends/p4test/midend.h"
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/evaluator/evaluator.h"
+#include "frontends/p4/frontend.h"
+#include "frontends/p4/typeMap.h"
+#include "midend/stfRunner.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+// Each statement of the ingress is rewritten by a pass of the midend:
+// Predication, RemoveExits, SimplifyKey, TableHit, NestedStructs,
+// FlattenInterfaceStructs, SynthesizeActions and MoveActionsToTables.
+const std::string switchSource = P4_SOURCE(P4Headers::V1MODEL, R"(
+header h_t {
+    bit<8> op;
+    bit<8> a;
+    bit<8> b;
+    bit<8> r;
+}
+
+struct Headers { h_t h; }
+struct inner_t { bit<8> x; }
+struct Metadata {
+    inner_t inner;
+    bit<8>  y;
+}
+
+parser parse(packet_in b, out Headers hdr, inout Metadata m, inout standard_metadata_t sm) {
+    state start {
+        b.extract(hdr.h);
+        transition accept;
+    }
+}
+
+control verifyChecksum(inout Headers hdr, inout Metadata m) { apply { } }
+
+control ingress(inout Headers hdr, inout Metadata m, inout standard_metadata_t sm) {
+    action compute(bit<8> k) {
+        if (hdr.h.op == 1)
+            hdr.h.r = hdr.h.a + hdr.h.b;
+        else
+            hdr.h.r = hdr.h.a - k;
+    }
+    action bounce() {
+        sm.egress_spec = 0;
+        exit;
+    }
+    table ops {
+        key = {
+            hdr.h.op        : exact;
+            hdr.h.isValid() : ternary;
+        }
+        actions = { compute; bounce; NoAction; }
+        default_action = NoAction();
+    }
+    apply {
+        sm.egress_spec = 1;
+        m.inner.x = hdr.h.a;
+        bool hit = ops.apply().hit;
+        if (!hit)
+            m.y = 0xff;
+        hdr.h.b = m.inner.x ^ m.y;
+    }
+}
+
+control egress(inout Headers hdr, inout Metadata m, inout standard_metadata_t sm) { apply { } }
+control computeChecksum(inout Headers hdr, inout Metadata m) { apply { } }
+control deparse(packet_out b, in Headers hdr) { apply { b.emit(hdr.h); } }
+
+V1Switch(parse(), verifyChecksum(), ingress(), egress(),
+    computeChecksum(), deparse()) main;
+)");
+
+const char* switchStf = R"(
+add ops hdr.h.op:1 compute(k:0)
+add ops hdr.h.op:2 compute(k:3)
+add ops hdr.h.op:3 bounce()
+
+packet 2 01050200
+expect 1 01050507 $
+packet 2 02050200
+expect 1 02050502 $
+packet 2 03050200
+expect 0 03050200 $
+packet 2 09050200
+expect 1 0905fa00 $
+)";
+
+/// Builds the interpreter for the output of the frontend @p program, after
+/// running the midend of p4test on it if @p midend is set.
+V1SwitchInterpreter* makeSwitch(const IR::P4Program* program, bool midend) {
+    if (!midend) {
+        auto refMap = new ReferenceMap;
+        auto typeMap = new TypeMap;
+        EvaluatorPass evaluator(refMap, typeMap);
+        program->apply(evaluator);
+        if (::errorCount() > 0)
+            return nullptr;
+        return new V1SwitchInterpreter(refMap, typeMap, evaluator.getToplevelBlock());
+    }
+    // the interpreter keeps using the maps of the midend
+    auto midEnd = new P4Test::MidEnd(P4CContext::get().options());
+    auto toplevel = midEnd->process(program);
+    if (::errorCount() > 0 || toplevel == nullptr)
+        return nullptr;
+    return new V1SwitchInterpreter(&midEnd->refMap, &midEnd->typeMap, toplevel);
+}
+
+enum class Outcome { Unsupported, Failed, Passed };
+
+/// Runs the STF test in @p stf on @p program, and appends the failures to @p failures.
+Outcome runStf(const IR::P4Program* program, bool midend, const std::string& stf,
+               std::vector<cstring>* failures) {
+    V1SwitchInterpreter* target;
+    try {
+        target = makeSwitch(program, midend);
+    } catch (ExecutionError&) {
+        return Outcome::Unsupported;
+    }
+    if (target == nullptr)
+        return Outcome::Unsupported;
+    StfRunner runner(target);
+    std::stringstream in(stf);
+    if (runner.run(in))
+        return Outcome::Passed;
+    failures->insert(failures->end(), runner.getFailures().begin(), runner.getFailures().end());
+    return Outcome::Failed;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+}  // namespace
+
+class MidEndStf : public P4CTest { };
+
+TEST_F(MidEndStf, SameAsFrontend) {
+    auto test = FrontendTestCase::create(switchSource);
+    ASSERT_TRUE(test);
+    for (bool midend : { false, true }) {
+        std::vector<cstring> failures;
+        EXPECT_EQ(Outcome::Passed, runStf(test->program, midend, switchStf, &failures))
+            << (midend ? "after the midend" : "after the frontend");
+        for (auto& f : failures)
+            ADD_FAILURE() << f;
+    }
+    ASSERT_EQ(0u, ::errorCount());
+
+    // the midend has moved the statements of the ingress into tables of their own
+    auto frontend = makeSwitch(test->program, false);
+    auto midend = makeSwitch(test->program, true);
+    ASSERT_TRUE(frontend != nullptr && midend != nullptr);
+    EXPECT_LT(frontend->getTables().size(), midend->getTables().size());
+}
+
+// Interprets the STF tests of the v1model samples, after the frontend and
+// after the midend.  The samples that pass after the frontend must still pass
+// after the midend; the others use features the interpreter does not model,
+// such as clone or recirculate, and are only counted.
+TEST_F(MidEndStf, Samples) {
+    std::string dir = P4C_SOURCE_DIR "/testdata/p4_16_samples";
+    std::vector<std::string> tests;
+    if (auto entries = opendir(dir.c_str())) {
+        while (auto entry = readdir(entries)) {
+            std::string name = entry->d_name;
+            const std::string suffix = "-bmv2.stf";
+            if (name.size() > suffix.size() &&
+                name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+                tests.push_back(name.substr(0, name.size() - 4));
+        }
+        closedir(entries);
+    }
+    std::sort(tests.begin(), tests.end());
+    ASSERT_FALSE(tests.empty()) << "no STF tests in " << dir;
+
+    unsigned compiled = 0, frontendPassed = 0, midendPassed = 0;
+    for (auto& test : tests) {
+        SCOPED_TRACE(test);
+        AutoCompileContext context(new GTestContext(GTestContext::get()));
+        auto& options = GTestContext::get().options();
+        options.langVersion = CompilerOptions::FrontendVersion::P4_16;
+        options.preprocessor_options = "-Ip4include";
+        options.file = dir + "/" + test + ".p4";
+        auto program = P4::parseP4File(options);
+        if (program != nullptr && ::errorCount() == 0)
+            program = P4::FrontEnd().run(options, program);
+        if (program == nullptr || ::errorCount() > 0)
+            continue;
+        compiled++;
+
+        auto stf = readFile(dir + "/" + test + ".stf");
+        std::vector<cstring> failures;
+        if (runStf(program, false, stf, &failures) != Outcome::Passed)
+            continue;
+        frontendPassed++;
+        auto outcome = runStf(program, true, stf, &failures);
+        EXPECT_EQ(Outcome::Passed, outcome) << "passes after the frontend only";
+        for (auto& f : failures)
+            ADD_FAILURE() << f;
+        if (outcome == Outcome::Passed)
+            midendPassed++;
+    }
+    std::cout << tests.size() << " STF tests, " << compiled << " compiled, " << frontendPassed
+              << " pass after the frontend, " << midendPassed << " after the midend" << std::endl;
+    EXPECT_LT(0u, frontendPassed);
+}
+
+}  // namespace Test
@@ -42,6 +42,7 @@ limitations under the License.
 #include "midend/midEndLast.h"
 #include "midend/nestedStructs.h"
 #include "midend/noMatch.h"
+#include "midend/parallelPerBlock.h"
 #include "midend/parserUnroll.h"
 #include "midend/predication.h"
 #include "midend/removeExits.h"
@@ -105,13 +106,18 @@ MidEnd::MidEnd(CompilerOptions& options) {
         new P4::RemoveSelectBooleans(&refMap, &typeMap),
         new P4::FlattenHeaders(&refMap, &typeMap),
         new P4::FlattenInterfaceStructs(&refMap, &typeMap),
-        new P4::Predication(&refMap),
-        new P4::MoveDeclarations(),  // more may have been introduced
-        new P4::ConstantFolding(&refMap, &typeMap),
-        new P4::LocalCopyPropagation(&refMap, &typeMap),
-        new P4::ConstantFolding(&refMap, &typeMap),
-        new P4::MoveDeclarations(),  // more may have been introduced
-        new P4::SimplifyControlFlow(&refMap, &typeMap),
+        // these only transform the insides of controls and parsers
+        new P4::ParallelPerBlock(&refMap, &typeMap,
+            [](P4::ReferenceMap* refMap, P4::TypeMap* typeMap) -> Visitor* {
+                return new PassManager({
+                    new P4::Predication(refMap),
+                    new P4::MoveDeclarations(),  // more may have been introduced
+                    new P4::ConstantFolding(refMap, typeMap),
+                    new P4::LocalCopyPropagation(refMap, typeMap),
+                    new P4::ConstantFolding(refMap, typeMap),
+                    new P4::MoveDeclarations(),  // more may have been introduced
+                    new P4::SimplifyControlFlow(refMap, typeMap)
+                }); }),
         new P4::CompileTimeOperations(),
         new P4::TableHit(&refMap, &typeMap),
         evaluator,
@@ -21,6 +21,7 @@ limitations under the License.
 #include "control-plane/p4RuntimeSerializer.h"
 #include "ir/ir.h"
 #include "ir/json_loader.h"
+#include "ir/binary_loader.h"
 #include "lib/log.h"
 #include "lib/error.h"
 #include "lib/exceptions.h"
@@ -28,6 +29,7 @@ limitations under the License.
 #include "lib/crash.h"
 #include "lib/nullstream.h"
 #include "frontends/common/applyOptionsPragmas.h"
+#include "frontends/common/compileServer.h"
 #include "frontends/common/parseInput.h"
 #include "frontends/p4/evaluator/evaluator.h"
 #include "frontends/p4/frontend.h"
@@ -39,6 +41,7 @@ class P4TestOptions : public CompilerOptions {
     bool parseOnly = false;
     bool validateOnly = false;
     bool loadIRFromJson = false;
+    bool loadIRFromBinary = false;
     P4TestOptions() {
         registerOption("--parse-only", nullptr,
                        [this](const char*) {
@@ -58,6 +61,13 @@ class P4TestOptions : public CompilerOptions {
                            return true;
                        },
                        "read previously dumped json instead of P4 source code");
+        registerOption("--fromBinary", "file",
+                       [this](const char* arg) {
+                           loadIRFromBinary = true;
+                           file = arg;
+                           return true;
+                       },
+                       "read IR previously dumped with --toBinary instead of P4 source code");
      }
 };
 
@@ -75,17 +85,14 @@ static void log_dump(const IR::Node *node, const char *head) {
             std::cout << *node << std::endl; }
 }
 
-int main(int argc, char *const argv[]) {
-    setup_gc_logging();
-    setup_signals();
-
+static int compile(int argc, char *const argv[]) {
     AutoCompileContext autoP4TestContext(new P4TestContext);
     auto& options = P4TestContext::get().options();
     options.langVersion = CompilerOptions::FrontendVersion::P4_16;
     options.compilerVersion = P4TEST_VERSION_STRING;
 
     if (options.process(argc, argv) != nullptr) {
-            if (options.loadIRFromJson == false)
+            if (options.loadIRFromJson == false && options.loadIRFromBinary == false)
                     options.setInputFile();
     }
     if (::errorCount() > 0)
@@ -102,6 +109,12 @@ int main(int argc, char *const argv[]) {
                 error("%s is not a P4Program in json format", options.file);
         } else {
             error("Can't open %s", options.file); }
+    } else if (options.loadIRFromBinary) {
+        BinaryLoader loader(options.file);
+        const IR::Node* node = nullptr;
+        loader >> node;
+        if (loader.valid() && !(node && (program = node->to<IR::P4Program>())))
+            error("%s is not a P4Program in binary form", options.file);
     } else {
         program = P4::parseP4File(options);
 
@@ -151,6 +164,8 @@ int main(int argc, char *const argv[]) {
         }
         if (options.dumpJsonFile)
             JSONGenerator(*openFile(options.dumpJsonFile, true), true) << program << std::endl;
+        if (options.dumpBinaryFile)
+            BinaryWriter(*openFile(options.dumpBinaryFile, true), true) << program;
         if (options.debugJson) {
             std::stringstream ss1, ss2;
             JSONGenerator gen1(ss1), gen2(ss2);
@@ -176,3 +191,12 @@ int main(int argc, char *const argv[]) {
         std::cerr << "Done." << std::endl;
     return ::errorCount() > 0;
 }
+
+int main(int argc, char *const argv[]) {
+    setup_gc_logging();
+    setup_signals();
+
+    if (auto socket = P4::CompileServer::serverSocket(argc, argv))
+        return P4::CompileServer(argv[0], compile).serve(socket);
+    return compile(argc, argv);
+}
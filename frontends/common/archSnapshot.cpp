@@ -0,0 +1,198 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "archSnapshot.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+#include "frontends/parsers/parserDriver.h"
+#include "ir/binary_loader.h"
+#include "ir/binary_writer.h"
+#include "lib/log.h"
+#include "lib/stringify.h"
+
+namespace P4 {
+
+namespace {
+
+/// A line marker left by the preprocessor: # line "file" flags
+struct LineMarker {
+    std::string file;
+    bool        enter = false;  // flag 1: start of an included file
+    bool        leave = false;  // flag 2: back from an included file
+
+    bool parse(const std::string &line) {
+        std::istringstream in(line);
+        char hash, quote;
+        unsigned number;
+        if (!(in >> hash >> number >> quote) || hash != '#' || quote != '"')
+            return false;
+        if (!std::getline(in, file, '"'))
+            return false;
+        int flag;
+        while (in >> flag) {
+            if (flag == 1) enter = true;
+            if (flag == 2) leave = true; }
+        return true; }
+};
+
+/// Checks that @line only has whitespace and comments; @inComment is true
+/// when inside a /* */ comment, at the start and at the end of the line.
+bool onlyComments(const std::string &line, bool &inComment) {
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (inComment) {
+            if (line.compare(i, 2, "*/") == 0) {
+                inComment = false;
+                ++i; }
+        } else if (line.compare(i, 2, "/*") == 0) {
+            inComment = true;
+            ++i;
+        } else if (line.compare(i, 2, "//") == 0) {
+            return true;
+        } else if (!isspace(line[i])) {
+            return false; } }
+    return true;
+}
+
+}  // namespace
+
+ArchSnapshot::ArchSnapshot(const CompilerOptions &options, FILE *in) : options(options) {
+    char buffer[65536];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        text.append(buffer, count);
+}
+
+bool ArchSnapshot::isIncludePath(const std::string &file) const {
+    const char *driverPath = getenv("P4C_16_INCLUDE_PATH");
+    for (const char *path : { p4includePath, driverPath }) {
+        if (path == nullptr || *path == 0) continue;
+        std::string dir(path);
+        if (dir.back() != '/') dir += '/';
+        if (file.compare(0, dir.size(), dir) == 0)
+            return true; }
+    return false;
+}
+
+bool ArchSnapshot::findIncludes() {
+    unsigned depth = 0;
+    bool inComment = false;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        std::string line = text.substr(pos, eol - pos);
+        LineMarker marker;
+        if (!inComment && marker.parse(line)) {
+            if (marker.enter) {
+                if (depth == 0) {
+                    if (!isIncludePath(marker.file)) break;
+                    if (name.isNull()) {
+                        start = pos;
+                        auto base = marker.file.substr(marker.file.rfind('/') + 1);
+                        name = base.substr(0, base.find('.')); } }
+                ++depth;
+            } else if (marker.leave && depth > 0 && --depth == 0) {
+                end = pos; }
+        } else if (depth == 0 && !onlyComments(line, inComment)) {
+            break; }
+        pos = eol + 1; }
+    return end > start;
+}
+
+cstring ArchSnapshot::snapshotFile() const {
+    // the IR schema changes more often than the version
+    auto key = std::hash<std::string>()(std::string(options.compilerVersion.c_str()) + '\n' +
+                                        std::to_string(IR::binary_ir_schema) + '\n' +
+                                        text.substr(start, end - start));
+    std::stringstream file;
+    file << options.archSnapshotDir << "/" << name << "-" << std::hex << key << ".p4ir";
+    return file.str();
+}
+
+const IR::P4Program *ArchSnapshot::load(cstring file, Util::InputSources *sources) const {
+    if (access(file, R_OK) != 0) return nullptr;
+    LOG1("Loading include files from " << file);
+    BinaryLoader loader(file);
+    loader.setSources(sources);
+    const IR::Node *node = nullptr;
+    loader >> node;
+    return loader.valid() && node ? node->to<IR::P4Program>() : nullptr;
+}
+
+bool ArchSnapshot::save(cstring file) const {
+    // parse the include files alone; they are complete declarations, so this
+    // gives the same result as for the whole program
+    std::istringstream in(text.substr(0, end));
+    auto errors = ::errorCount();
+    auto prelude = P4ParserDriver::parse(in, options.file);
+    if (prelude == nullptr || ::errorCount() > errors) return false;
+
+    // write to a private file first, as other compilations may be reading it
+    cstring tmp = file + "." + Util::toString(getpid());
+    {
+        std::ofstream out(tmp);
+        BinaryWriter(out, true) << prelude;
+        if (!out) {
+            LOG1("Cannot write " << tmp);
+            unlink(tmp);
+            return false; }
+    }
+    if (rename(tmp, file) != 0) {
+        LOG1("Cannot rename " << tmp << " to " << file);
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+const IR::P4Program *ArchSnapshot::parseAfter(cstring file) const {
+    auto sources = new Util::InputSources;
+    auto prelude = load(file, sources);
+    if (prelude == nullptr) return nullptr;
+    // the include files are read again, but not parsed, for their positions
+    unsigned lines = std::count(text.begin(), text.begin() + end, '\n');
+    std::istringstream in(text);
+    return P4ParserDriver::parse(in, options.file, 1, prelude, lines, sources);
+}
+
+const IR::P4Program *ArchSnapshot::parse() {
+    if (!findIncludes()) {
+        std::istringstream in(text);
+        return P4ParserDriver::parse(in, options.file);
+    }
+
+    // without a snapshot, make one and continue from it, as the next
+    // compilations will
+    auto file = snapshotFile();
+    auto errors = ::errorCount();
+    if (access(file, R_OK) == 0 || save(file)) {
+        if (auto program = parseAfter(file))
+            return program; }
+    if (::errorCount() > errors)
+        return nullptr;
+
+    // the snapshot could not be written
+    std::istringstream in(text);
+    return P4ParserDriver::parse(in, options.file);
+}
+
+}  // namespace P4
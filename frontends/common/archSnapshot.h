@@ -0,0 +1,76 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _FRONTENDS_COMMON_ARCHSNAPSHOT_H_
+#define _FRONTENDS_COMMON_ARCHSNAPSHOT_H_
+
+#include <cstdio>
+#include <string>
+
+#include "ir/ir.h"
+#include "frontends/common/options.h"
+
+namespace P4 {
+
+/**
+ * Most programs start by including core.p4 and an architecture file
+ * (v1model.p4, psa.p4, ...), which are much bigger than the program itself.
+ * ArchSnapshot keeps the parsed IR of these include files in the folder given
+ * with --arch-snapshots, so that other compilations that include exactly the
+ * same text can load it instead of parsing it again.
+ *
+ * The snapshots are written with BinaryWriter, and keyed by a hash of the
+ * compiler version, of the IR schema and of the preprocessed text of the
+ * include files, so they are only reused when the include files, the
+ * preprocessor options and the compiler are the same.
+ * Only include files from the P4 include path that come before any
+ * declaration in the program are considered.
+ *
+ * The include files are parsed by themselves before the snapshot is saved,
+ * so their declarations get the first ids, as when they are loaded.  The
+ * snapshot keeps their positions in the preprocessed text, which is still
+ * read, so diagnostics and the output are the same as without a snapshot.
+ */
+class ArchSnapshot {
+    const CompilerOptions &options;
+    /// The preprocessed program.
+    std::string text;
+    /// The span of @text holding the include files, if any.
+    size_t start = 0, end = 0;
+    /// The name of the first include file, to make snapshots easier to tell apart.
+    cstring name;
+
+    bool isIncludePath(const std::string &file) const;
+    bool findIncludes();
+    cstring snapshotFile() const;
+    const IR::P4Program *load(cstring file, Util::InputSources *sources) const;
+    bool save(cstring file) const;
+    const IR::P4Program *parseAfter(cstring file) const;
+
+ public:
+    ArchSnapshot(const CompilerOptions &options, FILE *in);
+
+    /// Parses the preprocessed P4-16 program, reusing the snapshot of its
+    /// include files if there is one and creating it otherwise.
+    const IR::P4Program *parse();
+
+    static const IR::P4Program *parse(FILE *in, const CompilerOptions &options)
+    { return ArchSnapshot(options, in).parse(); }
+};
+
+}  // namespace P4
+
+#endif /* _FRONTENDS_COMMON_ARCHSNAPSHOT_H_ */
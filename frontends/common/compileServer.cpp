@@ -0,0 +1,355 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "compileServer.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include "ir/ir.h"
+#include "lib/compile_context.h"
+#include "lib/log.h"
+
+namespace P4 {
+
+namespace {
+
+/// Options that print something and exit the process.
+const std::set<std::string> refusedOptions = {
+    "--help", "--version", "--listFrontendPasses", "--listMidendPasses", "--compile-server"
+};
+
+/// Where a compilation's standard output and error go, in its directory.
+const char *outputFile = ".p4c-server-stdout";
+const char *diagnosticsFile = ".p4c-server-stderr";
+
+/// Strings are longer than this only in corrupted messages.
+const uint32_t maxStringSize = 1u << 30;
+
+/// Messages are sequences of unsigned 32-bit integers, in network byte
+/// order, and of strings, sent as their size followed by their bytes.
+/// The first error makes the channel fail, and later calls do nothing.
+class Channel {
+    int fd;
+    bool failed = false;
+
+ public:
+    explicit Channel(int fd) : fd(fd) {}
+    bool ok() const { return !failed; }
+
+    void write(const char *data, size_t size) {
+        while (!failed && size > 0) {
+            ssize_t done = ::write(fd, data, size);
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done <= 0) {
+                failed = true;
+                break; }
+            data += done;
+            size -= done; } }
+    void read(char *data, size_t size) {
+        while (!failed && size > 0) {
+            ssize_t done = ::read(fd, data, size);
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done <= 0) {
+                failed = true;
+                break; }
+            data += done;
+            size -= done; } }
+
+    void put(uint32_t value) {
+        value = htonl(value);
+        write(reinterpret_cast<const char *>(&value), sizeof(value)); }
+    void put(const std::string &value) {
+        put(static_cast<uint32_t>(value.size()));
+        write(value.data(), value.size()); }
+    uint32_t getInt() {
+        uint32_t value = 0;
+        read(reinterpret_cast<char *>(&value), sizeof(value));
+        return ntohl(value); }
+    std::string getString() {
+        auto size = getInt();
+        if (size > maxStringSize)
+            failed = true;
+        if (failed)
+            return std::string();
+        std::string value(size, '\0');
+        read(&value[0], size);
+        return value; }
+};
+
+void writeRequest(Channel &channel, const CompileServer::Request &request) {
+    channel.put(static_cast<uint32_t>(request.args.size()));
+    for (auto &arg : request.args)
+        channel.put(arg);
+    channel.put(request.sourceName);
+    channel.put(request.source);
+}
+
+bool readRequest(Channel &channel, CompileServer::Request *request) {
+    auto args = channel.getInt();
+    for (uint32_t i = 0; channel.ok() && i < args; ++i)
+        request->args.push_back(channel.getString());
+    request->sourceName = channel.getString();
+    request->source = channel.getString();
+    return channel.ok();
+}
+
+void writeResponse(Channel &channel, const CompileServer::Response &response) {
+    channel.put(static_cast<uint32_t>(response.status));
+    channel.put(response.output);
+    channel.put(response.diagnostics);
+    channel.put(static_cast<uint32_t>(response.files.size()));
+    for (auto &file : response.files) {
+        channel.put(file.first);
+        channel.put(file.second); }
+}
+
+bool readResponse(Channel &channel, CompileServer::Response *response) {
+    response->status = static_cast<int>(channel.getInt());
+    response->output = channel.getString();
+    response->diagnostics = channel.getString();
+    auto files = channel.getInt();
+    for (uint32_t i = 0; channel.ok() && i < files; ++i) {
+        auto name = channel.getString();
+        response->files.emplace_back(name, channel.getString()); }
+    return channel.ok();
+}
+
+std::string readFile(const std::string &name) {
+    std::ifstream in(name, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+int removeEntry(const char *path, const struct stat *, int, struct FTW *) {
+    return ::remove(path);
+}
+
+void removeTree(const std::string &dir) {
+    nftw(dir.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+std::string systemError(const std::string &what) {
+    return what + ": " + strerror(errno) + "\n";
+}
+
+/// Holds the arena the IR of a compilation is allocated from; the compiler
+/// pushes its own context on top of this one.
+class RequestContext : public BaseCompileContext {
+ public:
+    RequestContext() { useArena(); }
+};
+
+/// Sends file descriptor @fd to @file, until the object is destroyed.
+class Redirect {
+    int fd, saved;
+
+ public:
+    Redirect(int fd, const char *file) : fd(fd), saved(dup(fd)) {
+        int out = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out >= 0) {
+            dup2(out, fd);
+            close(out); } }
+    ~Redirect() {
+        if (saved >= 0) {
+            dup2(saved, fd);
+            close(saved); } }
+};
+
+}  // namespace
+
+void CompileServer::reset() {
+    Log::reset();
+    IR::Node::resetIds();
+    for (auto &hook : resetHooks)
+        hook();
+}
+
+CompileServer::Response CompileServer::compile(const Request &request) {
+    Response response;
+    response.status = 1;
+    for (auto &arg : request.args) {
+        if (refusedOptions.count(arg)) {
+            response.diagnostics = arg + ": not supported by the compile server\n";
+            return response; } }
+    std::string sourceName = request.sourceName.empty() ? "program.p4" : request.sourceName;
+    if (sourceName.find('/') != std::string::npos || sourceName[0] == '.') {
+        response.diagnostics = sourceName + ": the program name must be a plain file name\n";
+        return response; }
+
+    auto tmp = getenv("TMPDIR");
+    std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/p4c-XXXXXX";
+    if (mkdtemp(&dir[0]) == nullptr) {
+        response.diagnostics = systemError(dir);
+        return response; }
+    std::vector<char> cwd(PATH_MAX);
+    if (getcwd(cwd.data(), cwd.size()) == nullptr || chdir(dir.c_str()) != 0) {
+        response.diagnostics = systemError(dir);
+        removeTree(dir);
+        return response; }
+    std::ofstream(sourceName, std::ios::binary) << request.source;
+
+    std::vector<std::string> args;
+    args.push_back(binaryName);
+    args.insert(args.end(), request.args.begin(), request.args.end());
+    args.push_back(sourceName);
+    std::vector<char *> argv;
+    for (auto &arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    reset();
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    {
+        // At the level of file descriptors, to catch the messages of the
+        // preprocessor too.
+        Redirect output(STDOUT_FILENO, outputFile);
+        Redirect diagnostics(STDERR_FILENO, diagnosticsFile);
+        // Freed, with all the IR of the compilation, at the end of the block.
+        RequestContext context;
+        AutoCompileContext autoContext(&context);
+        try {
+            response.status = compiler(static_cast<int>(args.size()), argv.data());
+        } catch (const std::exception &bug) {
+            std::cerr << bug.what() << std::endl;
+            response.status = 1;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        std::clog.flush();
+        fflush(nullptr);
+    }
+    response.output = readFile(outputFile);
+    response.diagnostics = readFile(diagnosticsFile);
+
+    if (auto entries = opendir(".")) {
+        while (auto entry = readdir(entries)) {
+            std::string name = entry->d_name;
+            struct stat info;
+            if (name == sourceName || name == outputFile || name == diagnosticsFile ||
+                stat(name.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+                continue;
+            response.files.emplace_back(name, readFile(name)); }
+        closedir(entries); }
+    if (chdir(cwd.data()) != 0)
+        std::cerr << systemError(cwd.data());
+    removeTree(dir);
+    return response;
+}
+
+int CompileServer::serve(const char *socketPath) {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        std::cerr << socketPath << ": socket path too long" << std::endl;
+        return 1; }
+    strcpy(address.sun_path, socketPath);  // NOLINT(runtime/printf)
+    auto sockaddr = reinterpret_cast<struct sockaddr *>(&address);
+
+    // Take the place of a server that is gone, but not of one still running.
+    struct stat info;
+    if (lstat(socketPath, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool running = probe >= 0 && connect(probe, sockaddr, sizeof(address)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (running) {
+            std::cerr << socketPath << ": a server is already running" << std::endl;
+            return 1; }
+        unlink(socketPath); }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, sockaddr, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        std::cerr << systemError(socketPath);
+        if (fd >= 0)
+            close(fd);
+        return 1; }
+    // A client that goes away must not stop the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    for (;;) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << systemError(socketPath);
+            break; }
+        Channel channel(client);
+        Request request;
+        if (readRequest(channel, &request))
+            writeResponse(channel, compile(request));
+        close(client);
+    }
+    close(fd);
+    unlink(socketPath);
+    return 1;
+}
+
+bool CompileServer::send(const char *socketPath, const Request &request, Response *response) {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    *response = Response();
+    response->status = 1;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        response->diagnostics = std::string(socketPath) + ": socket path too long\n";
+        return false; }
+    strcpy(address.sun_path, socketPath);  // NOLINT(runtime/printf)
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 ||
+        connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        response->diagnostics = systemError(socketPath);
+        if (fd >= 0)
+            close(fd);
+        return false; }
+    Channel channel(fd);
+    writeRequest(channel, request);
+    bool ok = channel.ok() && readResponse(channel, response);
+    close(fd);
+    if (!ok) {
+        *response = Response();
+        response->status = 1;
+        response->diagnostics = std::string(socketPath) + ": the server did not answer\n"; }
+    return ok;
+}
+
+const char *CompileServer::serverSocket(int argc, char *const argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--compile-server") == 0)
+        return argv[2];
+    return nullptr;
+}
+
+}  // namespace P4
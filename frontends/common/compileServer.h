@@ -0,0 +1,108 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _FRONTENDS_COMMON_COMPILESERVER_H_
+#define _FRONTENDS_COMMON_COMPILESERVER_H_
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace P4 {
+
+/**
+ * Runs the compilations sent by clients to a Unix socket, one after the
+ * other in the same process, so that builds that compile many small
+ * programs only pay once for starting the compiler.  Started with
+ *
+ *     <compiler> --compile-server <socket>
+ *
+ * A request holds the command-line arguments and the text of the program;
+ * the reply holds the exit status, what the compiler printed and the files
+ * it wrote.  Each compilation runs in a new temporary directory holding the
+ * program, so relative output paths (-o, --p4runtime-files, ...) land there
+ * and come back in the reply; only files at the top of that directory are
+ * returned.  Other paths, like -I folders, should be absolute.
+ *
+ * The compiler function pushes its own compile context, so every request
+ * gets fresh options and a fresh ErrorReporter.  Before each request the
+ * server resets the state that outlives contexts: the logging options, the
+ * ids of IR nodes and whatever the hooks added with addResetHook() clear.
+ * The IR of each compilation is allocated from an arena (see
+ * BaseCompileContext::useArena) which is released once the compilation is
+ * done, so the compiler must not keep IR nodes around from one compilation to
+ * the next: without the garbage collector they are freed memory.  Options that
+ * exit the process (--help, --version, ...) are refused.
+ */
+class CompileServer {
+ public:
+    struct Request {
+        /// The arguments, without the name of the compiler or the input file.
+        std::vector<std::string> args;
+        /// The file name to give the program, e.g. "prog.p4".
+        std::string sourceName;
+        std::string source;
+    };
+
+    struct Response {
+        int status = 0;
+        /// What the compiler wrote to std::cout.
+        std::string output;
+        /// What it wrote to std::cerr and std::clog: errors, warnings, logs.
+        std::string diagnostics;
+        /// The name and contents of each file it wrote.
+        std::vector<std::pair<std::string, std::string>> files;
+    };
+
+    /// The main function of a compiler.
+    typedef std::function<int(int argc, char *const argv[])> Compiler;
+
+ private:
+    std::string binaryName;
+    Compiler compiler;
+    std::vector<std::function<void()>> resetHooks;
+
+    void reset();
+
+ public:
+    CompileServer(std::string binaryName, Compiler compiler)
+        : binaryName(std::move(binaryName)), compiler(std::move(compiler)) {}
+
+    /// Adds @p hook to the functions that clear global state before each
+    /// compilation, for backends that have some.
+    void addResetHook(std::function<void()> hook) { resetHooks.push_back(std::move(hook)); }
+
+    /// Runs one compilation.
+    Response compile(const Request &request);
+
+    /// Accepts connections on @p socketPath and answers one request on each,
+    /// until it fails.  @return the exit status for main.
+    int serve(const char *socketPath);
+
+    /// Sends @p request to the server listening on @p socketPath.
+    /// @return false, with a message in @p response->diagnostics, if the
+    /// server could not be reached.
+    static bool send(const char *socketPath, const Request &request, Response *response);
+
+    /// @return the socket path if the command line is `<compiler>
+    /// --compile-server <socket>`, or nullptr.
+    static const char *serverSocket(int argc, char *const argv[]);
+};
+
+}  // namespace P4
+
+#endif /* _FRONTENDS_COMMON_COMPILESERVER_H_ */
@@ -101,6 +101,7 @@ const IR::Node* DoConstantFolding::postorder(IR::PathExpression* e) {
 const IR::Node* DoConstantFolding::postorder(IR::Type_Bits* type) {
     if (type->expression != nullptr) {
         if (auto cst = type->expression->to<IR::Constant>()) {
+            type = mutate(type);
             type->size = cst->asInt();
             type->expression = nullptr;
             if (type->size <= 0) {
@@ -121,6 +122,7 @@ const IR::Node* DoConstantFolding::postorder(IR::Type_Bits* type) {
 const IR::Node* DoConstantFolding::postorder(IR::Type_Varbits* type) {
     if (type->expression != nullptr) {
         if (auto cst = type->expression->to<IR::Constant>()) {
+            type = mutate(type);
             type->size = cst->asInt();
             type->expression = nullptr;
             if (type->size <= 0)
@@ -165,21 +167,33 @@ const IR::Node* DoConstantFolding::postorder(IR::Declaration_Constant* d) {
 }
 
 const IR::Node* DoConstantFolding::preorder(IR::AssignmentStatement* statement) {
+    auto left = statement->left;
+    auto right = statement->right;
     assignmentTarget = true;
-    visit(statement->left);
+    visit(left);
     assignmentTarget = false;
-    visit(statement->right);
+    visit(right);
     prune();
+    if (left != statement->left || right != statement->right) {
+        statement = mutate(statement);
+        statement->left = left;
+        statement->right = right; }
     return statement;
 }
 
 const IR::Node* DoConstantFolding::preorder(IR::ArrayIndex* e) {
-    visit(e->left);
+    auto left = e->left;
+    auto right = e->right;
+    visit(left);
     bool save = assignmentTarget;
     assignmentTarget = false;
-    visit(e->right);
+    visit(right);
     assignmentTarget = save;
     prune();
+    if (left != e->left || right != e->right) {
+        e = mutate(e);
+        e->left = left;
+        e->right = right; }
     return e;
 }
 
@@ -890,7 +904,7 @@ const IR::Node* DoConstantFolding::postorder(IR::SelectExpression* expression) {
     if (changes) {
         if (cases.size() == 0 && result == expression && warnings)
             ::warning(ErrorType::WARN_PARSER_TRANSITION, "%1%: no case matches", expression);
-        expression->selectCases = std::move(cases);
+        mutate(expression)->selectCases = std::move(cases);
     }
     return result;
 }
@@ -106,6 +106,7 @@ class DoConstantFolding : public Transform {
     DoConstantFolding(const ReferenceMap* refMap, TypeMap* typeMap, bool warnings = true) :
             refMap(refMap), typeMap(typeMap), typesKnown(typeMap != nullptr), warnings(warnings) {
         visitDagOnce = true; setName("DoConstantFolding");
+        lazyClone = true;
         assignmentTarget = false;
     }
 
@@ -25,8 +25,10 @@ limitations under the License.
 #include "lib/exceptions.h"
 #include "lib/nullstream.h"
 #include "lib/path.h"
+#include "lib/thread_pool.h"
 #include "frontends/p4/toP4/toP4.h"
 #include "ir/json_generator.h"
+#include "ir/pass_profile.h"
 #include "frontends/p4/frontend.h"
 
 const char* p4includePath = CONFIG_PKGDATADIR "/p4include";
@@ -61,6 +63,10 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--nocpp", nullptr,
                    [this](const char*) { doNotPreprocess = true; return true; },
                    "Skip preprocess, assume input file is already preprocessed.");
+    registerOption("--arch-snapshots", "dir",
+                   [this](const char* arg) { archSnapshotDir = arg; return true; },
+                   "Keep the parsed IR of the standard include files (core.p4 and the\n"
+                   "architecture) in `dir', and reuse it instead of parsing them again.");
     registerOption("--p4v", "{14|16}",
                    [this](const char* arg) {
                        if (!strcmp(arg, "1.0") || !strcmp(arg, "14")) {
@@ -98,6 +104,10 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--toJSON", "file",
                    [this](const char* arg) { dumpJsonFile = arg; return true; },
                    "Dump the compiler IR after the midend as JSON in the specified file.");
+    registerOption("--toBinary", "file",
+                   [this](const char* arg) { dumpBinaryFile = arg; return true; },
+                   "Dump the compiler IR after the midend in the specified file, in a\n"
+                   "binary form that is much smaller and faster to load than JSON.");
     registerOption("--p4runtime-files", "filelist",
                    [this](const char* arg) { p4RuntimeFiles = arg; return true; },
                    "Write the P4Runtime control plane API description to the specified\n"
@@ -187,6 +197,23 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
                        P4CContext::get().errorReporter().setMaxErrorCount(maxError);
                        return true; },
                    "Set the maximum number of errors to display before failing.");
+#ifdef MULTITHREAD
+    registerOption("--threads", "count",
+                   [](const char *arg) {
+                       auto threads = strtoul(arg, nullptr, 10);
+                       if (threads < 1) {
+                           ::error("Illegal thread count %1%", arg);
+                           return false; }
+                       Util::ThreadPool::get().setThreads(threads);
+                       return true; },
+                   "Use up to `count' threads for the passes that can visit\n"
+                   "independent parts of the program concurrently.");
+#endif  // MULTITHREAD
+    registerOption("--pass-profile", "file",
+                   [](const char *arg) { PassProfile::enable(arg); return true; },
+                   "[Compiler debugging] Record the time, memory and IR nodes used by\n"
+                   "each pass; write them as JSON to `file' and as a text summary,\n"
+                   "sorted by time, to `file'.txt");
     registerOption("--testJson", nullptr,
                     [this](const char*) { debugJson = true; return true; },
                     "[Compiler debugging] Dump and undump the IR");
@@ -252,11 +279,9 @@ void CompilerOptions::setInputFile() {
         ::error("Only one input file must be specified: %s",
                 cstring::join(remainingOptions.begin(), remainingOptions.end(), ","));
         usage();
-        exit(1);
     } else if (remainingOptions.size() == 0) {
         ::error("No input files specified");
         usage();
-        exit(1);
     } else {
         file = remainingOptions.at(0);
     }
@@ -71,6 +71,8 @@ class CompilerOptions : public Util::Options {
     bool doNotCompile = false;
     // if true skip preprocess
     bool doNotPreprocess = false;
+    // cache the parsed architecture include files in this folder
+    cstring archSnapshotDir = nullptr;
     // debugging dumps of programs written in this folder
     cstring dumpFolder = ".";
     // Pretty-print the program in the specified file
@@ -90,6 +92,9 @@ class CompilerOptions : public Util::Options {
     // Dump a JSON representation of the IR in the file
     cstring dumpJsonFile = nullptr;
 
+    // Dump the IR in the file in the binary format read by BinaryLoader
+    cstring dumpBinaryFile = nullptr;
+
     // Dump and undump the IR tree
     bool debugJson = false;
 
@@ -129,7 +134,8 @@ class CompilerOptions : public Util::Options {
     // strings matched against pass names that should be excluded from Backend passes
     std::vector<cstring> passesToExcludeBackend;
 
-    // Expect that the only remaining argument is the input file.
+    // Expect that the only remaining argument is the input file; reports an
+    // error otherwise.
     void setInputFile();
 
     // Returns the output of the preprocessor.
@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _FRONTENDS_COMMON_PARSEINPUT_H_
 #define _FRONTENDS_COMMON_PARSEINPUT_H_
 
+#include "frontends/common/archSnapshot.h"
 #include "frontends/common/options.h"
 #include "frontends/parsers/parserDriver.h"
 #include "frontends/p4/fromv1.0/converters.h"
@@ -84,6 +85,8 @@ const IR::P4Program* parseP4File(CompilerOptions& options) {
 
     auto result = options.isv1()
                 ? parseV1Program<FILE*, C>(in, options.file, 1, options.getDebugHook())
+                : options.archSnapshotDir
+                ? ArchSnapshot::parse(in, options)
                 : P4ParserDriver::parse(in, options.file);
     options.closeInput(in);
 
@@ -0,0 +1,114 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "programMap.h"
+
+namespace P4 {
+
+namespace {
+
+class CollectPathNames : public Inspector {
+    std::set<cstring>& names;
+ public:
+    explicit CollectPathNames(std::set<cstring>& names) : names(names)
+    { setName("CollectPathNames"); }
+    void postorder(const IR::Path* path) override { names.insert(path->name.name); }
+};
+
+// Names that other objects may use to refer to @object.
+bool declaredNames(const IR::Node* object, std::set<cstring>& names) {
+    if (auto mk = object->to<IR::Declaration_MatchKind>()) {
+        for (auto d : *mk->getDeclarations())
+            names.insert(d->getName().name);
+        return true;
+    }
+    auto decl = object->to<IR::IDeclaration>();
+    if (decl == nullptr)
+        return false;
+    names.insert(decl->getName().name);
+    return true;
+}
+
+}  // namespace
+
+const std::set<cstring>& ProgramMap::namesUsedBy(const IR::Node* object) {
+    auto it = namesUsed.find(object);
+    if (it != namesUsed.end())
+        return it->second;
+    auto& names = namesUsed[object];
+    object->apply(CollectPathNames(names));
+    return names;
+}
+
+bool ProgramMap::staleObjects(const IR::P4Program* newProgram,
+                              std::set<const IR::Node*>& stale,
+                              std::set<const IR::Node*>& dirty) {
+    if (program == nullptr || newProgram == nullptr)
+        return false;
+
+    std::set<const IR::Node*> before(program->objects.begin(), program->objects.end());
+    std::set<const IR::Node*> after(newProgram->objects.begin(), newProgram->objects.end());
+    std::set<cstring> changed;
+    for (auto obj : program->objects) {
+        if (after.count(obj))
+            continue;
+        if (!declaredNames(obj, changed))
+            return false;
+        stale.insert(obj);
+    }
+    for (auto obj : newProgram->objects) {
+        if (before.count(obj))
+            continue;
+        if (!declaredNames(obj, changed))
+            return false;
+        dirty.insert(obj);
+    }
+
+    // Objects that refer to a changed name have to be processed again; this
+    // may change their own types, so the names they declare change too.
+    bool more = true;
+    while (more) {
+        more = false;
+        for (auto obj : newProgram->objects) {
+            if (dirty.count(obj))
+                continue;
+            auto& used = namesUsedBy(obj);
+            for (auto name : changed) {
+                if (used.count(name)) {
+                    stale.insert(obj);
+                    dirty.insert(obj);
+                    declaredNames(obj, changed);
+                    more = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (auto it = namesUsed.begin(); it != namesUsed.end();) {
+        if (after.count(it->first))
+            ++it;
+        else
+            it = namesUsed.erase(it);
+    }
+
+    LOG2(mapKind << ": " << stale.size() << " stale objects, "
+         << dirty.size() << " to process out of " << newProgram->objects.size());
+    // Past this point it is cheaper to start from scratch.
+    return 2 * dirty.size() <= newProgram->objects.size();
+}
+
+}  // namespace P4
@@ -24,13 +24,32 @@ namespace P4 {
 // Base class for various maps.
 // A map is computed on a certain P4Program.
 // If the program has not changed, the map is up-to-date.
+// If only some top-level objects of the program have changed, the map
+// can be updated incrementally; see staleObjects.
 class ProgramMap : public IHasDbPrint {
+    // Names of all the paths that appear in each top-level object.
+    // Cached across programs, since most objects survive unchanged.
+    std::map<const IR::Node*, std::set<cstring>> namesUsed;
+    const std::set<cstring>& namesUsedBy(const IR::Node* object);
+
  protected:
     const IR::P4Program* program = nullptr;
     cstring mapKind;
     explicit ProgramMap(cstring kind) : mapKind(kind) {}
     virtual ~ProgramMap() {}
 
+    /// Compares the top-level objects of @p newProgram with the ones of
+    /// the program the map was computed for.  Inserts into @p stale the
+    /// old objects whose map entries may be out of date: the ones that are
+    /// no longer in the program, and the surviving ones that refer by name
+    /// to something that has changed.  Inserts into @p dirty the objects
+    /// of @p newProgram which have to be processed again: the new ones and
+    /// the stale surviving ones.
+    /// @returns false if the map should rather be recomputed from scratch.
+    bool staleObjects(const IR::P4Program* newProgram,
+                      std::set<const IR::Node*>& stale,
+                      std::set<const IR::Node*>& dirty);
+
  public:
     // Check if map is up-to-date for the specified node; return true if it is
     bool checkMap(const IR::Node* node) const {
@@ -25,8 +25,10 @@ ReferenceMap::ReferenceMap() : ProgramMap("ReferenceMap"), isv1(false) { clear()
 void ReferenceMap::clear() {
     pathToDeclaration.clear();
     usedNames.clear();
+    pathUses.clear();
     used.clear();
     thisToDeclaration.clear();
+    namesInObject.clear();
     usedNames.insert(P4::reservedWords.begin(), P4::reservedWords.end());
 }
 
@@ -38,9 +40,9 @@ void ReferenceMap::setDeclaration(const IR::Path* path, const IR::IDeclaration*
     if (previous != nullptr && previous != decl)
         BUG("%1% already resolved to %2% instead of %3%",
             dbp(path), dbp(previous), dbp(decl->getNode()));
-    pathToDeclaration.emplace(path, decl);
+    if (pathToDeclaration.emplace(path, decl).second)
+        ++used[decl];
     usedName(path->name.name);
-    used.insert(decl);
 }
 
 void ReferenceMap::setDeclaration(const IR::This* pointer, const IR::IDeclaration* decl) {
@@ -54,6 +56,98 @@ void ReferenceMap::setDeclaration(const IR::This* pointer, const IR::IDeclaratio
     thisToDeclaration.emplace(pointer, decl);
 }
 
+namespace {
+
+class ForgetReferences : public Inspector {
+    std::map<const IR::Path*, unsigned>& pathUses;
+    std::vector<const IR::Path*>& unused;
+    std::vector<const IR::This*>& pointers;
+    bool uncountedOnly;
+
+ public:
+    ForgetReferences(std::map<const IR::Path*, unsigned>& pathUses,
+                     std::vector<const IR::Path*>& unused,
+                     std::vector<const IR::This*>& pointers, bool uncountedOnly)
+            : pathUses(pathUses), unused(unused), pointers(pointers),
+              uncountedOnly(uncountedOnly) {
+        // count every occurrence, like ResolveReferences
+        visitDagOnce = false;
+        setName("ForgetReferences");
+    }
+    void postorder(const IR::Path* path) override {
+        auto it = pathUses.find(path);
+        if (it == pathUses.end() || it->second == 0)
+            unused.push_back(path);
+        else if (!uncountedOnly && --it->second == 0)
+            unused.push_back(path);
+    }
+    void postorder(const IR::This* pointer) override {
+        if (!uncountedOnly)
+            pointers.push_back(pointer); }
+};
+
+/// The names that ResolveReferences records as used.
+class CollectUsedNames : public Inspector {
+    std::set<cstring>& names;
+
+ public:
+    explicit CollectUsedNames(std::set<cstring>& names) : names(names)
+    { setName("CollectUsedNames"); }
+    void postorder(const IR::Path* path) override { names.insert(path->name.name); }
+    void postorder(const IR::Declaration* d) override { names.insert(d->getName().name); }
+    void postorder(const IR::Type_Declaration* d) override { names.insert(d->getName().name); }
+};
+
+}  // namespace
+
+void ReferenceMap::forgetReferences(const IR::Node* node, bool uncountedOnly) {
+    std::vector<const IR::Path*> unused;
+    std::vector<const IR::This*> pointers;
+    node->apply(ForgetReferences(pathUses, unused, pointers, uncountedOnly));
+    for (auto path : unused) {
+        pathUses.erase(path);
+        auto it = pathToDeclaration.find(path);
+        if (it == pathToDeclaration.end())
+            continue;
+        auto u = used.find(it->second);
+        if (u != used.end() && --u->second == 0)
+            used.erase(u);
+        pathToDeclaration.erase(it);
+    }
+    for (auto pointer : pointers)
+        thisToDeclaration.erase(pointer);
+}
+
+bool ReferenceMap::invalidate(const IR::P4Program* program, std::set<const IR::Node*>& dirty) {
+    std::set<const IR::Node*> stale;
+    if (!staleObjects(program, stale, dirty))
+        return false;
+    for (auto obj : stale)
+        forgetReferences(obj);
+    // The passes that made the new objects may have resolved some of their
+    // paths already, and not necessarily the way ResolveReferences does.
+    for (auto obj : dirty)
+        forgetReferences(obj, true);
+
+    // Names of objects that are gone are free again, as after clear().
+    std::map<const IR::Node*, std::set<cstring>> names;
+    usedNames.clear();
+    usedNames.insert(P4::reservedWords.begin(), P4::reservedWords.end());
+    for (auto obj : program->objects) {
+        if (names.count(obj))
+            continue;
+        auto it = namesInObject.find(obj);
+        auto& objNames = names[obj];
+        if (it != namesInObject.end())
+            objNames = std::move(it->second);
+        else
+            obj->apply(CollectUsedNames(objNames));
+        usedNames.insert(objNames.begin(), objNames.end());
+    }
+    namesInObject = std::move(names);
+    return true;
+}
+
 const IR::IDeclaration* ReferenceMap::getDeclaration(const IR::This* pointer, bool notNull) const {
     CHECK_NULL(pointer);
     auto result = get(thisToDeclaration, pointer);
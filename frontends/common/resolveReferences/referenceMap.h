@@ -39,8 +39,14 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     /// Maps paths in the program to declarations.
     std::map<const IR::Path*, const IR::IDeclaration*> pathToDeclaration;
 
-    /// Set containing all declarations in the program.
-    std::set<const IR::IDeclaration*> used;
+    /// Number of occurrences in the program of each resolved path, as
+    /// seen by ResolveReferences.  A path may appear in several places
+    /// when the IR is a DAG.
+    std::map<const IR::Path*, unsigned> pathUses;
+
+    /// All declarations in the program that some path resolves to,
+    /// with the number of such paths.
+    std::map<const IR::IDeclaration*, unsigned> used;
 
     /// Map from `This` to declarations (an experimental feature).
     std::map<const IR::This*, const IR::IDeclaration*> thisToDeclaration;
@@ -48,6 +54,10 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     /// Set containing all names used in the program.
     std::set<cstring> usedNames;
 
+    /// The names ResolveReferences finds in use in each top-level object,
+    /// from which usedNames is rebuilt when the map is updated incrementally.
+    std::map<const IR::Node*, std::set<cstring>> namesInObject;
+
  public:
     ReferenceMap();
     /// Looks up declaration for @p path. If @p notNull is false, then
@@ -57,6 +67,9 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     /// Sets declaration for @p path to @p decl.
     void setDeclaration(const IR::Path* path, const IR::IDeclaration* decl);
 
+    /// Records one more occurrence of the resolved @p path in the program.
+    void countReference(const IR::Path* path) { ++pathUses[path]; }
+
     /// Looks up declaration for @p pointer. If @p notNull is false,
     /// then failure to find a declaration is an error.
     const IR::IDeclaration* getDeclaration(const IR::This* pointer, bool notNull = false) const;
@@ -75,6 +88,17 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     /// Clear the reference map
     void clear();
 
+    /// Check whether the map can be updated incrementally for @p program.
+    /// If so, forgets the references made by all the top-level objects that
+    /// are no longer up-to-date, inserts into @p dirty the objects of
+    /// @p program which have to be resolved again, and returns true.
+    bool invalidate(const IR::P4Program* program, std::set<const IR::Node*>& dirty);
+
+    /// Forget the references made by the paths in @p node, as counted by
+    /// countReference.  With @p uncountedOnly, only forget the ones that
+    /// were never counted: passes set these on the paths they create.
+    void forgetReferences(const IR::Node* node, bool uncountedOnly = false);
+
     /// @returns @true if this map is for a P4_14 program
     bool isV1() const { return isv1; }
 
@@ -83,6 +107,12 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
 
     /// Indicate that @p name is used in the program.
     void usedName(cstring name) { usedNames.insert(name); }
+
+    /// Indicate that all the names used or generated by @p other are used
+    /// in the program, e.g. when merging parts of the program processed
+    /// with their own maps.
+    void addUsedNames(const ReferenceMap* other)
+    { usedNames.insert(other->usedNames.begin(), other->usedNames.end()); }
 };
 
 }  // namespace P4
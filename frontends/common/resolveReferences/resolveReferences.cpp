@@ -224,6 +224,7 @@ void ResolveReferences::resolvePath(const IR::Path* path, bool isType) const {
     }
 
     refMap->setDeclaration(path, decl);
+    refMap->countReference(path);
 }
 
 void ResolveReferences::checkShadowing(const IR::INamespace* ns) const {
@@ -262,8 +263,15 @@ void ResolveReferences::checkShadowing(const IR::INamespace* ns) const {
 
 Visitor::profile_t ResolveReferences::init_apply(const IR::Node* node) {
     anyOrder = refMap->isV1();
-    if (!refMap->checkMap(node))
-        refMap->clear();
+    toResolve.clear();
+    incremental = false;
+    if (!refMap->checkMap(node)) {
+        auto program = node->to<IR::P4Program>();
+        if (program != nullptr && refMap->invalidate(program, toResolve))
+            incremental = true;
+        else
+            refMap->clear();
+    }
     return Inspector::init_apply(node);
 }
 
@@ -282,6 +290,20 @@ bool ResolveReferences::preorder(const IR::P4Program* program) {
     BUG_CHECK(rootNamespace == nullptr, "Root namespace already set");
     rootNamespace = program;
     context = new ResolutionContext(rootNamespace);
+    if (incremental) {
+        // the ones to resolve are added to the globals when visited
+        for (auto obj : program->objects) {
+            auto mk = obj->to<IR::Declaration_MatchKind>();
+            if (mk != nullptr && !toResolve.count(obj))
+                addToGlobals(mk);
+        }
+        for (auto obj : program->objects) {
+            if (toResolve.count(obj))
+                visit(obj);
+        }
+        postorder(program);
+        return false;
+    }
     return true;
 }
 
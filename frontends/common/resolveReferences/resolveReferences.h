@@ -126,6 +126,12 @@ class ResolveReferences : public Inspector {
     /// If @true, then warn if one declaration shadows another.
     bool checkShadow;
 
+    /// When the program has changed only partially, the top-level objects
+    /// which have to be resolved again; all other references in the
+    /// `refMap` are still valid.
+    std::set<const IR::Node*> toResolve;
+    bool incremental = false;
+
  private:
     /// Add namespace @p ns to `context`
     void addToContext(const IR::INamespace* ns);
@@ -23,6 +23,7 @@ limitations under the License.
 #include "lib/log.h"
 #include "lib/exceptions.h"
 #include "lib/map.h"
+#include "lib/flat_ordered_map.h"
 #include "lib/ordered_map.h"
 #include "lib/ordered_set.h"
 #include "lib/null.h"
@@ -41,12 +42,12 @@ class CallGraph {
  protected:
     cstring name;
     // Use an ordered map to make this deterministic
-    ordered_map<T, std::vector<T>*> out_edges;  // map caller to list of callees
-    ordered_map<T, std::vector<T>*> in_edges;
+    flat_ordered_map<T, std::vector<T>*> out_edges;  // map caller to list of callees
+    flat_ordered_map<T, std::vector<T>*> in_edges;
 
  public:
     ordered_set<T> nodes;    // all nodes; do not modify this directly
-    typedef typename ordered_map<T, std::vector<T>*>::const_iterator const_iterator;
+    typedef typename flat_ordered_map<T, std::vector<T>*>::const_iterator const_iterator;
 
     explicit CallGraph(cstring name) : name(name) {}
 
@@ -0,0 +1,42 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "changedDeclarations.h"
+
+namespace P4 {
+
+void ChangedDeclarations::update(const IR::Node* before, const IR::Node* after) {
+    changed.clear();
+    std::set<const IR::Node*> stale;
+    // staleObjects compares with the program the map was last updated to.
+    updateMap(before);
+    all = after == nullptr || !staleObjects(after->to<IR::P4Program>(), stale, changed);
+    updateMap(after);
+    LOG2(this);
+}
+
+void ChangedDeclarations::dbprint(std::ostream& out) const {
+    out << mapKind << " for " << dbp(program) << ": ";
+    if (all) {
+        out << "all";
+        return;
+    }
+    out << changed.size();
+    for (auto decl : changed)
+        out << " " << dbp(decl);
+}
+
+}  // namespace P4
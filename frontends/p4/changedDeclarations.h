@@ -0,0 +1,71 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _FRONTENDS_P4_CHANGEDDECLARATIONS_H_
+#define _FRONTENDS_P4_CHANGEDDECLARATIONS_H_
+
+#include <set>
+#include "ir/ir.h"
+#include "ir/pass_manager.h"
+#include "frontends/common/programMap.h"
+
+namespace P4 {
+
+/**
+ * The top-level declarations of a program that changed in the last iteration
+ * of a PassRepeatedOnChanges, and the ones that refer to them by name,
+ * directly or not.  Passes that only look for work inside each declaration
+ * can skip the others, where they have already found none.
+ */
+class ChangedDeclarations : public ProgramMap {
+    bool all = true;
+    std::set<const IR::Node*> changed;
+
+ public:
+    ChangedDeclarations() : ProgramMap("ChangedDeclarations") {}
+    /// Every declaration counts as changed: nothing is known yet.
+    void reset() { all = true; changed.clear(); program = nullptr; }
+    /// Finds the declarations of @p after that differ from @p before.
+    void update(const IR::Node* before, const IR::Node* after);
+    /// True if a pass has to look at top-level declaration @p decl again.
+    bool contains(const IR::Node* decl) const { return all || changed.count(decl) != 0; }
+    bool everything() const { return all; }
+    size_t size() const { return changed.size(); }
+    void dbprint(std::ostream& out) const;
+};
+
+/**
+ * A PassRepeated that tracks the declarations each iteration changes.
+ * The passes given a pointer to `changes` only look at these (and at the
+ * declarations depending on them) in the next iteration.
+ */
+class PassRepeatedOnChanges : public PassRepeated {
+ protected:
+    ChangedDeclarations changes;
+    void iterated(const IR::Node* before, const IR::Node* after) override
+    { changes.update(before, after); }
+
+ public:
+    PassRepeatedOnChanges() = default;
+    explicit PassRepeatedOnChanges(const std::initializer_list<Visitor*> &init) :
+            PassManager(init), PassRepeated(init) {}
+    const IR::Node* apply_visitor(const IR::Node* program, const char* name = 0) override
+    { changes.reset(); return PassRepeated::apply_visitor(program, name); }
+};
+
+}  // namespace P4
+
+#endif /* _FRONTENDS_P4_CHANGEDDECLARATIONS_H_ */
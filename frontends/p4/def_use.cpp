@@ -29,7 +29,16 @@ const cstring StorageFactory::indexFieldName = "$lastIndex";
 const LocationSet* LocationSet::empty = new LocationSet();
 ProgramPoint ProgramPoint::beforeStart;
 
-StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) const {
+StorageLocation* StorageFactory::number(StorageLocation* location) {
+    location->factory = this;
+    location->id = locations.size();
+    if (location->is<BaseLocation>())
+        baseLocations.setbit(location->id);
+    locations.push_back(location);
+    return location;
+}
+
+StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) {
     if (type->is<IR::Type_Bits>() ||
         type->is<IR::Type_Boolean>() ||
         type->is<IR::Type_Varbits>() ||
@@ -44,7 +53,7 @@ StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) cons
         type->is<IR::Type_Tuple>() ||
         // Also for newtype
         type->is<IR::Type_Newtype>())
-        return new BaseLocation(type, name);
+        return number(new BaseLocation(type, name));
     if (type->is<IR::Type_StructLike>()) {
         type = typeMap->getTypeType(type, true);  // get the canonical version
         auto st = type->to<IR::Type_StructLike>();
@@ -70,7 +79,7 @@ StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) cons
             auto valid = create(IR::Type_Boolean::get(), name + "." + validFieldName);
             result->addField(validFieldName, valid);
         }
-        return result;
+        return number(result);
     }
     if (type->is<IR::Type_Stack>()) {
         type = typeMap->getTypeType(type, true);  // get the canonical version
@@ -81,7 +90,7 @@ StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) cons
             result->addElement(i, sl);
         }
         result->setLastIndexField(create(IR::Type_Bits::get(32), name + "." + indexFieldName));
-        return result;
+        return number(result);
     }
     return nullptr;
 }
@@ -154,15 +163,15 @@ const LocationSet* LocationSet::join(const LocationSet* other) const {
         return other;
     if (other == LocationSet::empty)
         return this;
-    auto result = new LocationSet(locations);
-    for (auto e : other->locations)
-        result->add(e);
+    auto result = new LocationSet(*this);
+    result->setFactory(other->factory);
+    result->locations |= other->locations;
     return result;
 }
 
 const LocationSet* LocationSet::getArrayLastIndex() const {
     auto result = new LocationSet();
-    for (auto l : locations) {
+    for (auto l : *this) {
         if (l->is<ArrayLocation>()) {
             auto array = l->to<ArrayLocation>();
             result->add(array->getLastIndexField());
@@ -174,7 +183,7 @@ const LocationSet* LocationSet::getArrayLastIndex() const {
 
 const LocationSet* LocationSet::getField(cstring field) const {
     auto result = new LocationSet();
-    for (auto l : locations) {
+    for (auto l : *this) {
         if (l->is<StructLocation>()) {
             auto strct = l->to<StructLocation>();
             if (field == StorageFactory::validFieldName && strct->isHeaderUnion()) {
@@ -200,7 +209,7 @@ const LocationSet* LocationSet::getValidField() const
 
 const LocationSet* LocationSet::getIndex(unsigned index) const {
     auto result = new LocationSet();
-    for (auto l : locations) {
+    for (auto l : *this) {
         auto array = l->to<ArrayLocation>();
         array->addElement(index, result);
     }
@@ -209,7 +218,7 @@ const LocationSet* LocationSet::getIndex(unsigned index) const {
 
 const LocationSet* LocationSet::allElements() const {
     auto result = new LocationSet();
-    for (auto l : locations) {
+    for (auto l : *this) {
         auto array = l->to<ArrayLocation>();
         for (auto e : *array)
             result->add(e);
@@ -218,8 +227,10 @@ const LocationSet* LocationSet::allElements() const {
 }
 
 const LocationSet* LocationSet::canonicalize() const {
+    if (factory == nullptr || (locations - factory->getBaseLocations()).empty())
+        return this;  // already canonical
     LocationSet* result = new LocationSet();
-    for (auto e : locations)
+    for (auto e : *this)
         result->addCanonical(e);
     return result;
 }
@@ -239,18 +250,35 @@ void LocationSet::addCanonical(const StorageLocation* location) {
 }
 
 bool LocationSet::overlaps(const LocationSet* other) const {
-    for (auto s : locations) {
-        if (other->locations.find(s) != other->locations.end())
-            return true;
-    }
-    return false;
+    BUG_CHECK(factory == nullptr || other->factory == nullptr || factory == other->factory,
+              "comparing locations of different storage maps");
+    return locations.intersects(other->locations);
+}
+
+unsigned ProgramPointTable::getId(const ProgramPoint& point) {
+    auto it = ids.emplace(point, points.size());
+    if (it.second)
+        points.push_back(point);
+    return it.first->second;
+}
+
+const ProgramPoints* ProgramPointTable::singleton(const ProgramPoint& point) {
+    auto id = getId(point);
+    if (id >= singletons.size())
+        singletons.resize(id + 1);
+    if (singletons[id] == nullptr)
+        singletons[id] = new ProgramPoints(this, point);
+    return singletons[id];
 }
 
 const ProgramPoints* ProgramPoints::merge(const ProgramPoints* with) const {
-    auto result = new ProgramPoints(points);
-    for (auto p : with->points)
-        result->points.emplace(p);
-    return result;
+    if (with == this || (points | with->points) == points)
+        return this;
+    if ((points | with->points) == with->points)
+        return with;
+    BUG_CHECK(table == nullptr || with->table == nullptr || table == with->table,
+              "merging program points of different tables");
+    return new ProgramPoints(table ? table : with->table, points | with->points);
 }
 
 ProgramPoint::ProgramPoint(const ProgramPoint &context, const IR::Node* node) {
@@ -274,61 +302,57 @@ std::size_t ProgramPoint::hash() const {
     return result;
 }
 
-bool ProgramPoints::operator==(const ProgramPoints& other) const {
-    if (points.size() != other.points.size())
-        return false;
-    for (auto p : points)
-        if (other.points.find(p) == other.points.end())
-            return false;
-    return true;
-}
-
 Definitions* Definitions::joinDefinitions(const Definitions* other) const {
+    BUG_CHECK(factory == nullptr || other->factory == nullptr || factory == other->factory,
+              "joining definitions of different storage maps");
     auto result = new Definitions();
-    for (auto d : other->definitions) {
-        auto loc = d.first;
-        auto defs = d.second;
-        auto current = ::get(definitions, loc);
-        if (current != nullptr) {
-            auto merged = current->merge(defs);
-            result->definitions.emplace(loc, merged);
-        } else {
-            result->definitions.emplace(loc, defs);
-        }
-    }
-    for (auto d : definitions) {
-        auto loc = d.first;
-        auto defs = d.second;
-        auto current = ::get(other->definitions, loc);
-        if (current == nullptr)
-            result->definitions.emplace(loc, defs);
-        // otherwise have have already done it in the loop above
+    result->factory = factory ? factory : other->factory;
+    auto size = std::max(definitions.size(), other->definitions.size());
+    result->definitions.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        auto mine = i < definitions.size() ? definitions[i] : nullptr;
+        auto theirs = i < other->definitions.size() ? other->definitions[i] : nullptr;
+        if (mine == nullptr)
+            result->definitions[i] = theirs;
+        else if (theirs == nullptr)
+            result->definitions[i] = mine;
+        else
+            result->definitions[i] = mine->merge(theirs);
     }
     if (unreachable && other->unreachable)
         result->setUnreachable();
     return result;
 }
 
+void Definitions::setDefintion(const BaseLocation* loc, const ProgramPoints* point) {
+    CHECK_NULL(loc); CHECK_NULL(point);
+    BUG_CHECK(factory == nullptr || loc->getFactory() == factory,
+              "%1%: location of another storage map", loc);
+    factory = loc->getFactory();
+    if (loc->getId() >= definitions.size())
+        definitions.resize(factory->getLocations().size());
+    definitions[loc->getId()] = point;
+}
+
 void Definitions::setDefinition(const StorageLocation* location, const ProgramPoints* point) {
     LocationSet locset;
     locset.addCanonical(location);
     for (auto sl : locset)
-        definitions[sl->to<BaseLocation>()] = point;
+        setDefintion(sl->to<BaseLocation>(), point);
 }
 
 void Definitions::setDefinition(const LocationSet* locations, const ProgramPoints* point) {
     for (auto sl : *locations->canonicalize())
-        definitions[sl->to<BaseLocation>()] = point;
+        setDefintion(sl->to<BaseLocation>(), point);
 }
 
 void Definitions::removeLocation(const StorageLocation* location) {
-    auto loc = new LocationSet();
-    loc->addCanonical(location);
-    for (auto sl : *loc) {
-        auto bl = sl->to<BaseLocation>();
-        auto it = definitions.find(bl);
-        if (it != definitions.end())
-            definitions.erase(it);
+    LocationSet loc;
+    loc.addCanonical(location);
+    for (auto sl : loc) {
+        auto id = sl->getId();
+        if (id < definitions.size())
+            definitions[id] = nullptr;
     }
 }
 
@@ -341,24 +365,20 @@ const ProgramPoints* Definitions::getPoints(const LocationSet* locations) const
     return result;
 }
 
-Definitions* Definitions::writes(ProgramPoint point, const LocationSet* locations) const {
+Definitions* Definitions::writes(const ProgramPoints* points, const LocationSet* locations) const {
     auto result = new Definitions(*this);
-    auto points = new ProgramPoints();
-    points->add(point);
-    auto canon = locations->canonicalize();
-    for (auto l : *canon)
-        result->setDefinition(l->to<BaseLocation>(), points);
+    result->setDefinition(locations, points);
     return result;
 }
 
 bool Definitions::operator==(const Definitions& other) const {
-    if (definitions.size() != other.definitions.size())
-        return false;
-    for (auto d : definitions) {
-        auto od = ::get(other.definitions, d.first);
-        if (od == nullptr)
-            return false;
-        if (!d.second->operator==(*od))
+    auto size = std::max(definitions.size(), other.definitions.size());
+    for (size_t i = 0; i < size; i++) {
+        auto mine = i < definitions.size() ? definitions[i] : nullptr;
+        auto theirs = i < other.definitions.size() ? other.definitions[i] : nullptr;
+        if (mine == theirs)
+            continue;
+        if (mine == nullptr || theirs == nullptr || !(*mine == *theirs))
             return false;
     }
     return true;
@@ -379,8 +399,8 @@ void ComputeWriteSet::enterScope(const IR::ParameterList* parameters,
     if (defs == nullptr)
         defs = new Definitions();
 
-    auto startPoints = new ProgramPoints(entryPoint);
-    auto uninit = new ProgramPoints(ProgramPoint::beforeStart);
+    auto startPoints = allDefinitions->getPoints(entryPoint);
+    auto uninit = allDefinitions->getPoints(ProgramPoint::beforeStart);
 
     if (parameters != nullptr) {
         for (auto p : parameters->parameters) {
@@ -775,7 +795,7 @@ bool ComputeWriteSet::preorder(const IR::IfStatement* statement) {
     visit(statement->condition);
     auto cond = getWrites(statement->condition);
     // defs are the definitions after evaluating the condition
-    auto defs = currentDefinitions->writes(getProgramPoint(), cond);
+    auto defs = currentDefinitions->writes(allDefinitions->getPoints(getProgramPoint()), cond);
     (void)setDefinitions(defs, statement->condition);
     visit(statement->ifTrue);
     auto result = currentDefinitions;
@@ -829,7 +849,7 @@ bool ComputeWriteSet::preorder(const IR::AssignmentStatement* statement) {
     auto l = getWrites(statement->left);
     auto r = getWrites(statement->right);
     locs = l->join(r);
-    auto defs = currentDefinitions->writes(getProgramPoint(), locs);
+    auto defs = currentDefinitions->writes(allDefinitions->getPoints(getProgramPoint()), locs);
     return setDefinitions(defs);
 }
 
@@ -839,7 +859,8 @@ bool ComputeWriteSet::preorder(const IR::SwitchStatement* statement) {
         return setDefinitions(currentDefinitions);
     visit(statement->expression);
     auto locs = getWrites(statement->expression);
-    auto defs = currentDefinitions->writes(getProgramPoint(statement->expression), locs);
+    auto defs = currentDefinitions->writes(
+        allDefinitions->getPoints(getProgramPoint(statement->expression)), locs);
     (void)setDefinitions(defs, statement->expression);
     auto save = currentDefinitions;
     auto result = new Definitions();
@@ -908,7 +929,7 @@ bool ComputeWriteSet::preorder(const IR::Function* function) {
     enterScope(function->type->parameters, locals, point, false);
 
     // The return value is uninitialized
-    auto uninit = new ProgramPoints(ProgramPoint::beforeStart);
+    auto uninit = allDefinitions->getPoints(ProgramPoint::beforeStart);
     auto retVal = allDefinitions->storageMap->addRetVal();
     currentDefinitions->setDefinition(retVal, uninit);
 
@@ -950,7 +971,7 @@ bool ComputeWriteSet::preorder(const IR::MethodCallStatement* statement) {
     lhs = false;
     visit(statement->methodCall);
     auto locs = getWrites(statement->methodCall);
-    auto defs = currentDefinitions->writes(getProgramPoint(), locs);
+    auto defs = currentDefinitions->writes(allDefinitions->getPoints(getProgramPoint()), locs);
     return setDefinitions(defs);
 }
 
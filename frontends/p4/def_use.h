@@ -17,7 +17,9 @@ limitations under the License.
 #ifndef _FRONTENDS_P4_DEF_USE_H_
 #define _FRONTENDS_P4_DEF_USE_H_
 
+#include <deque>
 #include "ir/ir.h"
+#include "lib/bitvec.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 
 namespace P4 {
@@ -25,14 +27,34 @@ namespace P4 {
 class StorageFactory;
 class LocationSet;
 
+/// Iterates over the elements of a TABLE whose indices are the bits set in a bitvec.
+template<class TABLE> class BitvecTableIterator {
+    const TABLE*            table;
+    bitvec::const_bitref    bit;
+
+ public:
+    BitvecTableIterator(const TABLE* table, bitvec::const_bitref bit) : table(table), bit(bit) {}
+    const typename TABLE::value_type& operator*() const { return (*table)[*bit]; }
+    BitvecTableIterator& operator++() { ++bit; return *this; }
+    bool operator==(const BitvecTableIterator& other) const { return bit == other.bit; }
+    bool operator!=(const BitvecTableIterator& other) const { return bit != other.bit; }
+};
+
 /// Abstraction for something that is has a left value (variable, parameter)
 class StorageLocation : public IHasDbPrint {
+    friend class StorageFactory;
+    const StorageFactory* factory = nullptr;
+    unsigned id = 0;
+
  public:
     virtual ~StorageLocation() {}
     const IR::Type* type;
     const cstring name;
     StorageLocation(const IR::Type* type, cstring name) : type(type), name(name)
     { CHECK_NULL(type); }
+    /// The factory that created this location, and the number it gave it.
+    const StorageFactory* getFactory() const { return factory; }
+    unsigned getId() const { return id; }
     template <class T>
     const T* to() const {
         auto result = dynamic_cast<const T*>(this);
@@ -143,12 +165,24 @@ class ArrayLocation : public StorageLocation {
     void addLastIndexField(LocationSet* result) const override;
 };
 
+/// Creates the storage locations of a parser or control, and numbers them
+/// densely in creation order, so that sets of them can be bit vectors.
 class StorageFactory {
     TypeMap* typeMap;
+    std::vector<const StorageLocation*> locations;  // by id
+    bitvec baseLocations;  // ids of the BaseLocations
+
+    StorageLocation* number(StorageLocation* location);
+
  public:
     explicit StorageFactory(TypeMap* typeMap) : typeMap(typeMap)
     { CHECK_NULL(typeMap); }
-    StorageLocation* create(const IR::Type* type, cstring name) const;
+    // the locations point back to their factory
+    StorageFactory(const StorageFactory&) = delete;
+    StorageFactory& operator=(const StorageFactory&) = delete;
+    StorageLocation* create(const IR::Type* type, cstring name);
+    const std::vector<const StorageLocation*>& getLocations() const { return locations; }
+    const bitvec& getBaseLocations() const { return baseLocations; }
 
     static const cstring validFieldName;
     static const cstring indexFieldName;
@@ -156,14 +190,23 @@ class StorageFactory {
 
 /// A set of locations that may be read or written by a computation.
 /// In general this is a conservative approximation of the actual location set.
+/// The set is a bit vector of the ids of the locations, so all the locations
+/// must come from the same StorageFactory.
 class LocationSet : public IHasDbPrint {
-    std::set<const StorageLocation*> locations;
+    /// Factory of the locations; null as long as the set is empty.
+    const StorageFactory* factory = nullptr;
+    bitvec locations;
+
+    void setFactory(const StorageFactory* other) {
+        BUG_CHECK(factory == nullptr || other == nullptr || factory == other,
+                  "mixing locations of different storage maps");
+        if (factory == nullptr) factory = other; }
 
  public:
+    typedef BitvecTableIterator<std::vector<const StorageLocation*>> const_iterator;
+
     LocationSet() = default;
-    explicit LocationSet(const std::set<const StorageLocation*> &other) : locations(other) {}
-    explicit LocationSet(const StorageLocation* location)
-    { CHECK_NULL(location); locations.emplace(location); }
+    explicit LocationSet(const StorageLocation* location) { add(location); }
     static const LocationSet* empty;
 
     const LocationSet* getField(cstring field) const;
@@ -172,19 +215,22 @@ class LocationSet : public IHasDbPrint {
     const LocationSet* allElements() const;
     const LocationSet* getArrayLastIndex() const;
 
-    void add(const StorageLocation* location)
-    { CHECK_NULL(location); locations.emplace(location); }
+    void add(const StorageLocation* location) {
+        CHECK_NULL(location);
+        setFactory(location->getFactory());
+        locations.setbit(location->getId()); }
     const LocationSet* join(const LocationSet* other) const;
     /// @returns this location set expressed only in terms of BaseLocation;
     /// e.g., a StructLocation is expanded in all its fields.
     const LocationSet* canonicalize() const;
     void addCanonical(const StorageLocation* location);
-    std::set<const StorageLocation*>::const_iterator begin() const { return locations.cbegin(); }
-    std::set<const StorageLocation*>::const_iterator end()   const { return locations.cend(); }
+    /// Iterates in the order the locations were created.
+    const_iterator begin() const { return const_iterator(locationTable(), locations.begin()); }
+    const_iterator end() const { return const_iterator(locationTable(), locations.end()); }
     virtual void dbprint(std::ostream& out) const {
         if (locations.empty())
             out << "LocationSet::empty";
-        for (auto l : locations) {
+        for (auto l : *this) {
             l->dbprint(out);
             out << " ";
         }
@@ -192,6 +238,10 @@ class LocationSet : public IHasDbPrint {
     // only defined for canonical representations
     bool overlaps(const LocationSet* other) const;
     bool isEmpty() const { return locations.empty(); }
+
+ private:
+    const std::vector<const StorageLocation*>* locationTable() const
+    { return factory ? &factory->getLocations() : nullptr; }
 };
 
 /// Maps a declaration to its associated storage.
@@ -299,57 +349,88 @@ template<> struct hash<P4::ProgramPoint> {
 }  // namespace std
 
 namespace P4 {
+class ProgramPoints;
+
+/// Numbers the program points of a parser or control, so that sets of them
+/// can be bit vectors.  ProgramPoint::beforeStart is always number 0.
+class ProgramPointTable {
+    std::unordered_map<ProgramPoint, unsigned> ids;
+    std::deque<ProgramPoint> points;  // by id
+    std::vector<const ProgramPoints*> singletons;  // by id; created on demand
+
+ public:
+    typedef std::deque<ProgramPoint> Points;
+
+    ProgramPointTable() { (void)getId(ProgramPoint::beforeStart); }
+    ProgramPointTable(const ProgramPointTable&) = delete;
+    ProgramPointTable& operator=(const ProgramPointTable&) = delete;
+    unsigned getId(const ProgramPoint& point);
+    const Points& getPoints() const { return points; }
+    /// @returns the set holding only @p point; the same object every time.
+    const ProgramPoints* singleton(const ProgramPoint& point);
+};
+
 class ProgramPoints : public IHasDbPrint {
-    typedef std::unordered_set<ProgramPoint> Points;
-    Points points;
-    explicit ProgramPoints(const Points &points) : points(points) {}
+    /// Table numbering the points; null as long as the set is empty.
+    const ProgramPointTable* table = nullptr;
+    bitvec points;
+    ProgramPoints(const ProgramPointTable* table, const bitvec& points) :
+            table(table), points(points) {}
  public:
+    typedef BitvecTableIterator<ProgramPointTable::Points> const_iterator;
+
     ProgramPoints() = default;
-    explicit ProgramPoints(ProgramPoint point) { points.emplace(point); }
-    void add(ProgramPoint point) { points.emplace(point); }
+    ProgramPoints(ProgramPointTable* table, const ProgramPoint& point) : table(table)
+    { CHECK_NULL(table); points.setbit(table->getId(point)); }
     const ProgramPoints* merge(const ProgramPoints* with) const;
-    bool operator==(const ProgramPoints& other) const;
+    bool operator==(const ProgramPoints& other) const { return points == other.points; }
     void dbprint(std::ostream& out) const {
         out << "{";
-        for (auto p : points)
+        for (auto &p : *this)
             out << p << " ";
         out << "}";
     }
-    size_t size() const { return points.size(); }
-    bool containsBeforeStart() const
-    { return points.find(ProgramPoint::beforeStart) != points.end(); }
-    Points::const_iterator begin() const
-    { return points.cbegin(); }
-    Points::const_iterator end() const
-    { return points.cend(); }
+    size_t size() const { return points.popcount(); }
+    bool containsBeforeStart() const { return points.getbit(0); }
+    const_iterator begin() const
+    { return const_iterator(table ? &table->getPoints() : nullptr, points.begin()); }
+    const_iterator end() const
+    { return const_iterator(table ? &table->getPoints() : nullptr, points.end()); }
 };
 
 /// List of definers for each base storage (at a specific program point).
 class Definitions : public IHasDbPrint {
+    /// Factory of the locations; null as long as there are no definitions.
+    const StorageFactory* factory = nullptr;
     /// Set of program points that have written last to each location
-    /// (conservative approximation).
-    std::map<const BaseLocation*, const ProgramPoints*> definitions;
+    /// (conservative approximation), indexed by the id of the location;
+    /// null for the locations that have no definitions.
+    std::vector<const ProgramPoints*> definitions;
     /// If true the current program point is actually unreachable and
     /// it's definitions should not matter.
-    bool unreachable;
+    bool unreachable = false;
+
+    const ProgramPoints* get(const BaseLocation* location) const {
+        BUG_CHECK(factory == nullptr || location->getFactory() == factory,
+                  "%1%: location of another storage map", location);
+        auto id = location->getId();
+        return id < definitions.size() ? definitions[id] : nullptr; }
 
  public:
     Definitions() = default;
-    Definitions(const Definitions& other) :
-            definitions(other.definitions), unreachable(other.unreachable) {}
+    Definitions(const Definitions& other) = default;
     Definitions* joinDefinitions(const Definitions* other) const;
     /// Point writes the specified LocationSet.
-    Definitions* writes(ProgramPoint point, const LocationSet* locations) const;
-    void setDefintion(const BaseLocation* loc, const ProgramPoints* point)
-    { CHECK_NULL(loc); CHECK_NULL(point); definitions[loc] = point; }
+    Definitions* writes(const ProgramPoints* point, const LocationSet* locations) const;
+    void setDefintion(const BaseLocation* loc, const ProgramPoints* point);
     void setDefinition(const StorageLocation* loc, const ProgramPoints* point);
     void setDefinition(const LocationSet* loc, const ProgramPoints* point);
     Definitions* setUnreachable() { unreachable = true; return this; }
     bool isUnreachable() const { return unreachable; }
     bool hasLocation(const BaseLocation* location) const
-    { return definitions.find(location) != definitions.end(); }
+    { return get(location) != nullptr; }
     const ProgramPoints* getPoints(const BaseLocation* location) const {
-        auto r = ::get(definitions, location);
+        auto r = get(location);
         BUG_CHECK(r != nullptr, "%1%: no definitions", location);
         return r; }
     const ProgramPoints* getPoints(const LocationSet* locations) const;
@@ -359,19 +440,24 @@ class Definitions : public IHasDbPrint {
             out << "  Unreachable";
             return;
         }
-        if (definitions.empty())
+        if (empty())
             out << "  Empty definitions";
         bool first = true;
-        for (auto d : definitions) {
+        for (size_t i = 0; i < definitions.size(); i++) {
+            if (definitions[i] == nullptr)
+                continue;
             if (!first)
                 out << std::endl;
-            out << "  " << *d.first << "=>" << *d.second;
+            out << "  " << *factory->getLocations()[i] << "=>" << *definitions[i];
             first = false;
         }
     }
     Definitions* cloneDefinitions() const { return new Definitions(*this); }
     void removeLocation(const StorageLocation* loc);
-    bool empty() const { return definitions.empty(); }
+    bool empty() const {
+        for (auto d : definitions)
+            if (d != nullptr) return false;
+        return true; }
 };
 
 class AllDefinitions : public IHasDbPrint {
@@ -379,6 +465,7 @@ class AllDefinitions : public IHasDbPrint {
     /// However, for ProgramPoints representing P4Control, P4Action, and P4Table
     /// the definitions are BEFORE the ProgramPoint.
     std::unordered_map<ProgramPoint, Definitions*> atPoint;
+    ProgramPointTable programPoints;
 
  public:
     StorageMap* storageMap;
@@ -398,6 +485,9 @@ class AllDefinitions : public IHasDbPrint {
     }
     void setDefinitionsAt(ProgramPoint point, Definitions* defs)
     { atPoint[point] = defs; }
+    /// @returns the set holding only @p point.
+    const ProgramPoints* getPoints(const ProgramPoint& point)
+    { return programPoints.singleton(point); }
     void dbprint(std::ostream& out) const {
         for (auto e : atPoint)
             out << e.first << " => " << e.second << std::endl;
@@ -413,6 +503,10 @@ class AllDefinitions : public IHasDbPrint {
  *
  * @pre Must be executed after variable initializers have been removed.
  *
+ * It does not set threadedFlows: it is not a ControlFlowVisitor, and it
+ * visits the branches of if and switch statements itself rather than with
+ * parallel_visit.  The visitors it creates for those branches also share
+ * allDefinitions, whose maps and program point table are not threadsafe.
  */
 class ComputeWriteSet : public Inspector {
  protected:
@@ -417,7 +417,8 @@ bool DiscoverInlining::preorder(const IR::ControlBlock* block) {
         ::error("%1%: instantiation of control in parser",
                 block->node);
         return false;
-    } else if (getContext()->node->is<IR::ControlBlock>() && allowControls) {
+    } else if (getContext()->node->is<IR::ControlBlock>() && allowControls &&
+               changed(getContext()->node->to<IR::ControlBlock>()->container)) {
         auto parent = getContext()->node->to<IR::ControlBlock>();
         LOG3("Will inline " << dbp(block) << "@" << dbp(block->node) << " into " << dbp(parent));
         auto instance = block->node->to<IR::Declaration_Instance>();
@@ -426,7 +427,7 @@ bool DiscoverInlining::preorder(const IR::ControlBlock* block) {
     }
 
     visit_all(block);
-    if (::errorCount() > 0)
+    if (::errorCount() > 0 || !changed(block->container))
         return false;
     visit(block->container->body);
     return false;
@@ -438,7 +439,8 @@ bool DiscoverInlining::preorder(const IR::ParserBlock* block) {
         ::error("%1%: instantiation of parser in control",
                 block->node);
         return false;
-    } else if (getContext()->node->is<IR::ParserBlock>()) {
+    } else if (getContext()->node->is<IR::ParserBlock>() &&
+               changed(getContext()->node->to<IR::ParserBlock>()->container)) {
         auto parent = getContext()->node->to<IR::ParserBlock>();
         LOG3("Will inline " << block << "@" << block->node << " into " << parent);
         auto instance = block->node->to<IR::Declaration_Instance>();
@@ -446,7 +448,7 @@ bool DiscoverInlining::preorder(const IR::ParserBlock* block) {
         inlineList->addInstantiation(parent->container, callee, instance);
     }
     visit_all(block);
-    if (::errorCount() > 0)
+    if (::errorCount() > 0 || !changed(block->container))
         return false;
     visit(block->container->states, "states");
     return false;
@@ -20,6 +20,7 @@ limitations under the License.
 #include "lib/ordered_map.h"
 #include "ir/ir.h"
 #include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/changedDeclarations.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 #include "frontends/p4/evaluator/evaluator.h"
 #include "frontends/p4/evaluator/substituteParameters.h"
@@ -184,15 +185,21 @@ class DiscoverInlining : public Inspector {
     TypeMap*            typeMap;     // input
     IHasBlock*          evaluator;   // used to obtain the toplevel block
     IR::ToplevelBlock*  toplevel;
+    // If set, only the changed containers can have anything left to inline.
+    const ChangedDeclarations* changes;
+
+    bool changed(const IR::Node* container) const
+    { return changes == nullptr || changes->contains(container); }
 
  public:
     bool allowParsers = true;
     bool allowControls = true;
 
     DiscoverInlining(InlineList* inlineList, ReferenceMap* refMap,
-                     TypeMap* typeMap, IHasBlock* evaluator) :
+                     TypeMap* typeMap, IHasBlock* evaluator,
+                     const ChangedDeclarations* changes = nullptr) :
             inlineList(inlineList), refMap(refMap), typeMap(typeMap),
-            evaluator(evaluator), toplevel(nullptr) {
+            evaluator(evaluator), toplevel(nullptr), changes(changes) {
         CHECK_NULL(inlineList); CHECK_NULL(refMap); CHECK_NULL(typeMap); CHECK_NULL(evaluator);
         setName("DiscoverInlining"); visitDagOnce = false;
     }
@@ -236,10 +243,11 @@ class GeneralInliner : public AbstractInliner<InlineList, InlineSummary> {
 class InlinePass : public PassManager {
     InlineList toInline;
  public:
-    InlinePass(ReferenceMap* refMap, TypeMap* typeMap, EvaluatorPass* evaluator)
+    InlinePass(ReferenceMap* refMap, TypeMap* typeMap, EvaluatorPass* evaluator,
+               const ChangedDeclarations* changes = nullptr)
     : PassManager({
         new TypeChecking(refMap, typeMap),
-        new DiscoverInlining(&toInline, refMap, typeMap, evaluator),
+        new DiscoverInlining(&toInline, refMap, typeMap, evaluator, changes),
         new InlineDriver<InlineList, InlineSummary>(&toInline, new GeneralInliner(refMap->isV1())),
         new RemoveAllUnusedDeclarations(refMap) }) { }
 };
@@ -247,13 +255,14 @@ class InlinePass : public PassManager {
 /**
 Performs inlining as many times as necessary.  Most frequently once
 will be enough.  Multiple iterations are necessary only when instances are
-passed as arguments using constructor arguments.
+passed as arguments using constructor arguments.  These iterations only
+look for instantiations to inline in the controls and parsers that changed.
 */
-class Inline : public PassRepeated {
+class Inline : public PassRepeatedOnChanges {
  public:
     Inline(ReferenceMap* refMap, TypeMap* typeMap, EvaluatorPass* evaluator)
     : PassManager({
-        new InlinePass(refMap, typeMap, evaluator),
+        new InlinePass(refMap, typeMap, evaluator, &changes),
         // After inlining the output of the evaluator changes, so
         // we have to run it again
         evaluator }) {}
@@ -18,6 +18,7 @@ limitations under the License.
 #define _FRONTENDS_P4_SIMPLIFY_H_
 
 #include "ir/ir.h"
+#include "ir/node_kinds.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 #include "frontends/p4/methodInstance.h"
 #include "frontends/common/resolveReferences/resolveReferences.h"
@@ -53,8 +54,12 @@ class DoSimplifyControlFlow : public Transform {
     TypeMap*      typeMap;
  public:
     DoSimplifyControlFlow(ReferenceMap* refMap, TypeMap* typeMap) :
-            refMap(refMap), typeMap(typeMap)
-    { CHECK_NULL(refMap); CHECK_NULL(typeMap); setName("DoSimplifyControlFlow"); }
+            refMap(refMap), typeMap(typeMap) {
+        CHECK_NULL(refMap); CHECK_NULL(typeMap); setName("DoSimplifyControlFlow");
+        setKinds(NodeKinds::of<IR::BlockStatement, IR::IfStatement, IR::EmptyStatement,
+                               IR::SwitchStatement>(),
+                 NodeKinds::of<IR::EmptyStatement, IR::MethodCallStatement>());
+    }
     const IR::Node* postorder(IR::BlockStatement* statement) override;
     const IR::Node* postorder(IR::IfStatement* statement) override;
     const IR::Node* postorder(IR::EmptyStatement* statement) override;
@@ -195,6 +195,15 @@ bool FindSpecializations::isSimpleConstant(const IR::Expression* expr) const {
     return false;
 }
 
+bool FindSpecializations::preorder(const IR::P4Program* program) {
+    if (changes == nullptr)
+        return true;
+    for (auto obj : program->objects)
+        if (changes->contains(obj))
+            visit(obj);
+    return false;
+}
+
 bool FindSpecializations::noParameters(const IR::IContainer* container) {
     return container->getTypeParameters()->empty() &&
             container->getConstructorParameters()->empty();
@@ -301,10 +310,10 @@ const IR::Node* Specialize::postorder(IR::Declaration_Instance* decl) {
     return instantiate(replacement);
 }
 
-SpecializeAll::SpecializeAll(ReferenceMap* refMap, TypeMap* typeMap) : PassRepeated({}) {
+SpecializeAll::SpecializeAll(ReferenceMap* refMap, TypeMap* typeMap) {
     passes.emplace_back(new ConstantFolding(refMap, typeMap));
     passes.emplace_back(new TypeChecking(refMap, typeMap));
-    passes.emplace_back(new FindSpecializations(&specMap));
+    passes.emplace_back(new FindSpecializations(&specMap, &changes));
     passes.emplace_back(new Specialize(&specMap));
     passes.emplace_back(new RemoveAllUnusedDeclarations(refMap));
     specMap.refMap = refMap;
@@ -20,6 +20,7 @@ limitations under the License.
 #include "ir/ir.h"
 #include "frontends/common/resolveReferences/referenceMap.h"
 #include "frontends/common/constantFolding.h"
+#include "frontends/p4/changedDeclarations.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 
 namespace P4 {
@@ -96,9 +97,13 @@ class SpecializationMap {
  */
 class FindSpecializations : public Inspector {
     SpecializationMap* specMap;
+    // If set, only the changed declarations can have new instantiations.
+    const ChangedDeclarations* changes;
 
  public:
-    explicit FindSpecializations(SpecializationMap* specMap) : specMap(specMap) {
+    explicit FindSpecializations(SpecializationMap* specMap,
+                                 const ChangedDeclarations* changes = nullptr) :
+            specMap(specMap), changes(changes) {
         CHECK_NULL(specMap);
         setName("FindSpecializations");
     }
@@ -112,6 +117,7 @@ class FindSpecializations : public Inspector {
     /// specialize.
     bool noParameters(const IR::IContainer* container);
 
+    bool preorder(const IR::P4Program* program) override;
     bool preorder(const IR::P4Parser* parser) override
     { return noParameters(parser); }
     bool preorder(const IR::P4Control* control) override
@@ -180,7 +186,8 @@ class Specialize : public Transform {
  * constant values for constructor parameters, but constructor calls may have
  * (a) expressions and (b) other constructor parameters as arguments.  Hence,
  * each iteration applies constant folding and then specialization until
- * reaching convergence.
+ * reaching convergence.  Each iteration after the first only looks for
+ * instantiations in the declarations that changed.
  *
  * Eventually, all instantiations of Control or Parser type declarations with
  * constructor parameters will be replaced by instantiations of specialized
@@ -193,7 +200,7 @@ class Specialize : public Transform {
  * @post No declarations nor instantiations remain of Parser or Control types
  * with constructor parameters.
  */
-class SpecializeAll : public PassRepeated {
+class SpecializeAll : public PassRepeatedOnChanges {
     SpecializationMap specMap;
  public:
     SpecializeAll(ReferenceMap* refMap, TypeMap* typeMap);
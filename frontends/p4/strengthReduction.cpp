@@ -114,9 +114,11 @@ const IR::Node* DoStrengthReduction::postorder(IR::BXor* expr) {
         return expr->left;
     bool cmpl = false;
     if (auto l = expr->left->to<IR::Cmpl>()) {
+        expr = mutate(expr);
         expr->left = l->expr;
         cmpl = !cmpl; }
     if (auto r = expr->right->to<IR::Cmpl>()) {
+        expr = mutate(expr);
         expr->right = r->expr;
         cmpl = !cmpl; }
     if (cmpl)
@@ -276,12 +278,14 @@ const IR::Node* DoStrengthReduction::postorder(IR::Slice* expr) {
         int hi = expr->getH();
         int lo = expr->getL();
         if (lo + shift_amt >= 0 && hi + shift_amt < shift_of->type->width_bits()) {
+            expr = mutate(expr);
             expr->e0 = shift_of;
             expr->e1 = new IR::Constant(hi + shift_amt);
             expr->e2 = new IR::Constant(lo + shift_amt); }
         if (hi + shift_amt <= 0)
             return new IR::Constant(IR::Type_Bits::get(hi - lo + 1), 0);
         if (lo + shift_amt < 0) {
+            expr = mutate(expr);
             expr->e0 = shift_of;
             expr->e1 = new IR::Constant(hi + shift_amt);
             expr->e2 = new IR::Constant(0);
@@ -291,10 +295,12 @@ const IR::Node* DoStrengthReduction::postorder(IR::Slice* expr) {
     while (auto cat = expr->e0->to<IR::Concat>()) {
         unsigned rwidth = cat->right->type->width_bits();
         if (expr->getL() >= rwidth) {
+            expr = mutate(expr);
             expr->e0 = cat->left;
             expr->e1 = new IR::Constant(expr->getH() - rwidth);
             expr->e2 = new IR::Constant(expr->getL() - rwidth);
         } else if (expr->getH() < rwidth) {
+            expr = mutate(expr);
             expr->e0 = cat->right;
         } else {
             return new IR::Concat(expr->type,
@@ -18,6 +18,7 @@ limitations under the License.
 #define _P4_STRENGTHREDUCTION_H_
 
 #include "ir/ir.h"
+#include "ir/node_kinds.h"
 #include "frontends/common/resolveReferences/referenceMap.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 #include "frontends/p4/typeMap.h"
@@ -60,7 +61,15 @@ class DoStrengthReduction final : public Transform {
     const IR::Node* simplifyConcat(IR::Slice* expr);
 
  public:
-    DoStrengthReduction() { visitDagOnce = true; setName("StrengthReduction"); }
+    DoStrengthReduction() {
+        visitDagOnce = true; lazyClone = true; setName("StrengthReduction");
+        setKinds(NodeKinds::of<IR::Cmpl, IR::BAnd, IR::BOr, IR::BXor, IR::LAnd, IR::LOr,
+                               IR::LNot, IR::Sub, IR::Add, IR::Shl, IR::Shr, IR::Mul, IR::Div,
+                               IR::Mod, IR::Slice>(),
+                 NodeKinds::of<IR::Add, IR::BAnd, IR::BOr, IR::Cmpl, IR::Concat, IR::Constant,
+                               IR::Operation_Relation, IR::Neg, IR::Shl, IR::Shr, IR::Slice,
+                               IR::Type_Bits>());
+    }
 
     using Transform::postorder;
 
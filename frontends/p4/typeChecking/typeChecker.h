@@ -38,9 +38,10 @@ class ClearTypeMap : public Inspector {
             typeMap(typeMap) { CHECK_NULL(typeMap); }
     bool preorder(const IR::P4Program* program) override {
         // Clear map only if program has not changed from last time
-        // otherwise we can reuse it
+        // otherwise we can reuse it; if only some top-level objects have
+        // changed only their types are cleared.
         if (!typeMap->checkMap(program))
-            typeMap->clear();
+            typeMap->invalidate(program);
         return false;  // prune()
     }
 };
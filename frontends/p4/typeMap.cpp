@@ -56,6 +56,57 @@ void TypeMap::clear() {
     program = nullptr;
 }
 
+namespace {
+
+class CollectNodes : public Inspector {
+    std::set<const IR::Node*>& nodes;
+ public:
+    explicit CollectNodes(std::set<const IR::Node*>& nodes) : nodes(nodes)
+    { setName("CollectNodes"); }
+    bool preorder(const IR::Node* node) override { nodes.insert(node); return true; }
+};
+
+class RemoveNodes : public Inspector {
+    std::set<const IR::Node*>& nodes;
+ public:
+    explicit RemoveNodes(std::set<const IR::Node*>& nodes) : nodes(nodes)
+    { setName("RemoveNodes"); }
+    bool preorder(const IR::Node* node) override { nodes.erase(node); return !nodes.empty(); }
+};
+
+}  // namespace
+
+void TypeMap::invalidate(const IR::P4Program* newProgram) {
+    std::set<const IR::Node*> stale, dirty;
+    if (!staleObjects(newProgram, stale, dirty)) {
+        clear();
+        return;
+    }
+
+    std::set<const IR::Node*> nodes;
+    CollectNodes collect(nodes);
+    for (auto obj : stale)
+        obj->apply(collect);
+    // Nodes may be shared with objects that are still up-to-date;
+    // these have to keep their types.
+    RemoveNodes keep(nodes);
+    for (auto obj : newProgram->objects) {
+        if (nodes.empty())
+            break;
+        if (!dirty.count(obj))
+            obj->apply(keep);
+    }
+    LOG3("Removing " << nodes.size() << " nodes from typeMap");
+    for (auto node : nodes) {
+        typeMap.erase(node);
+        if (auto expr = node->to<IR::Expression>()) {
+            leftValues.erase(expr);
+            constants.erase(expr);
+        }
+    }
+    program = nullptr;
+}
+
 void TypeMap::checkPrecondition(const IR::Node* element, const IR::Type* type) const {
     CHECK_NULL(element); CHECK_NULL(type);
     if (type->is<IR::Type_Name>())
@@ -110,6 +161,10 @@ bool TypeMap::equivalent(const IR::Type* left, const IR::Type* right) {
         return right == nullptr;
     if (right == nullptr)
         return false;
+    // Canonical types are shared, so this is often enough.
+    // (A stack still needs its size checked.)
+    if (left == right && !left->is<IR::Type_Stack>())
+        return true;
     if (left->node_type_name() != right->node_type_name())
         return false;
 
@@ -299,24 +354,69 @@ bool TypeMap::implicitlyConvertibleTo(const IR::Type* from, const IR::Type* to)
     return false;
 }
 
+namespace {
+size_t combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+}  // namespace
+
+// Must be consistent with equivalent(): equivalent types have the same hash.
+// Types that equivalent() only compares coarsely (or not at all) are hashed by
+// their kind alone.
+size_t TypeMap::structuralHash(const IR::Type* type) {
+    if (type == nullptr)
+        return 0;
+    size_t result = std::hash<const void*>()(type->node_type_name().c_str());
+    if (auto tb = type->to<IR::Type_Bits>())
+        return combine(combine(result, tb->size), tb->isSigned);
+    if (auto tv = type->to<IR::Type_Varbits>())
+        return combine(result, tv->size);
+    if (auto tt = type->to<IR::Type_Type>())
+        return combine(result, structuralHash(tt->type));
+    if (auto tv = type->to<IR::ITypeVar>())
+        return combine(combine(result, std::hash<const void*>()(tv->getVarName().c_str())),
+                       tv->getDeclId());
+    if (auto ts = type->to<IR::Type_Stack>())
+        // not the size: it may not be known, which equivalent() reports as an error
+        return combine(result, structuralHash(ts->elementType));
+    if (auto td = type->to<IR::Type_Declaration>()) {
+        if (type->is<IR::Type_Enum>() || type->is<IR::Type_SerEnum>() ||
+            type->is<IR::Type_Extern>() || type->is<IR::Type_Newtype>())
+            return combine(result, std::hash<const void*>()(td->name.name.c_str()));
+    }
+    if (auto sl = type->to<IR::Type_StructLike>()) {
+        for (auto f : sl->fields)
+            result = combine(combine(result, std::hash<const void*>()(f->name.name.c_str())),
+                             structuralHash(f->type));
+        return result;
+    }
+    if (auto bl = type->to<IR::Type_BaseList>()) {
+        for (auto c : bl->components)
+            result = combine(result, structuralHash(c));
+        return result;
+    }
+    if (auto ts = type->to<IR::Type_Set>())
+        return combine(result, structuralHash(ts->elementType));
+    if (auto ts = type->to<IR::Type_SpecializedCanonical>())
+        return combine(result, structuralHash(ts->substituted));
+    if (auto ta = type->to<IR::Type_ActionEnum>())
+        return combine(result, std::hash<const void*>()(ta->actionList));
+    return result;
+}
+
 // Used for tuples, stacks and lists only
 const IR::Type* TypeMap::getCanonical(const IR::Type* type) {
-    // Currently a linear search; hopefully this won't be too expensive in practice
-    std::vector<const IR::Type*>* searchIn;
-    if (type->is<IR::Type_Stack>())
-        searchIn = &canonicalStacks;
-    else if (type->is<IR::Type_Tuple>())
-        searchIn = &canonicalTuples;
-    else if (type->is<IR::Type_List>())
-        searchIn = &canonicalLists;
-    else
+    if (!type->is<IR::Type_Stack>() && !type->is<IR::Type_Tuple>() &&
+        !type->is<IR::Type_List>())
         BUG("%1%: unexpected type", type);
 
-    for (auto t : *searchIn) {
-        if (TypeMap::equivalent(type, t))
-            return t;
+    auto hash = structuralHash(type);
+    auto candidates = canonicalTypes.equal_range(hash);
+    for (auto it = candidates.first; it != candidates.second; ++it) {
+        if (TypeMap::equivalent(type, it->second))
+            return it->second;
     }
-    searchIn->push_back(type);
+    canonicalTypes.emplace(hash, type);
     return type;
 }
 
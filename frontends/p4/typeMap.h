@@ -17,6 +17,8 @@ limitations under the License.
 #ifndef _FRONTENDS_P4_TYPEMAP_H_
 #define _FRONTENDS_P4_TYPEMAP_H_
 
+#include <unordered_map>
+
 #include "ir/ir.h"
 #include "frontends/common/programMap.h"
 #include "frontends/p4/typeChecking/typeSubstitution.h"
@@ -41,9 +43,8 @@ class TypeMap final : public ProgramMap {
  protected:
     // We want to have the same canonical type for two
     // different tuples, lists, or stacks with the same signature.
-    std::vector<const IR::Type*> canonicalTuples;
-    std::vector<const IR::Type*> canonicalStacks;
-    std::vector<const IR::Type*> canonicalLists;
+    // The canonical types are hash-consed, keyed by structuralHash().
+    std::unordered_multimap<size_t, const IR::Type*> canonicalTypes;
 
     // Map each node to its canonical type
     std::map<const IR::Node*, const IR::Type*> typeMap;
@@ -70,6 +71,10 @@ class TypeMap final : public ProgramMap {
     const IR::Type* getTypeType(const IR::Node* element, bool notNull) const;
     void dbprint(std::ostream& out) const;
     void clear();
+    /// Prepare the map for type-checking @p program.  Only removes the
+    /// entries of the top-level objects that have changed or that depend on
+    /// changed objects, unless it is simpler to clear the whole map.
+    void invalidate(const IR::P4Program* program);
     bool isLeftValue(const IR::Expression* expression) const
     { return leftValues.count(expression) > 0; }
     bool isCompileTimeConstant(const IR::Expression* expression) const;
@@ -85,6 +90,8 @@ class TypeMap final : public ProgramMap {
 
     /// Check deep structural equivalence; defined between canonical types only.
     static bool equivalent(const IR::Type* left, const IR::Type* right);
+    /// A hash of a canonical type that is the same for all equivalent types.
+    static size_t structuralHash(const IR::Type* type);
     /// This is the same as equivalence, but it also allows some legal
     /// implicit conversions, such as a tuple type to a struct type, which
     /// is used when initializing a struct with a list expression.
@@ -164,6 +164,68 @@ P4ParserDriver::parse(FILE* in, const char* sourceFile,
     return parse(inputStream.get(), sourceFile, sourceLine);
 }
 
+namespace {
+
+/// Drops the tokens of the first lines of the input, whose declarations
+/// were parsed before.
+class SkipLinesLexer : public AbstractP4Lexer {
+    AbstractP4Lexer& lexer;
+    unsigned lines;
+
+ public:
+    SkipLinesLexer(AbstractP4Lexer& lexer, unsigned lines) : lexer(lexer), lines(lines) {}
+
+    Token yylex(P4::P4ParserDriver& driver) override {
+        while (true) {
+            Token token = lexer.yylex(driver);
+            // the start token has no position
+            unsigned line = token.location.getStart().getLineNumber();
+            if (line == 0 || line > lines)
+                return token;
+        }
+    }
+};
+
+}  // namespace
+
+/* static */ const IR::P4Program*
+P4ParserDriver::parse(std::istream& in, const char* sourceFile,
+                      unsigned sourceLine, const IR::P4Program* prelude,
+                      unsigned preludeLines, Util::InputSources* sources) {
+    LOG1("Parsing P4-16 program " << sourceFile << " after " << prelude->objects.size()
+         << " declarations");
+
+    P4ParserDriver driver;
+    driver.sources = sources;
+    driver.addPrelude(prelude);
+    P4Lexer lexer(in);
+    SkipLinesLexer skipPrelude(lexer, preludeLines);
+    if (!driver.parse(skipPrelude, sourceFile, sourceLine)) return nullptr;
+    return new IR::P4Program(driver.nodes->srcInfo, *driver.nodes);
+}
+
+void P4ParserDriver::addPrelude(const IR::P4Program* prelude) {
+    for (auto obj : prelude->objects) {
+        if (auto error = obj->to<IR::Type_Error>()) {
+            // later error declarations are merged into this one
+            allErrors = error->clone();
+            nodes->push_back(allErrors);
+            continue;
+        }
+        nodes->push_back(obj);
+        if (obj->is<IR::Type_Extern>() || obj->is<IR::Type_ArchBlock>() ||
+            obj->is<IR::IContainer>()) {
+            auto decl = obj->to<IR::IDeclaration>();
+            structure->pushContainerType(decl->getName(), obj->is<IR::Type_Extern>());
+            structure->pop();
+        } else if (auto type = obj->to<IR::Type_Declaration>()) {
+            structure->declareType(type->name);
+        } else if (auto decl = obj->to<IR::IDeclaration>()) {
+            structure->declareObject(decl->getName());
+        }
+    }
+}
+
 template<typename T> const T*
 P4ParserDriver::parse(P4AnnotationLexer::Type type,
                       const Util::SourceInfo& srcInfo,
@@ -116,6 +116,18 @@ class P4ParserDriver final : public AbstractParserDriver {
     static const IR::P4Program* parse(FILE* in, const char* sourceFile,
                                       unsigned sourceLine = 1);
 
+    /**
+     * Parse a P4-16 program whose first @p preludeLines lines hold the
+     * declarations in @p prelude, parsed separately (e.g. the architecture
+     * include files).  These lines are still read into @p sources, so that
+     * the positions of @p prelude, which must point into @p sources, are the
+     * same as if the whole program had been parsed.
+     * The resulting program starts with the declarations of @p prelude.
+     */
+    static const IR::P4Program* parse(std::istream& in, const char* sourceFile,
+                                      unsigned sourceLine, const IR::P4Program* prelude,
+                                      unsigned preludeLines, Util::InputSources* sources);
+
     /**
      * Parses a P4-16 annotation body.
      *
@@ -230,6 +242,9 @@ class P4ParserDriver final : public AbstractParserDriver {
     bool parse(AbstractP4Lexer& lexer, const char* sourceFile,
                unsigned sourceLine = 1);
 
+    /// Makes the top-level declarations of @p prelude visible to the parser.
+    void addPrelude(const IR::P4Program* prelude);
+
     /// Common functionality for parsing annotation bodies.
     template<typename T> const T* parse(P4AnnotationLexer::Type type,
                                         const Util::SourceInfo& srcInfo,
@@ -0,0 +1,167 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "binary_loader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iterator>
+
+#include "binary_writer.h"
+
+BinaryLoader::BinaryLoader(cstring filename) : name(filename) {
+    int fd = ::open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        ::error("%1%: cannot open", filename);
+        failed = true;
+    } else if (st.st_size > 0) {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::error("%1%: cannot map in memory", filename);
+            failed = true;
+        } else {
+            mapped = static_cast<const char *>(addr);
+            mappedSize = st.st_size;
+            pos = mapped;
+            end = mapped + mappedSize; } }
+    if (fd >= 0) close(fd);
+    if (!failed) open();
+}
+
+BinaryLoader::BinaryLoader(std::istream &in) : name("<stream>") {
+    buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    pos = buffer.data();
+    end = pos + buffer.size();
+    open();
+}
+
+BinaryLoader::~BinaryLoader() {
+    if (mapped) munmap(const_cast<char *>(mapped), mappedSize);
+}
+
+void BinaryLoader::fail(const char *what) {
+    if (!failed)
+        ::error("%1%: %2% binary IR", name, what);
+    failed = true;
+    pos = end;
+}
+
+void BinaryLoader::open() {
+    if (size_t(end - pos) < sizeof(BinaryWriter::magic) ||
+        memcmp(pos, BinaryWriter::magic, sizeof(BinaryWriter::magic)) != 0) {
+        fail("not a");
+        return; }
+    pos += sizeof(BinaryWriter::magic);
+    if (varint() != BinaryWriter::version || varint() != IR::binary_ir_schema) {
+        ::error("%1%: binary IR written by another version of the compiler", name);
+        failed = true;
+        return; }
+
+    for (auto count = varint(); count > 0 && !failed; --count) {
+        auto size = varint();
+        if (size > uint64_t(end - pos)) {
+            fail("truncated");
+            break; }
+        stringData.emplace_back(pos, size);
+        pos += size; }
+    strings.resize(stringData.size());
+
+    for (auto count = varint(); count > 0 && !failed; --count) {
+        auto ref = varint();
+        typeNames.push_back(ref);
+        types.push_back(get(IR::binary_unpacker_table, string(ref + 1))); }
+
+    for (auto count = varint(); count > 0 && !failed; --count) {
+        Position p;
+        p.file = varint();
+        p.line = varint();
+        p.column = varint();
+        p.brief = varint();
+        p.startLine = varint();
+        p.startColumn = varint();
+        p.endLine = varint();
+        p.endColumn = varint();
+        positions.push_back(p); }
+}
+
+cstring BinaryLoader::string(uint64_t ref) {
+    if (ref == 0) return cstring();
+    if (ref > strings.size()) {
+        fail("bad string in");
+        return cstring(); }
+    auto &s = strings[ref - 1];
+    if (s.isNull()) {
+        auto &data = stringData[ref - 1];
+        s = cstring(data.first, data.second); }
+    return s;
+}
+
+Util::SourceInfo BinaryLoader::sourceInfo() {
+    auto ref = varint();
+    if (ref == 0) return Util::SourceInfo();
+    if (ref > positions.size()) {
+        fail("bad source position in");
+        return Util::SourceInfo(); }
+    auto &p = positions[ref - 1];
+    if (sources != nullptr) {
+        Util::SourcePosition start(p.startLine, p.startColumn), end(p.endLine, p.endColumn);
+        if (start.isValid() && end.isValid() && start <= end)
+            return Util::SourceInfo(sources, start, end); }
+    return Util::SourceInfo(string(p.file), p.line, p.column, string(p.brief));
+}
+
+IR::Node *BinaryLoader::node(BinaryFactoryFn make) {
+    auto tag = varint();
+    if (tag == 0 || failed) return nullptr;
+    if (!(tag & 1)) {
+        auto index = tag/2 - 1;
+        if (index >= nodes.size() || nodes[index] == nullptr) {
+            fail("bad node reference in");
+            return nullptr; }
+        return nodes[index]; }
+    auto type = tag/2;
+    if (type >= types.size()) {
+        fail("bad node type in");
+        return nullptr; }
+    if (!make) make = types[type];
+    if (!make) {
+        ::error("%1%: cannot load nodes of type %2%", name, string(typeNames[type] + 1));
+        failed = true;
+        pos = end;
+        return nullptr; }
+    auto index = nodes.size();
+    nodes.push_back(nullptr);
+    auto rv = make(*this);
+    nodes[index] = rv;
+    if (rv) reserveIds(rv);
+    return rv;
+}
+
+void BinaryLoader::reserveIds(const IR::Node *n) {
+    // IR::Node reserves its own id; new declarations must not reuse the
+    // declids either, as type variables are told apart by name and declid.
+    if (auto decl = n->to<IR::Declaration>())
+        IR::Declaration::reserveId(decl->declid);
+    else if (auto type = n->to<IR::Type_Declaration>())
+        IR::Type_Declaration::reserveId(type->declid);
+    else if (auto infInt = n->to<IR::Type_InfInt>())
+        IR::Type_InfInt::reserveId(infInt->declid);
+    else if (auto pointer = n->to<IR::This>())
+        IR::This::reserveId(pointer->id);
+}
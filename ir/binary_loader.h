@@ -0,0 +1,333 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_BINARY_LOADER_H_
+#define _IR_BINARY_LOADER_H_
+
+#include <string.h>
+#include <boost/optional.hpp>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lib/bitvec.h"
+#include "lib/cstring.h"
+#include "lib/ltbitmatrix.h"
+#include "lib/match.h"
+#include "lib/ordered_map.h"
+#include "lib/ordered_set.h"
+#include "lib/safe_vector.h"
+#include "ir.h"
+
+/**
+ * Reads back the images written by BinaryWriter.  A file is mapped in memory
+ * rather than read; the strings are only turned into cstrings when a node
+ * refers to them.
+ *
+ * Malformed input is reported as a compilation error, after which the loader
+ * only returns null nodes and default values; callers should check valid()
+ * before using what they read.
+ */
+class BinaryLoader {
+    template<typename T> class has_fromBinary {
+        typedef char small;
+        typedef struct { char c[2]; } big;
+
+        template<typename C> static small test(decltype(&C::fromBinary));
+        template<typename C> static big test(...);
+     public:
+        static const bool value = sizeof(test<T>(0)) == sizeof(char);
+    };
+
+    struct Position {
+        uint64_t file, line, column, brief;
+        uint64_t startLine, startColumn, endLine, endColumn;
+    };
+
+    cstring name;           // for error messages
+    std::string buffer;     // when not reading from a mapped file
+    const char *mapped = nullptr;
+    size_t mappedSize = 0;
+    const char *pos = nullptr, *end = nullptr;
+    bool failed = false;
+
+    std::vector<std::pair<const char *, size_t>> stringData;
+    std::vector<cstring> strings;  // made on first use
+    std::vector<BinaryFactoryFn> types;
+    std::vector<uint64_t> typeNames;
+    std::vector<Position> positions;
+    const Util::InputSources *sources = nullptr;
+    std::vector<IR::Node *> nodes;  // in the order they were written
+    int lastId = 0;
+
+    void open();
+    void fail(const char *what);
+    uint64_t varint() {
+        uint64_t rv = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (pos == end) {
+                fail("truncated");
+                return 0; }
+            uint8_t byte = *pos++;
+            rv |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return rv; }
+        fail("bad integer");
+        return 0; }
+    int64_t svarint() {
+        uint64_t v = varint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+    std::string raw() {
+        uint64_t size = varint();
+        if (size > uint64_t(end - pos)) {
+            fail("truncated");
+            return std::string(); }
+        std::string rv(pos, size);
+        pos += size;
+        return rv; }
+    cstring string(uint64_t ref);
+
+    /// Reads a node; new nodes are made with @p make if given, and with the
+    /// factory for their type otherwise.
+    IR::Node *node(BinaryFactoryFn make = nullptr);
+    /// Keeps the id counters of the IR classes above the ids of @p n.
+    static void reserveIds(const IR::Node *n);
+    template<class T> static IR::Node *make(BinaryLoader &bin) { return T::fromBinary(bin); }
+
+ public:
+    /// Maps @p filename in memory.
+    explicit BinaryLoader(cstring filename);
+    explicit BinaryLoader(std::istream &in);
+    ~BinaryLoader();
+
+    bool valid() const { return !failed; }
+
+    /// Gives the nodes loaded after this call their full positions in
+    /// @p sources, which must hold the text they were parsed from, at the
+    /// same lines.  Otherwise they only keep the file, line and fragment.
+    void setSources(const Util::InputSources *s) { sources = s; }
+
+    /// Used by IR::Node and IR::ID; see BinaryWriter.
+    int nodeId() {
+        lastId += svarint();
+        return lastId; }
+    Util::SourceInfo sourceInfo();
+
+ private:
+    template<typename T, class ALLOC>
+    void unpack(safe_vector<T, ALLOC> &v) {
+        T temp;
+        for (auto size = varint(); size > 0 && !failed; --size) {
+            unpack(temp);
+            v.push_back(temp); } }
+
+    template<typename T>
+    void unpack(std::vector<T> &v) {
+        T temp;
+        for (auto size = varint(); size > 0 && !failed; --size) {
+            unpack(temp);
+            v.push_back(temp); } }
+
+    template<typename T>
+    void unpack(std::set<T> &v) {
+        T temp;
+        for (auto size = varint(); size > 0 && !failed; --size) {
+            unpack(temp);
+            v.insert(temp); } }
+
+    template<typename T>
+    void unpack(ordered_set<T> &v) {
+        T temp;
+        for (auto size = varint(); size > 0 && !failed; --size) {
+            unpack(temp);
+            v.insert(temp); } }
+
+    template<typename K, typename V>
+    void unpack(std::map<K, V> &v) {
+        std::pair<K, V> temp;
+        for (auto size = varint(); size > 0 && !failed; --size) {
+            unpack(temp);
+            v.insert(temp); } }
+
+    template<typename K, typename V>
+    void unpack(std::multimap<K, V> &v) {
+        std::pair<K, V> temp;
+        for (auto size = varint(); size > 0 && !failed; --size) {
+            unpack(temp);
+            v.insert(temp); } }
+
+    template<typename K, typename V>
+    void unpack(ordered_map<K, V> &v) {
+        std::pair<K, V> temp;
+        for (auto size = varint(); size > 0 && !failed; --size) {
+            unpack(temp);
+            v.insert(temp); } }
+
+    template<typename T, typename U>
+    void unpack(std::pair<T, U> &v) {
+        unpack(v.first);
+        unpack(v.second); }
+
+    template<typename T>
+    void unpack(boost::optional<T> &v) {
+        bool isValid = false;
+        unpack(isValid);
+        if (!isValid) {
+            v = boost::none;
+            return; }
+        T value;
+        unpack(value);
+        v = std::move(value); }
+
+    template<typename T> void unpack(IR::Vector<T> &v) {
+        if (IR::Node *n = node(&make<IR::Vector<T>>)) v = *n->to<IR::Vector<T>>(); }
+    template<typename T> void unpack(const IR::Vector<T> *&v) {
+        IR::Node *n = node(&make<IR::Vector<T>>);
+        v = n ? n->to<IR::Vector<T>>() : nullptr; }
+    template<typename T> void unpack(IR::IndexedVector<T> &v) {
+        if (IR::Node *n = node(&make<IR::IndexedVector<T>>)) v = *n->to<IR::IndexedVector<T>>(); }
+    template<typename T> void unpack(const IR::IndexedVector<T> *&v) {
+        IR::Node *n = node(&make<IR::IndexedVector<T>>);
+        v = n ? n->to<IR::IndexedVector<T>>() : nullptr; }
+    template<class T, template<class K, class V, class COMP, class ALLOC> class MAP,
+             class COMP, class ALLOC>
+    void unpack(IR::NameMap<T, MAP, COMP, ALLOC> &m) {
+        typedef IR::NameMap<T, MAP, COMP, ALLOC> map_t;
+        if (IR::Node *n = node(&make<map_t>)) m = *n->to<map_t>(); }
+    template<class T, template<class K, class V, class COMP, class ALLOC> class MAP,
+             class COMP, class ALLOC>
+    void unpack(const IR::NameMap<T, MAP, COMP, ALLOC> *&m) {
+        typedef IR::NameMap<T, MAP, COMP, ALLOC> map_t;
+        IR::Node *n = node(&make<map_t>);
+        m = n ? n->to<map_t>() : nullptr; }
+
+    void unpack(bool &v) {
+        if (pos == end) {
+            fail("truncated");
+            v = false;
+        } else {
+            v = *pos++ != 0; } }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    unpack(T &v) { v = svarint(); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    unpack(T &v) { v = varint(); }
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type
+    unpack(T &v) { v = static_cast<T>(svarint()); }
+    void unpack(double &v) {
+        if (size_t(end - pos) < sizeof(v)) {
+            fail("truncated");
+            return; }
+        memcpy(&v, pos, sizeof(v));
+        pos += sizeof(v); }
+    void unpack(big_int &v) {
+        bool big = false;
+        unpack(big);
+        if (big)
+            v = big_int(raw().c_str());
+        else
+            v = svarint(); }
+
+    void unpack(cstring &v) { v = string(varint()); }
+    void unpack(IR::ID &v) {
+        v.srcInfo = sourceInfo();
+        unpack(v.name);
+        unpack(v.originalName); }
+
+    void unpack(bitvec &v) { raw().c_str() >> v; }
+    void unpack(LTBitMatrix &m) { raw().c_str() >> m; }
+
+    void unpack(match_t &v) {
+        v.word0 = varint();
+        v.word1 = varint(); }
+
+    void unpack(UnparsedConstant *&v) {
+        bool present = false;
+        unpack(present);
+        v = nullptr;
+        if (!present) return;
+        v = new UnparsedConstant;
+        unpack(v->text);
+        unpack(v->skip);
+        unpack(v->base);
+        unpack(v->hasWidth); }
+
+    template<typename T>
+    typename std::enable_if<
+        has_fromBinary<T>::value &&
+        !std::is_base_of<IR::INode, T>::value
+    >::type
+    unpack(T *&v) {
+        bool present = false;
+        unpack(present);
+        v = present ? T::fromBinary(*this) : nullptr; }
+
+    template<typename T>
+    typename std::enable_if<
+        has_fromBinary<T>::value &&
+        !std::is_base_of<IR::INode, T>::value
+    >::type
+    unpack(T &v) { v = *(T::fromBinary(*this)); }
+
+    template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    unpack(T &v) {
+        if (IR::Node *n = node()) v = *(n->to<T>()); }
+    template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    unpack(const T *&v) {
+        IR::Node *n = node();
+        v = n ? n->to<T>() : nullptr; }
+
+    template<typename T, size_t N>
+    void unpack(T (&v)[N]) {
+        for (auto &e : v) unpack(e); }
+
+ public:
+    template<typename T> BinaryLoader& operator>>(T &v) {
+        unpack(v);
+        return *this; }
+};
+
+template<class T>
+IR::Vector<T>::Vector(BinaryLoader &bin) : VectorBase(bin) {
+    bin >> vec;
+}
+template<class T>
+IR::Vector<T>* IR::Vector<T>::fromBinary(BinaryLoader &bin) {
+    return new Vector<T>(bin);
+}
+template<class T>
+IR::IndexedVector<T>::IndexedVector(BinaryLoader &bin) : Vector<T>(bin) {
+    for (auto el : *this) insertInMap(el);
+}
+template<class T>
+IR::IndexedVector<T>* IR::IndexedVector<T>::fromBinary(BinaryLoader &bin) {
+    return new IndexedVector<T>(bin);
+}
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+IR::NameMap<T, MAP, COMP, ALLOC>::NameMap(BinaryLoader &bin) : Node(bin) {
+    bin >> symbols;
+}
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+IR::NameMap<T, MAP, COMP, ALLOC> *IR::NameMap<T, MAP, COMP, ALLOC>::fromBinary(BinaryLoader &bin) {
+    return new IR::NameMap<T, MAP, COMP, ALLOC>(bin);
+}
+
+#endif /* _IR_BINARY_LOADER_H_ */
@@ -0,0 +1,124 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "binary_writer.h"
+
+#include <limits>
+
+const char BinaryWriter::magic[4] = { 'P', '4', 'I', 'R' };
+
+BinaryWriter::~BinaryWriter() {
+    std::string header(magic, sizeof(magic));
+    varint(header, version);
+    varint(header, IR::binary_ir_schema);
+    varint(header, strings.size());
+    for (auto s : strings) {
+        varint(header, s.size());
+        header.append(s.c_str(), s.size()); }
+    varint(header, types.size());
+    for (auto t : types)
+        varint(header, t);
+    varint(header, positions.size());
+    for (auto &p : positions) {
+        varint(header, p.file ? intern(p.file) + 1 : 0);
+        varint(header, p.line);
+        varint(header, p.column);
+        varint(header, p.brief ? intern(p.brief) + 1 : 0);
+        varint(header, std::get<0>(p.span));
+        varint(header, std::get<1>(p.span));
+        varint(header, std::get<2>(p.span));
+        varint(header, std::get<3>(p.span)); }
+    out.write(header.data(), header.size());
+    out.write(body.data(), body.size());
+    out.flush();
+}
+
+unsigned BinaryWriter::intern(cstring s) {
+    auto it = stringIndex.find(s);
+    if (it != stringIndex.end())
+        return it->second;
+    stringIndex.emplace(s, strings.size());
+    strings.push_back(s);
+    return strings.size() - 1;
+}
+
+unsigned BinaryWriter::position(const Position &p) {
+    auto it = positionIndex.find(p);
+    if (it != positionIndex.end())
+        return it->second;
+    // intern the strings now, so that the string table is complete before
+    // the positions are written
+    if (p.file) intern(p.file);
+    if (p.brief) intern(p.brief);
+    positionIndex.emplace(p, positions.size());
+    positions.push_back(p);
+    return positions.size() - 1;
+}
+
+void BinaryWriter::sourceInfo(const Util::SourceInfo &si) {
+    if (!dumpSourceInfo) {
+        varint(0);
+        return; }
+    if (si.isValid()) {
+        auto &start = si.getStart(), &end = si.getEnd();
+        Span span(start.getLineNumber(), start.getColumnNumber(),
+                  end.getLineNumber(), end.getColumnNumber());
+        auto it = spanIndex.find(span);
+        if (it == spanIndex.end()) {
+            Position p;
+            p.file = si.toSourcePositionData(&p.line, &p.column);
+            p.brief = si.toBriefSourceFragment();
+            p.span = span;
+            it = spanIndex.emplace(span, position(p)).first; }
+        varint(it->second + 1);
+    } else if (si.line != -1) {
+        // loaded from a dump: only the position data is left
+        Position p;
+        p.file = si.filename;
+        p.line = si.line;
+        p.column = si.column;
+        p.brief = si.srcBrief;
+        varint(position(p) + 1);
+    } else {
+        varint(0); }
+}
+
+void BinaryWriter::generate(const big_int &v) {
+    if (v >= std::numeric_limits<int64_t>::min() && v <= std::numeric_limits<int64_t>::max()) {
+        generate(false);
+        svarint(v.convert_to<int64_t>());
+    } else {
+        generate(true);
+        raw(v.str()); }
+}
+
+void BinaryWriter::node(const IR::Node *n) {
+    if (n == nullptr) {
+        varint(0);
+        return; }
+    auto it = nodeIndex.find(n->id);
+    if (it != nodeIndex.end()) {
+        varint(2*uint64_t(it->second) + 2);
+        return; }
+    nodeIndex.emplace(n->id, nodeIndex.size());
+    auto name = n->node_type_name();
+    auto type = typeIndex.find(name);
+    if (type == typeIndex.end()) {
+        type = typeIndex.emplace(name, types.size()).first;
+        types.push_back(intern(name)); }
+    varint(2*uint64_t(type->second) + 1);
+    n->toBinary(*this);
+}
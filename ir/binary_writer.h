@@ -0,0 +1,246 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_BINARY_WRITER_H_
+#define _IR_BINARY_WRITER_H_
+
+#include <string.h>
+#include <boost/optional.hpp>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "lib/bitvec.h"
+#include "lib/cstring.h"
+#include "lib/ltbitmatrix.h"
+#include "lib/match.h"
+#include "lib/ordered_map.h"
+#include "lib/ordered_set.h"
+#include "lib/safe_vector.h"
+#include "lib/source_file.h"
+
+#include "ir.h"
+
+/**
+ * Writes IR trees in a compact binary form, which BinaryLoader reads back.
+ * It plays the same role as JSONGenerator, and the generated toBinary
+ * methods of the IR classes write their fields in declaration order, without
+ * their names.
+ *
+ * An image holds, in this order:
+ *  - a header with a magic number, the format version and IR::binary_ir_schema;
+ *  - the table of all strings, each written once;
+ *  - the names of the node types used, so that nodes refer to their type by
+ *    index in this table;
+ *  - the table of source positions, shared by all the nodes with the same
+ *    position.  Each holds the file, line and source fragment shown to users,
+ *    and the span in the InputSources of the program, which BinaryLoader
+ *    uses when it is given the same sources;
+ *  - the values written with operator<<, in order.
+ * All the integers are varints, zigzag-encoded when signed.  A node is written
+ * in full the first time it is seen, and as an index in the order in which
+ * nodes were written after that, so DAGs are preserved.
+ *
+ * As the tables come first, the image is only written to the stream when the
+ * BinaryWriter is destroyed.
+ */
+class BinaryWriter {
+ public:
+    static const char magic[4];
+    static const unsigned version = 2;
+
+ private:
+    /// start line and column, end line and column
+    typedef std::tuple<unsigned, unsigned, unsigned, unsigned> Span;
+    struct Position {
+        cstring file;
+        unsigned line, column;
+        cstring brief;
+        Span span{0, 0, 0, 0};  // none for positions loaded from a dump
+        bool operator<(const Position &a) const {
+            return std::tie(file, line, column, brief, span) <
+                   std::tie(a.file, a.line, a.column, a.brief, a.span); }
+    };
+
+    std::ostream &out;
+    bool dumpSourceInfo;
+    std::string body;
+    std::unordered_map<cstring, unsigned> stringIndex;
+    std::vector<cstring> strings;
+    std::unordered_map<cstring, unsigned> typeIndex;
+    std::vector<unsigned> types;  // as string indices
+    std::map<Position, unsigned> positionIndex;
+    std::vector<Position> positions;
+    // computing the position of a span in the sources is expensive
+    std::map<Span, unsigned> spanIndex;
+    std::unordered_map<int, unsigned> nodeIndex;  // by node id
+    int lastId = 0;
+
+    template<typename T>
+    class has_toBinary {
+        typedef char small;
+        typedef struct { char c[2]; } big;
+
+        template<typename C> static small test(decltype(&C::toBinary));
+        template<typename C> static big test(...);
+     public:
+        static const bool value = sizeof(test<T>(0)) == sizeof(char);
+    };
+
+    static void varint(std::string &to, uint64_t v) {
+        while (v >= 0x80) {
+            to += static_cast<char>(v | 0x80);
+            v >>= 7; }
+        to += static_cast<char>(v); }
+    void varint(uint64_t v) { varint(body, v); }
+    void svarint(int64_t v) { varint((static_cast<uint64_t>(v) << 1) ^ (v >> 63)); }
+    void raw(const std::string &s) {
+        varint(s.size());
+        body += s; }
+    unsigned intern(cstring s);
+    unsigned position(const Position &p);
+    void node(const IR::Node *n);
+
+ public:
+    explicit BinaryWriter(std::ostream &out, bool dumpSourceInfo = false) :
+        out(out), dumpSourceInfo(dumpSourceInfo) {}
+    ~BinaryWriter();
+
+    /// Used by IR::Node and IR::ID, which know what their fields mean.
+    void nodeId(int id) {
+        svarint(int64_t(id) - lastId);
+        lastId = id; }
+    void sourceInfo(const Util::SourceInfo &si);
+
+    template<typename T, class ALLOC>
+    void generate(const safe_vector<T, ALLOC> &v) {
+        varint(v.size());
+        for (auto &e : v) generate(e); }
+
+    template<typename T>
+    void generate(const std::vector<T> &v) {
+        varint(v.size());
+        for (auto &e : v) generate(e); }
+
+    template<typename T, typename U>
+    void generate(const std::pair<T, U> &v) {
+        generate(v.first);
+        generate(v.second); }
+
+    template<typename T>
+    void generate(const boost::optional<T> &v) {
+        generate(bool(v));
+        if (v) generate(*v); }
+
+    template<typename T>
+    void generate(const std::set<T> &v) {
+        varint(v.size());
+        for (auto &e : v) generate(e); }
+
+    template<typename T>
+    void generate(const ordered_set<T> &v) {
+        varint(v.size());
+        for (auto &e : v) generate(e); }
+
+    template<typename K, typename V>
+    void generate(const std::map<K, V> &v) {
+        varint(v.size());
+        for (auto &e : v) generate(e); }
+
+    template<typename K, typename V>
+    void generate(const std::multimap<K, V> &v) {
+        varint(v.size());
+        for (auto &e : v) generate(e); }
+
+    template<typename K, typename V>
+    void generate(const ordered_map<K, V> &v) {
+        varint(v.size());
+        for (auto &e : v) generate(e); }
+
+    void generate(bool v) { body += static_cast<char>(v); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    generate(T v) { svarint(v); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    generate(T v) { varint(v); }
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type
+    generate(T v) { svarint(static_cast<int64_t>(v)); }
+    void generate(double v) {
+        char bytes[sizeof(v)];
+        memcpy(bytes, &v, sizeof(v));
+        body.append(bytes, sizeof(v)); }
+    void generate(const big_int &v);
+
+    void generate(cstring v) { varint(v ? intern(v) + 1 : 0); }
+    void generate(const IR::ID &v) {
+        sourceInfo(v.srcInfo);
+        generate(v.name);
+        generate(v.originalName); }
+
+    // these have no compact form, but are seldom used
+    void generate(const bitvec &v) {
+        std::stringstream tmp;
+        tmp << v;
+        raw(tmp.str()); }
+    void generate(const LTBitMatrix &v) {
+        std::stringstream tmp;
+        tmp << v;
+        raw(tmp.str()); }
+
+    void generate(const match_t &v) {
+        varint(v.word0);
+        varint(v.word1); }
+
+    void generate(const UnparsedConstant *v) {
+        generate(v != nullptr);
+        if (!v) return;
+        generate(v->text);
+        generate(v->skip);
+        generate(v->base);
+        generate(v->hasWidth); }
+
+    template<typename T>
+    typename std::enable_if<
+                    has_toBinary<T>::value &&
+                    !std::is_base_of<IR::INode, T>::value>::type
+    generate(const T &v) { v.toBinary(*this); }
+
+    template<typename T>
+    typename std::enable_if<
+                    has_toBinary<T>::value &&
+                    !std::is_base_of<IR::INode, T>::value>::type
+    generate(const T *v) {
+        generate(v != nullptr);
+        if (v) v->toBinary(*this); }
+
+    void generate(const IR::Node &v) { node(&v); }
+
+    template<typename T>
+    typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    generate(const T *v) { node(v ? v->getNode() : nullptr); }
+
+    template<typename T, size_t N>
+    void generate(const T (&v)[N]) {
+        for (auto &e : v) generate(e); }
+
+    template<typename T> BinaryWriter &operator<<(const T &v) { generate(v); return *this; }
+};
+
+#endif /* _IR_BINARY_WRITER_H_ */
@@ -28,6 +28,7 @@ limitations under the License.
 #include "declaration.h"
 
 class JSONLoader;
+class BinaryLoader;
 
 namespace IR {
 
@@ -79,6 +80,7 @@ class IndexedVector : public Vector<T> {
     explicit IndexedVector(const Vector<T> &a) {
         insert(typename Vector<T>::end(), a.begin(), a.end()); }
     explicit IndexedVector(JSONLoader &json);
+    explicit IndexedVector(BinaryLoader &bin);
 
     void clear() { IR::Vector<T>::clear(); declarations.clear(); }
     // TODO: Although this is not a const_iterator, it should NOT
@@ -175,6 +177,7 @@ class IndexedVector : public Vector<T> {
 
     void toJSON(JSONGenerator &json) const override;
     static IndexedVector<T>* fromJSON(JSONLoader &json);
+    static IndexedVector<T>* fromBinary(BinaryLoader &bin);
     void check_valid() const {
         for (auto el : *this) {
             auto it = declarations.find(el->getName());
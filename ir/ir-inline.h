@@ -72,6 +72,36 @@ template<class T> void IR::Vector<T>::visit_children(Visitor &v) {
 template<class T> void IR::Vector<T>::visit_children(Visitor &v) const {
     for (auto &a : vec) v.visit(a); }
 template<class T> void IR::Vector<T>::parallel_visit_children(Visitor &v) {
+    if (v.threaded_parallel_visit(vec.size())) {
+        std::vector<const Node *> results(vec.begin(), vec.end());
+        v.threaded_parallel_apply(results);
+        auto i = vec.begin();
+        for (auto n : results) {
+            if (!n && *i) {
+                i = erase(i);
+            } else if (n == *i) {
+                i++;
+            } else if (auto l = dynamic_cast<const Vector *>(n)) {
+                i = erase(i);
+                i = insert(i, l->vec.begin(), l->vec.end());
+                i += l->vec.size();
+            } else if (auto v = dynamic_cast<const VectorBase *>(n)) {
+                if (v->empty()) {
+                    i = erase(i);
+                } else {
+                    i = insert(i, v->size() - 1, nullptr);
+                    for (auto el : *v) {
+                        if (auto e = dynamic_cast<const T *>(el))
+                            *i++ = e;
+                        else
+                            BUG("visitor returned invalid type %s for Vector<%s>",
+                                e->node_type_name(), T::static_type_name()); } }
+            } else if (auto e = dynamic_cast<const T *>(n)) {
+                *i++ = e;
+            } else {
+                BUG("visitor returned invalid type %s for Vector<%s>",
+                    n->node_type_name(), T::static_type_name()); } }
+        return; }
     Visitor *start = nullptr, *tmp = &v;
     size_t todo = vec.size();
     if (todo > 1) start = &v.flow_clone();
@@ -108,6 +138,13 @@ template<class T> void IR::Vector<T>::parallel_visit_children(Visitor &v) {
             v.flow_merge(*tmp); }
 }
 template<class T> void IR::Vector<T>::parallel_visit_children(Visitor &v) const {
+    if (v.threaded_parallel_visit(vec.size())) {
+        std::vector<const Node *> results(vec.begin(), vec.end());
+        v.threaded_parallel_apply(results);
+        for (size_t i = 0; i < vec.size(); ++i)
+            if (results[i] != vec[i])
+                BUG("const Visitor wants to change IR");
+        return; }
     Visitor *start = nullptr, *tmp = &v;
     size_t todo = vec.size();
     if (todo > 1) start = &v.flow_clone();
@@ -133,6 +170,11 @@ template<class T> void IR::Vector<T>::toJSON(JSONGenerator &json) const {
     json << "]";
 }
 
+template<class T> void IR::Vector<T>::toBinary(BinaryWriter &bin) const {
+    Node::toBinary(bin);
+    bin << vec;
+}
+
 std::ostream &operator<<(std::ostream &out, const IR::Vector<IR::Expression> &v);
 
 template<class T> void IR::IndexedVector<T>::visit_children(Visitor &v) {
@@ -241,6 +283,13 @@ void IR::NameMap<T, MAP, COMP, ALLOC>::toJSON(JSONGenerator &json) const {
     if (*sep) json << std::endl << json.indent;
     json << "}";
 }
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+void IR::NameMap<T, MAP, COMP, ALLOC>::toBinary(BinaryWriter &bin) const {
+    Node::toBinary(bin);
+    bin << symbols;
+}
 
 template<class KEY, class VALUE,
          template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
@@ -52,8 +52,8 @@ class JSONGenerator {
     explicit JSONGenerator(std::ostream &out, bool dumpSourceInfo = false) :
         out(out), dumpSourceInfo(dumpSourceInfo) {}
 
-    template<typename T>
-    void generate(const safe_vector<T> &v) {
+    template<typename T, class ALLOC>
+    void generate(const safe_vector<T, ALLOC> &v) {
         out << "[";
         if (v.size() > 0) {
             out << std::endl << ++indent;
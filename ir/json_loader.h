@@ -86,8 +86,8 @@ class JSONLoader {
         return nullptr;  // invalid json exception?
     }
 
-    template<typename T>
-    void unpack_json(safe_vector<T> &v) {
+    template<typename T, class ALLOC>
+    void unpack_json(safe_vector<T, ALLOC> &v) {
         T temp;
         for (auto e : *json->to<JsonVector>()) {
             load(e, temp);
@@ -259,7 +259,9 @@ class JSONLoader {
     template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
     unpack_json(T &v) { v = *(get_node()->to<T>()); }
     template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
-    unpack_json(const T *&v) { v = get_node()->to<T>(); }
+    unpack_json(const T *&v) {
+        auto node = get_node();  // null for a json null
+        v = node ? node->to<T>() : nullptr; }
 
     template<typename T, size_t N>
     void unpack_json(T (&v)[N]) {
@@ -18,6 +18,7 @@ limitations under the License.
 #define _IR_NAMEMAP_H_
 
 class JSONLoader;
+class BinaryLoader;
 
 namespace IR {
 
@@ -39,6 +40,7 @@ class NameMap : public Node {
     NameMap(const NameMap &) = default;
     NameMap(NameMap &&) = default;
     explicit NameMap(JSONLoader &);
+    explicit NameMap(BinaryLoader &);
     NameMap &operator=(const NameMap &) = default;
     NameMap &operator=(NameMap &&) = default;
     typedef typename map_t::value_type          value_type;
@@ -132,6 +134,8 @@ class NameMap : public Node {
     void visit_children(Visitor &v) const override;
     void toJSON(JSONGenerator &json) const override;
     static NameMap<T, MAP, COMP, ALLOC> *fromJSON(JSONLoader &json);
+    void toBinary(BinaryWriter &bin) const override;
+    static NameMap<T, MAP, COMP, ALLOC> *fromBinary(BinaryLoader &bin);
 
     Util::Enumerator<const T*>* valueEnumerator() const {
         return Util::Enumerator<const T*>::createEnumerator(Values(symbols).begin(),
@@ -16,13 +16,61 @@ limitations under the License.
 
 #include "ir.h"
 #include "ir/json_loader.h"
+#include "ir/binary_loader.h"
+#include "lib/arena.h"
 
 void IR::Node::traceVisit(const char* visitor) const
 { LOG3("Visiting " << visitor << " " << id << ":" << node_type_name()); }
 
-void IR::Node::traceCreation() const { LOG5("Created node " << id); }
+IR::IdCounter IR::Node::currentId(0);
+
+// The first id after those of the nodes that outlive compilations, once
+// resetIds has been called.
+static IR::IdCounter firstReusableId(-1);
+
+void IR::Node::traceCreation() const {
+    if (firstReusableId >= 0 && Arena::isSuspended()) {
+        int next = firstReusableId;
+        while (id >= next) {
+#ifdef MULTITHREAD
+            if (firstReusableId.compare_exchange_weak(next, id + 1))
+                break;
+#else
+            firstReusableId = next = id + 1;
+#endif  // MULTITHREAD
+        } }
+    LOG5("Created node " << id);
+}
+
+void IR::Node::resetIds() {
+    if (firstReusableId < 0)
+        firstReusableId = static_cast<int>(currentId);
+    currentId = static_cast<int>(firstReusableId);
+}
 
-int IR::Node::currentId = 0;
+#if !HAVE_LIBGC
+// Without the collector, what the nodes own (maps, big_ints) is only freed by
+// their destructors, so the arena has to run them.
+static void destroyNode(void *p) { static_cast<IR::Node *>(p)->~Node(); }
+#endif  /* !HAVE_LIBGC */
+
+void *IR::Node::operator new(size_t size) {
+#if HAVE_LIBGC
+    return Arena::alloc(size);
+#else
+    return Arena::alloc(size, destroyNode);
+#endif  /* HAVE_LIBGC */
+}
+
+void IR::Node::operator delete(void *p) {
+#if !HAVE_LIBGC
+    // destroyed early, or its constructor threw
+    if (auto *arena = Arena::owner(p)) {
+        arena->removeFinalizer(p);
+        return; }
+#endif  /* !HAVE_LIBGC */
+    Arena::dealloc(p);
+}
 
 void IR::Node::toJSON(JSONGenerator &json) const {
     json << json.indent << "\"Node_ID\" : " << id << "," << std::endl
@@ -37,6 +85,16 @@ IR::Node::Node(JSONLoader &json) : id(-1) {
         currentId = id+1;
 }
 
+void IR::Node::toBinary(BinaryWriter &bin) const {
+    bin.sourceInfo(srcInfo);
+    bin.nodeId(id);
+}
+
+IR::Node::Node(BinaryLoader &bin) : srcInfo(bin.sourceInfo()), id(bin.nodeId()), clone_id(id) {
+    if (id >= currentId)
+        currentId = id+1;
+}
+
 // Abbreviated debug print
 cstring IR::dbp(const IR::INode* node) {
     std::stringstream str;
@@ -18,6 +18,11 @@ limitations under the License.
 #define _IR_NODE_H_
 
 #include <memory>
+#include <type_traits>
+#include <typeinfo>
+#ifdef MULTITHREAD
+#include <atomic>
+#endif  // MULTITHREAD
 #include "lib/cstring.h"
 #include "lib/stringify.h"
 #include "lib/indent.h"
@@ -32,9 +37,19 @@ class Modifier;
 class Transform;
 class JSONGenerator;
 class JSONLoader;
+class BinaryWriter;
+class BinaryLoader;
 
 namespace IR {
 
+/// Type of the counters used to hand out node and declaration ids; atomic when
+/// IR nodes may be created concurrently by several threads.
+#ifdef MULTITHREAD
+typedef std::atomic<int> IdCounter;
+#else
+typedef int IdCounter;
+#endif  // MULTITHREAD
+
 class Node;
 class Annotation;
 
@@ -49,6 +64,7 @@ class INode : public Util::IHasSourceInfo, public IHasDbPrint {
     virtual void dbprint(std::ostream &out) const = 0;  // for debugging
     virtual cstring toString() const = 0;  // for user consumption
     virtual void toJSON(JSONGenerator &) const = 0;
+    virtual void toBinary(BinaryWriter &) const = 0;
     virtual cstring node_type_name() const = 0;
     virtual void validate() const {}
     virtual const Annotation *getAnnotation(cstring) const { return nullptr; }
@@ -57,6 +73,10 @@ class INode : public Util::IHasSourceInfo, public IHasDbPrint {
     template<typename T> const T &as() const;
 };
 
+class Node;
+/// The type tag of @p node, or -1 if it is null.
+inline int nodeTypeTag(const Node *node);
+
 class Node : public virtual INode {
  public:
     virtual bool apply_visitor_preorder(Modifier &v);
@@ -70,7 +90,7 @@ class Node : public virtual INode {
     virtual void apply_visitor_revisit(Transform &v, const Node *n) const;
 
  protected:
-    static int currentId;
+    static IdCounter currentId;
     void traceVisit(const char* visitor) const;
     virtual void visit_children(Visitor &) { }
     virtual void visit_children(Visitor &) const { }
@@ -93,6 +113,18 @@ class Node : public virtual INode {
     Node(const Node& other) : srcInfo(other.srcInfo), id(currentId++), clone_id(other.clone_id) {
         traceCreation(); }
     virtual ~Node() {}
+    /// Nodes are allocated from the current Arena, if there is one.
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+    static void *operator new(size_t, void *place) { return place; }
+    static void operator delete(void *, void *) {}
+    /// the number of nodes created so far
+    static int nodeCount() { return currentId; }
+    /// Hands out ids again from the first one after those of the nodes that
+    /// outlive compilations: the nodes made before the first call, and the
+    /// ones made under Arena::Suspend.  For processes that run one compilation
+    /// after another, whose ids would otherwise overflow.
+    static void resetIds();
     const Node *apply(Visitor &v) const;
     const Node *apply(Visitor &&v) const { return apply(v); }
     virtual Node *clone() const = 0;
@@ -104,14 +136,27 @@ class Node : public virtual INode {
     cstring node_type_name() const override { return "Node"; }
     static cstring static_type_name() { return "Node"; }
     virtual int num_children() { return 0; }
+    /// The number of the class of this node in a preorder walk of the classes
+    /// generated from the .def files, so the tags of a class and its subclasses
+    /// are the range NodeTypeTags<CLASS>::first..last (see gen-tree-macro.h).
+    /// A class defined elsewhere has the tag of its closest generated base.
+    virtual int node_type_tag() const { return NodeTypeTags<Node>::first; }
     template<typename T> bool is() const { return to<T>() != nullptr; }
-    template<typename T> const T *to() const { return dynamic_cast<const T*>(this); }
-    template<typename T> const T &as() const { return dynamic_cast<const T&>(*this); }
+    /// Generated classes are checked with their type tags; other classes
+    /// (interfaces, templates) need a dynamic_cast.
+    template<typename T> const T *to() const {
+        return to<T>(std::integral_constant<bool, NodeTypeTags<T>::known>()); }
+    template<typename T> const T &as() const {
+        auto *rv = to<T>();
+        if (!rv) throw std::bad_cast();
+        return *rv; }
     explicit Node(JSONLoader &json);
     cstring toString() const override { return node_type_name(); }
     void toJSON(JSONGenerator &json) const override;
     void sourceInfoToJSON(JSONGenerator &json) const;
     Util::JsonObject* sourceInfoJsonObj() const;
+    explicit Node(BinaryLoader &bin);
+    void toBinary(BinaryWriter &bin) const override;
     /* operator== does a 'shallow' comparison, comparing two Node subclass objects for equality,
      * and comparing pointers in the Node directly for equality */
     virtual bool operator==(const Node &a) const { return typeid(*this) == typeid(a); }
@@ -124,8 +169,25 @@ class Node : public virtual INode {
 #undef DEFINE_OPEQ_FUNC
 
     bool operator!=(const Node &n) const { return !operator==(n); }
+
+ private:
+    template<typename T> const T *to(std::true_type) const {
+        int tag = nodeTypeTag(this);
+        if (tag < NodeTypeTags<T>::first || tag > NodeTypeTags<T>::last) return nullptr;
+        return static_cast<const T *>(this); }
+    template<typename T> const T *to(std::false_type) const {
+        return dynamic_cast<const T *>(this); }
 };
 
+/// to<T>() and is<T>() are called on the results of lookups that may fail,
+/// like a non-strict TypeMap::getType, and give back null for a null node, as
+/// the dynamic_cast they used before did.  The pointer is the `this` of the
+/// caller, which the compiler would assume is not null, so it is hidden from
+/// the optimizer before the check.
+inline int nodeTypeTag(const Node *node) {
+    __asm__("" : "+r"(node));
+    return node ? node->node_type_tag() : -1; }
+
 // simple version of dbprint
 cstring dbp(const INode* node);
 
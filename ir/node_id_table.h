@@ -0,0 +1,129 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_NODE_ID_TABLE_H_
+#define _IR_NODE_ID_TABLE_H_
+
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "node.h"
+
+/**
+ * Maps IR nodes to a T, for the visitors to keep the state of every node they
+ * visit.  Rather than hashing the node pointer, entries are found by the dense
+ * Node::id, in pages of 256 ids that are only allocated when one of them is
+ * used.  The pages cover the range of ids seen so far, so visiting a subtree
+ * only costs space for the ids in that subtree.
+ *
+ * Ids are not always unique -- IR read back from a file keeps the ids it was
+ * written with -- so a node whose slot is already taken by another node with
+ * the same id goes to a hash table instead.
+ *
+ * Entries never move: pointers to them stay valid until they are erased.
+ */
+template<class T> class NodeIdTable {
+    enum { PAGE_BITS = 8, PAGE_SIZE = 1 << PAGE_BITS };
+    struct Slot {
+        const IR::Node  *node;      // null when unused
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
+        T &get() { return *reinterpret_cast<T *>(&value); }
+    };
+
+    std::vector<Slot *>                         pages;
+    int                                         firstPage = 0;
+    size_t                                      count = 0;
+    std::unordered_map<const IR::Node *, T>     clashes;
+
+    Slot *slot(int id) const {
+        int page = (id >> PAGE_BITS) - firstPage;
+        if (id < 0 || page < 0 || size_t(page) >= pages.size() || !pages[page])
+            return nullptr;
+        return &pages[page][id & (PAGE_SIZE - 1)]; }
+    Slot *makeSlot(int id) {
+        int page = id >> PAGE_BITS;
+        if (pages.empty()) {
+            firstPage = page;
+            pages.resize(1, nullptr);
+        } else if (page < firstPage) {
+            // leave room below as well, for the rest of the subtree
+            int newFirst = std::max(0, page - int(pages.size()));
+            pages.insert(pages.begin(), firstPage - newFirst, nullptr);
+            firstPage = newFirst;
+        } else if (size_t(page - firstPage) >= pages.size()) {
+            pages.resize(std::max(size_t(page - firstPage) + 1, 2 * pages.size()), nullptr); }
+        auto &p = pages[page - firstPage];
+        if (!p) p = new Slot[PAGE_SIZE]();
+        return &p[id & (PAGE_SIZE - 1)]; }
+
+ public:
+    NodeIdTable() = default;
+    NodeIdTable(const NodeIdTable &) = delete;
+    NodeIdTable &operator=(const NodeIdTable &) = delete;
+    ~NodeIdTable() { clear(); }
+
+    size_t size() const { return count + clashes.size(); }
+    bool empty() const { return size() == 0; }
+
+    /// @return the entry for @p n, or null if there is none
+    T *find(const IR::Node *n) const {
+        if (auto s = slot(n->id))
+            if (s->node == n) return &s->get();
+        if (!clashes.empty()) {
+            auto it = clashes.find(n);
+            if (it != clashes.end()) return const_cast<T *>(&it->second); }
+        return nullptr; }
+
+    /// Adds an entry for @p n made from @p args if there is none.
+    /// @return the entry, and whether it was added
+    template<class... ARGS> std::pair<T *, bool> emplace(const IR::Node *n, ARGS &&... args) {
+        Slot *s = n->id >= 0 ? makeSlot(n->id) : nullptr;
+        if (s && s->node == n)
+            return std::make_pair(&s->get(), false);
+        if (s && !s->node && (clashes.empty() || !clashes.count(n))) {
+            new (&s->value) T(std::forward<ARGS>(args)...);
+            s->node = n;
+            ++count;
+            return std::make_pair(&s->get(), true); }
+        auto rv = clashes.emplace(std::piecewise_construct, std::forward_as_tuple(n),
+                                  std::forward_as_tuple(std::forward<ARGS>(args)...));
+        return std::make_pair(&rv.first->second, rv.second); }
+
+    /// Erases the entries for which @p pred(node, entry) is true.
+    template<class PRED> void erase_if(PRED pred) {
+        for (auto p : pages) {
+            if (!p) continue;
+            for (Slot *s = p; s < p + PAGE_SIZE; ++s) {
+                if (s->node && pred(s->node, s->get())) {
+                    s->get().~T();
+                    s->node = nullptr;
+                    --count; } } }
+        for (auto it = clashes.begin(); it != clashes.end();) {
+            if (pred(it->first, it->second))
+                it = clashes.erase(it);
+            else
+                ++it; } }
+
+    void clear() {
+        erase_if([](const IR::Node *, const T &) { return true; });
+        for (auto p : pages) delete [] p;
+        pages.clear(); }
+};
+
+#endif /* _IR_NODE_ID_TABLE_H_ */
@@ -0,0 +1,129 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "node_kinds.h"
+
+namespace {
+
+class CollectKinds : public Inspector {
+    NodeKinds &kinds;
+
+ public:
+    explicit CollectKinds(NodeKinds &kinds) : kinds(kinds) { setName("CollectKinds"); }
+    bool preorder(const IR::Node *node) override {
+        kinds.addTag(node->node_type_tag());
+        return true; }
+};
+
+std::vector<const IR::Node *> declarations(const IR::Node *root) {
+    if (auto program = root->to<IR::P4Program>())
+        return std::vector<const IR::Node *>(program->objects.begin(), program->objects.end());
+    return { root };
+}
+
+cstring declarationName(const IR::Node *node) {
+    if (auto decl = node->to<IR::IDeclaration>())
+        return decl->getName().name;
+    return cstring();
+}
+
+}  // namespace
+
+NodeKinds NodeKinds::in(const IR::Node *node) {
+    NodeKinds rv;
+    node->apply(CollectKinds(rv));
+    return rv;
+}
+
+/// Counts the kinds in the declarations of @p newRoot that have not been seen
+/// yet.  If @p newRoot was made from @p replaced by a pass that only creates
+/// nodes of the kinds @p created, a new declaration with the name of an old
+/// one holds the kinds of the old one and @p created.
+void NodeKindCensus::setRoot(const IR::Node *newRoot, const IR::Node *replaced,
+                             const NodeKinds *created) {
+    if (newRoot == root)
+        return;
+    std::unordered_map<cstring, const IR::Node *> byName;  // nullptr if not unique
+    if (created != nullptr && replaced != nullptr) {
+        if (replaced->is<IR::P4Program>() && newRoot->is<IR::P4Program>()) {
+            for (auto decl : declarations(replaced)) {
+                auto name = declarationName(decl);
+                if (!name)
+                    continue;
+                auto inserted = byName.emplace(name, decl);
+                if (!inserted.second)
+                    inserted.first->second = nullptr; }
+        } else if (!replaced->is<IR::P4Program>() && !newRoot->is<IR::P4Program>()) {
+            byName.emplace(cstring(), replaced); } }
+
+    std::unordered_map<const IR::Node *, NodeKinds> next;
+    for (auto decl : declarations(newRoot)) {
+        if (next.count(decl))
+            continue;
+        auto known = kinds.find(decl);
+        if (known != kinds.end()) {
+            next.emplace(decl, known->second);
+            continue; }
+        auto name = newRoot->is<IR::P4Program>() ? declarationName(decl) : cstring();
+        auto old = byName.find(name);
+        if (old != byName.end() && old->second != nullptr && kinds.count(old->second)) {
+            NodeKinds derived = kinds.at(old->second);
+            derived |= *created;
+            next.emplace(decl, derived);
+            continue; }
+        next.emplace(decl, NodeKinds::in(decl)); }
+    kinds = std::move(next);
+    root = newRoot;
+}
+
+std::vector<const IR::Node *>
+NodeKindCensus::holding(const IR::Node *root, const NodeKinds &wanted) {
+    setRoot(root);
+    std::vector<const IR::Node *> rv;
+    for (auto decl : declarations(root))
+        if (kinds.at(decl).intersects(wanted))
+            rv.push_back(decl);
+    return rv;
+}
+
+bool NodeKindCensus::canSkip(const Visitor &pass, const IR::Node *root) {
+    auto input = pass.inputKinds();
+    if (input == nullptr)
+        return false;
+    auto held = holding(root, *input);
+    auto seen = unchanged.find(&pass);
+    if (seen == unchanged.end())
+        return held.empty();
+    for (auto decl : held)
+        if (!seen->second.count(decl))
+            return false;
+    // Forget the declarations that are gone.
+    seen->second = std::unordered_set<const IR::Node *>(held.begin(), held.end());
+    return true;
+}
+
+void NodeKindCensus::ran(const Visitor &pass, const IR::Node *before, const IR::Node *after) {
+    auto input = pass.inputKinds();
+    if (input == nullptr)
+        return;
+    if (after == before) {
+        auto held = holding(before, *input);
+        unchanged[&pass] = std::unordered_set<const IR::Node *>(held.begin(), held.end());
+        return; }
+    unchanged.erase(&pass);
+    if (after != nullptr && before == root)
+        setRoot(after, before, pass.outputKinds());
+}
@@ -0,0 +1,83 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_NODE_KINDS_H_
+#define _IR_NODE_KINDS_H_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ir/ir.h"
+#include "lib/bitvec.h"
+
+/// A set of IR node classes, as the type tags the ir-generator numbers them
+/// with (see Node::node_type_tag).  A class stands for itself and all its
+/// subclasses, so only classes generated from the .def files can be added.
+class NodeKinds {
+    bitvec tags;
+
+ public:
+    NodeKinds() = default;
+    template<class T> NodeKinds &add() {
+        static_assert(IR::NodeTypeTags<T>::known, "not a class generated from the .def files");
+        tags.setrange(IR::NodeTypeTags<T>::first,
+                      IR::NodeTypeTags<T>::last - IR::NodeTypeTags<T>::first + 1);
+        return *this; }
+    template<class... T> static NodeKinds of() {
+        NodeKinds rv;
+        int unused[] = { 0, (rv.add<T>(), 0)... };
+        (void)unused;
+        return rv; }
+    void addTag(int tag) { tags.setbit(tag); }
+    NodeKinds &operator|=(const NodeKinds &a) { tags |= a.tags; return *this; }
+    bool intersects(const NodeKinds &a) const { return tags.intersects(a.tags); }
+    bool empty() const { return tags.empty(); }
+    bool operator==(const NodeKinds &a) const { return tags == a.tags; }
+    bool operator!=(const NodeKinds &a) const { return tags != a.tags; }
+    /// The kinds of the nodes in the tree under @p node.
+    static NodeKinds in(const IR::Node *node);
+};
+
+/**
+ * The kinds of nodes in each top-level declaration of a program, which
+ * PassManager uses to skip the passes that declare their input kinds
+ * (Visitor::inputKinds) when they have nothing to do.  A root that is not a
+ * P4Program counts as a single declaration.  Declarations are told apart by
+ * their address: a pass that changes one makes a new node, whose kinds are
+ * counted when it is first seen, or derived from the declaration it replaced
+ * when the pass declares the kinds it creates.
+ */
+class NodeKindCensus {
+    const IR::Node *root = nullptr;
+    std::unordered_map<const IR::Node *, NodeKinds> kinds;  // of the declarations of root
+    /// The declarations each pass last ran on without changing them.
+    std::unordered_map<const Visitor *, std::unordered_set<const IR::Node *>> unchanged;
+
+    void setRoot(const IR::Node *root, const IR::Node *replaced = nullptr,
+                 const NodeKinds *created = nullptr);
+
+ public:
+    /// The declarations of @p root that hold nodes of some of the @p wanted kinds.
+    std::vector<const IR::Node *> holding(const IR::Node *root, const NodeKinds &wanted);
+    /// True if @p pass declares its input kinds, and would not change @p root
+    /// because it has already run without change on all the declarations that
+    /// hold them.
+    bool canSkip(const Visitor &pass, const IR::Node *root);
+    /// Records that @p pass turned @p before into @p after.
+    void ran(const Visitor &pass, const IR::Node *before, const IR::Node *after);
+};
+
+#endif /* _IR_NODE_KINDS_H_ */
@@ -15,9 +15,44 @@ limitations under the License.
 */
 
 #include "ir.h"
+#include "node_kinds.h"
 #include "lib/gc.h"
 #include "lib/n4.h"
 
+namespace {
+
+/// The census of the outermost pass manager being applied on this thread,
+/// while it applies a pass manager; nullptr while it applies other passes,
+/// so that the pass managers those make and apply get their own.
+thread_local NodeKindCensus *activeCensus = nullptr;
+
+/// Makes a census when there is none, for the time a pass manager is applied.
+class CensusScope {
+    NodeKindCensus own;
+    NodeKindCensus *saved;
+
+ public:
+    CensusScope() : saved(activeCensus) {
+        if (activeCensus == nullptr)
+            activeCensus = &own; }
+    ~CensusScope() { activeCensus = saved; }
+    NodeKindCensus *operator->() { return saved ? saved : &own; }
+};
+
+/// Passes the census on to @p pass for as long as it is applied, if it is a
+/// pass manager.
+class ChildCensus {
+    NodeKindCensus *saved;
+
+ public:
+    explicit ChildCensus(const Visitor *pass) : saved(activeCensus) {
+        if (dynamic_cast<const PassManager *>(pass) == nullptr)
+            activeCensus = nullptr; }
+    ~ChildCensus() { activeCensus = saved; }
+};
+
+}  // namespace
+
 void PassManager::removePasses(const std::vector<cstring> &exclude) {
     for (auto it : exclude) {
         bool excluded = false;
@@ -32,6 +67,39 @@ void PassManager::removePasses(const std::vector<cstring> &exclude) {
             throw std::runtime_error("Trying to exclude unknown pass '" + it + "'");
         }
     }
+    kinds_collected = false;
+}
+
+void PassManager::collectKinds() const {
+    if (kinds_collected) return;
+    kinds_collected = true;
+    passes_input_kinds = passes_output_kinds = nullptr;
+    if (passes.empty()) return;
+    NodeKinds input, output;
+    bool allOutputs = true;
+    for (auto p : passes) {
+        auto in = p->inputKinds();
+        if (in == nullptr) return;
+        input |= *in;
+        if (auto out = p->outputKinds())
+            output |= *out;
+        else
+            allOutputs = false; }
+    passes_input_kinds = new NodeKinds(input);
+    if (allOutputs)
+        passes_output_kinds = new NodeKinds(output);
+}
+
+const NodeKinds *PassManager::inputKinds() const {
+    if (input_kinds) return input_kinds;
+    collectKinds();
+    return passes_input_kinds;
+}
+
+const NodeKinds *PassManager::outputKinds() const {
+    if (input_kinds) return output_kinds;
+    collectKinds();
+    return passes_output_kinds;
 }
 
 const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *) {
@@ -42,6 +110,7 @@ const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *
         explicit indent_nesting(indent_t &i) : indent(i) { ++indent; }
         ~indent_nesting() { --indent; }
     } nest_log_indent(log_indent);
+    CensusScope census;
 
     early_exit_flag = false;
     unsigned initial_error_count = ::errorCount();
@@ -54,13 +123,22 @@ const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *
         try {
             try {
                 size_t maxmem;
-                LOG1(log_indent << name() << " invoking " << v->name());
-                auto after = program->apply(**it);
-                LOG3(log_indent << "heap after " << v->name() << ": in use " <<
-                     n4(gc_mem_inuse(&maxmem)) << "B, max " << n4(maxmem) << "B");
-                if (stop_on_error && ::errorCount() > initial_error_count)
-                    break;
-                if ((program = after) == nullptr) break;
+                if (census->canSkip(*v, program)) {
+                    // It would not change anything.
+                    LOG1(log_indent << name() << " skipping " << v->name());
+                } else {
+                    LOG1(log_indent << name() << " invoking " << v->name());
+                    const IR::Node *after;
+                    {
+                        ChildCensus child(v);
+                        after = program->apply(**it);
+                    }
+                    LOG3(log_indent << "heap after " << v->name() << ": in use " <<
+                         n4(gc_mem_inuse(&maxmem)) << "B, max " << n4(maxmem) << "B");
+                    if (stop_on_error && ::errorCount() > initial_error_count)
+                        break;
+                    census->ran(*v, program, after);
+                    if ((program = after) == nullptr) break; }
             } catch (Backtrack::trigger::type_t &trig_type) {
                 throw Backtrack::trigger(trig_type);
             }
@@ -113,6 +191,7 @@ void PassManager::runDebugHooks(const char* visitorName, const IR::Node* program
 }
 
 const IR::Node *PassRepeated::apply_visitor(const IR::Node *program, const char *name) {
+    CensusScope census;  // shared by the iterations
     bool done = false;
     unsigned iterations = 0;
     unsigned initial_error_count = ::errorCount();
@@ -127,12 +206,15 @@ const IR::Node *PassRepeated::apply_visitor(const IR::Node *program, const char
         iterations++;
         if (repeats != 0 && iterations > repeats)
             done = true;
+        if (!done)
+            iterated(program, newprogram);
         program = newprogram;
     }
     return program;
 }
 
 const IR::Node *PassRepeatUntil::apply_visitor(const IR::Node *program, const char *name) {
+    CensusScope census;  // shared by the iterations
     do {
         running = true;
         program = PassManager::apply_visitor(program, name);
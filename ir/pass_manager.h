@@ -25,6 +25,11 @@ typedef std::function<void(const char* manager, unsigned seqNo,
 class PassManager : virtual public Visitor, virtual public Backtrack {
     bool early_exit_flag;
     mutable int never_backtracks_cache = -1;
+    // the kinds of the passes, once collected
+    mutable bool kinds_collected = false;
+    mutable const NodeKinds *passes_input_kinds = nullptr;
+    mutable const NodeKinds *passes_output_kinds = nullptr;
+    void collectKinds() const;
 
  protected:
     safe_vector<DebugHook>   debugHooks;  // called after each pass
@@ -44,11 +49,15 @@ class PassManager : virtual public Visitor, virtual public Backtrack {
     { addPasses(init); }
     void addPasses(const std::initializer_list<Visitor *> &init) {
         never_backtracks_cache = -1;
+        kinds_collected = false;
         for (auto p : init) if (p) passes.emplace_back(p); }
     void removePasses(const std::vector<cstring> &exclude);
     const IR::Node *apply_visitor(const IR::Node *, const char * = 0) override;
     bool backtrack(trigger &trig) override;
     bool never_backtracks() override;
+    /// The union of the kinds of the passes, if they all declare them.
+    const NodeKinds *inputKinds() const override;
+    const NodeKinds *outputKinds() const override;
     void setStopOnError(bool stop) { stop_on_error = stop; }
     void addDebugHook(DebugHook h, bool recursive = false) {
         debugHooks.push_back(h);
@@ -68,6 +77,12 @@ class PassManager : virtual public Visitor, virtual public Backtrack {
 // Repeat a pass until convergence (or up to a fixed number of repeats)
 class PassRepeated : virtual public PassManager {
     unsigned            repeats;  // 0 = until convergence
+
+ protected:
+    /// Called when an iteration changed the program, with the program
+    /// before and after it, before the next iteration runs.
+    virtual void iterated(const IR::Node *, const IR::Node *) {}
+
  public:
     PassRepeated() : repeats(0) {}
     PassRepeated(const std::initializer_list<Visitor *> &init) :
@@ -84,6 +99,9 @@ class PassRepeatUntil : virtual public PassManager {
                     std::function<bool()> done)
     : PassManager(init), done(done) {}
     const IR::Node *apply_visitor(const IR::Node *, const char * = 0) override;
+    // what it does depends on 'done' too, so only declared kinds apply
+    const NodeKinds *inputKinds() const override { return input_kinds; }
+    const NodeKinds *outputKinds() const override { return output_kinds; }
 };
 
 class PassIf : virtual public PassManager {
@@ -93,6 +111,9 @@ class PassIf : virtual public PassManager {
     PassIf(std::function<bool()> cond, const std::initializer_list<Visitor *> &init)
     : PassManager(init), cond(cond) {}
     const IR::Node *apply_visitor(const IR::Node *, const char * = 0) override;
+    // what it does depends on 'cond' too, so only declared kinds apply
+    const NodeKinds *inputKinds() const override { return input_kinds; }
+    const NodeKinds *outputKinds() const override { return output_kinds; }
 };
 
 // Converts a function Node* -> Node* into a visitor
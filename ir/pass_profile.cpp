@@ -0,0 +1,208 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "pass_profile.h"
+
+#include <time.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <vector>
+
+#include "ir.h"
+#include "lib/gc.h"
+#include "lib/json.h"
+#include "lib/n4.h"
+#include "lib/nullstream.h"
+#include "lib/ordered_map.h"
+
+namespace {
+
+struct Sample {
+    uint64_t            wall, cpu, nodes;
+    size_t              alloc, heap;
+    PassProfile::Counts counts;
+
+    static uint64_t now(clockid_t clock) {
+        struct timespec ts;
+        clock_gettime(clock, &ts);
+        return ts.tv_sec*1000000000UL + ts.tv_nsec; }
+    explicit Sample(const PassProfile::Counts &counts) : counts(counts) {
+        wall = now(CLOCK_MONOTONIC);
+        cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+        nodes = IR::Node::nodeCount();
+        alloc = gc_mem_allocated(&heap); }
+};
+
+struct Record {
+    cstring                         name;
+    unsigned                        calls = 0;
+    uint64_t                        wall = 0, cpu = 0, nodes = 0, visits = 0, alloc = 0;
+    uint64_t                        clones = 0, clonesDiscarded = 0, clonesAvoided = 0;
+    int64_t                         heap = 0;
+    ordered_map<cstring, Record *>  children;   // in the order they first ran
+    const Sample                    *started = nullptr;
+
+    explicit Record(cstring name) : name(name) {}
+    Record *child(cstring name) {
+        auto &c = children[name];
+        if (!c) c = new Record(name);
+        return c; }
+    void begin(const PassProfile::Counts &counts) { started = new Sample(counts); }
+    void end(const PassProfile::Counts &counts) {
+        Sample now(counts);
+        ++calls;
+        wall += now.wall - started->wall;
+        cpu += now.cpu - started->cpu;
+        nodes += now.nodes - started->nodes;
+        visits += now.counts.visits - started->counts.visits;
+        clones += now.counts.clones - started->counts.clones;
+        clonesDiscarded += now.counts.clonesDiscarded - started->counts.clonesDiscarded;
+        clonesAvoided += now.counts.clonesAvoided - started->counts.clonesAvoided;
+        alloc += now.alloc - started->alloc;
+        heap += int64_t(now.heap) - int64_t(started->heap);
+        delete started;
+        started = nullptr; }
+    uint64_t self() const {
+        uint64_t rv = wall;
+        for (auto &c : children) rv -= std::min(rv, c.second->wall);
+        return rv; }
+
+    Util::JsonObject *toJson() const {
+        auto rv = new Util::JsonObject();
+        rv->emplace("name", name);
+        rv->emplace("calls", calls);
+        rv->emplace("wall_us", wall / 1000);
+        rv->emplace("self_us", self() / 1000);
+        rv->emplace("cpu_us", cpu / 1000);
+        rv->emplace("alloc_bytes", alloc);
+        rv->emplace("heap_delta_bytes", heap);
+        rv->emplace("nodes_created", nodes);
+        rv->emplace("nodes_visited", visits);
+        rv->emplace("nodes_cloned", clones);
+        rv->emplace("clones_discarded", clonesDiscarded);
+        rv->emplace("clones_avoided", clonesAvoided);
+        if (!children.empty()) {
+            auto passes = new Util::JsonArray();
+            for (auto &c : children) passes->append(c.second->toJson());
+            rv->emplace("passes", passes); }
+        return rv; }
+};
+
+cstring                 reportFile;
+Record                  *root = nullptr;
+std::vector<Record *>   stack;
+__thread bool           profilingThread = false;
+
+}  // namespace
+
+void PassProfile::enable(cstring filename) {
+    if (!root) std::atexit(writeReport);
+    reportFile = filename;
+    root = new Record("total");
+    stack.clear();
+    stack.push_back(root);
+    root->begin(PassProfile::Counts());
+    profilingThread = true;
+}
+
+bool PassProfile::enabled() { return root != nullptr && profilingThread; }
+
+void PassProfile::start(cstring name, const Counts &counts) {
+    if (!enabled()) return;
+    auto r = stack.back()->child(name);
+    r->begin(counts);
+    stack.push_back(r);
+}
+
+void PassProfile::finish(const Counts &counts) {
+    if (!enabled() || stack.empty()) return;
+    stack.back()->end(counts);
+    stack.pop_back();
+}
+
+void PassProfile::writeReport() {
+    if (!root) return;
+    // Passes still running (if exiting from an error) end here.  exit() may
+    // be called from another thread than the profiling one, where finish()
+    // does nothing, so the records are closed here.
+    while (!stack.empty()) {
+        auto r = stack.back();
+        r->end(r->started->counts);
+        stack.pop_back(); }
+    auto json = openFile(reportFile, false);
+    if (json) {
+        writeJson(*json);
+        delete json; }
+    auto summary = openFile(reportFile + ".txt", false);
+    if (summary) {
+        writeSummary(*summary);
+        delete summary; }
+    root = nullptr;
+}
+
+void PassProfile::writeJson(std::ostream &out) {
+    if (!root) return;
+    root->toJson()->serialize(out);
+    out << std::endl;
+}
+
+void PassProfile::writeSummary(std::ostream &out) {
+    if (!root) return;
+    // aggregate all the runs of each pass, wherever it ran
+    struct Totals {
+        cstring name;
+        unsigned calls = 0;
+        uint64_t self = 0, wall = 0, cpu = 0, nodes = 0, visits = 0, alloc = 0;
+        uint64_t clones = 0, clonesAvoided = 0;
+    };
+    std::map<cstring, Totals> byName;
+    std::vector<const Record *> todo;
+    for (auto &c : root->children) todo.push_back(c.second);
+    while (!todo.empty()) {
+        auto r = todo.back();
+        todo.pop_back();
+        auto &sum = byName[r->name];
+        sum.name = r->name;
+        sum.calls += r->calls;
+        sum.self += r->self();
+        sum.wall += r->wall;
+        sum.cpu += r->cpu;
+        sum.nodes += r->nodes;
+        sum.visits += r->visits;
+        sum.alloc += r->alloc;
+        sum.clones += r->clones;
+        sum.clonesAvoided += r->clonesAvoided;
+        for (auto &c : r->children) todo.push_back(c.second); }
+    std::vector<const Totals *> sorted;
+    for (auto &s : byName) sorted.push_back(&s.second);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Totals *a, const Totals *b) { return a->self > b->self; });
+
+    out << std::fixed << std::setprecision(1);
+    out << "Total " << root->wall / 1e6 << " ms wall, " << root->cpu / 1e6 << " ms cpu, "
+        << n4(root->alloc) << "B allocated, " << n4(root->nodes) << " IR nodes created"
+        << std::endl;
+    // all columns but the first include the nested passes
+    out << "   self ms   total ms     cpu ms   calls  nodes visits  alloc clones avoided  pass"
+        << std::endl;
+    for (auto t : sorted)
+        out << std::setw(10) << t->self / 1e6 << ' ' << std::setw(10) << t->wall / 1e6 << ' '
+            << std::setw(10) << t->cpu / 1e6 << ' ' << std::setw(7) << t->calls << "   "
+            << n4(t->nodes) << "   " << n4(t->visits) << "  " << n4(t->alloc) << "B   "
+            << n4(t->clones) << "    " << n4(t->clonesAvoided) << "  " << t->name << std::endl;
+}
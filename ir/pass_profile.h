@@ -0,0 +1,62 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_PASS_PROFILE_H_
+#define _IR_PASS_PROFILE_H_
+
+#include <iostream>
+#include "lib/cstring.h"
+
+/**
+ * Aggregates the cost of every pass over a compilation: wall and cpu time,
+ * bytes allocated and change in heap size, IR nodes created, nodes visited
+ * and nodes cloned by Modifiers and Transforms.  Passes are nested the same
+ * way as the PassManagers that run them, and repeated runs of a pass under
+ * the same parent are added up.
+ *
+ * Every Visitor::profile_t reports to the profiler when it is enabled.  Only
+ * passes started from the thread that enabled it are recorded; work done by
+ * the thread pool counts towards the pass that started it, except for the
+ * visitor counts, which are only counted on the profiling thread.
+ */
+class PassProfile {
+ public:
+    /// Running totals kept by the visitors of each thread.
+    struct Counts {
+        uint64_t visits = 0;            ///< nodes visited (not revisited)
+        uint64_t clones = 0;            ///< nodes cloned by Modifiers and Transforms
+        uint64_t clonesDiscarded = 0;   ///< clones dropped because nothing changed
+        uint64_t clonesAvoided = 0;     ///< nodes a lazyClone Transform never cloned
+    };
+
+    /// Start recording; a JSON report is written to @p filename and a text
+    /// summary sorted by time to @p filename.txt when the compiler exits.
+    static void enable(cstring filename);
+    static bool enabled();
+
+    /// Called by Visitor::profile_t when pass @p name starts and ends;
+    /// @p counts are the running totals of this thread.
+    static void start(cstring name, const Counts &counts);
+    static void finish(const Counts &counts);
+
+    /// Ends the passes still running and writes the report, once; called
+    /// at exit, from whichever thread exits.  Profiling stops after this.
+    static void writeReport();
+    static void writeJson(std::ostream &out);
+    static void writeSummary(std::ostream &out);
+};
+
+#endif /* _IR_PASS_PROFILE_H_ */
@@ -15,7 +15,11 @@ limitations under the License.
 */
 
 #include <utility>
+#ifdef MULTITHREAD
+#include <mutex>
+#endif  // MULTITHREAD
 #include "ir.h"
+#include "lib/arena.h"
 
 namespace IR {
 
@@ -48,41 +52,60 @@ const cstring IR::Annotation::synchronousAnnotation = "synchronous";
 const cstring IR::Annotation::noSideEffectsAnnotation = "noSideEffects";
 const cstring IR::Annotation::matchAnnotation = "match";
 
-int Type_Declaration::nextId = 0;
-int Type_InfInt::nextId = 0;
+IdCounter Type_Declaration::nextId(0);
+IdCounter Type_InfInt::nextId(0);
+
+void Type_Declaration::reserveId(int id) {
+    if (id >= nextId)
+        nextId = id + 1;
+}
+
+void Type_InfInt::reserveId(int id) {
+    if (id >= nextId)
+        nextId = id + 1;
+}
 
 Annotations* Annotations::empty = new Annotations(Vector<Annotation>());
 
 const Type_Bits* Type_Bits::get(int width, bool isSigned) {
     // map (width, signed) to type
     using bit_type_key = std::pair<int, bool>;
+#ifdef MULTITHREAD
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+#endif  // MULTITHREAD
     static std::map<bit_type_key, const IR::Type_Bits*> *type_map = nullptr;
     if (type_map == nullptr)
         type_map = new std::map<bit_type_key, const IR::Type_Bits*>();
     auto &result = (*type_map)[std::make_pair(width, isSigned)];
-    if (!result)
-        result = new Type_Bits(width, isSigned);
+    if (!result) {
+        // the cache outlives any compilation, so not in its arena
+        Arena::Suspend heap;
+        result = new Type_Bits(width, isSigned); }
     return result;
 }
 
 const Type::Unknown *Type::Unknown::get() {
     static const Type::Unknown *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type::Unknown());
+    if (!singleton) {
+        Arena::Suspend heap;
+        singleton = new Type::Unknown(); }
     return singleton;
 }
 
 const Type::Boolean *Type::Boolean::get() {
     static const Type::Boolean *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type::Boolean());
+    if (!singleton) {
+        Arena::Suspend heap;
+        singleton = new Type::Boolean(); }
     return singleton;
 }
 
 const Type_String *Type_String::get() {
     static const Type_String *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type_String());
+    if (!singleton) {
+        Arena::Suspend heap;
+        singleton = new Type_String(); }
     return singleton;
 }
 
@@ -104,29 +127,33 @@ const Type::Varbits *Type::Varbits::get() {
 
 const Type_Dontcare *Type_Dontcare::get() {
     static const Type_Dontcare *singleton;
-    if (!singleton)
-        singleton = (new Type_Dontcare());
+    if (!singleton) {
+        Arena::Suspend heap;
+        singleton = new Type_Dontcare(); }
     return singleton;
 }
 
 const Type_State *Type_State::get() {
     static const Type_State *singleton;
-    if (!singleton)
-        singleton = (new Type_State());
+    if (!singleton) {
+        Arena::Suspend heap;
+        singleton = new Type_State(); }
     return singleton;
 }
 
 const Type_Void *Type_Void::get() {
     static const Type_Void *singleton;
-    if (!singleton)
-        singleton = (new Type_Void());
+    if (!singleton) {
+        Arena::Suspend heap;
+        singleton = new Type_Void(); }
     return singleton;
 }
 
 const Type_MatchKind *Type_MatchKind::get() {
     static const Type_MatchKind *singleton;
-    if (!singleton)
-        singleton = (new Type_MatchKind());
+    if (!singleton) {
+        Arena::Suspend heap;
+        singleton = new Type_MatchKind(); }
     return singleton;
 }
 
@@ -18,14 +18,16 @@ limitations under the License.
 
 #include "ir.h"
 #include "dbprint.h"
+#include "lib/arena.h"
 #include "lib/gmputil.h"
 #include "lib/bitops.h"
 
 #define SINGLETON_TYPE(NAME)                                    \
 const IR::Type_##NAME *IR::Type_##NAME::get() {                 \
     static const Type_##NAME *singleton;                        \
-    if (!singleton)                                             \
-        singleton = (new Type_##NAME(Util::SourceInfo()));      \
+    if (!singleton) {                                           \
+        Arena::Suspend heap;                                    \
+        singleton = (new Type_##NAME(Util::SourceInfo())); }    \
     return singleton;                                           \
 }
 SINGLETON_TYPE(Block)
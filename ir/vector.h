@@ -18,11 +18,13 @@ limitations under the License.
 #define _IR_VECTOR_H_
 
 #include "dbprint.h"
+#include "lib/arena.h"
 #include "lib/enumerator.h"
 #include "lib/null.h"
 #include "lib/safe_vector.h"
 
 class JSONLoader;
+class BinaryLoader;
 
 namespace IR {
 
@@ -46,13 +48,15 @@ class VectorBase : public Node {
     VectorBase &operator=(VectorBase &&) = default;
  protected:
     explicit VectorBase(JSONLoader &json) : Node(json) {}
+    explicit VectorBase(BinaryLoader &bin) : Node(bin) {}
 };
 
 // This class should only be used in the IR.
 // User-level code should use regular std::vector
 template<class T>
 class Vector : public VectorBase {
-    safe_vector<const T *>   vec;
+    // allocated from the arena, like the nodes
+    safe_vector<const T *, ArenaAllocator<const T *>>   vec;
 
  public:
     typedef const T* value_type;
@@ -60,6 +64,7 @@ class Vector : public VectorBase {
     Vector(const Vector &) = default;
     Vector(Vector &&) = default;
     explicit Vector(JSONLoader &json);
+    explicit Vector(BinaryLoader &bin);
     Vector &operator=(const Vector &) = default;
     Vector &operator=(Vector &&) = default;
     explicit Vector(const T *a) {
@@ -68,8 +73,9 @@ class Vector : public VectorBase {
         vec.insert(vec.end(), a.begin(), a.end()); }
     Vector(const std::initializer_list<const T *> &a) : vec(a) {}
     static Vector<T>* fromJSON(JSONLoader &json);
-    typedef typename safe_vector<const T *>::iterator        iterator;
-    typedef typename safe_vector<const T *>::const_iterator  const_iterator;
+    static Vector<T>* fromBinary(BinaryLoader &bin);
+    typedef typename decltype(vec)::iterator        iterator;
+    typedef typename decltype(vec)::const_iterator  const_iterator;
     iterator begin() { return vec.begin(); }
     const_iterator begin() const { return vec.begin(); }
     VectorBase::iterator VectorBase_begin() const override {
@@ -185,8 +191,9 @@ class Vector : public VectorBase {
     virtual void parallel_visit_children(Visitor &v);
     virtual void parallel_visit_children(Visitor &v) const;
     void toJSON(JSONGenerator &json) const override;
+    void toBinary(BinaryWriter &bin) const override;
     Util::Enumerator<const T*>* getEnumerator() const {
-        return Util::Enumerator<const T*>::createEnumerator(vec); }
+        return Util::Enumerator<const T*>::createEnumerator(vec.begin(), vec.end()); }
     template <typename S>
     Util::Enumerator<const S*>* only() const {
         std::function<bool(const T*)> filter = [](const T* d) { return d->template is<S>(); };
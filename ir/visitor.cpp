@@ -16,7 +16,19 @@ limitations under the License.
 
 #include <time.h>
 #include "ir.h"
+#include "node_kinds.h"
 #include "lib/log.h"
+#include "lib/thread_pool.h"
+#include "pass_profile.h"
+
+#ifdef MULTITHREAD
+#define MTONLY(...)     __VA_ARGS__
+#else
+#define MTONLY(...)
+#endif  // MULTITHREAD
+
+/// nodes visited and cloned by this thread, for PassProfile
+static __thread PassProfile::Counts counts;
 
 /** @class Visitor::ChangeTracker
  *  @brief Assists visitors in traversing the IR.
@@ -31,27 +43,49 @@ class Visitor::ChangeTracker {
         bool            visit_in_progress;
         bool            visitOnce;
         const IR::Node  *result;
+        MTONLY(std::thread::id owner;)  // thread currently visiting the node
+        visit_info_t(bool in_progress, bool visitOnce, const IR::Node *result)
+        : visit_in_progress(in_progress), visitOnce(visitOnce), result(result) {}
     };
-    typedef std::unordered_map<const IR::Node *, visit_info_t>  visited_t;
-    visited_t           visited;
+    NodeIdTable<visit_info_t>   visited;
+#ifdef MULTITHREAD
+    // The branches of a threaded parallel_visit share the tracker; a branch that
+    // reaches a (DAG) node already being visited by another thread waits on
+    // 'finished' for that visit to complete.
+    mutable std::mutex          lock;
+    std::condition_variable     finished;
+#endif  // MULTITHREAD
 
  public:
     /** Begin tracking @n during a visiting pass.  Use `finish(@n)` to mark @n as
      * visited once the pass completes.
+     *
+     * @return false if @n was concurrently being visited by another thread, and that
+     * visit has now finished so @n should not be visited again (`result(@n)` has the
+     * result).  Always true if the visitor is running on only one thread.
      */
-    void start(const IR::Node *n, bool defaultVisitOnce) {
+    bool start(const IR::Node *n, bool defaultVisitOnce) {
+        MTONLY(std::unique_lock<std::mutex> acquire(lock);)
         // Initialization
-        visited_t::iterator visited_it;
+        visit_info_t *visit_info;
         bool inserted;
         bool visit_in_progress = true;
-        std::tie(visited_it, inserted) =
-            visited.emplace(n, visit_info_t{visit_in_progress, defaultVisitOnce, n});
+        std::tie(visit_info, inserted) =
+            visited.emplace(n, visit_in_progress, defaultVisitOnce, n);
 
         // Sanity check for IR loops
         bool already_present = !inserted;
-        visit_info_t *visit_info = &(visited_it->second);
+#ifdef MULTITHREAD
+        if (inserted) {
+            visit_info->owner = std::this_thread::get_id();
+        } else if (visit_info->visit_in_progress &&
+                   visit_info->owner != std::this_thread::get_id()) {
+            finished.wait(acquire, [visit_info] { return !visit_info->visit_in_progress; });
+            return !visit_info->visitOnce; }
+#endif  // MULTITHREAD
         if (already_present && visit_info->visit_in_progress)
             BUG("IR loop detected ");
+        return true;
     }
 
     /** Mark the process of visiting @orig as finished, with @final being the
@@ -68,41 +102,42 @@ class Visitor::ChangeTracker {
      * previously been invoked.
      */
     bool finish(const IR::Node *orig, const IR::Node *final) {
-        auto it = visited.find(orig);
-        if (it == visited.end())
+        MTONLY(std::lock_guard<std::mutex> acquire(lock);)
+        visit_info_t *orig_visit_info = visited.find(orig);
+        if (!orig_visit_info)
             BUG("visitor state tracker corrupted");
 
-        visit_info_t *orig_visit_info = &(it->second);
         orig_visit_info->visit_in_progress = false;
+        bool changed = true;
         if (!final) {
             orig_visit_info->result = final;
-            return true;
         } else if (final != orig && *final != *orig) {
             orig_visit_info->result = final;
-            visited.emplace(final, visit_info_t{false, orig_visit_info->visitOnce, final});
-            return true;
+            visited.emplace(final, false, orig_visit_info->visitOnce, final);
         } else {
             // FIXME -- not safe if the visitor resurrects the node (which it shouldn't)
             // if (final && final->id == IR::Node::currentId - 1)
             //     --IR::Node::currentId;
-            return false; } }
+            changed = false; }
+        MTONLY(finished.notify_all();)
+        return changed; }
 
     /** Return a pointer to the visitOnce flag for node @n so that it can be changed
      */
     bool *refVisitOnce(const IR::Node *n) {
-        if (!visited.count(n))
+        MTONLY(std::lock_guard<std::mutex> acquire(lock);)
+        auto info = visited.find(n);
+        if (!info)
             BUG("visitor state tracker corrupted");
-        return &visited.at(n).visitOnce;
+        return &info->visitOnce;
     }
 
     /** Forget nodes that have already been visited, allowing them to be visited
      * again. */
     void revisit_visited() {
-        for (auto it = visited.begin(); it != visited.end();) {
-            if (!it->second.visit_in_progress)
-                it = visited.erase(it);
-            else
-                ++it; } }
+        MTONLY(std::lock_guard<std::mutex> acquire(lock);)
+        visited.erase_if([](const IR::Node *, const visit_info_t &info) {
+            return !info.visit_in_progress; }); }
 
     /** Determine whether @n has been visited and the visitor has finished
      *  and we don't want to visit @n again the next time we see it.
@@ -112,8 +147,9 @@ class Visitor::ChangeTracker {
      * @return true if @n has been visited and the visitor is finished and visitOnce is true
      */
     bool done(const IR::Node *n) const {
-        auto it = visited.find(n);
-        return it != visited.end() && !it->second.visit_in_progress && it->second.visitOnce;
+        MTONLY(std::lock_guard<std::mutex> acquire(lock);)
+        auto info = visited.find(n);
+        return info && !info->visit_in_progress && info->visitOnce;
     }
 
     /** Produce the result of visiting @n.
@@ -123,9 +159,9 @@ class Visitor::ChangeTracker {
      * if `start(@n)` has not been invoked.
      */
     const IR::Node *result(const IR::Node *n) const {
-        if (!visited.count(n))
-            return n;
-        return visited.at(n).result;
+        MTONLY(std::lock_guard<std::mutex> acquire(lock);)
+        auto info = visited.find(n);
+        return info ? info->result : n;
     }
 };
 
@@ -150,6 +186,14 @@ Visitor::profile_t Transform::init_apply(const IR::Node *root) {
 void Visitor::end_apply() {}
 void Visitor::end_apply(const IR::Node*) {}
 
+void Visitor::setKinds(const NodeKinds &input) {
+    input_kinds = new NodeKinds(input);
+}
+void Visitor::setKinds(const NodeKinds &input, const NodeKinds &output) {
+    input_kinds = new NodeKinds(input);
+    output_kinds = new NodeKinds(output);
+}
+
 static indent_t profile_indent;
 static uint64_t first_start = 0;
 Visitor::profile_t::profile_t(Visitor &v_) : v(v_) {
@@ -165,6 +209,8 @@ Visitor::profile_t::profile_t(Visitor &v_) : v(v_) {
     LOG3(profile_indent << v.name() << " statrting at +" <<
          (first_start ? start - first_start : (first_start = start, 0UL))/1000000.0 << " msec");
     ++profile_indent;
+    if (PassProfile::enabled())
+        PassProfile::start(v.name(), counts);
 }
 Visitor::profile_t::profile_t(profile_t &&a) : v(a.v), start(a.start) {
     a.start = 0;
@@ -181,6 +227,8 @@ Visitor::profile_t::~profile_t() {
         ts.tv_sec = ts.tv_nsec = 0;
 #endif
         uint64_t end = ts.tv_sec*1000000000UL + ts.tv_nsec + 1;
+        if (PassProfile::enabled())
+            PassProfile::finish(counts);
         LOG1(profile_indent << v.name() << ' ' << (end-start)/1000.0 << " usec"); }
 }
 
@@ -224,24 +272,69 @@ struct PushContext {
 namespace {
 class ForwardChildren : public Visitor {
     const ChangeTracker &visited;
+    bool checkOnly;
+    const IR::Node *apply_visitor(const IR::Node *n, const char * = 0) {
+        if (n && visited.done(n)) {
+            auto rv = visited.result(n);
+            if (rv != n) changed = true;
+            if (!checkOnly) return rv; }
+        return n; }
+ public:
+    bool changed = false;   // some child has already been changed
+    // with @checkOnly, the children are left alone, so this can visit a const node
+    explicit ForwardChildren(const ChangeTracker &v, bool checkOnly = false)
+    : visited(v), checkOnly(checkOnly) {}
+};
+
+/// Gives the children of a clone the results of visiting the children of the original
+/// node, as they were collected by a lazyClone Transform.
+class ReplayChildren : public Visitor {
+    const std::vector<std::pair<const IR::Node *, const IR::Node *>> &results;
+    size_t next = 0;
     const IR::Node *apply_visitor(const IR::Node *n, const char * = 0) {
-        if (visited.done(n))
-            return visited.result(n);
+        for (size_t i = next; i < results.size(); ++i) {
+            if (results[i].first == n) {
+                next = i + 1;
+                return results[i].second; } }
         return n; }
  public:
-    explicit ForwardChildren(const ChangeTracker &v) : visited(v) {}
+    explicit ReplayChildren(decltype(results) r) : results(r) {}
 };
 }    // namespace
 
+/** The node being visited by a Transform with lazyClone.  The original is passed to
+ *  preorder and postorder until something needs to change it; the results of visiting
+ *  its children are collected in 'changed' and only then given to a clone.
+ */
+struct Transform::LazyFrame {
+    Transform           &self;
+    LazyFrame           *parent;
+    Visitor::Context    &ctxt;
+    IR::Node            *copy = nullptr;
+    bool                collect = false;    // visiting the children of the original
+    std::vector<std::pair<const IR::Node *, const IR::Node *>> changed;
+
+    LazyFrame(Transform &self, Visitor::Context &ctxt)
+    : self(self), parent(self.lazy_frame), ctxt(ctxt) { self.lazy_frame = this; }
+    ~LazyFrame() { self.lazy_frame = parent; }
+    IR::Node *current() const { return copy ? copy : const_cast<IR::Node *>(ctxt.original); }
+    IR::Node *materialize() {
+        if (!copy) {
+            ctxt.node = copy = ctxt.original->clone();
+            ++counts.clones; }
+        return copy; }
+};
+
 const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
     if (ctxt) ctxt->child_name = name;
     if (n) {
         PushContext local(ctxt, n);
-        if (visited->done(n)) {
+        if (visited->done(n) || !visited->start(n, visitDagOnce)) {
             n->apply_visitor_revisit(*this, visited->result(n));
             n = visited->result(n);
         } else {
-            visited->start(n, visitDagOnce);
+            ++counts.visits;
+            ++counts.clones;
             IR::Node *copy = n->clone();
             local.current.node = copy;
             if (!dontForwardChildrenBeforePreorder) {
@@ -253,7 +346,9 @@ const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
                 visitCurrentOnce = visited->refVisitOnce(n);
                 copy->apply_visitor_postorder(*this); }
             if (visited->finish(n, copy))
-                (n = copy)->validate(); } }
+                (n = copy)->validate();
+            else
+                ++counts.clonesDiscarded; } }
     if (ctxt)
         ctxt->child_index++;
     else
@@ -265,21 +360,34 @@ const IR::Node *Inspector::apply_visitor(const IR::Node *n, const char *name) {
     if (ctxt) ctxt->child_name = name;
     if (n && !join_flows(n)) {
         PushContext local(ctxt, n);
-        auto vp = visited->emplace(n, info_t{false, visitDagOnce});
-        if (!vp.second && !vp.first->second.done)
+        MTONLY(std::unique_lock<std::mutex> acquire(visited->lock);)
+        auto vp = visited->emplace(n, false, visitDagOnce);
+        info_t *info = vp.first;
+#ifdef MULTITHREAD
+        // another branch of a threaded parallel_visit is visiting this node
+        if (!vp.second && !info->done && info->owner != std::this_thread::get_id())
+            visited->finished.wait(acquire, [info] { return info->done; });
+#endif  // MULTITHREAD
+        if (!vp.second && !info->done)
             BUG("IR loop detected");
-        if (!vp.second && vp.first->second.visitOnce) {
+        if (!vp.second && info->visitOnce) {
+            MTONLY(acquire.unlock();)
             n->apply_visitor_revisit(*this);
         } else {
-            vp.first->second.done = false;
-            visitCurrentOnce = &vp.first->second.visitOnce;
+            info->done = false;
+            MTONLY(info->owner = std::this_thread::get_id();
+                   acquire.unlock();)
+            visitCurrentOnce = &info->visitOnce;
+            ++counts.visits;
             if (n->apply_visitor_preorder(*this)) {
                 n->visit_children(*this);
-                visitCurrentOnce = &vp.first->second.visitOnce;
+                visitCurrentOnce = &info->visitOnce;
                 n->apply_visitor_postorder(*this); }
-            if (vp.first != visited->find(n))
+            MTONLY(acquire.lock();)
+            if (info != visited->find(n))
                 BUG("visitor state tracker corrupted");
-            vp.first->second.done = true; } }
+            info->done = true;
+            MTONLY(visited->finished.notify_all();) } }
     if (ctxt)
         ctxt->child_index++;
     else
@@ -289,13 +397,21 @@ const IR::Node *Inspector::apply_visitor(const IR::Node *n, const char *name) {
 
 const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
     if (ctxt) ctxt->child_name = name;
-    if (n) {
+    if (n && lazyClone && !threadedFlows) {
+        auto parent = lazy_frame;
+        auto rv = lazy_apply_visitor(n);
+        if (!parent || !parent->collect)
+            n = rv;
+        else if (rv != n)
+            parent->changed.emplace_back(n, rv);
+    } else if (n) {
         PushContext local(ctxt, n);
-        if (visited->done(n)) {
+        if (visited->done(n) || !visited->start(n, visitDagOnce)) {
             n->apply_visitor_revisit(*this, visited->result(n));
             n = visited->result(n);
         } else {
-            visited->start(n, visitDagOnce);
+            ++counts.visits;
+            ++counts.clones;
             auto copy = n->clone();
             local.current.node = copy;
             if (!dontForwardChildrenBeforePreorder) {
@@ -320,6 +436,7 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
                 } else {
                     extra_clone = true;
                     visited->start(preorder_result, *visitCurrentOnce);
+                    ++counts.clones;
                     local.current.node = copy = preorder_result->clone(); } }
             if (!prune_flag) {
                 copy->visit_children(*this);
@@ -330,7 +447,9 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
                 && final_result != preorder_result
                 && *final_result == *preorder_result)
                 final_result = preorder_result;
-            if (visited->finish(n, final_result) && (n = final_result))
+            if (!visited->finish(n, final_result))
+                ++counts.clonesDiscarded;
+            else if ((n = final_result))
                 final_result->validate();
             if (extra_clone)
                 visited->finish(preorder_result, final_result); } }
@@ -341,12 +460,80 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
     return n;
 }
 
+/* Same as the traversal above, except that the node is only cloned when preorder or
+ * postorder call mutate, or when some child changes.  While the node is not cloned its
+ * children are visited const, with their results collected by apply_visitor. */
+const IR::Node *Transform::lazy_apply_visitor(const IR::Node *n) {
+    PushContext local(ctxt, n);
+    if (visited->done(n) || !visited->start(n, visitDagOnce)) {
+        n->apply_visitor_revisit(*this, visited->result(n));
+        return visited->result(n); }
+    ++counts.visits;
+    LazyFrame frame(*this, local.current);
+    if (!dontForwardChildrenBeforePreorder) {
+        ForwardChildren check(*visited, true);
+        n->visit_children(check);
+        if (check.changed) {
+            ForwardChildren forward_children(*visited);
+            frame.materialize()->visit_children(forward_children); } }
+    bool save_prune_flag = prune_flag;
+    prune_flag = false;
+    visitCurrentOnce = visited->refVisitOnce(n);
+    bool extra_clone = false;
+    const IR::Node *preorder_result = frame.current()->apply_visitor_preorder(*this);
+    if (preorder_result == n)
+        preorder_result = frame.current();
+    const IR::Node *final_result = preorder_result;
+    if (preorder_result != frame.current()) {
+        if (!preorder_result) {
+            prune_flag = true;
+        } else if (visited->done(preorder_result)) {
+            final_result = visited->result(preorder_result);
+            prune_flag = true;
+        } else {
+            extra_clone = true;
+            visited->start(preorder_result, *visitCurrentOnce);
+            ++counts.clones;
+            local.current.node = frame.copy = preorder_result->clone(); } }
+    if (!prune_flag) {
+        if (frame.copy) {
+            frame.copy->visit_children(*this);
+        } else {
+            frame.collect = true;
+            n->visit_children(*this);
+            frame.collect = false;
+            if (!frame.changed.empty()) {
+                ReplayChildren replay(frame.changed);
+                frame.materialize()->visit_children(replay); } }
+        visitCurrentOnce = visited->refVisitOnce(n);
+        final_result = frame.current()->apply_visitor_postorder(*this);
+        if (final_result == n)
+            final_result = frame.current(); }
+    prune_flag = save_prune_flag;
+    if (frame.copy && final_result == frame.copy && preorder_result
+        && final_result != preorder_result && *final_result == *preorder_result)
+        final_result = preorder_result;
+    const IR::Node *rv = n;
+    if (!frame.copy)
+        ++counts.clonesAvoided;
+    if (!visited->finish(n, final_result)) {
+        if (frame.copy) ++counts.clonesDiscarded;
+    } else if ((rv = final_result)) {
+        final_result->validate(); }
+    if (extra_clone)
+        visited->finish(preorder_result, final_result);
+    return rv;
+}
+
+IR::Node *Transform::mutable_node(const IR::Node *n) {
+    if (lazy_frame && n == lazy_frame->ctxt.original)
+        return lazy_frame->materialize();
+    return const_cast<IR::Node *>(n);
+}
+
 void Inspector::revisit_visited() {
-    for (auto it = visited->begin(); it != visited->end();) {
-        if (it->second.done)
-            it = visited->erase(it);
-        else
-            ++it; }
+    MTONLY(std::lock_guard<std::mutex> acquire(visited->lock);)
+    visited->erase_if([](const IR::Node *, const info_t &info) { return info.done; });
 }
 void Modifier::revisit_visited() {
     visited->revisit_visited();
@@ -442,6 +629,51 @@ bool Transform::check_clone(const Visitor *v) {
     return true;
 }
 
+bool Visitor::threaded_parallel_visit(size_t branches) const {
+#ifdef MULTITHREAD
+    return threadedFlows && !joinFlows && branches > 1 && Util::ThreadPool::get().enabled();
+#else
+    (void)branches;
+    return false;
+#endif  // MULTITHREAD
+}
+
+void Visitor::threaded_parallel_apply(std::vector<const IR::Node *> &nodes) {
+    BUG_CHECK(ctxt, "threaded_parallel_apply called outside of a visit");
+    // Same flow state as the sequential parallel_visit_children: this visitor takes
+    // the first branch, and each other branch runs in a clone of the incoming state,
+    // merged back in order.
+    Visitor *start = nodes.size() > 1 ? &flow_clone() : this;
+    if (start == this) {
+        // flow_clone doesn't actually clone, so the branches can't run concurrently
+        for (auto &n : nodes) n = apply_visitor(n);
+        return; }
+    std::vector<Visitor *> clones = { this };
+    for (size_t i = 1; i < nodes.size(); ++i)
+        clones.push_back(i + 1 < nodes.size() ? &start->flow_clone() : start);
+    // Each branch gets its own copy of the current context frame, so they don't race
+    // updating child_index/child_name, and see the same indexes as a sequential visit.
+    const Context *parent = ctxt;
+    std::vector<Context> frames(nodes.size(), *parent);
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        frames[i].child_index += i;
+        clones[i]->ctxt = &frames[i];
+        Visitor *v = clones[i];
+        const IR::Node **n = &nodes[i];
+        tasks.emplace_back([v, n]() { *n = v->apply_visitor(*n); }); }
+    try {
+        Util::ThreadPool::get().run(tasks);
+    } catch (...) {
+        ctxt = parent;
+        throw; }
+    ctxt = parent;
+    ctxt->child_index += nodes.size();
+    for (size_t i = 1; i < clones.size(); ++i) {
+        clones[i]->ctxt = ctxt;
+        flow_merge(*clones[i]); }
+}
+
 ControlFlowVisitor &ControlFlowVisitor::flow_clone() {
     auto *rv = clone();
     assert(rv->check_clone(this));
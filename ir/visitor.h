@@ -19,10 +19,19 @@ limitations under the License.
 
 #include <stdexcept>
 #include <unordered_map>
+#include <vector>
+#ifdef MULTITHREAD
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif  // MULTITHREAD
 #include "lib/cstring.h"
 #include "ir/ir.h"
+#include "ir/node_id_table.h"
 #include "lib/exceptions.h"
 
+class NodeKinds;
+
 class Visitor {
  public:
     struct Context {
@@ -125,6 +134,15 @@ class Visitor {
             ctxt->child_index = cidx; }
         v.parallel_visit_children(*this); }
 
+    /** True if a parallel_visit over @branches children should run them concurrently
+     * with `threaded_parallel_apply` -- see `threadedFlows`. */
+    bool threaded_parallel_visit(size_t branches) const;
+    /** Visit each of @nodes with its own flow_clone of this visitor, running the visits
+     * concurrently on the Util::ThreadPool, and replace each entry with the result.
+     * The clones are then flow_merged back into this visitor in order, exactly as a
+     * sequential parallel_visit would. */
+    void threaded_parallel_apply(std::vector<const IR::Node *> &nodes);
+
     virtual Visitor *clone() const { BUG("need %s::clone method",  name()); return nullptr; }
 
     // Functions for IR visit_children to call for ControlFlowVisitors.
@@ -150,6 +168,15 @@ class Visitor {
     void setName(const char* name) { internalName = name; }
     void print_context() const;  // for debugging; can be called from debugger
 
+    /// The kinds of nodes this pass acts on, or nullptr if it does not say.
+    /// A pass that declares them promises to change a top-level declaration
+    /// only if the declaration holds nodes of these kinds, in a way that only
+    /// depends on that declaration, and to have no other effect that later
+    /// passes rely on.  PassManager skips it when it has nothing to do.
+    virtual const NodeKinds *inputKinds() const { return input_kinds; }
+    /// The kinds of nodes this pass creates, or nullptr if it does not say.
+    virtual const NodeKinds *outputKinds() const { return output_kinds; }
+
     // Context access/search functions.  getContext returns the context
     // that refers to the immediate parent of the node currently being
     // visited.  findContext searches up the context for a (grand)parent
@@ -189,7 +216,8 @@ class Visitor {
 
     /// @return the current node - i.e., the node that was passed to preorder()
     /// or postorder(). For Modifiers and Transforms, this is a clone of the
-    /// node returned by getOriginal().
+    /// node returned by getOriginal(), unless the Transform uses lazyClone and
+    /// has not changed it.
     const IR::Node* getCurrentNode() const { return ctxt->node; }
     template <class T>
     const T* getCurrentNode() const {
@@ -206,6 +234,19 @@ class Visitor {
     // flow_merge the visitor from all the parents before visiting the node and its
     // children.  This only works for Inspector (not Modifier/Transform) currently.
     bool joinFlows = false;
+    // if threadedFlows is 'true', parallel_visit will visit its children concurrently
+    // on the Util::ThreadPool (only when built with MULTITHREAD and the pool has more
+    // than one thread).  The flow_clones then run at the same time, so any state they
+    // share other than through flow_merge must be threadsafe.  Ignored with joinFlows.
+    // No pass sets it yet: DoLocalCopyPropagation updates the TableInfo it shares
+    // between flows in an order dependent way, and ComputeWriteSet does not use
+    // parallel_visit.
+    bool threadedFlows = false;
+    // set with setKinds, see inputKinds and outputKinds
+    const NodeKinds *input_kinds = nullptr;
+    const NodeKinds *output_kinds = nullptr;
+    void setKinds(const NodeKinds &input);
+    void setKinds(const NodeKinds &input, const NodeKinds &output);
 
     virtual void init_join_flows(const IR::Node *) { assert(0); }
 
@@ -269,8 +310,20 @@ class Modifier : public virtual Visitor {
 };
 
 class Inspector : public virtual Visitor {
-    struct info_t { bool done, visitOnce; };
-    typedef std::unordered_map<const IR::Node *, info_t>       visited_t;
+    struct info_t {
+        bool done, visitOnce;
+#ifdef MULTITHREAD
+        std::thread::id owner;  // thread currently visiting the node
+#endif  // MULTITHREAD
+        info_t(bool done, bool visitOnce) : done(done), visitOnce(visitOnce) {}
+    };
+    struct visited_t : public NodeIdTable<info_t> {
+#ifdef MULTITHREAD
+        // shared by all the branches of a threaded parallel_visit
+        std::mutex              lock;
+        std::condition_variable finished;
+#endif  // MULTITHREAD
+    };
     visited_t   *visited = nullptr;
     bool check_clone(const Visitor *) override;
  public:
@@ -291,8 +344,12 @@ class Inspector : public virtual Visitor {
 class Transform : public virtual Visitor {
     ChangeTracker       *visited = nullptr;
     bool prune_flag = false;
+    struct LazyFrame;   // state of the node being visited with lazyClone
+    LazyFrame           *lazy_frame = nullptr;
     void visitor_const_error() override;
     bool check_clone(const Visitor *) override;
+    const IR::Node *lazy_apply_visitor(const IR::Node *n);
+    IR::Node *mutable_node(const IR::Node *n);
 
  public:
     profile_t init_apply(const IR::Node *root) override;
@@ -311,6 +368,16 @@ class Transform : public virtual Visitor {
     void prune() { prune_flag = true; }
 
  protected:
+    // if lazyClone is 'true' (set in the constructor of the derived Transform), nodes
+    // are only cloned when they change: preorder and postorder may be passed the
+    // original node, so they must not modify it except through 'mutate'.  A node whose
+    // children change is cloned before its postorder.  Ignored with threadedFlows.
+    bool lazyClone = false;
+
+    /// @return the node being visited, @p n, in a form that may be modified, which is
+    /// a clone of it the first time this is called on an original with lazyClone.
+    template<class T> T *mutate(T *n) { return static_cast<T *>(mutable_node(n)); }
+
     const IR::Node *transform_child(const IR::Node *child) {
         auto *rv = apply_visitor(child);
         prune_flag = true;
@@ -0,0 +1,172 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "config.h"
+#include "arena.h"
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#if HAVE_LIBGC
+#include <gc/gc.h>
+#endif  /* HAVE_LIBGC */
+
+#ifdef MULTITHREAD
+#define MTONLY(...)     __VA_ARGS__
+#else
+#define MTONLY(...)
+#endif  // MULTITHREAD
+
+Arena *Arena::currentArena = nullptr;
+
+namespace {
+
+/// The chunks of all the arenas, by their end address, so that freeing memory
+/// can tell arena memory from heap memory.
+struct Registry {
+    std::map<const char *, std::pair<const char *, Arena *>>  chunks;
+    std::atomic<size_t>                                         count;
+    MTONLY(std::mutex lock;)
+    Registry() : count(0) {}
+};
+
+Registry &registry() {
+    static Registry *reg = new Registry;  // never destroyed, as arenas may outlive it
+    return *reg;
+}
+
+__thread int suspended;
+
+}  // namespace
+
+void *Arena::allocate(size_t size, size_t align) {
+    MTONLY(std::lock_guard<std::mutex> guard(lock);)
+    return bump(size, align);
+}
+
+void *Arena::bump(size_t size, size_t align) {
+    used += size;
+    auto p = (reinterpret_cast<uintptr_t>(next) + align - 1) & ~uintptr_t(align - 1);
+    if (next && p + size <= reinterpret_cast<uintptr_t>(limit)) {
+        next = reinterpret_cast<char *>(p + size);
+        return reinterpret_cast<char *>(p); }
+    return newChunk(size, align);
+}
+
+void *Arena::newChunk(size_t size, size_t align) {
+    bool large = size > chunkSize / 4;
+    size_t bytes = large ? size + align : chunkSize;
+    char *begin = static_cast<char *>(::operator new(bytes));
+    chunks.push_back(Chunk{ begin, begin + bytes });
+    auto &reg = registry();
+    {
+        MTONLY(std::lock_guard<std::mutex> guard(reg.lock);)
+        reg.chunks.emplace(begin + bytes, std::make_pair(begin, this));
+        ++reg.count;
+    }
+    auto p = (reinterpret_cast<uintptr_t>(begin) + align - 1) & ~uintptr_t(align - 1);
+    if (!large) {
+        // large blocks get a chunk of their own, and allocation goes on in the current one
+        next = reinterpret_cast<char *>(p + size);
+        limit = begin + bytes; }
+    return reinterpret_cast<char *>(p);
+}
+
+void Arena::addFinalizer(void (*fn)(void *), void *obj) {
+    MTONLY(std::lock_guard<std::mutex> guard(lock);)
+    finalizers.emplace_back(fn, obj);
+}
+
+void Arena::removeFinalizer(void *obj) {
+    MTONLY(std::lock_guard<std::mutex> guard(lock);)
+    // almost always the last one, destroyed by its failing constructor
+    for (auto it = finalizers.rbegin(); it != finalizers.rend(); ++it) {
+        if (it->second == obj) {
+            finalizers.erase(std::next(it).base());
+            return; } }
+}
+
+void Arena::releaseChunks() {
+    auto &reg = registry();
+    {
+        MTONLY(std::lock_guard<std::mutex> guard(reg.lock);)
+        for (auto &c : chunks)
+            reg.chunks.erase(c.end);
+        reg.count -= chunks.size();
+    }
+#if !HAVE_LIBGC
+    for (auto &c : chunks)
+        ::operator delete(c.begin);
+#endif  /* !HAVE_LIBGC */
+    // With the garbage collector, the chunks are collected when nothing points
+    // into them anymore, so IR that escaped the arena stays valid.
+    chunks.clear();
+}
+
+void Arena::reset() {
+    std::vector<std::pair<void (*)(void *), void *>> fin;
+    {
+        MTONLY(std::lock_guard<std::mutex> guard(lock);)
+        fin.swap(finalizers);
+    }
+    // the finalizers may still free arena memory, so run them before it goes away
+    for (auto it = fin.rbegin(); it != fin.rend(); ++it)
+        it->first(it->second);
+    MTONLY(std::lock_guard<std::mutex> guard(lock);)
+    releaseChunks();
+    next = limit = nullptr;
+    used = 0;
+}
+
+size_t Arena::bytesReserved() const {
+    size_t rv = 0;
+    for (auto &c : chunks)
+        rv += c.end - c.begin;
+    return rv;
+}
+
+Arena *Arena::owner(const void *p) {
+    auto &reg = registry();
+    if (!p || reg.count == 0) return nullptr;
+    MTONLY(std::lock_guard<std::mutex> guard(reg.lock);)
+    auto it = reg.chunks.upper_bound(static_cast<const char *>(p));
+    if (it != reg.chunks.end() && it->second.first <= p)
+        return it->second.second;
+    return nullptr;
+}
+
+void *Arena::alloc(size_t size, void (*finalizer)(void *)) {
+    Arena *arena = currentArena;
+    if (!arena || suspended)
+        return ::operator new(size);
+    MTONLY(std::lock_guard<std::mutex> guard(arena->lock);)
+    void *rv = arena->bump(size, alignof(std::max_align_t));
+    if (finalizer) arena->finalizers.emplace_back(finalizer, rv);
+    return rv;
+}
+
+void Arena::dealloc(void *p) {
+    if (!p || owner(p)) return;
+#if HAVE_LIBGC
+    // inside a chunk released by a reset, which the collector frees as a whole
+    if (GC_base(p) != p) return;
+#endif  /* HAVE_LIBGC */
+    ::operator delete(p);
+}
+
+bool Arena::isSuspended() { return suspended > 0; }
+
+Arena::Suspend::Suspend() { ++suspended; }
+Arena::Suspend::~Suspend() { --suspended; }
@@ -0,0 +1,129 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef P4C_LIB_ARENA_H_
+#define P4C_LIB_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+#ifdef MULTITHREAD
+#include <mutex>
+#endif  // MULTITHREAD
+
+/**
+ * A region allocator: memory is handed out by bumping a pointer through large
+ * chunks, and is only given back all at once, by reset() or when the Arena is
+ * destroyed.  Objects that own other memory can register a finalizer to be
+ * run by reset().
+ *
+ * The chunks come from the global operator new, so when the compiler uses the
+ * garbage collector they are scanned like any other object.  Then reset() only
+ * drops them, and the collector frees each chunk once nothing points into it.
+ * Without the collector, reset() frees the chunks, and any pointer into them
+ * is left dangling.
+ *
+ * The IR allocates its nodes (and the storage of IR::Vector) from the current
+ * arena, which is the one of the active BaseCompileContext if it has one; see
+ * BaseCompileContext::useArena.
+ */
+class Arena {
+    struct Chunk {
+        char    *begin, *end;
+    };
+    std::vector<Chunk>                                  chunks;
+    std::vector<std::pair<void (*)(void *), void *>>    finalizers;
+    char        *next = nullptr, *limit = nullptr;
+    size_t      chunkSize;
+    size_t      used = 0;
+#ifdef MULTITHREAD
+    std::mutex  lock;
+#endif  // MULTITHREAD
+
+    static Arena *currentArena;
+
+    void *bump(size_t size, size_t align);
+    void *newChunk(size_t size, size_t align);
+    void releaseChunks();
+
+ public:
+    enum { DEFAULT_CHUNK_SIZE = 1 << 20 };
+    explicit Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE) : chunkSize(chunkSize) {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { reset(); }
+
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+    /// Arranges for @p fn(@p obj) to be called by reset(), in the reverse of
+    /// the order the finalizers were added.
+    void addFinalizer(void (*fn)(void *), void *obj);
+    /// Removes the finalizer for @p obj, when it is destroyed before the reset.
+    void removeFinalizer(void *obj);
+    /// Runs the finalizers and frees all the memory allocated from this arena,
+    /// or leaves it to the garbage collector when there is one.
+    void reset();
+
+    /// bytes handed out since the last reset
+    size_t bytesAllocated() const { return used; }
+    /// bytes in the chunks held by the arena
+    size_t bytesReserved() const;
+
+    /// @return the arena @p p was allocated from, or null if it did not come
+    /// from any live arena.
+    static Arena *owner(const void *p);
+
+    /// The arena the IR is allocated from, or null to use the heap.
+    static Arena *current() { return currentArena; }
+    static void setCurrent(Arena *a) { currentArena = a; }
+
+    /// Allocates from the current arena, unless there is none or it is suspended
+    /// on this thread, and from the heap otherwise.  @p finalizer, if given, is
+    /// added for the new object when it comes from the arena.
+    static void *alloc(size_t size, void (*finalizer)(void *) = nullptr);
+    /// Frees memory from alloc(): heap memory is deleted, arena memory is left
+    /// for the reset of its arena.
+    static void dealloc(void *p);
+
+    /// True while a Suspend exists on this thread.
+    static bool isSuspended();
+
+    /// While one of these exists, alloc() on this thread uses the heap.  For
+    /// objects that must outlive the compilation, like the caches of types.
+    class Suspend {
+     public:
+        Suspend();
+        ~Suspend();
+        Suspend(const Suspend &) = delete;
+        Suspend &operator=(const Suspend &) = delete;
+    };
+};
+
+/// A standard allocator that uses Arena::alloc and Arena::dealloc.
+template<class T> struct ArenaAllocator {
+    typedef T value_type;
+    ArenaAllocator() = default;
+    template<class U> ArenaAllocator(const ArenaAllocator<U> &) {}
+    T *allocate(size_t n) { return static_cast<T *>(Arena::alloc(n * sizeof(T))); }
+    void deallocate(T *p, size_t) { Arena::dealloc(p); }
+    template<class U> struct rebind { typedef ArenaAllocator<U> other; };
+};
+template<class T, class U>
+bool operator==(const ArenaAllocator<T> &, const ArenaAllocator<U> &) { return true; }
+template<class T, class U>
+bool operator!=(const ArenaAllocator<T> &, const ArenaAllocator<U> &) { return false; }
+
+#endif /* P4C_LIB_ARENA_H_ */
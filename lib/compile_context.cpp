@@ -23,12 +23,26 @@ ICompileContext::~ICompileContext() { }
 /* static */ void CompileContextStack::push(ICompileContext* context) {
     BUG_CHECK(context != nullptr, "Pushing a null CompileContext");
     getStack().push_back(context);
+    updateArena();
 }
 
 /* static */ void CompileContextStack::pop() {
     BUG_CHECK(!getStack().empty(),
               "Popping an empty CompileContextStack");
     getStack().pop_back();
+    updateArena();
+}
+
+/* static */ void CompileContextStack::updateArena() {
+    auto& stack = getStack();
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        auto* context = dynamic_cast<BaseCompileContext*>(*it);
+        if (context && context->arena()) {
+            Arena::setCurrent(context->arena());
+            return;
+        }
+    }
+    Arena::setCurrent(nullptr);
 }
 
 /* static */ void CompileContextStack::reportNoContext() {
@@ -64,6 +78,11 @@ BaseCompileContext::BaseCompileContext() { }
 BaseCompileContext::BaseCompileContext(const BaseCompileContext& other)
     : errorReporterInstance(other.errorReporterInstance) { }
 
+BaseCompileContext::~BaseCompileContext() {
+    if (arenaInstance && Arena::current() == arenaInstance.get())
+        Arena::setCurrent(nullptr);
+}
+
 /* static */ BaseCompileContext& BaseCompileContext::get() {
     return CompileContextStack::top<BaseCompileContext>();
 }
@@ -80,6 +99,12 @@ DiagnosticAction BaseCompileContext::getDefaultErrorDiagnosticAction() {
     return DiagnosticAction::Error;
 }
 
+void BaseCompileContext::useArena(size_t chunkSize) {
+    BUG_CHECK(!arenaInstance, "CompileContext already has an arena");
+    arenaInstance.reset(new Arena(chunkSize));
+    CompileContextStack::updateArena();
+}
+
 DiagnosticAction
 BaseCompileContext::getDiagnosticAction(cstring /* diagnostic */,
                                         DiagnosticAction defaultAction) {
@@ -17,9 +17,11 @@ limitations under the License.
 #ifndef P4C_LIB_COMPILE_CONTEXT_H_
 #define P4C_LIB_COMPILE_CONTEXT_H_
 
+#include <memory>
 #include <typeinfo>
 #include <vector>
 
+#include "lib/arena.h"
 #include "lib/cstring.h"
 #include "lib/error_reporter.h"
 
@@ -51,6 +53,7 @@ struct CompileContextStack final {
 
  private:
     friend struct AutoCompileContext;
+    friend class BaseCompileContext;
 
     using StackType = std::vector<ICompileContext*>;
 
@@ -62,6 +65,8 @@ struct CompileContextStack final {
     static void push(ICompileContext* context);
     static void pop();
     static StackType& getStack();
+    /// Makes the arena of the topmost context that has one the current one.
+    static void updateArena();
 
     CompileContextStack() = delete;
 };
@@ -82,6 +87,7 @@ class BaseCompileContext : public ICompileContext {
  protected:
     BaseCompileContext();
     BaseCompileContext(const BaseCompileContext& other);
+    ~BaseCompileContext();
 
  public:
     /// @return the current compilation context, which must inherit from
@@ -102,9 +108,23 @@ class BaseCompileContext : public ICompileContext {
     virtual DiagnosticAction
     getDiagnosticAction(cstring diagnostic, DiagnosticAction defaultAction);
 
+    /// Allocates the IR made while this context is active from an arena, which
+    /// is freed all at once when the context is destroyed.  For processes that
+    /// run many compilations.  Without the garbage collector, nothing made in
+    /// the context may be used after it is gone: it is freed memory.  With the
+    /// collector, the arena chunks that are still referenced stay alive.  The
+    /// contexts pushed on top of this one allocate from the same arena, unless
+    /// they have their own.  A copy of the context does not share the arena.
+    void useArena(size_t chunkSize = Arena::DEFAULT_CHUNK_SIZE);
+
+    /// @return the arena of this context, or null if it allocates from the heap.
+    Arena* arena() const { return arenaInstance.get(); }
+
  private:
     /// Error and warning tracking facilities for this compilation context.
     ErrorReporter errorReporterInstance;
+
+    std::unique_ptr<Arena> arenaInstance;
 };
 
 #endif /* P4C_LIB_COMPILE_CONTEXT_H_ */
@@ -18,6 +18,9 @@ limitations under the License.
 
 #include <string>
 #include <unordered_set>
+#ifdef MULTITHREAD
+#include <mutex>
+#endif  // MULTITHREAD
 
 #include "hash.h"
 
@@ -40,6 +43,7 @@ inline table_entry_flags operator |(table_entry_flags l, table_entry_flags r) {
 // cache entry, ordered by string length
 class table_entry {
     std::size_t m_length = 0;
+    std::size_t m_hash = 0;
     table_entry_flags m_flags = table_entry_flags::none;
 
     union {
@@ -49,8 +53,9 @@ class table_entry {
 
  public:
     // entry ctor, makes copy of passed string
-    table_entry(const char *string, std::size_t length, table_entry_flags flags)
-        : m_length(length) {
+    table_entry(const char *string, std::size_t length, std::size_t hash,
+                table_entry_flags flags)
+        : m_length(length), m_hash(hash) {
         if ((flags & table_entry_flags::no_need_copy) == table_entry_flags::no_need_copy) {
             // No need to copy object, it's view of string, string literal or string allocated
             // on heap and wrapped with cstring.
@@ -85,7 +90,8 @@ class table_entry {
     // table_entry moveable only
     table_entry(const table_entry &) = delete;
 
-    table_entry(table_entry &&other) : m_length(other.m_length), m_flags(other.m_flags) {
+    table_entry(table_entry &&other)
+        : m_length(other.m_length), m_hash(other.m_hash), m_flags(other.m_flags) {
         // this object for internal usage only, length will never be accessed
         // if object was moved, so do not zero other.m_length here
 
@@ -111,6 +117,10 @@ class table_entry {
         return m_length;
     }
 
+    std::size_t hash() const {
+        return m_hash;
+    }
+
     const char *string() const {
         if (is_inplace()) {
             return m_inplace_string;
@@ -120,7 +130,8 @@ class table_entry {
     }
 
     bool operator ==(const table_entry &other) const {
-        return length() == other.length() && std::memcmp(string(), other.string(), length()) == 0;
+        return hash() == other.hash() && length() == other.length() &&
+               std::memcmp(string(), other.string(), length()) == 0;
     }
 
  private:
@@ -134,31 +145,91 @@ namespace std {
 template<>
 struct hash<table_entry> {
     std::size_t operator()(const table_entry &entry) const {
-        return Util::Hash::murmur(entry.string(), entry.length());
+        // computed once, when the string is looked up
+        return entry.hash();
     }
 };
 }
 
 namespace {
-std::unordered_set<table_entry>& cache() {
-    static std::unordered_set<table_entry> g_cache;
+// The table is split into shards, picked by the top bits of the hash, so that
+// threads interning different strings rarely contend for the same lock.
+constexpr unsigned shard_bits = 6;
+
+struct table_shard {
+#ifdef MULTITHREAD
+    std::mutex lock;
+#endif  // MULTITHREAD
+    std::unordered_set<table_entry> entries;
+};
+
+table_shard *shards() {
+    // never destroyed, as cstrings may still be in use by static destructors
+    static table_shard *g_shards = new table_shard[1U << shard_bits];
 
-    return g_cache;
+    return g_shards;
 }
 
+table_shard &shard_for(std::size_t hash) {
+    return shards()[hash >> (8 * sizeof(std::size_t) - shard_bits)];
+}
+
+#ifdef MULTITHREAD
+// Per-thread cache of recently interned strings, so that looking up a string
+// that is already interned usually needs no lock at all.  Interned strings are
+// never freed, so the cached pointers stay valid.
+struct recent_entry {
+    std::size_t hash;
+    std::size_t length;
+    const char *string;
+};
+
+constexpr unsigned recent_size = 256;
+static __thread recent_entry recent[recent_size];
+
+const char *find_recent(const char *string, std::size_t length, std::size_t hash) {
+    auto &r = recent[hash % recent_size];
+    if (r.string && r.hash == hash && r.length == length &&
+        std::memcmp(r.string, string, length) == 0)
+        return r.string;
+    return nullptr;
+}
+
+const char *remember(const char *string, std::size_t length, std::size_t hash) {
+    recent[hash % recent_size] = { hash, length, string };
+    return string;
+}
+#else
+inline const char *find_recent(const char *, std::size_t, std::size_t) { return nullptr; }
+inline const char *remember(const char *string, std::size_t, std::size_t) { return string; }
+#endif  // MULTITHREAD
+
 const char *save_to_cache(const char *string, std::size_t length, table_entry_flags flags) {
+    auto hash = Util::Hash::murmur(string, length);
+    if ((flags & table_entry_flags::no_need_copy) != table_entry_flags::no_need_copy) {
+        if (auto found = find_recent(string, length, hash))
+            return found;
+    }
+
+    auto &shard = shard_for(hash);
+#ifdef MULTITHREAD
+    std::lock_guard<std::mutex> acquire(shard.lock);
+#endif  // MULTITHREAD
     if ((flags & table_entry_flags::no_need_copy) == table_entry_flags::no_need_copy) {
-        return cache().emplace(string, length, flags).first->string();
+        return remember(shard.entries.emplace(string, length, hash, flags).first->string(),
+                        length, hash);
     }
 
     // temporary table_entry, used for searching only. no need to copy string
-    auto found = cache().find(table_entry(string, length, table_entry_flags::no_need_copy));
+    auto found = shard.entries.find(
+        table_entry(string, length, hash, table_entry_flags::no_need_copy));
 
-    if (found == cache().end()) {
-        return cache().emplace(string, length, flags).first->string();
+    if (found == shard.entries.end()) {
+        return remember(shard.entries.emplace(string, length, hash, flags).first->string(),
+                        length, hash);
     }
 
-    return found->string();
+    return remember(found->string(), length, hash);
 }
 
 }  // namespace
@@ -178,9 +249,15 @@ void cstring::construct_from_literal(const char *string, std::size_t length) {
 
 size_t cstring::cache_size(size_t &count) {
     size_t rv = 0;
-    count = cache().size();
-    for (auto &s : cache())
-        rv += sizeof(s) + s.length();
+    count = 0;
+    for (unsigned i = 0; i < (1U << shard_bits); ++i) {
+        auto &shard = shards()[i];
+#ifdef MULTITHREAD
+        std::lock_guard<std::mutex> acquire(shard.lock);
+#endif  // MULTITHREAD
+        count += shard.entries.size();
+        for (auto &s : shard.entries)
+            rv += sizeof(s) + s.length(); }
     return rv;
 }
 
@@ -45,13 +45,13 @@ limitations under the License.
  *   - Because cstring deals with immutable strings, any modification requires
  *     that the complete string be copied.
  *   - Interning has an initial cost: converting a const char*, a
- *     std::string, or a std::stringstream to a cstring requires copying it.
- *     Currently, this happens every time you perform the conversion, whether
- *     the string is already interned or not, unless the source is an
- *     std::string.
+ *     std::string, or a std::stringstream to a cstring requires hashing it
+ *     and looking it up, and copying it if it isn't interned yet.
  *   - Interned strings can never be freed, so they'll stick around for the
  *     lifetime of the program.
- *   - The string interning cstring performs is currently not threadsafe, so you
+ *   - The string interning cstring performs is only threadsafe when built with
+ *     MULTITHREAD (where the table is sharded, with a lock per shard, and
+ *     each thread caches the strings it interned recently), so otherwise you
  *     can't safely use cstrings off the main thread.
  *
  * Given these tradeoffs, the general rule of thumb to follow is that you should
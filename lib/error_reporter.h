@@ -17,6 +17,9 @@ limitations under the License.
 #ifndef P4C_LIB_ERROR_REPORTER_H_
 #define P4C_LIB_ERROR_REPORTER_H_
 
+#ifdef MULTITHREAD
+#include <mutex>
+#endif  // MULTITHREAD
 #include "error_helper.h"
 #include "error_catalog.h"
 #include "exceptions.h"
@@ -41,6 +44,14 @@ class ErrorReporter final {
     /// Track errors or warnings that have already been issued for a particular source location
     std::set<std::pair<int, const Util::SourceInfo>> errorTracker;
 
+#ifdef MULTITHREAD
+    /// Diagnostics may be reported concurrently by passes running on several
+    /// threads; this serializes the bookkeeping and the output.
+    static std::recursive_mutex &lock() {
+        static std::recursive_mutex theLock;
+        return theLock; }
+#endif  // MULTITHREAD
+
     /// Output the message and flush the stream
     void emit_message(cstring message) {
         *outputstream << message;
@@ -52,6 +63,9 @@ class ErrorReporter final {
     /// If the error has been reported, return true. Otherwise, insert add the error to the
     /// list of seen errors, and return false.
     bool error_reported(int err, const Util::SourceInfo source) {
+#ifdef MULTITHREAD
+        std::lock_guard<std::recursive_mutex> guard(lock());
+#endif  // MULTITHREAD
         auto p = errorTracker.emplace(err, source);
         return !p.second;  // if insertion took place, then we have not seen the error.
     }
@@ -135,6 +149,9 @@ class ErrorReporter final {
     void diagnose(DiagnosticAction action, const char* diagnosticName,
                   const char* format, T... args) {
         if (action == DiagnosticAction::Ignore) return;
+#ifdef MULTITHREAD
+        std::lock_guard<std::recursive_mutex> guard(lock());
+#endif  // MULTITHREAD
 
         std::string prefix;
         if (action == DiagnosticAction::Warn) {
@@ -0,0 +1,438 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef LIB_FLAT_ORDERED_MAP_H_
+#define LIB_FLAT_ORDERED_MAP_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Map ordered by order of element insertion, with the same interface as
+ * ordered_map, but kept in a single array of entries rather than in a list
+ * and a tree.  Lookups go through an open-addressing hash index on the keys,
+ * which is only built once the map holds more than a few entries; smaller
+ * maps are searched linearly.  Keys must be hashable with std::hash, and
+ * keys equivalent under COMP must compare equal with ==.
+ *
+ * Differences with ordered_map:
+ *  - inserting may move the entries, and so invalidates all iterators and
+ *    references, as for a std::vector;
+ *  - erasing leaves a tombstone in place of the entry, so the other
+ *    iterators remain valid; the space is reclaimed on a later insertion;
+ *  - lower_bound, upper_bound and inserting before an existing entry take
+ *    linear time.
+ */
+template <class K, class V, class COMP = std::less<K>,
+          class ALLOC = std::allocator<std::pair<const K, V>>>
+class flat_ordered_map {
+ public:
+    typedef K                           key_type;
+    typedef V                           mapped_type;
+    typedef std::pair<const K, V>       value_type;
+    typedef COMP                        key_compare;
+    typedef ALLOC                       allocator_type;
+    typedef value_type                  &reference;
+    typedef const value_type            &const_reference;
+    typedef size_t                      size_type;
+
+    class value_compare : std::binary_function<value_type, value_type, bool> {
+        friend class flat_ordered_map;
+     protected:
+        COMP    comp;
+        explicit value_compare(COMP c) : comp(c) {}
+     public:
+        bool operator()(const value_type &a, const value_type &b) const {
+            return comp(a.first, b.first); }
+    };
+
+ private:
+    struct slot {
+        bool    live;
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+        value_type &value() { return *reinterpret_cast<value_type *>(&storage); }
+        const value_type &value() const {
+            return *reinterpret_cast<const value_type *>(&storage); }
+    };
+    using slot_alloc = typename ALLOC::template rebind<slot>::other;
+
+    // Maps with at most this many entries have no hash index.
+    static constexpr size_t small_size = 8;
+    // Cells of the hash index: empty, erased, or 'first_slot' + slot number.
+    enum : uint32_t { empty_cell = 0, erased_cell = 1, first_slot = 2 };
+
+    slot_alloc          alloc;
+    // 'used' entries, live or erased, followed by an extra slot which is
+    // always marked live, so that iterators stop on it.
+    slot                *slots = nullptr;
+    size_t              used = 0;
+    size_t              capacity = 0;
+    size_t              live = 0;
+    // The index holds at most 'capacity' cells that are not empty, in a table
+    // of at least twice that size.
+    std::vector<uint32_t> index;
+    slot                *retired = nullptr;
+    size_t              retired_used = 0, retired_capacity = 0;
+
+    static size_t hash(const K &k) {
+        // std::hash of pointers and cstrings is the address, whose low bits are
+        // always the same
+        uint64_t h = std::hash<K>()(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h; }
+
+    size_t find_slot(const K &k) const {
+        if (index.empty()) {
+            for (size_t i = 0; i < used; ++i)
+                if (slots[i].live && slots[i].value().first == k)
+                    return i;
+            return used; }
+        size_t mask = index.size() - 1;
+        for (size_t h = hash(k) & mask; index[h] != empty_cell; h = (h + 1) & mask) {
+            if (index[h] != erased_cell && slots[index[h] - first_slot].value().first == k)
+                return index[h] - first_slot; }
+        return used; }
+    void index_slot(size_t i) {
+        size_t mask = index.size() - 1;
+        size_t h = hash(slots[i].value().first) & mask;
+        while (index[h] != empty_cell)
+            h = (h + 1) & mask;
+        index[h] = i + first_slot; }
+    void unindex_slot(size_t i) {
+        if (index.empty()) return;
+        size_t mask = index.size() - 1;
+        for (size_t h = hash(slots[i].value().first) & mask;; h = (h + 1) & mask) {
+            if (index[h] == i + first_slot) {
+                index[h] = erased_cell;
+                return; } } }
+    void rebuild_index() {
+        index.clear();
+        if (live <= small_size) return;
+        size_t size = 16;
+        while (size < 2 * capacity) size *= 2;
+        index.resize(size, empty_cell);
+        for (size_t i = 0; i < used; ++i)
+            if (slots[i].live) index_slot(i); }
+
+    /// Moves the live entries to a new array of 'cap' entries, leaving an
+    /// unconstructed slot where entry 'gap' was (or at the end if 'gap' is
+    /// 'used').  Returns the position of that slot.  The old array is only
+    /// released by 'retire', as the new entry may be made from one of the
+    /// moved keys.
+    size_t relocate(size_t cap, size_t gap) {
+        slot *to = alloc.allocate(cap + 1);
+        size_t n = 0, hole = 0;
+        for (size_t i = 0; i <= used; ++i) {
+            if (i == gap) hole = n++;
+            if (i == used) break;
+            if (!slots[i].live) continue;
+            ::new(&to[n].storage) value_type(std::move(slots[i].value()));
+            to[n++].live = true; }
+        to[hole].live = false;
+        retired = slots;
+        retired_used = used;
+        retired_capacity = capacity;
+        slots = to;
+        capacity = cap;
+        used = n;
+        slots[used].live = true;
+        rebuild_index();
+        return hole; }
+    void retire() {
+        if (!retired) return;
+        for (size_t i = 0; i < retired_used; ++i)
+            if (retired[i].live) retired[i].value().~value_type();
+        alloc.deallocate(retired, retired_capacity + 1);
+        retired = nullptr; }
+
+    /// Returns an unconstructed slot placed before entry 'pos'; the caller
+    /// constructs the entry in it, and then calls 'added'.
+    size_t make_room(size_t pos) {
+        if (pos == used && used < capacity) {
+            slots[used].live = false;
+            slots[used + 1].live = true;
+            return used++; }
+        size_t cap = capacity;
+        if (cap == 0)
+            cap = 4;
+        else if (live >= capacity / 2)
+            cap *= 2;
+        return relocate(cap, pos); }
+    void added(size_t i) {
+        retire();
+        slots[i].live = true;
+        ++live;
+        if (!index.empty())
+            index_slot(i);
+        else if (live > small_size)
+            rebuild_index(); }
+
+    void copy_from(const flat_ordered_map &a) {
+        if (a.live == 0) return;
+        slots = alloc.allocate(a.live + 1);
+        capacity = a.live;
+        for (auto &el : a) {
+            ::new(&slots[used].storage) value_type(el);
+            slots[used++].live = true; }
+        slots[used].live = true;
+        live = used;
+        rebuild_index(); }
+    void release() {
+        for (size_t i = 0; i < used; ++i)
+            if (slots[i].live) slots[i].value().~value_type();
+        if (slots) alloc.deallocate(slots, capacity + 1);
+        slots = nullptr;
+        used = capacity = live = 0;
+        index.clear(); }
+
+    template<class VT, class SLOT>
+    class iter : public std::iterator<std::bidirectional_iterator_tag, VT> {
+        friend class flat_ordered_map;
+        SLOT    *p;
+     public:
+        iter() : p(nullptr) {}
+        explicit iter(SLOT *p) : p(p) {}
+        // iterator converts to const_iterator
+        template<class VT2, class SLOT2>
+        iter(const iter<VT2, SLOT2> &a) : p(a.p) {}  // NOLINT(runtime/explicit)
+        VT &operator*() const { return p->value(); }
+        VT *operator->() const { return &p->value(); }
+        iter &operator++() { do ++p; while (!p->live); return *this; }
+        iter &operator--() { do --p; while (!p->live); return *this; }
+        iter operator++(int) { auto rv = *this; ++*this; return rv; }
+        iter operator--(int) { auto rv = *this; --*this; return rv; }
+        bool operator==(const iter &a) const { return p == a.p; }
+        bool operator!=(const iter &a) const { return p != a.p; }
+        template<class, class> friend class iter;
+    };
+
+ public:
+    typedef iter<value_type, slot>                      iterator;
+    typedef iter<const value_type, const slot>          const_iterator;
+    typedef std::reverse_iterator<iterator>             reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>       const_reverse_iterator;
+
+ private:
+    size_t pos_of(const_iterator it) const { return it.p - slots; }
+    iterator at_slot(size_t i) { return iterator(slots + i); }
+    const_iterator at_slot(size_t i) const { return const_iterator(slots + i); }
+    size_t first_live() const {
+        size_t i = 0;
+        while (i < used && !slots[i].live) ++i;
+        return i; }
+
+ public:
+    flat_ordered_map() {}
+    flat_ordered_map(const flat_ordered_map &a) { copy_from(a); }
+    flat_ordered_map(flat_ordered_map &&a) { *this = std::move(a); }
+    flat_ordered_map &operator=(const flat_ordered_map &a) {
+        if (this != &a) {
+            release();
+            copy_from(a); }
+        return *this; }
+    flat_ordered_map &operator=(flat_ordered_map &&a) {
+        if (this != &a) {
+            release();
+            std::swap(slots, a.slots);
+            std::swap(used, a.used);
+            std::swap(capacity, a.capacity);
+            std::swap(live, a.live);
+            index.swap(a.index); }
+        return *this; }
+    flat_ordered_map(const std::initializer_list<value_type> &il) { insert(il.begin(), il.end()); }
+    ~flat_ordered_map() { release(); }
+
+    iterator                    begin() noexcept { return at_slot(first_live()); }
+    const_iterator              begin() const noexcept { return at_slot(first_live()); }
+    iterator                    end() noexcept { return at_slot(used); }
+    const_iterator              end() const noexcept { return at_slot(used); }
+    reverse_iterator            rbegin() noexcept { return reverse_iterator(end()); }
+    const_reverse_iterator      rbegin() const noexcept { return const_reverse_iterator(end()); }
+    reverse_iterator            rend() noexcept { return reverse_iterator(begin()); }
+    const_reverse_iterator      rend() const noexcept { return const_reverse_iterator(begin()); }
+    const_iterator              cbegin() const noexcept { return begin(); }
+    const_iterator              cend() const noexcept { return end(); }
+    const_reverse_iterator      crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator      crend() const noexcept { return rend(); }
+
+    bool        empty() const noexcept { return live == 0; }
+    size_type   size() const noexcept { return live; }
+    size_type   max_size() const noexcept { return UINT32_MAX - first_slot; }
+    bool operator==(const flat_ordered_map &a) const {
+        return size() == a.size() && std::equal(begin(), end(), a.begin()); }
+    bool operator!=(const flat_ordered_map &a) const { return !(*this == a); }
+    void clear() { release(); }
+
+    iterator        find(const key_type &a) { return at_slot(find_slot(a)); }
+    const_iterator  find(const key_type &a) const { return at_slot(find_slot(a)); }
+    size_type       count(const key_type &a) const { return find_slot(a) != used; }
+    iterator        lower_bound(const key_type &a) { return at_slot(lower_slot(a)); }
+    const_iterator  lower_bound(const key_type &a) const { return at_slot(lower_slot(a)); }
+    iterator        upper_bound(const key_type &a) { return at_slot(upper_slot(a)); }
+    const_iterator  upper_bound(const key_type &a) const { return at_slot(upper_slot(a)); }
+    iterator        upper_bound_pred(const key_type &a) { return at_slot(upper_pred_slot(a)); }
+    const_iterator  upper_bound_pred(const key_type &a) const {
+                        return at_slot(upper_pred_slot(a)); }
+
+ private:
+    /// The entry with the least key satisfying 'pred' if 'least', or with the
+    /// greatest if not; entries are not sorted, so this looks at all of them.
+    template<class PRED> size_t bound(PRED pred, bool least) const {
+        COMP comp;
+        size_t best = used;
+        for (size_t i = 0; i < used; ++i) {
+            if (!slots[i].live || !pred(slots[i].value().first)) continue;
+            if (best == used ||
+                (least ? comp(slots[i].value().first, slots[best].value().first)
+                       : comp(slots[best].value().first, slots[i].value().first)))
+                best = i; }
+        return best; }
+    size_t lower_slot(const K &a) const {
+        return bound([&a](const K &k) { return !COMP()(k, a); }, true); }
+    size_t upper_slot(const K &a) const {
+        return bound([&a](const K &k) { return COMP()(a, k); }, true); }
+    size_t upper_pred_slot(const K &a) const {
+        return bound([&a](const K &k) { return !COMP()(a, k); }, false); }
+
+    template<typename KK, typename... VV>
+    std::pair<iterator, bool> emplace_at(size_t pos, KK &&k, VV &&... v) {
+        size_t i = find_slot(k);
+        if (i != used)
+            return std::make_pair(at_slot(i), false);
+        i = make_room(pos);
+        try {
+            ::new(&slots[i].storage) value_type(std::piecewise_construct_t(),
+                                                std::forward_as_tuple(std::forward<KK>(k)),
+                                                std::forward_as_tuple(std::forward<VV>(v)...));
+        } catch (...) {
+            retire();
+            throw; }
+        added(i);
+        return std::make_pair(at_slot(i), true); }
+
+ public:
+    V& operator[](const K &x) { return emplace(x).first->second; }
+    V& operator[](K &&x) { return emplace(std::move(x)).first->second; }
+    V& at(const K &x) {
+        size_t i = find_slot(x);
+        if (i == used) throw std::out_of_range("flat_ordered_map::at");
+        return slots[i].value().second; }
+    const V& at(const K &x) const {
+        size_t i = find_slot(x);
+        if (i == used) throw std::out_of_range("flat_ordered_map::at");
+        return slots[i].value().second; }
+
+    template<typename KK, typename... VV>
+    std::pair<iterator, bool> emplace(KK &&k, VV &&... v) {
+        return emplace_at(used, std::forward<KK>(k), std::forward<VV>(v)...); }
+    template<typename KK, typename... VV>
+    std::pair<iterator, bool> emplace_hint(const_iterator pos, KK &&k, VV &&... v) {
+        return emplace_at(pos_of(pos), std::forward<KK>(k), std::forward<VV>(v)...); }
+
+    std::pair<iterator, bool> insert(const value_type &v) {
+        return emplace_at(used, v.first, v.second); }
+    std::pair<iterator, bool> insert(const_iterator pos, const value_type &v) {
+        return emplace_at(pos_of(pos), v.first, v.second); }
+    template<class InputIterator> void insert(InputIterator b, InputIterator e) {
+        while (b != e) insert(*b++); }
+    template<class InputIterator>
+    void insert(const_iterator pos, InputIterator b, InputIterator e) {
+        // 'pos' moves when the entries are moved; keep its rank instead
+        size_t rank = 0;
+        for (auto it = begin(); it != pos; ++it) ++rank;
+        while (b != e) {
+            auto it = begin();
+            for (size_t i = 0; i < rank; ++i) ++it;
+            if (insert(it, *b++).second) ++rank; } }
+
+    iterator erase(const_iterator pos) {
+        size_t i = pos_of(pos);
+        unindex_slot(i);
+        slots[i].value().~value_type();
+        slots[i].live = false;
+        --live;
+        return ++at_slot(i); }
+    size_type erase(const K &k) {
+        size_t i = find_slot(k);
+        if (i == used) return 0;
+        erase(at_slot(i));
+        return 1; }
+
+    template<class Compare> void sort(Compare comp) {
+        if (!slots) return;
+        std::vector<size_t> order;
+        for (size_t i = 0; i < used; ++i)
+            if (slots[i].live) order.push_back(i);
+        std::stable_sort(order.begin(), order.end(), [this, &comp](size_t a, size_t b) {
+            return comp(slots[a].value(), slots[b].value()); });
+        slot *to = alloc.allocate(capacity + 1);
+        for (size_t n = 0; n < order.size(); ++n) {
+            ::new(&to[n].storage) value_type(std::move(slots[order[n]].value()));
+            to[n].live = true;
+            slots[order[n]].value().~value_type(); }
+        alloc.deallocate(slots, capacity + 1);
+        slots = to;
+        used = order.size();
+        slots[used].live = true;
+        rebuild_index(); }
+};
+
+namespace GetImpl {
+
+template<class K, class T, class V, class Comp, class Alloc>
+inline V get(const flat_ordered_map<K, V, Comp, Alloc> &m, T key, V def = V()) {
+    auto it = m.find(key);
+    if (it != m.end()) return it->second;
+    return def; }
+
+template<class K, class T, class V, class Comp, class Alloc>
+inline V *getref(flat_ordered_map<K, V, Comp, Alloc> &m, T key) {
+    auto it = m.find(key);
+    if (it != m.end()) return &it->second;
+    return 0; }
+
+template<class K, class T, class V, class Comp, class Alloc>
+inline const V *getref(const flat_ordered_map<K, V, Comp, Alloc> &m, T key) {
+    auto it = m.find(key);
+    if (it != m.end()) return &it->second;
+    return 0; }
+
+template<class K, class T, class V, class Comp, class Alloc>
+inline V get(const flat_ordered_map<K, V, Comp, Alloc> *m, T key, V def = V()) {
+    return m ? get(*m, key, def) : def; }
+
+template<class K, class T, class V, class Comp, class Alloc>
+inline V *getref(flat_ordered_map<K, V, Comp, Alloc> *m, T key) {
+    return m ? getref(*m, key) : 0; }
+
+template<class K, class T, class V, class Comp, class Alloc>
+inline const V *getref(const flat_ordered_map<K, V, Comp, Alloc> *m, T key) {
+    return m ? getref(*m, key) : 0; }
+
+}  // namespace GetImpl
+using namespace GetImpl;  // NOLINT(build/namespaces)
+
+#endif /* LIB_FLAT_ORDERED_MAP_H_ */
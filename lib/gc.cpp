@@ -16,6 +16,9 @@ limitations under the License.
 
 #include "config.h"
 #if HAVE_LIBGC
+#ifdef MULTITHREAD
+#define GC_THREADS
+#endif  // MULTITHREAD
 #include <gc/gc_cpp.h>
 #include <gc/gc_mark.h>
 #endif  /* HAVE_LIBGC */
@@ -142,3 +145,33 @@ size_t gc_mem_inuse(size_t *max) {
     return 0;
 #endif
 }
+
+size_t gc_mem_allocated(size_t *heap) {
+#if HAVE_LIBGC
+    if (heap) *heap = GC_get_heap_size();
+    return GC_get_total_bytes();
+#else
+    if (heap) *heap = 0;
+    return 0;
+#endif
+}
+
+void gc_allow_threads() {
+#if HAVE_LIBGC && defined(MULTITHREAD)
+    GC_allow_register_threads();
+#endif
+}
+
+void gc_register_thread() {
+#if HAVE_LIBGC && defined(MULTITHREAD)
+    struct GC_stack_base sb;
+    GC_get_stack_base(&sb);
+    GC_register_my_thread(&sb);
+#endif
+}
+
+void gc_unregister_thread() {
+#if HAVE_LIBGC && defined(MULTITHREAD)
+    GC_unregister_my_thread();
+#endif
+}
@@ -21,5 +21,12 @@ limitations under the License.
 
 void setup_gc_logging();
 size_t gc_mem_inuse(size_t *max = 0);  // trigger GC, return inuse after
+size_t gc_mem_allocated(size_t *heap = 0);  // total allocated so far, without a GC
+
+// Threads other than the main thread must be registered with the collector so their
+// stacks are scanned.  These do nothing unless built with both libgc and MULTITHREAD.
+void gc_allow_threads();        // call from the main thread before starting any threads
+void gc_register_thread();      // call first thing in each new thread
+void gc_unregister_thread();    // call before the thread exits
 
 #endif /* LIB_GC_H_ */
@@ -0,0 +1,248 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef LIB_HAMT_H_
+#define LIB_HAMT_H_
+
+#include <limits.h>
+#include <stdint.h>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * Persistent map: a hash array mapped trie whose nodes are never changed once
+ * built.  Copying a map takes constant time, as the copy shares all its nodes
+ * with the original; setting an entry copies the nodes on the path to it and
+ * shares the rest.  Two maps copied from each other can be compared by
+ * skipping the subtrees they still share (for_each_unshared).
+ *
+ * Each node has a bitmap of the 32 hash slots that hold an entry, and one of
+ * those that hold a subtree, with the entries and subtrees packed in arrays.
+ * Keys whose hashes are equal end up together in a list at the bottom of the
+ * trie.  Iteration is in the order of the hashes, so is arbitrary.
+ */
+template <class K, class V, class HASH = std::hash<K>, class EQUAL = std::equal_to<K>>
+class hamt {
+ public:
+    typedef K                   key_type;
+    typedef V                   mapped_type;
+    /// The entries are never changed in place, so iteration gives them as const.
+    typedef std::pair<K, V>     value_type;
+    typedef size_t              size_type;
+
+ private:
+    enum { BITS = 5, MASK = (1 << BITS) - 1, HASH_BITS = sizeof(size_t) * CHAR_BIT };
+    struct node {
+        uint32_t                                    datamap = 0, nodemap = 0;
+        std::vector<value_type>                     entries;  // in slot order
+        std::vector<std::shared_ptr<const node>>    children;  // in slot order
+    };
+    typedef std::shared_ptr<const node> node_ptr;
+
+    node_ptr    root;
+    size_t      entries = 0;
+
+    static size_t hash(const K &k) {
+        // std::hash of pointers and cstrings is the address, whose low bits are
+        // always the same
+        uint64_t h = HASH()(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h; }
+    // below the last level the hashes are equal, and the entries are just listed
+    static bool collisions(unsigned shift) { return shift >= HASH_BITS; }
+    static uint32_t slot(size_t h, unsigned shift) { return uint32_t(1) << ((h >> shift) & MASK); }
+    static unsigned index(uint32_t map, uint32_t bit)
+    { return __builtin_popcount(map & (bit - 1)); }
+
+    static const V *lookup(const node *n, unsigned shift, size_t h, const K &k) {
+        for (; n; shift += BITS) {
+            if (collisions(shift)) {
+                for (auto &e : n->entries)
+                    if (EQUAL()(e.first, k)) return &e.second;
+                return nullptr; }
+            uint32_t bit = slot(h, shift);
+            if (n->datamap & bit) {
+                auto &e = n->entries[index(n->datamap, bit)];
+                return EQUAL()(e.first, k) ? &e.second : nullptr; }
+            if (!(n->nodemap & bit)) return nullptr;
+            n = n->children[index(n->nodemap, bit)].get(); }
+        return nullptr; }
+
+    // a subtree holding just the two entries, whose keys differ
+    static node_ptr subtree(value_type &&a, size_t ha, value_type &&b, size_t hb, unsigned shift) {
+        auto n = std::make_shared<node>();
+        if (collisions(shift)) {
+            n->entries.push_back(std::move(a));
+            n->entries.push_back(std::move(b));
+            return n; }
+        uint32_t bita = slot(ha, shift), bitb = slot(hb, shift);
+        if (bita == bitb) {
+            n->nodemap = bita;
+            n->children.push_back(subtree(std::move(a), ha, std::move(b), hb, shift + BITS));
+        } else {
+            n->datamap = bita | bitb;
+            if (bita > bitb) std::swap(a, b);
+            n->entries.push_back(std::move(a));
+            n->entries.push_back(std::move(b)); }
+        return n; }
+
+    static node_ptr insert(const node *n, unsigned shift, size_t h, value_type &&v, bool &added) {
+        auto rv = std::make_shared<node>(*n);
+        if (collisions(shift)) {
+            for (auto &e : rv->entries) {
+                if (EQUAL()(e.first, v.first)) {
+                    e.second = std::move(v.second);
+                    return rv; } }
+            rv->entries.push_back(std::move(v));
+            added = true;
+            return rv; }
+        uint32_t bit = slot(h, shift);
+        if (rv->datamap & bit) {
+            unsigned i = index(rv->datamap, bit);
+            auto &e = rv->entries[i];
+            if (EQUAL()(e.first, v.first)) {
+                e.second = std::move(v.second);
+                return rv; }
+            // the two entries go down to a new subtree
+            value_type old = std::move(e);
+            size_t oldh = hash(old.first);
+            rv->entries.erase(rv->entries.begin() + i);
+            rv->datamap &= ~bit;
+            rv->nodemap |= bit;
+            rv->children.insert(rv->children.begin() + index(rv->nodemap, bit),
+                                subtree(std::move(old), oldh, std::move(v), h, shift + BITS));
+            added = true;
+        } else if (rv->nodemap & bit) {
+            auto &child = rv->children[index(rv->nodemap, bit)];
+            child = insert(child.get(), shift + BITS, h, std::move(v), added);
+        } else {
+            rv->datamap |= bit;
+            rv->entries.insert(rv->entries.begin() + index(rv->datamap, bit), std::move(v));
+            added = true; }
+        return rv; }
+
+    template<class FN> static bool for_each(const node *n, FN &fn) {
+        for (auto &e : n->entries)
+            if (!fn(e)) return false;
+        for (auto &c : n->children)
+            if (!for_each(c.get(), fn)) return false;
+        return true; }
+
+    template<class FN>
+    static bool unshared(const node *a, const node *b, unsigned shift, FN &fn) {
+        if (a == b) return true;
+        auto other = [b, shift, &fn](const value_type &e) {
+            return fn(e, lookup(b, shift, hash(e.first), e.first)); };
+        if (!b || collisions(shift))
+            return for_each(a, other);
+        for (auto &e : a->entries)
+            if (!other(e)) return false;
+        for (uint32_t map = a->nodemap; map; map &= map - 1) {
+            uint32_t bit = map & (~map + 1);
+            auto child = a->children[index(a->nodemap, bit)].get();
+            if (b->nodemap & bit) {
+                if (!unshared(child, b->children[index(b->nodemap, bit)].get(), shift + BITS, fn))
+                    return false;
+            } else if (!for_each(child, other)) {
+                return false; } }
+        return true; }
+
+ public:
+    class const_iterator : public std::iterator<std::forward_iterator_tag, const value_type> {
+        friend class hamt;
+        // the nodes from the root down, with the position in each: first the
+        // entries, then the subtrees
+        std::vector<std::pair<const node *, size_t>> stack;
+
+        explicit const_iterator(const node *root) {
+            if (root) stack.emplace_back(root, 0);
+            settle(); }
+        // moves down to the next entry, if the current position is not one
+        void settle() {
+            while (!stack.empty()) {
+                auto n = stack.back().first;
+                size_t pos = stack.back().second;
+                if (pos < n->entries.size()) return;
+                if (pos - n->entries.size() < n->children.size()) {
+                    ++stack.back().second;
+                    stack.emplace_back(n->children[pos - n->entries.size()].get(), 0);
+                } else {
+                    stack.pop_back(); } } }
+
+     public:
+        const_iterator() = default;
+        const value_type &operator*() const {
+            return stack.back().first->entries[stack.back().second]; }
+        const value_type *operator->() const { return &**this; }
+        const_iterator &operator++() { ++stack.back().second; settle(); return *this; }
+        const_iterator operator++(int) { auto rv = *this; ++*this; return rv; }
+        bool operator==(const const_iterator &i) const { return stack == i.stack; }
+        bool operator!=(const const_iterator &i) const { return stack != i.stack; }
+    };
+    typedef const_iterator iterator;
+
+    hamt() = default;
+    hamt(std::initializer_list<value_type> il) { for (auto &v : il) set(v.first, v.second); }
+
+    size_type size() const { return entries; }
+    bool empty() const { return entries == 0; }
+    void clear() { root.reset(); entries = 0; }
+
+    const_iterator begin() const { return const_iterator(root.get()); }
+    const_iterator end() const { return const_iterator(nullptr); }
+
+    /// @returns the value for @p k, or null if there is none
+    const V *lookup(const K &k) const { return lookup(root.get(), 0, hash(k), k); }
+    size_type count(const K &k) const { return lookup(k) != nullptr; }
+    const V &at(const K &k) const {
+        if (auto v = lookup(k)) return *v;
+        throw std::out_of_range("hamt::at"); }
+
+    /// Sets the value for @p k, adding an entry if there is none.
+    void set(const K &k, V v) {
+        bool added = false;
+        size_t h = hash(k);
+        if (!root) {
+            auto n = std::make_shared<node>();
+            n->datamap = slot(h, 0);
+            n->entries.emplace_back(k, std::move(v));
+            root = n;
+            added = true;
+        } else {
+            root = insert(root.get(), 0, h, value_type(k, std::move(v)), added); }
+        entries += added; }
+
+    /// True if the two maps are copies of each other, with no entry set since.
+    bool same(const hamt &other) const { return root == other.root; }
+
+    /// Calls @p fn(entry, other_value) for the entries of this map, but skips
+    /// the subtrees shared with @p other, which hold the same entries in both
+    /// maps.  other_value points to the value of the key in @p other, or is
+    /// null if @p other has no entry for the key.  Stops as soon as @p fn
+    /// returns false.
+    /// @returns false if @p fn did
+    template<class FN> bool for_each_unshared(const hamt &other, FN fn) const {
+        return !root || unshared(root.get(), other.root.get(), 0, fn); }
+};
+
+#endif /* LIB_HAMT_H_ */
@@ -16,12 +16,198 @@ limitations under the License.
 
 #include <stdexcept>
 #include <sstream>
+#include <limits>
+#include <string.h>
 #include "json.h"
 #include "indent.h"
 #include "lib/gmputil.h"
 
 namespace Util {
 
+JsonWriter::JsonWriter(std::ostream& out)
+    : out(&out), indent(indent_t::getindent(out).level()) {}
+
+void JsonWriter::flush() {
+    if (!out || text.empty()) return;
+    out->write(text.data(), text.size());
+    text.clear();
+}
+
+void JsonWriter::newline() {
+    text += '\n';
+    text.append(indent * indent_t::tabsz, ' ');
+}
+
+/// Called before each value, to write what separates it from the previous one.
+void JsonWriter::separator() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (frames.empty())
+        return;
+    auto &frame = frames.back();
+    if (frame.object)
+        throw std::logic_error("Json object value without a label");
+    if (!frame.first)
+        text += frame.compact ? ", " : ",";
+    if (!frame.compact)
+        newline();
+    frame.first = false;
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separator();
+    frames.push_back({true, false, true});
+    text += '{';
+    ++indent;
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    if (frames.empty() || !frames.back().object || afterKey)
+        throw std::logic_error("Unbalanced json object");
+    frames.pop_back();
+    --indent;
+    newline();
+    text += '}';
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(bool compact) {
+    separator();
+    frames.push_back({false, compact, true});
+    text += '[';
+    if (!compact)
+        ++indent;
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    if (frames.empty() || frames.back().object)
+        throw std::logic_error("Unbalanced json array");
+    auto frame = frames.back();
+    frames.pop_back();
+    if (!frame.compact) {
+        --indent;
+        if (!frame.first)
+            newline();
+    }
+    text += ']';
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(cstring label) {
+    if (label.isNullOrEmpty())
+        throw std::logic_error("Empty label");
+    if (frames.empty() || !frames.back().object || afterKey)
+        throw std::logic_error(cstring("Json label outside of an object ") + label.c_str());
+    auto &frame = frames.back();
+    if (!frame.first)
+        text += ',';
+    frame.first = false;
+    newline();
+    string(label.c_str(), label.size());
+    text += " : ";
+    afterKey = true;
+    return *this;
+}
+
+void JsonWriter::string(const char* s, size_t size) {
+    // like JsonValue, this does not escape anything
+    text += '"';
+    text.append(s, size);
+    text += '"';
+}
+
+void JsonWriter::integer(unsigned long long v, bool negative) {
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (negative)
+        *--p = '-';
+    text.append(p, buf + sizeof(buf) - p);
+}
+
+JsonWriter& JsonWriter::null() {
+    separator();
+    text += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool v) {
+    separator();
+    text += v ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const big_int& v) {
+    if (v >= std::numeric_limits<long long>::min() &&
+        v <= std::numeric_limits<long long>::max())
+        return value(static_cast<long long>(v));
+    separator();
+    std::stringstream str;
+    str << v;
+    text += str.str();
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(cstring s) {
+    if (s.isNull())
+        return null();
+    separator();
+    string(s.c_str(), s.size());
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* s) {
+    if (s == nullptr)
+        return null();
+    separator();
+    string(s, strlen(s));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const std::string& s) {
+    separator();
+    string(s.data(), s.size());
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const IJson* v) {
+    if (v == nullptr)
+        return null();
+    v->serialize(*this);
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter& JsonWriter::splice(const JsonWriter& fragment) {
+    if (!fragment.done() || fragment.text.empty())
+        throw std::logic_error("Incomplete json fragment");
+    separator();
+    // the fragment was written at indentation 0
+    const char *p = fragment.text.data(), *end = p + fragment.text.size();
+    while (auto nl = static_cast<const char*>(memchr(p, '\n', end - p))) {
+        text.append(p, nl - p);
+        newline();
+        p = nl + 1;
+    }
+    text.append(p, end - p);
+    flushIfFull();
+    return *this;
+}
+
+void IJson::serialize(std::ostream& out) const {
+    JsonWriter writer(out);
+    serialize(writer);
+}
+
 cstring IJson::toString() const {
     std::stringstream str;
     serialize(str);
@@ -64,22 +250,22 @@ JsonValue::JsonValue(long long v)
 JsonValue::JsonValue(unsigned long long v)
     : tag(Kind::Number), value(makeValue(v)) { }
 
-void JsonValue::serialize(std::ostream& out) const {
+void JsonValue::serialize(JsonWriter& out) const {
     switch (tag) {
         case Kind::String:
-            out << "\"" << str << "\"";
+            out.value(str.isNull() ? cstring("") : str);
             break;
         case Kind::Number:
-            out << value;
+            out.value(value);
             break;
         case Kind::True:
-            out << "true";
+            out.value(true);
             break;
         case Kind::False:
-            out << "false";
+            out.value(false);
             break;
         case Kind::Null:
-            out << "null";
+            out.null();
             break;
     }
 }
@@ -112,33 +298,16 @@ bool JsonValue::operator==(const JsonValue& other) const {
     }
 }
 
-void JsonArray::serialize(std::ostream& out) const {
+void JsonArray::serialize(JsonWriter& out) const {
     bool isSmall = true;
     for (auto v : *this) {
-        if (!v->is<JsonValue>())
+        if (v == nullptr || !v->is<JsonValue>())
             isSmall = false;
     }
-    out << "[";
-    if (!isSmall)
-        out << IndentCtl::indent;
-    bool first = true;
-    for (auto v : *this) {
-        if (!first) {
-            out << ",";
-            if (isSmall)
-                out << " ";
-        }
-        if (!isSmall)
-            out << IndentCtl::endl;
-        if (v == nullptr)
-            out << "null";
-        else
-            v->serialize(out);
-        first = false;
-    }
-    if (!isSmall)
-        out << IndentCtl::unindent << IndentCtl::endl;
-    out << "]";
+    out.beginArray(isSmall);
+    for (auto v : *this)
+        out.value(v);
+    out.endArray();
 }
 
 bool JsonValue::getBool() const {
@@ -171,21 +340,11 @@ JsonArray* JsonArray::append(IJson* value) {
     return this;
 }
 
-void JsonObject::serialize(std::ostream& out) const {
-    out << "{" << IndentCtl::indent;
-    bool first = true;
-    for (auto &it : *this) {
-        if (!first)
-            out << ",";
-        first = false;
-        out << IndentCtl::endl;
-        out << "\"" << it.first << "\"" << " : ";
-        if (it.second == nullptr)
-            out << "null";
-        else
-            it.second->serialize(out);
-    }
-    out << IndentCtl::unindent << IndentCtl::endl << "}";
+void JsonObject::serialize(JsonWriter& out) const {
+    out.beginObject();
+    for (auto &it : *this)
+        out.key(it.first).value(it.second);
+    out.endObject();
 }
 
 JsonObject* JsonObject::emplace(cstring label, IJson* value) {
@@ -194,7 +353,7 @@ JsonObject* JsonObject::emplace(cstring label, IJson* value) {
     auto j = get(label);
     if (j != nullptr)
         throw std::logic_error(cstring("Duplicate label in json object ") + label.c_str());
-    ordered_map<cstring, IJson*>::emplace(label, value);
+    flat_ordered_map<cstring, IJson*>::emplace(label, value);
     return this;
 }
 
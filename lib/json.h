@@ -19,22 +19,110 @@ limitations under the License.
 
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include <vector>
 #include <type_traits>
 
 #include "gtest/gtest_prod.h"
 #include "lib/gmputil.h"
 #include "lib/cstring.h"
+#include "lib/flat_ordered_map.h"
 #include "lib/ordered_map.h"
 
 namespace Test { class TestJson; }
 
 namespace Util {
 
+class IJson;
+
+/**
+ * Writes JSON text as it is produced, with the same layout as
+ * IJson::serialize, without building JsonObject and JsonArray trees first.
+ * Output is buffered and only handed to the stream in large blocks.
+ *
+ *    writer.beginObject();
+ *    writer.key("name").value(name);
+ *    writer.key("ids").beginArray(true);
+ *    ...
+ *    writer.endArray();
+ *    writer.endObject();
+ *
+ * Parts of the document that are still built as IJson trees can be written
+ * with value(const IJson*).  Unlike JsonObject, duplicate keys are not
+ * detected.
+ */
+class JsonWriter {
+    struct Frame {
+        bool object;
+        bool compact;
+        bool first;
+    };
+
+    std::ostream* out;
+    std::string text;
+    std::vector<Frame> frames;
+    int indent = 0;  // one level for each open object and non-compact array
+    bool afterKey = false;
+
+    void newline();
+    void separator();
+    void integer(unsigned long long v, bool negative);
+    void string(const char* s, size_t size);
+    void flushIfFull() { if (out && text.size() >= 1 << 16) flush(); }
+
+ public:
+    /// Writes to @p out, starting at its current IndentCtl indentation.
+    explicit JsonWriter(std::ostream& out);
+    /// Keeps the text; see JsonFragment.
+    JsonWriter() : out(nullptr) {}
+    JsonWriter(const JsonWriter&) = delete;
+    ~JsonWriter() { flush(); }
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    /// The values of a compact array are written on a single line, as
+    /// IJson does for arrays that only hold JsonValues.
+    JsonWriter& beginArray(bool compact = false);
+    JsonWriter& endArray();
+    JsonWriter& key(cstring label);
+
+    JsonWriter& null();
+    JsonWriter& value(bool v);
+    template<typename T, typename std::enable_if<std::is_integral<T>::value &&
+                                                 std::is_signed<T>::value, int>::type = 0>
+    JsonWriter& value(T v) {
+        separator();
+        if (v < 0)
+            integer(0ULL - static_cast<unsigned long long>(v), true);
+        else
+            integer(v, false);
+        return *this; }
+    template<typename T, typename std::enable_if<std::is_integral<T>::value &&
+                                                 !std::is_signed<T>::value &&
+                                                 !std::is_same<T, bool>::value, int>::type = 0>
+    JsonWriter& value(T v) {
+        separator();
+        integer(v, false);
+        return *this; }
+    JsonWriter& value(const big_int& v);
+    /// A null cstring is written as null.
+    JsonWriter& value(cstring s);
+    JsonWriter& value(const char* s);
+    JsonWriter& value(const std::string& s);
+    JsonWriter& value(const IJson* v);
+    /// Copies the value held by @p fragment, indented to the current level.
+    JsonWriter& splice(const JsonWriter& fragment);
+
+    /// True when the value written so far is complete.
+    bool done() const { return frames.empty() && !afterKey; }
+    void flush();
+};
+
 class IJson {
  public:
     virtual ~IJson() {}
-    virtual void serialize(std::ostream& out) const = 0;
+    void serialize(std::ostream& out) const;
+    virtual void serialize(JsonWriter& out) const = 0;
     cstring toString() const;
     template<typename T> bool is() const { return to<T>() != nullptr; }
     template<typename T> T* to() { return dynamic_cast<T*>(this); }
@@ -67,7 +155,8 @@ class JsonValue final : public IJson {
     JsonValue(cstring s) : tag(Kind::String), str(s) {}               // NOLINT
     JsonValue(const std::string &s) : tag(Kind::String), str(s) {}    // NOLINT
     JsonValue(const char* s) : tag(Kind::String), str(s) {}           // NOLINT
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& out) const override;
 
     bool operator==(const big_int& v) const;
     // is_integral is true for bool
@@ -110,7 +199,8 @@ class JsonValue final : public IJson {
 class JsonArray final : public IJson, public std::vector<IJson*> {
     friend class Test::TestJson;
  public:
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& out) const override;
     JsonArray* clone() const { return new JsonArray(*this); }
     JsonArray* append(IJson* value);
     JsonArray* append(big_int v) { append(new JsonValue(v)); return this; }
@@ -130,12 +220,13 @@ class JsonArray final : public IJson, public std::vector<IJson*> {
     JsonArray(std::vector<IJson*> &data) : std::vector<IJson*>(data) {} // NOLINT
 };
 
-class JsonObject final : public IJson, public ordered_map<cstring, IJson*> {
+class JsonObject final : public IJson, public flat_ordered_map<cstring, IJson*> {
     friend class Test::TestJson;
 
  public:
     JsonObject() = default;
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& out) const override;
     JsonObject* emplace(cstring label, IJson* value);
     JsonObject* emplace_non_null(cstring label, IJson* value);
     JsonObject* emplace(cstring label, big_int v)
@@ -154,6 +245,19 @@ class JsonObject final : public IJson, public ordered_map<cstring, IJson*> {
     IJson* get(cstring label) const { return ::get(*this, label); }
 };
 
+/// A value written ahead of time with a JsonWriter, for the parts of a
+/// document that are complete as soon as they are produced.  It can be
+/// placed in JsonObjects and JsonArrays like any other value, but its
+/// contents cannot be inspected or changed afterwards.
+class JsonFragment final : public IJson {
+    JsonWriter text;
+
+ public:
+    JsonWriter& writer() { return text; }
+    using IJson::serialize;
+    void serialize(JsonWriter& out) const override { out.splice(text); }
+};
+
 }  // namespace Util
 
 #endif  /* _LIB_JSON_H_ */
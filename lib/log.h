@@ -84,6 +84,10 @@ inline bool verbose() { return Detail::verbosity > 0; }
 inline int verbosity() { return Detail::verbosity; }
 void increaseVerbosity();
 
+// Forget the specs and verbosity set so far, for processes that run many
+// compilations with their own options.
+void reset();
+
 }  // namespace Log
 
 #ifndef MAX_LOGGING_LEVEL
@@ -28,7 +28,7 @@ class safe_vector : public std::vector<T, _Alloc> {
     typedef typename std::vector<T, _Alloc>::reference reference;
     typedef typename std::vector<T, _Alloc>::const_reference const_reference;
     typedef typename std::vector<T, _Alloc>::size_type size_type;
-    typedef typename std::vector<T>::const_iterator const_iterator;
+    typedef typename std::vector<T, _Alloc>::const_iterator const_iterator;
     reference operator[](size_type n) { return this->at(n); }
     const_reference operator[](size_type n) const { return this->at(n); }
 };
@@ -0,0 +1,209 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "exceptions.h"
+#include "gc.h"
+
+#ifdef MULTITHREAD
+extern void register_thread();  // in crash.cpp
+#endif  // MULTITHREAD
+
+namespace Util {
+
+namespace {
+
+struct Batch {
+    const std::vector<std::function<void()>>    &tasks;
+    std::vector<std::exception_ptr>             errors;
+    std::atomic<size_t>                         remaining;
+    explicit Batch(const std::vector<std::function<void()>> &t)
+    : tasks(t), errors(t.size()), remaining(t.size()) {}
+};
+
+struct Task {
+    Batch       *batch;
+    size_t      index;
+};
+
+struct WorkQueue {
+    std::mutex          lock;
+    std::deque<Task>    tasks;
+};
+
+/// index of the current thread's WorkQueue in ThreadPool::impl::queues; slot 0 is
+/// shared by all threads that are not pool workers.
+static __thread unsigned worker_index = 0;
+
+}  // namespace
+
+struct ThreadPool::impl {
+    // 'lock' and 'wakeup' are only used to put idle threads to sleep; the queues
+    // themselves are protected by their own locks.
+    std::mutex                  lock;
+    std::condition_variable     wakeup;
+    std::atomic<size_t>         queued{0};
+    bool                        stopping = false;
+    std::vector<WorkQueue *>    queues;
+    std::vector<std::thread>    workers;
+
+    void push(unsigned q, Batch &batch) {
+        {
+            std::lock_guard<std::mutex> guard(queues[q]->lock);
+            for (size_t i = 0; i < batch.tasks.size(); ++i)
+                queues[q]->tasks.push_back(Task{&batch, i});
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            queued += batch.tasks.size();
+        }
+        wakeup.notify_all();
+    }
+
+    /// take the most recently pushed task from queue @q, but only if it belongs to
+    /// @batch (or to any batch, if @batch is null)
+    bool pop(unsigned q, Batch *batch, Task &task) {
+        std::lock_guard<std::mutex> guard(queues[q]->lock);
+        auto &dq = queues[q]->tasks;
+        if (dq.empty() || (batch && dq.back().batch != batch)) return false;
+        task = dq.back();
+        dq.pop_back();
+        --queued;
+        return true;
+    }
+
+    /// take the oldest task from some queue other than the current thread's own
+    bool steal(Task &task) {
+        for (size_t i = 1; i <= queues.size(); ++i) {
+            unsigned q = (worker_index + i) % queues.size();
+            std::lock_guard<std::mutex> guard(queues[q]->lock);
+            auto &dq = queues[q]->tasks;
+            if (dq.empty()) continue;
+            task = dq.front();
+            dq.pop_front();
+            --queued;
+            return true; }
+        return false;
+    }
+
+    void execute(const Task &task) {
+        Batch &batch = *task.batch;
+        try {
+            batch.tasks[task.index]();
+        } catch (...) {
+            batch.errors[task.index] = std::current_exception(); }
+        if (--batch.remaining == 0) {
+            // take the lock so the notification can't slip in between a waiter
+            // checking 'remaining' and going to sleep
+            { std::lock_guard<std::mutex> guard(lock); }
+            wakeup.notify_all(); }
+    }
+
+    void worker(unsigned index) {
+        worker_index = index;
+#ifdef MULTITHREAD
+        register_thread();
+#endif  // MULTITHREAD
+        gc_register_thread();
+        Task task;
+        while (true) {
+            if (pop(index, nullptr, task) || steal(task)) {
+                execute(task);
+                continue; }
+            std::unique_lock<std::mutex> guard(lock);
+            wakeup.wait(guard, [this] { return stopping || queued.load() > 0; });
+            if (stopping) break; }
+        gc_unregister_thread();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto &w : workers) w.join();
+        workers.clear();
+        stopping = false;
+    }
+};
+
+ThreadPool::ThreadPool() : pimpl(new impl) {
+    pimpl->queues.push_back(new WorkQueue);
+}
+
+ThreadPool::~ThreadPool() {
+    pimpl->stop();
+}
+
+ThreadPool &ThreadPool::get() {
+    // never destroyed, so workers can't be torn down under a running static destructor
+    static ThreadPool *pool = new ThreadPool;
+    return *pool;
+}
+
+void ThreadPool::setThreads(unsigned threads) {
+    BUG_CHECK(worker_index == 0, "ThreadPool::setThreads called from a pool thread");
+    pimpl->stop();
+#ifdef MULTITHREAD
+    if (threads > 1) gc_allow_threads();
+    while (pimpl->queues.size() < threads)
+        pimpl->queues.push_back(new WorkQueue);
+    for (unsigned i = 1; i < threads; ++i)
+        pimpl->workers.emplace_back(&impl::worker, pimpl, i);
+#else
+    (void)threads;
+#endif  // MULTITHREAD
+}
+
+unsigned ThreadPool::threads() const {
+    return pimpl->workers.size() + 1;
+}
+
+void ThreadPool::run(const std::vector<std::function<void()>> &tasks) {
+    if (tasks.empty()) return;
+    if (pimpl->workers.empty() || tasks.size() == 1) {
+        std::exception_ptr error;
+        for (auto &t : tasks) {
+            try {
+                t();
+            } catch (...) {
+                if (!error) error = std::current_exception(); } }
+        if (error) std::rethrow_exception(error);
+        return; }
+    Batch batch(tasks);
+    pimpl->push(worker_index, batch);
+    Task task;
+    while (batch.remaining.load() > 0) {
+        if (pimpl->pop(worker_index, &batch, task)) {
+            pimpl->execute(task);
+            continue; }
+        // everything left in the batch was stolen; wait for the thieves to finish it
+        std::unique_lock<std::mutex> guard(pimpl->lock);
+        pimpl->wakeup.wait(guard, [&batch] { return batch.remaining.load() == 0; }); }
+    for (auto &e : batch.errors)
+        if (e) std::rethrow_exception(e);
+}
+
+}  // namespace Util
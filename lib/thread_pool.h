@@ -0,0 +1,64 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef LIB_THREAD_POOL_H_
+#define LIB_THREAD_POOL_H_
+
+#include <functional>
+#include <vector>
+
+namespace Util {
+
+/**
+ * A fork-join pool of worker threads with per-worker work-stealing deques.
+ *
+ * `run` pushes a batch of tasks onto the calling thread's deque (or onto a
+ * shared queue if the caller is not a pool thread) and then works on the batch
+ * itself until every task has completed.  Idle workers steal tasks from the
+ * other deques.  Tasks may call `run` recursively.  A thread waiting on a
+ * batch only ever executes tasks from that batch, so a task never starts
+ * running on a thread that is in the middle of some unrelated task.
+ *
+ * Worker threads are only created when the compiler is built with
+ * MULTITHREAD; otherwise (or with a thread count <= 1) `run` simply executes
+ * the tasks in order on the calling thread.
+ */
+class ThreadPool {
+    struct impl;
+    impl        *pimpl;
+    ThreadPool();
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+ public:
+    static ThreadPool &get();
+
+    /// Set the total number of threads (including the calling thread) used to run
+    /// tasks.  Stops and restarts the workers, so must not be called from a task.
+    void setThreads(unsigned threads);
+    unsigned threads() const;
+    bool enabled() const { return threads() > 1; }
+
+    /// Run all the @tasks, possibly concurrently, and return once they have all
+    /// completed.  If any of them throws, the exception thrown by the earliest such
+    /// task (in vector order) is rethrown after the whole batch is done.
+    void run(const std::vector<std::function<void()>> &tasks);
+};
+
+}  // namespace Util
+
+#endif /* LIB_THREAD_POOL_H_ */
@@ -0,0 +1,1177 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "concreteInterpreter.h"
+#include "frontends/p4/coreLibrary.h"
+
+namespace P4 {
+
+namespace {
+
+// Thrown by parsers, and by the parser code of their callees, on errors.
+struct ParserError {
+    cstring error;
+};
+
+// Parsers that run longer are assumed to loop forever.
+const unsigned maxParserStates = 10000;
+
+// The unsigned bits of a value that may be negative.
+big_int toUnsigned(const big_int& value, unsigned width) {
+    return value & Util::mask(width);
+}
+
+}  // namespace
+
+//////////////////////////////////////////////////////////////////////
+
+ConcreteValue* ConcreteValue::getField(cstring name) {
+    if (auto st = type->to<IR::Type_StructLike>()) {
+        size_t index = 0;
+        for (auto f : st->fields) {
+            if (f->name == name)
+                return &fields.at(index);
+            index++;
+        }
+    }
+    return nullptr;
+}
+
+bool ConcreteValue::operator==(const ConcreteValue& other) const {
+    if (type->is<IR::Type_Header>()) {
+        if (valid != other.valid)
+            return false;
+        if (!valid)
+            return true;
+    }
+    if (value != other.value || width != other.width || member != other.member ||
+        fields.size() != other.fields.size())
+        return false;
+    for (size_t i = 0; i < fields.size(); i++)
+        if (fields[i] != other.fields[i])
+            return false;
+    return true;
+}
+
+void ConcreteValue::dbprint(std::ostream& out) const {
+    if (type->is<IR::Type_Header>() && !valid) {
+        out << "<invalid>";
+    } else if (!fields.empty() || type->is<IR::Type_StructLike>() ||
+               type->is<IR::Type_Stack>() || type->is<IR::Type_BaseList>()) {
+        out << "{ ";
+        bool first = true;
+        for (auto& f : fields) {
+            if (!first)
+                out << ", ";
+            first = false;
+            f.dbprint(out);
+        }
+        out << " }";
+    } else if (!member.isNullOrEmpty()) {
+        out << member;
+    } else {
+        out << value;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+big_int ConcretePacket::peek(unsigned bits, size_t offset) const {
+    size_t start = extracted + offset;
+    big_int rv = 0;
+    size_t i = 0;
+    if (start % 8 == 0) {
+        for (; i + 8 <= bits; i += 8)
+            rv = (rv << 8) | data[(start + i) / 8];
+    }
+    for (; i < bits; i++) {
+        size_t bit = start + i;
+        rv = (rv << 1) | ((data[bit / 8] >> (7 - bit % 8)) & 1);
+    }
+    return rv;
+}
+
+void ConcretePacket::emit(const big_int& value, unsigned bits) {
+    for (unsigned i = bits; i > 0; ) {
+        if (emittedBits % 8 == 0 && i >= 8) {
+            i -= 8;
+            emitted.push_back(static_cast<uint8_t>(static_cast<unsigned>(
+                (value >> i) & 0xff)));
+            emittedBits += 8;
+            continue;
+        }
+        i--;
+        if (emittedBits % 8 == 0)
+            emitted.push_back(0);
+        if (boost::multiprecision::bit_test(value, i))
+            emitted.back() |= 1 << (7 - emittedBits % 8);
+        emittedBits++;
+    }
+}
+
+std::vector<uint8_t> ConcretePacket::payload() const {
+    size_t start = std::min(data.size(), (extracted + 7) / 8);
+    return std::vector<uint8_t>(data.begin() + start, data.end());
+}
+
+std::vector<uint8_t> ConcretePacket::deparsed() const {
+    auto rv = emitted;
+    auto rest = payload();
+    rv.insert(rv.end(), rest.begin(), rest.end());
+    return rv;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ConcreteTable::ConcreteTable(const IR::P4Table* table, const TypeMap* typeMap) : table(table) {
+    auto key = table->getKey();
+    if (key == nullptr)
+        return;
+    for (auto ke : key->keyElements) {
+        auto ann = ke->getAnnotation(IR::Annotation::nameAnnotation);
+        keyNames.push_back(ann ? IR::Annotation::getName(ann) : ke->expression->toString());
+        auto kind = ke->matchType->path->name.name;
+        matchKinds.push_back(kind);
+        auto type = typeMap->getType(ke->expression, true);
+        widths.push_back(type->is<IR::Type_Boolean>() ? 1 : type->width_bits());
+        if (kind != P4CoreLibrary::instance.exactMatch.name)
+            exactOnly = false;
+        if (kind == P4CoreLibrary::instance.lpmMatch.name)
+            lpmField = keyNames.size() - 1;
+        else if (kind != P4CoreLibrary::instance.exactMatch.name)
+            usesPriorities = true;
+    }
+}
+
+bool ConcreteTable::add(Entry entry) {
+    if (exactOnly) {
+        std::vector<big_int> key;
+        for (auto& k : entry.keys)
+            key.push_back(k.value);
+        if (!exactIndex.emplace(key, entries.size()).second)
+            return false;
+    }
+    entries.push_back(std::move(entry));
+    return true;
+}
+
+const ConcreteTable::Entry* ConcreteTable::lookup(const std::vector<big_int>& key) const {
+    if (exactOnly) {
+        auto it = exactIndex.find(key);
+        return it == exactIndex.end() ? nullptr : &entries[it->second];
+    }
+
+    const Entry* best = nullptr;
+    unsigned bestPrefix = 0;
+    for (auto& e : entries) {
+        bool match = true;
+        for (size_t i = 0; match && i < key.size(); i++) {
+            auto& k = e.keys[i];
+            auto& kind = matchKinds[i];
+            if (kind == P4CoreLibrary::instance.exactMatch.name)
+                match = key[i] == k.value;
+            else if (kind == "range")
+                match = k.value <= key[i] && key[i] <= k.high;
+            else
+                match = (key[i] & k.mask) == k.value;
+        }
+        if (!match)
+            continue;
+        if (usesPriorities) {
+            if (best == nullptr || e.priority < best->priority)
+                best = &e;
+        } else if (lpmField >= 0) {
+            unsigned prefix = bitcount(e.keys[lpmField].mask);
+            if (best == nullptr || prefix > bestPrefix) {
+                best = &e;
+                bestPrefix = prefix;
+            }
+        } else {
+            return &e;
+        }
+    }
+    return best;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ConcreteInterpreter::ConcreteInterpreter(ReferenceMap* refMap, TypeMap* typeMap) :
+        refMap(refMap), typeMap(typeMap) {
+    CHECK_NULL(refMap); CHECK_NULL(typeMap);
+}
+
+// Types of fields and parameters may still be names, or new types.
+static const IR::Type* canonical(const TypeMap* typeMap, const IR::Type* type) {
+    if (type->is<IR::Type_Name>())
+        type = typeMap->getTypeType(type, true);
+    if (auto nt = type->to<IR::Type_Newtype>())
+        return canonical(typeMap, nt->type);
+    if (auto sc = type->to<IR::Type_SpecializedCanonical>())
+        return canonical(typeMap, sc->substituted);
+    return type;
+}
+
+ConcreteValue ConcreteInterpreter::create(const IR::Type* type) const {
+    type = canonical(typeMap, type);
+    ConcreteValue rv(type);
+    if (auto st = type->to<IR::Type_StructLike>()) {
+        for (auto f : st->fields)
+            rv.fields.push_back(create(f->type));
+    } else if (auto stack = type->to<IR::Type_Stack>()) {
+        auto element = create(stack->elementType);
+        rv.fields.assign(stack->getSize(), element);
+    } else if (auto list = type->to<IR::Type_BaseList>()) {
+        for (auto c : list->components)
+            rv.fields.push_back(create(c));
+    } else if (type->is<IR::Type_Error>()) {
+        rv.member = P4CoreLibrary::instance.noError.name;
+    } else if (auto en = type->to<IR::Type_Enum>()) {
+        rv.member = en->members.at(0)->name.name;
+    }
+    return rv;
+}
+
+ConcreteValue ConcreteInterpreter::fromInteger(const IR::Type* type, const big_int& value) const {
+    type = canonical(typeMap, type);
+    const IR::Type* bits = type;
+    if (auto se = type->to<IR::Type_SerEnum>())
+        bits = se->type;
+    if (auto tb = bits->to<IR::Type_Bits>()) {
+        big_int v = toUnsigned(value, tb->size);
+        if (tb->isSigned && tb->size > 0 && boost::multiprecision::bit_test(v, tb->size - 1))
+            v -= Util::shift_left(1, tb->size);
+        return ConcreteValue(type, v);
+    }
+    if (type->is<IR::Type_Boolean>())
+        return ConcreteValue(type, value != 0 ? 1 : 0);
+    return ConcreteValue(type, value);
+}
+
+void ConcreteInterpreter::raise(cstring error, const IR::Node*) {
+    throw ParserError{error};
+}
+
+MethodInstance* ConcreteInterpreter::getMethod(const IR::MethodCallExpression* call) {
+    auto it = methods.find(call);
+    if (it != methods.end())
+        return it->second;
+    auto mi = MethodInstance::resolve(call, refMap, typeMap);
+    methods.emplace(call, mi);
+    return mi;
+}
+
+static unsigned bitWidth(const IR::Type* type) {
+    if (type->is<IR::Type_Boolean>())
+        return 1;
+    if (auto se = type->to<IR::Type_SerEnum>())
+        return se->type->size;
+    if (auto tb = type->to<IR::Type_Bits>())
+        return tb->size;
+    return 0;
+}
+
+void ConcreteInterpreter::serialize(const ConcreteValue& value, ConcretePacket* bits) const {
+    auto type = value.type;
+    if (type->is<IR::Type_Header>() && !value.valid)
+        return;
+    if (type->is<IR::Type_Varbits>()) {
+        bits->emit(value.value, value.width);
+    } else if (auto width = bitWidth(type)) {
+        bits->emit(toUnsigned(value.value, width), width);
+    } else {
+        for (auto& f : value.fields)
+            serialize(f, bits);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Expressions
+
+ConcreteValue* ConcreteInterpreter::location(const IR::Expression* expression) {
+    if (auto pe = expression->to<IR::PathExpression>()) {
+        auto decl = refMap->getDeclaration(pe->path, true);
+        auto it = values.find(decl);
+        if (it != values.end())
+            return &it->second;
+        if (auto dc = decl->to<IR::Declaration_Constant>()) {
+            auto value = evaluate(dc->initializer);
+            auto type = typeMap->getType(dc, true);
+            if (value.type->is<IR::Type_InfInt>())
+                value = fromInteger(type, value.value);
+            return &values.emplace(decl, value).first->second;
+        }
+        throw ExecutionError("%1%: no value for %2%", expression, decl->getName());
+    }
+    if (auto mem = expression->to<IR::Member>()) {
+        auto baseType = typeMap->getType(mem->expr, true);
+        if (auto stack = baseType->to<IR::Type_Stack>()) {
+            auto base = location(mem->expr);
+            unsigned index = base->nextIndex;
+            if (mem->member == IR::Type_Stack::last) {
+                if (index == 0)
+                    raise(P4CoreLibrary::instance.stackOutOfBounds.name, mem);
+                return &base->fields.at(index - 1);
+            }
+            if (mem->member == IR::Type_Stack::next) {
+                if (index >= stack->getSize())
+                    raise(P4CoreLibrary::instance.stackOutOfBounds.name, mem);
+                return &base->fields.at(index);
+            }
+        } else if (!mem->expr->is<IR::TypeNameExpression>() &&
+                   !mem->expr->is<IR::MethodCallExpression>()) {
+            auto base = location(mem->expr);
+            if (auto field = base->getField(mem->member))
+                return field;
+        }
+    }
+    if (auto ai = expression->to<IR::ArrayIndex>()) {
+        auto base = location(ai->left);
+        auto index = evaluate(ai->right).value;
+        if (index < 0 || index >= base->fields.size())
+            raise(P4CoreLibrary::instance.stackOutOfBounds.name, ai);
+        return &base->fields[static_cast<size_t>(index)];
+    }
+    temporaries.push_back(evaluate(expression));
+    return &temporaries.back();
+}
+
+void ConcreteInterpreter::assign(ConcreteValue* dest, const ConcreteValue& value) {
+    auto type = dest->type;
+    if (value.type->is<IR::Type_InfInt>() && !type->is<IR::Type_InfInt>()) {
+        *dest = fromInteger(type, value.value);
+    } else if (value.type->is<IR::Type_BaseList>() && !type->is<IR::Type_BaseList>()) {
+        // a list initializing a struct or header
+        for (size_t i = 0; i < dest->fields.size() && i < value.fields.size(); i++)
+            assign(&dest->fields[i], value.fields[i]);
+        dest->valid = true;
+    } else if (value.type->is<IR::Type_StructLike>() && type->is<IR::Type_StructLike>() &&
+               value.type != type) {
+        // a struct initializer, typed by its fields
+        for (size_t i = 0; i < dest->fields.size() && i < value.fields.size(); i++)
+            assign(&dest->fields[i], value.fields[i]);
+        dest->valid = value.valid;
+    } else {
+        *dest = value;
+        dest->type = type;
+    }
+}
+
+ConcreteValue ConcreteInterpreter::evaluate(const IR::Expression* expression) {
+    if (auto c = expression->to<IR::Constant>()) {
+        auto type = typeMap->getType(c);
+        return fromInteger(type ? type : c->type, c->value);
+    }
+    if (auto b = expression->to<IR::BoolLiteral>())
+        return ConcreteValue(IR::Type_Boolean::get(), b->value ? 1 : 0);
+    if (auto s = expression->to<IR::StringLiteral>()) {
+        ConcreteValue rv(IR::Type_String::get());
+        rv.member = s->value;
+        return rv;
+    }
+    if (expression->is<IR::PathExpression>() || expression->is<IR::ArrayIndex>())
+        return *location(expression);
+
+    auto type = typeMap->getType(expression, true);
+    if (auto mem = expression->to<IR::Member>()) {
+        if (mem->expr->is<IR::TypeNameExpression>()) {
+            auto ctype = canonical(typeMap, type);
+            if (auto se = ctype->to<IR::Type_SerEnum>()) {
+                auto decl = se->getDeclByName(mem->member)->to<IR::SerEnumMember>();
+                return fromInteger(se, evaluate(decl->value).value);
+            }
+            ConcreteValue rv(ctype);
+            rv.member = mem->member.name;
+            return rv;
+        }
+        auto baseType = typeMap->getType(mem->expr, true);
+        if (auto stack = baseType->to<IR::Type_Stack>()) {
+            if (mem->member == IR::Type_Stack::arraySize)
+                return fromInteger(type, stack->getSize());
+            if (mem->member == IR::Type_Stack::lastIndex)
+                return fromInteger(type, big_int(location(mem->expr)->nextIndex) - 1);
+        }
+        if (mem->expr->is<IR::MethodCallExpression>()) {
+            auto base = evaluate(mem->expr);
+            if (auto field = base.getField(mem->member))
+                return *field;
+            throw ExecutionError("%1%: unexpected member", expression);
+        }
+        return *location(expression);
+    }
+    if (auto mc = expression->to<IR::MethodCallExpression>())
+        return call(mc);
+
+    if (auto land = expression->to<IR::LAnd>()) {
+        if (!evaluate(land->left).isTrue())
+            return ConcreteValue(type, 0);
+        return ConcreteValue(type, evaluate(land->right).isTrue() ? 1 : 0);
+    }
+    if (auto lor = expression->to<IR::LOr>()) {
+        if (evaluate(lor->left).isTrue())
+            return ConcreteValue(type, 1);
+        return ConcreteValue(type, evaluate(lor->right).isTrue() ? 1 : 0);
+    }
+    if (auto mux = expression->to<IR::Mux>()) {
+        if (evaluate(mux->e0).isTrue())
+            return evaluate(mux->e1);
+        return evaluate(mux->e2);
+    }
+
+    if (auto rel = expression->to<IR::Operation_Relation>()) {
+        auto left = evaluate(rel->left);
+        auto right = evaluate(rel->right);
+        if (left.type->is<IR::Type_InfInt>())
+            left = fromInteger(right.type, left.value);
+        else if (right.type->is<IR::Type_InfInt>())
+            right = fromInteger(left.type, right.value);
+        bool result;
+        if (rel->is<IR::Equ>())
+            result = left == right;
+        else if (rel->is<IR::Neq>())
+            result = left != right;
+        else if (rel->is<IR::Lss>())
+            result = left.value < right.value;
+        else if (rel->is<IR::Leq>())
+            result = left.value <= right.value;
+        else if (rel->is<IR::Grt>())
+            result = left.value > right.value;
+        else
+            result = left.value >= right.value;
+        return ConcreteValue(type, result ? 1 : 0);
+    }
+
+    if (auto concat = expression->to<IR::Concat>()) {
+        auto left = evaluate(concat->left);
+        auto right = evaluate(concat->right);
+        unsigned rw = bitWidth(right.type);
+        return fromInteger(type, Util::shift_left(left.value, rw) |
+                           toUnsigned(right.value, rw));
+    }
+    if (auto shift = expression->to<IR::Shl>()) {
+        auto left = evaluate(shift->left);
+        auto amount = evaluate(shift->right).value;
+        unsigned width = bitWidth(type);
+        if (width != 0 && amount >= width)
+            return fromInteger(type, 0);
+        return fromInteger(type, Util::shift_left(left.value, static_cast<unsigned>(amount)));
+    }
+    if (auto shift = expression->to<IR::Shr>()) {
+        auto left = evaluate(shift->left);
+        auto amount = evaluate(shift->right).value;
+        unsigned width = bitWidth(type);
+        if (width != 0 && amount >= width)
+            amount = width;
+        return fromInteger(type, Util::shift_right(left.value, static_cast<unsigned>(amount)));
+    }
+    if (auto bin = expression->to<IR::Operation_Binary>()) {
+        auto left = evaluate(bin->left).value;
+        auto right = evaluate(bin->right).value;
+        big_int result;
+        if (bin->is<IR::Add>() || bin->is<IR::AddSat>()) {
+            result = left + right;
+        } else if (bin->is<IR::Sub>() || bin->is<IR::SubSat>()) {
+            result = left - right;
+        } else if (bin->is<IR::Mul>()) {
+            result = left * right;
+        } else if (bin->is<IR::Div>() || bin->is<IR::Mod>()) {
+            if (right == 0)
+                throw ExecutionError("%1%: division by zero", expression);
+            result = bin->is<IR::Div>() ? big_int(left / right) : big_int(left % right);
+        } else if (bin->is<IR::BAnd>()) {
+            result = left & right;
+        } else if (bin->is<IR::BOr>()) {
+            result = left | right;
+        } else if (bin->is<IR::BXor>()) {
+            result = left ^ right;
+        } else {
+            throw ExecutionError("%1%: unsupported operation", expression);
+        }
+        if (bin->is<IR::AddSat>() || bin->is<IR::SubSat>()) {
+            if (auto tb = canonical(typeMap, type)->to<IR::Type_Bits>()) {
+                big_int max = tb->isSigned ? Util::mask(tb->size - 1) : Util::mask(tb->size);
+                big_int min = tb->isSigned ? big_int(-max - 1) : big_int(0);
+                if (result > max)
+                    result = max;
+                else if (result < min)
+                    result = min;
+            }
+        }
+        return fromInteger(type, result);
+    }
+
+    if (auto neg = expression->to<IR::Neg>())
+        return fromInteger(type, -evaluate(neg->expr).value);
+    if (auto cmpl = expression->to<IR::Cmpl>())
+        return fromInteger(type, -evaluate(cmpl->expr).value - 1);
+    if (auto lnot = expression->to<IR::LNot>())
+        return ConcreteValue(type, evaluate(lnot->expr).isTrue() ? 0 : 1);
+    if (auto cast = expression->to<IR::Cast>()) {
+        auto value = evaluate(cast->expr);
+        auto dest = canonical(typeMap, type);
+        if (bitWidth(dest) != 0 || dest->is<IR::Type_InfInt>())
+            return fromInteger(dest, value.value);
+        value.type = dest;
+        return value;
+    }
+    if (auto slice = expression->to<IR::Slice>()) {
+        auto value = evaluate(slice->e0).value;
+        unsigned h = slice->getH(), l = slice->getL();
+        return fromInteger(type, Util::shift_right(value, l) & Util::mask(h - l + 1));
+    }
+
+    if (auto list = expression->to<IR::ListExpression>()) {
+        ConcreteValue rv(canonical(typeMap, type));
+        for (auto c : list->components)
+            rv.fields.push_back(evaluate(c));
+        return rv;
+    }
+    if (auto si = expression->to<IR::StructInitializerExpression>()) {
+        auto rv = create(type);
+        for (auto c : si->components) {
+            auto field = rv.getField(c->name);
+            BUG_CHECK(field != nullptr, "%1%: no such field", c);
+            assign(field, evaluate(c->expression));
+        }
+        rv.valid = true;
+        return rv;
+    }
+    throw ExecutionError("%1%: cannot evaluate this expression", expression);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Statements
+
+void ConcreteInterpreter::declare(const IR::Declaration* decl) {
+    if (auto dv = decl->to<IR::Declaration_Variable>()) {
+        auto value = create(typeMap->getType(dv, true));
+        if (dv->initializer != nullptr)
+            assign(&value, evaluate(dv->initializer));
+        values[dv] = value;
+    } else if (auto dc = decl->to<IR::Declaration_Constant>()) {
+        auto value = create(typeMap->getType(dc, true));
+        assign(&value, evaluate(dc->initializer));
+        values[dc] = value;
+    }
+    // Instances, actions, tables and parser states have no values.
+}
+
+ConcreteInterpreter::Flow ConcreteInterpreter::execute(const IR::StatOrDecl* statement) {
+    if (auto decl = statement->to<IR::Declaration>()) {
+        declare(decl);
+        return Flow::Next;
+    }
+    if (auto block = statement->to<IR::BlockStatement>()) {
+        for (auto c : block->components) {
+            auto flow = execute(c);
+            if (flow != Flow::Next)
+                return flow;
+        }
+        return Flow::Next;
+    }
+    if (auto as = statement->to<IR::AssignmentStatement>()) {
+        if (auto slice = as->left->to<IR::Slice>()) {
+            auto dest = location(slice->e0);
+            unsigned h = slice->getH(), l = slice->getL();
+            unsigned width = bitWidth(dest->type);
+            auto bits = toUnsigned(evaluate(as->right).value, h - l + 1);
+            auto old = toUnsigned(dest->value, width) & ~Util::maskFromSlice(h, l);
+            *dest = fromInteger(dest->type, old | Util::shift_left(bits, l));
+        } else {
+            auto dest = location(as->left);
+            assign(dest, evaluate(as->right));
+        }
+        return Flow::Next;
+    }
+    if (auto mcs = statement->to<IR::MethodCallStatement>()) {
+        call(mcs->methodCall);
+        return exiting ? Flow::Exit : Flow::Next;
+    }
+    if (auto ifs = statement->to<IR::IfStatement>()) {
+        bool condition = evaluate(ifs->condition).isTrue();
+        if (exiting)
+            return Flow::Exit;
+        if (condition)
+            return execute(ifs->ifTrue);
+        if (ifs->ifFalse != nullptr)
+            return execute(ifs->ifFalse);
+        return Flow::Next;
+    }
+    if (auto ss = statement->to<IR::SwitchStatement>()) {
+        auto value = evaluate(ss->expression);
+        if (exiting)
+            return Flow::Exit;
+        bool matched = false;
+        for (auto c : ss->cases) {
+            if (!matched) {
+                if (c->label->is<IR::DefaultExpression>())
+                    matched = true;
+                else if (auto pe = c->label->to<IR::PathExpression>())
+                    matched = pe->path->name.name == value.member;
+            }
+            if (matched && c->statement != nullptr)
+                return execute(c->statement);
+        }
+        return Flow::Next;
+    }
+    if (auto rs = statement->to<IR::ReturnStatement>()) {
+        if (rs->expression != nullptr)
+            returnValue = evaluate(rs->expression);
+        return Flow::Return;
+    }
+    if (statement->is<IR::ExitStatement>()) {
+        exiting = true;
+        return Flow::Exit;
+    }
+    if (statement->is<IR::EmptyStatement>())
+        return Flow::Next;
+    throw ExecutionError("%1%: cannot execute this statement", statement);
+}
+
+void ConcreteInterpreter::bind(const IR::ParameterList* params,
+                               const ParameterSubstitution* args,
+                               const std::vector<ConcreteValue>* data, CopyOut* copyOut) {
+    // Evaluate all arguments before binding any parameter.
+    std::vector<std::pair<const IR::Parameter*, ConcreteValue>> bound;
+    size_t dataIndex = 0;
+    for (auto p : params->parameters) {
+        auto value = create(typeMap->getType(p, true));
+        auto arg = args ? args->lookup(p) : nullptr;
+        if (arg == nullptr) {
+            if (p->direction == IR::Direction::None && data != nullptr &&
+                dataIndex < data->size())
+                assign(&value, data->at(dataIndex++));
+            else if (p->defaultValue != nullptr)
+                assign(&value, evaluate(p->defaultValue));
+        } else if (p->direction == IR::Direction::Out) {
+            copyOut->emplace_back(p, location(arg->expression));
+        } else if (p->direction == IR::Direction::InOut) {
+            auto loc = location(arg->expression);
+            assign(&value, *loc);
+            copyOut->emplace_back(p, loc);
+        } else if (!value.type->is<IR::Type_Extern>()) {
+            assign(&value, evaluate(arg->expression));
+        }
+        bound.emplace_back(p, std::move(value));
+    }
+    for (auto& b : bound)
+        values[b.first] = std::move(b.second);
+}
+
+void ConcreteInterpreter::finish(const CopyOut& copyOut) {
+    for (auto& c : copyOut)
+        assign(c.second, values.at(c.first));
+}
+
+void ConcreteInterpreter::invoke(const IR::ParameterList* params,
+                                 const ParameterSubstitution* args,
+                                 const std::vector<ConcreteValue>* data,
+                                 const IR::StatOrDecl* body) {
+    CopyOut copyOut;
+    bind(params, args, data, &copyOut);
+    execute(body);
+    finish(copyOut);
+}
+
+ConcreteValue ConcreteInterpreter::call(const IR::MethodCallExpression* call) {
+    auto mi = getMethod(call);
+    if (auto am = mi->to<ApplyMethod>()) {
+        if (auto table = am->object->to<IR::P4Table>())
+            return applyTable(table, call);
+        // Parsers and controls instantiated by this one.
+        auto inst = am->object->to<IR::Declaration_Instance>();
+        const IR::IDeclaration* decl = nullptr;
+        if (inst != nullptr) {
+            auto type = inst->type;
+            if (auto ts = type->to<IR::Type_Specialized>())
+                type = ts->baseType;
+            if (auto tn = type->to<IR::Type_Name>())
+                decl = refMap->getDeclaration(tn->path, true);
+        }
+        auto container = decl ? decl->to<IR::IContainer>() : nullptr;
+        if (container == nullptr)
+            throw ExecutionError("%1%: cannot apply this object", call);
+        ParameterSubstitution ctorArgs;
+        ctorArgs.populate(container->getConstructorParameters(), inst->arguments);
+        CopyOut unused;
+        bind(container->getConstructorParameters(), &ctorArgs, nullptr, &unused);
+        CopyOut copyOut;
+        bind(am->getActualParameters(), &mi->substitution, nullptr, &copyOut);
+        if (auto control = decl->to<IR::P4Control>()) {
+            for (auto d : control->controlLocals)
+                declare(d);
+            execute(control->body);
+            exiting = false;
+        } else {
+            auto parser = decl->to<IR::P4Parser>();
+            for (auto d : parser->parserLocals)
+                declare(d);
+            try {
+                runStates(parser);
+            } catch (ParserError&) {
+                // the caller rejects the packet too, with the outputs so far
+                finish(copyOut);
+                throw;
+            }
+        }
+        finish(copyOut);
+        return ConcreteValue();
+    }
+    if (auto bim = mi->to<BuiltInMethod>()) {
+        auto base = location(bim->appliedTo);
+        if (bim->name == IR::Type_Header::isValid) {
+            bool valid = base->valid;
+            if (base->type->is<IR::Type_HeaderUnion>())
+                for (auto& f : base->fields)
+                    valid = valid || f.valid;
+            return ConcreteValue(IR::Type_Boolean::get(), valid ? 1 : 0);
+        }
+        if (bim->name == IR::Type_Header::setValid ||
+            bim->name == IR::Type_Header::setInvalid) {
+            bool valid = bim->name == IR::Type_Header::setValid;
+            // Making a member of a union valid invalidates its siblings.
+            if (valid) {
+                if (auto mem = bim->appliedTo->to<IR::Member>()) {
+                    if (typeMap->getType(mem->expr, true)->is<IR::Type_HeaderUnion>()) {
+                        for (auto& f : location(mem->expr)->fields)
+                            if (&f != base)
+                                f = create(f.type);
+                    }
+                }
+            }
+            if (valid && !base->valid)
+                *base = create(base->type);
+            base->valid = valid;
+            return ConcreteValue();
+        }
+        auto count = static_cast<size_t>(evaluate(
+            mi->substitution.lookupByName("count")->expression).value);
+        auto size = base->fields.size();
+        auto empty = create(base->fields.at(0).type);
+        if (bim->name == IR::Type_Stack::push_front) {
+            for (size_t i = size; i-- > 0; )
+                base->fields[i] = i >= count ? base->fields[i - count] : empty;
+            base->nextIndex = std::min(size, base->nextIndex + count);
+        } else {
+            for (size_t i = 0; i < size; i++)
+                base->fields[i] = i + count < size ? base->fields[i + count] : empty;
+            base->nextIndex = base->nextIndex > count ? base->nextIndex - count : 0;
+        }
+        return ConcreteValue();
+    }
+    if (auto ac = mi->to<ActionCall>()) {
+        invoke(ac->action->parameters, &mi->substitution, nullptr, ac->action->body);
+        return ConcreteValue();
+    }
+    if (auto fc = mi->to<FunctionCall>()) {
+        returnValue = ConcreteValue();
+        invoke(fc->function->type->parameters, &mi->substitution, nullptr, fc->function->body);
+        auto rv = create(fc->function->type->returnType);
+        if (rv.type->is<IR::Type_Void>())
+            return rv;
+        assign(&rv, returnValue);
+        return rv;
+    }
+
+    auto& corelib = P4CoreLibrary::instance;
+    if (auto ef = mi->to<ExternFunction>()) {
+        if (ef->method->name == IR::ParserState::verify) {
+            if (!argument(mi, "check").isTrue())
+                raise(argument(mi, "toSignal").member, call);
+            return ConcreteValue();
+        }
+    } else if (auto em = mi->to<ExternMethod>()) {
+        auto extern_ = em->originalExternType->name;
+        auto method = em->method->name;
+        if (extern_ == corelib.packetIn.name) {
+            if (method == corelib.packetIn.extract.name) {
+                extract(mi);
+                return ConcreteValue();
+            }
+            if (method == corelib.packetIn.lookahead.name) {
+                auto rv = create(typeMap->getType(call, true));
+                size_t offset = 0;
+                unsigned width = rv.type->is<IR::Type_Header>() ||
+                        rv.type->is<IR::Type_Struct>() ?
+                        typeMap->minWidthBits(rv.type, call) : bitWidth(rv.type);
+                if (packet->available() < width)
+                    raise(corelib.packetTooShort.name, call);
+                read(&rv, &offset, 0);
+                return rv;
+            }
+            if (method == corelib.packetIn.advance.name) {
+                auto bits = static_cast<size_t>(argument(mi, "sizeInBits").value);
+                if (packet->available() < bits)
+                    raise(corelib.packetTooShort.name, call);
+                packet->advance(bits);
+                return ConcreteValue();
+            }
+            if (method == corelib.packetIn.length.name)
+                return fromInteger(typeMap->getType(call, true), packet->length());
+        } else if (extern_ == corelib.packetOut.name &&
+                   method == corelib.packetOut.emit.name) {
+            emit(argument(mi, "hdr"));
+            return ConcreteValue();
+        }
+    }
+
+    ConcreteValue rv;
+    if (!callExtern(mi, &rv))
+        throw ExecutionError("%1%: unsupported extern", call);
+    return rv;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Externs
+
+ConcreteValue ConcreteInterpreter::argument(const MethodInstance* mi, cstring parameter) {
+    auto arg = mi->substitution.lookupByName(parameter);
+    if (arg == nullptr)
+        throw ExecutionError("%1%: missing argument %2%", mi->expr, parameter);
+    return evaluate(arg->expression);
+}
+
+ConcreteValue* ConcreteInterpreter::argumentLocation(const MethodInstance* mi, cstring parameter) {
+    auto arg = mi->substitution.lookupByName(parameter);
+    if (arg == nullptr)
+        throw ExecutionError("%1%: missing argument %2%", mi->expr, parameter);
+    return location(arg->expression);
+}
+
+bool ConcreteInterpreter::callExtern(const MethodInstance*, ConcreteValue*) {
+    return false;
+}
+
+void ConcreteInterpreter::read(ConcreteValue* value, size_t* offset, unsigned varbitSize) {
+    auto type = value->type;
+    if (type->is<IR::Type_Varbits>()) {
+        value->value = packet->peek(varbitSize, *offset);
+        value->width = varbitSize;
+        *offset += varbitSize;
+    } else if (auto width = bitWidth(type)) {
+        *value = fromInteger(type, packet->peek(width, *offset));
+        *offset += width;
+    } else {
+        for (auto& f : value->fields)
+            read(&f, offset, varbitSize);
+        value->valid = true;
+    }
+}
+
+void ConcreteInterpreter::extract(const MethodInstance* mi) {
+    auto& corelib = P4CoreLibrary::instance;
+    auto arg = mi->substitution.lookupByName("hdr")->expression;
+    ConcreteValue* stack = nullptr;
+    if (auto mem = arg->to<IR::Member>()) {
+        if (mem->member == IR::Type_Stack::next &&
+            typeMap->getType(mem->expr, true)->is<IR::Type_Stack>())
+            stack = location(mem->expr);
+    }
+    auto hdr = location(arg);
+    unsigned width = typeMap->minWidthBits(hdr->type, arg);
+    unsigned varbitSize = 0;
+    if (mi->substitution.lookupByName("variableFieldSizeInBits") != nullptr) {
+        varbitSize = static_cast<unsigned>(argument(mi, "variableFieldSizeInBits").value);
+        for (auto f : hdr->type->to<IR::Type_Header>()->fields) {
+            auto vt = canonical(typeMap, f->type)->to<IR::Type_Varbits>();
+            if (vt != nullptr && varbitSize > static_cast<unsigned>(vt->size))
+                raise(corelib.headerTooShort.name, mi->expr);
+        }
+        width += varbitSize;
+    }
+    if (packet->available() < width)
+        raise(corelib.packetTooShort.name, mi->expr);
+    size_t offset = 0;
+    read(hdr, &offset, varbitSize);
+    packet->advance(offset);
+    if (stack != nullptr)
+        stack->nextIndex++;
+}
+
+void ConcreteInterpreter::emit(const ConcreteValue& value) {
+    serialize(value, packet);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Tables
+
+ConcreteTable* ConcreteInterpreter::getTable(const IR::P4Table* table) {
+    auto it = tables.find(table);
+    if (it != tables.end())
+        return &it->second;
+    auto ct = &tables.emplace(table, ConcreteTable(table, typeMap)).first->second;
+
+    auto entries = table->getEntries();
+    if (entries == nullptr)
+        return ct;
+    int index = 0;
+    for (auto e : entries->entries) {
+        index++;
+        ConcreteTable::Entry entry;
+        entry.priority = index;
+        if (auto ann = e->getAnnotation("priority")) {
+            if (ann->expr.size() == 1 && ann->expr[0]->is<IR::Constant>())
+                entry.priority = ann->expr[0]->to<IR::Constant>()->asInt();
+        }
+        for (size_t i = 0; i < e->keys->components.size(); i++) {
+            auto k = e->keys->components.at(i);
+            unsigned width = ct->widths.at(i);
+            ConcreteTable::KeyMatch match;
+            match.mask = Util::mask(width);
+            match.high = match.mask;
+            if (k->is<IR::DefaultExpression>()) {
+                match.value = 0;
+                match.mask = 0;
+            } else if (auto mask = k->to<IR::Mask>()) {
+                match.mask = toUnsigned(evaluate(mask->right).value, width);
+                match.value = toUnsigned(evaluate(mask->left).value, width) & match.mask;
+            } else if (auto range = k->to<IR::Range>()) {
+                match.value = toUnsigned(evaluate(range->left).value, width);
+                match.high = toUnsigned(evaluate(range->right).value, width);
+            } else {
+                match.value = toUnsigned(evaluate(k).value, width);
+                match.high = match.value;
+            }
+            entry.keys.push_back(match);
+        }
+        auto mce = e->action->to<IR::MethodCallExpression>();
+        BUG_CHECK(mce != nullptr, "%1%: expected an action call", e->action);
+        auto path = mce->method->to<IR::PathExpression>()->path;
+        entry.action = refMap->getDeclaration(path, true)->to<IR::P4Action>();
+        for (auto arg : *mce->arguments)
+            entry.data.push_back(evaluate(arg->expression));
+        ct->add(std::move(entry));
+    }
+    return ct;
+}
+
+bool ConcreteInterpreter::addEntry(ConcreteTable* table,
+                                   std::vector<ConcreteTable::KeyMatch> keys, int priority,
+                                   const IR::P4Action* action, const std::vector<big_int>& data) {
+    ConcreteTable::Entry entry;
+    entry.keys = std::move(keys);
+    entry.priority = priority;
+    entry.action = action;
+    size_t index = 0;
+    for (auto p : action->parameters->parameters) {
+        if (p->direction != IR::Direction::None)
+            continue;
+        if (index >= data.size())
+            throw ExecutionError("%1%: missing action data", p);
+        entry.data.push_back(fromInteger(typeMap->getType(p, true), data[index++]));
+    }
+    return table->add(std::move(entry));
+}
+
+void ConcreteInterpreter::setDefaultAction(ConcreteTable* table, const IR::P4Action* action,
+                                           const std::vector<big_int>& data) {
+    table->defaultAction = action;
+    table->defaultData.clear();
+    size_t index = 0;
+    for (auto p : action->parameters->parameters) {
+        if (p->direction != IR::Direction::None)
+            continue;
+        if (index >= data.size())
+            throw ExecutionError("%1%: missing action data", p);
+        table->defaultData.push_back(fromInteger(typeMap->getType(p, true), data[index++]));
+    }
+}
+
+ConcreteValue ConcreteInterpreter::applyTable(const IR::P4Table* table,
+                                              const IR::MethodCallExpression* call) {
+    auto ct = getTable(table);
+    std::vector<big_int> key;
+    if (auto k = table->getKey()) {
+        size_t i = 0;
+        for (auto ke : k->keyElements)
+            key.push_back(toUnsigned(evaluate(ke->expression).value, ct->widths.at(i++)));
+    }
+
+    auto entry = ct->lookup(key);
+    const IR::P4Action* action = nullptr;
+    const std::vector<ConcreteValue>* data = nullptr;
+    const IR::Vector<IR::Argument>* args = nullptr;
+    if (entry != nullptr) {
+        action = entry->action;
+        data = &entry->data;
+    } else if (ct->defaultAction != nullptr) {
+        action = ct->defaultAction;
+        data = &ct->defaultData;
+    } else if (auto def = table->getDefaultAction()) {
+        // The default action of the program binds all its parameters.
+        const IR::Expression* method = def;
+        if (auto mce = def->to<IR::MethodCallExpression>()) {
+            method = mce->method;
+            args = mce->arguments;
+        }
+        auto decl = refMap->getDeclaration(method->to<IR::PathExpression>()->path, true);
+        action = decl->to<IR::P4Action>();
+    }
+
+    auto rv = create(typeMap->getType(call, true));
+    rv.getField(IR::Type_Table::hit)->value = entry != nullptr ? 1 : 0;
+    if (auto miss = rv.getField(IR::Type_Table::miss))
+        miss->value = entry != nullptr ? 0 : 1;
+    if (action == nullptr)
+        return rv;
+    rv.getField(IR::Type_Table::action_run)->member = action->name.name;
+
+    if (args == nullptr) {
+        // The in arguments come from the list of actions.
+        for (auto ale : table->getActionList()->actionList) {
+            if (refMap->getDeclaration(ale->getPath(), true) != action)
+                continue;
+            if (auto mce = ale->expression->to<IR::MethodCallExpression>())
+                args = mce->arguments;
+            break;
+        }
+    }
+    ParameterSubstitution subst;
+    if (args != nullptr)
+        subst.populate(action->parameters, args);
+    invoke(action->parameters, &subst, data, action->body);
+    return rv;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Parsers and controls
+
+bool ConcreteInterpreter::matches(const IR::Expression* keyset, const ConcreteValue& value) {
+    if (keyset->is<IR::DefaultExpression>())
+        return true;
+    if (auto list = keyset->to<IR::ListExpression>()) {
+        for (size_t i = 0; i < list->components.size(); i++)
+            if (!matches(list->components.at(i), value.fields.at(i)))
+                return false;
+        return true;
+    }
+    unsigned width = bitWidth(value.type);
+    if (auto mask = keyset->to<IR::Mask>()) {
+        auto m = toUnsigned(evaluate(mask->right).value, width);
+        return (toUnsigned(value.value, width) & m) ==
+                (toUnsigned(evaluate(mask->left).value, width) & m);
+    }
+    if (auto range = keyset->to<IR::Range>())
+        return evaluate(range->left).value <= value.value &&
+                value.value <= evaluate(range->right).value;
+    if (auto pe = keyset->to<IR::PathExpression>()) {
+        if (refMap->getDeclaration(pe->path, true)->is<IR::P4ValueSet>())
+            throw ExecutionError("%1%: value sets are not supported", keyset);
+    }
+    auto key = evaluate(keyset);
+    if (key.type->is<IR::Type_InfInt>())
+        key = fromInteger(value.type, key.value);
+    return key.value == value.value && key.member == value.member;
+}
+
+const IR::ParserState* ConcreteInterpreter::nextState(const IR::ParserState* state) {
+    auto select = state->selectExpression;
+    if (select == nullptr)
+        return state;  // accept or reject
+    if (auto pe = select->to<IR::PathExpression>())
+        return refMap->getDeclaration(pe->path, true)->to<IR::ParserState>();
+    auto se = select->to<IR::SelectExpression>();
+    BUG_CHECK(se != nullptr, "%1%: unexpected select", select);
+    ConcreteValue value;
+    if (se->select->components.size() == 1)
+        value = evaluate(se->select->components.at(0));
+    else
+        value = evaluate(se->select);
+    for (auto c : se->selectCases)
+        if (matches(c->keyset, value))
+            return refMap->getDeclaration(c->state->path, true)->to<IR::ParserState>();
+    raise(P4CoreLibrary::instance.noMatch.name, se);
+    return nullptr;
+}
+
+void ConcreteInterpreter::runStates(const IR::P4Parser* parser) {
+    auto state = parser->states.getDeclaration<IR::ParserState>(IR::ParserState::start);
+    unsigned count = 0;
+    while (state->name != IR::ParserState::accept) {
+        if (state->name == IR::ParserState::reject)
+            raise(P4CoreLibrary::instance.noError.name, state);
+        if (++count > maxParserStates)
+            throw ExecutionError("%1%: parser does not terminate", parser);
+        for (auto c : state->components)
+            execute(c);
+        state = nextState(state);
+    }
+}
+
+void ConcreteInterpreter::start(const IR::Type_Declaration* container, ConcretePacket* packet,
+                                const IR::ParameterList* params,
+                                const std::vector<ConcreteValue*>& args) {
+    this->packet = packet;
+    temporaries.clear();
+    exiting = false;
+    size_t index = 0;
+    for (auto p : params->parameters) {
+        auto type = typeMap->getType(p, true);
+        if (type->is<IR::Type_Extern>())
+            continue;
+        BUG_CHECK(index < args.size(), "%1%: missing argument for %2%", container, p);
+        auto value = create(type);
+        if (p->direction != IR::Direction::Out)
+            assign(&value, *args[index]);
+        values[p] = std::move(value);
+        index++;
+    }
+}
+
+void ConcreteInterpreter::finish(const IR::ParameterList* params,
+                                 const std::vector<ConcreteValue*>& args) {
+    size_t index = 0;
+    for (auto p : params->parameters) {
+        if (typeMap->getType(p, true)->is<IR::Type_Extern>())
+            continue;
+        if (p->direction == IR::Direction::Out || p->direction == IR::Direction::InOut)
+            assign(args[index], values.at(p));
+        index++;
+    }
+    packet = nullptr;
+}
+
+cstring ConcreteInterpreter::runParser(const IR::P4Parser* parser, ConcretePacket* packet,
+                                       const std::vector<ConcreteValue*>& args) {
+    auto params = parser->getApplyParameters();
+    start(parser, packet, params, args);
+    cstring error = P4CoreLibrary::instance.noError.name;
+    try {
+        for (auto d : parser->parserLocals)
+            declare(d);
+        runStates(parser);
+    } catch (ParserError& e) {
+        error = e.error;
+    }
+    finish(params, args);
+    return error;
+}
+
+void ConcreteInterpreter::runControl(const IR::P4Control* control, ConcretePacket* packet,
+                                     const std::vector<ConcreteValue*>& args) {
+    auto params = control->getApplyParameters();
+    start(control, packet, params, args);
+    try {
+        for (auto d : control->controlLocals)
+            declare(d);
+        execute(control->body);
+    } catch (ParserError& e) {
+        throw ExecutionError("%1%: error %2% raised in a control", control, e.error);
+    }
+    exiting = false;
+    finish(params, args);
+}
+
+}  // namespace P4
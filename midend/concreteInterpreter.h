@@ -0,0 +1,233 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _MIDEND_CONCRETEINTERPRETER_H_
+#define _MIDEND_CONCRETEINTERPRETER_H_
+
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "ir/ir.h"
+#include "lib/exceptions.h"
+#include "lib/gmputil.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/methodInstance.h"
+#include "frontends/p4/typeMap.h"
+
+// Concrete P4 program evaluation: runs parsers and controls on actual
+// packets, with the table entries held in memory.  Where interpreter.h
+// evaluates programs symbolically to analyze them, this executes them, so
+// that tests can check the packets a program produces without a target.
+
+namespace P4 {
+
+// Raised when a packet cannot be processed: the program uses something the
+// interpreter does not support, or fails an assertion.
+class ExecutionError final : public Util::P4CExceptionBase {
+ public:
+    template <typename... T>
+    explicit ExecutionError(const char* format, T... args) : P4CExceptionBase(format, args...) {}
+};
+
+// The value of a variable, or of a part of one.  Structured values hold the
+// values of their fields, or of their elements, in declaration order.
+class ConcreteValue {
+ public:
+    const IR::Type* type = nullptr;  // canonical type
+    // bit<>, int<> and varbit<> values, bool as 0 or 1, serializable enums;
+    // int<> values are kept signed
+    big_int value;
+    unsigned width = 0;              // the bits a varbit<> holds
+    bool valid = false;              // headers
+    cstring member;                  // error and enum values
+    // fields of structs, headers, unions and tuples; elements of stacks
+    std::vector<ConcreteValue> fields;
+    unsigned nextIndex = 0;          // stacks
+
+    ConcreteValue() = default;
+    explicit ConcreteValue(const IR::Type* type) : type(type) {}
+    ConcreteValue(const IR::Type* type, big_int value) : type(type), value(value) {}
+
+    bool isTrue() const { return value != 0; }
+    // The field called 'name', or null if there is none.
+    ConcreteValue* getField(cstring name);
+    const ConcreteValue* getField(cstring name) const
+    { return const_cast<ConcreteValue*>(this)->getField(name); }
+    // Headers are equal if both are invalid, or both valid with equal fields.
+    bool operator==(const ConcreteValue& other) const;
+    bool operator!=(const ConcreteValue& other) const { return !(*this == other); }
+    void dbprint(std::ostream& out) const;
+};
+
+// A packet being parsed, with the headers emitted by the deparser.
+class ConcretePacket {
+    std::vector<uint8_t> data;
+    size_t extracted = 0;  // bits
+    std::vector<uint8_t> emitted;
+    size_t emittedBits = 0;
+
+ public:
+    explicit ConcretePacket(std::vector<uint8_t> data) : data(std::move(data)) {}
+    size_t length() const { return data.size(); }
+    // Bits not yet extracted.
+    size_t available() const { return data.size() * 8 - extracted; }
+    // Reads 'bits' bits, 'offset' bits past the extracted ones, most
+    // significant first.  The caller checks that they are available.
+    big_int peek(unsigned bits, size_t offset = 0) const;
+    big_int extract(unsigned bits) {
+        auto rv = peek(bits);
+        extracted += bits;
+        return rv; }
+    void advance(size_t bits) { extracted += bits; }
+    void emit(const big_int& value, unsigned bits);
+    // The bytes following the extracted headers.
+    std::vector<uint8_t> payload() const;
+    // The emitted headers followed by the payload.
+    std::vector<uint8_t> deparsed() const;
+};
+
+// The entries of a table, held in memory.  Exact tables are indexed by key;
+// the others are searched linearly.
+class ConcreteTable {
+ public:
+    struct KeyMatch {
+        big_int value;
+        big_int mask;   // exact (all ones), lpm (a prefix), ternary, optional
+        big_int high;   // range: value..high
+    };
+    struct Entry {
+        std::vector<KeyMatch> keys;
+        int priority = 0;  // the matching entry with the lowest priority wins
+        const IR::P4Action* action = nullptr;
+        // arguments of the directionless parameters of the action
+        std::vector<ConcreteValue> data;
+    };
+
+    const IR::P4Table* table;
+    // For each key field, its control-plane name, match kind and width
+    std::vector<cstring> keyNames;
+    std::vector<cstring> matchKinds;
+    std::vector<unsigned> widths;
+
+    // The default action, as set by the control plane, if it was.
+    const IR::P4Action* defaultAction = nullptr;
+    std::vector<ConcreteValue> defaultData;
+
+ private:
+    std::vector<Entry> entries;
+    std::map<std::vector<big_int>, size_t> exactIndex;
+    bool exactOnly = true;
+    bool usesPriorities = false;
+    int lpmField = -1;
+
+ public:
+    ConcreteTable(const IR::P4Table* table, const TypeMap* typeMap);
+    size_t size() const { return entries.size(); }
+    // Adds an entry; false if an exact table already has one with this key.
+    bool add(Entry entry);
+    // The entry the key matches, or null on a miss.
+    const Entry* lookup(const std::vector<big_int>& key) const;
+};
+
+// Executes the parsers and controls of a program on packets.  Architectures
+// subclass it to drive their pipeline and implement their externs.
+class ConcreteInterpreter {
+ protected:
+    ReferenceMap* refMap;
+    TypeMap* typeMap;
+    ConcretePacket* packet = nullptr;
+    // The values of the parameters, variables and constants in scope.  There
+    // is no recursion in P4, so each declaration has at most one live value.
+    std::unordered_map<const IR::IDeclaration*, ConcreteValue> values;
+    // Values of expressions that are not variables, whose fields are read.
+    std::deque<ConcreteValue> temporaries;
+    std::map<const IR::P4Table*, ConcreteTable> tables;
+    std::unordered_map<const IR::MethodCallExpression*, MethodInstance*> methods;
+    ConcreteValue returnValue;
+    bool exiting = false;
+
+    enum class Flow { Next, Return, Exit };
+    // The out and inout parameters of a call, and where their values go.
+    typedef std::vector<std::pair<const IR::Parameter*, ConcreteValue*>> CopyOut;
+
+    // Raises a P4 error; parsers stop and reject the packet.
+    void raise(cstring error, const IR::Node* node);
+    MethodInstance* getMethod(const IR::MethodCallExpression* call);
+    ConcreteValue* location(const IR::Expression* expression);
+    void assign(ConcreteValue* dest, const ConcreteValue& value);
+    Flow execute(const IR::StatOrDecl* statement);
+    void declare(const IR::Declaration* decl);
+    ConcreteValue call(const IR::MethodCallExpression* call);
+    // Binds the parameters of a call to its in and inout arguments.
+    // Directionless parameters with no argument take their values from
+    // 'data', in order.
+    void bind(const IR::ParameterList* params, const ParameterSubstitution* args,
+              const std::vector<ConcreteValue>* data, CopyOut* copyOut);
+    // Copies the inout and out parameters back to the arguments.
+    void finish(const CopyOut& copyOut);
+    void invoke(const IR::ParameterList* params, const ParameterSubstitution* args,
+                const std::vector<ConcreteValue>* data, const IR::StatOrDecl* body);
+    ConcreteValue applyTable(const IR::P4Table* table, const IR::MethodCallExpression* call);
+    void extract(const MethodInstance* mi);
+    void read(ConcreteValue* value, size_t* offset, unsigned varbitSize);
+    void emit(const ConcreteValue& value);
+    bool matches(const IR::Expression* keyset, const ConcreteValue& value);
+    const IR::ParserState* nextState(const IR::ParserState* state);
+    void runStates(const IR::P4Parser* parser);
+    void start(const IR::Type_Declaration* container, ConcretePacket* packet,
+               const IR::ParameterList* params, const std::vector<ConcreteValue*>& args);
+    void finish(const IR::ParameterList* params, const std::vector<ConcreteValue*>& args);
+
+    // Implements the externs of the architecture; false if it does not know
+    // the method called.
+    virtual bool callExtern(const MethodInstance* mi, ConcreteValue* result);
+    ConcreteValue argument(const MethodInstance* mi, cstring parameter);
+    ConcreteValue* argumentLocation(const MethodInstance* mi, cstring parameter);
+
+ public:
+    ConcreteInterpreter(ReferenceMap* refMap, TypeMap* typeMap);
+    virtual ~ConcreteInterpreter() {}
+    ReferenceMap* getRefMap() const { return refMap; }
+
+    // A value of 'type' with all bits zero, and headers invalid.
+    ConcreteValue create(const IR::Type* type) const;
+    // Converts an integer to a value of the bit<>, int<> or bool 'type'.
+    ConcreteValue fromInteger(const IR::Type* type, const big_int& value) const;
+    ConcreteValue evaluate(const IR::Expression* expression);
+    // Flattens scalars, in declaration order, into bits.
+    void serialize(const ConcreteValue& value, ConcretePacket* bits) const;
+
+    // The entries of a table, with the program's constant entries loaded.
+    ConcreteTable* getTable(const IR::P4Table* table);
+    // Adds an entry, converting the control-plane arguments of its action.
+    bool addEntry(ConcreteTable* table, std::vector<ConcreteTable::KeyMatch> keys, int priority,
+                  const IR::P4Action* action, const std::vector<big_int>& data);
+    void setDefaultAction(ConcreteTable* table, const IR::P4Action* action,
+                          const std::vector<big_int>& data);
+
+    // Runs a parser on 'packet', with the values of its parameters after the
+    // packet_in one; returns the name of the error it ended with.
+    cstring runParser(const IR::P4Parser* parser, ConcretePacket* packet,
+                      const std::vector<ConcreteValue*>& args);
+    // Runs a control, with the values of its parameters but a packet_out.
+    void runControl(const IR::P4Control* control, ConcretePacket* packet,
+                    const std::vector<ConcreteValue*>& args);
+};
+
+}  // namespace P4
+
+#endif /* _MIDEND_CONCRETEINTERPRETER_H_ */
@@ -18,6 +18,7 @@ limitations under the License.
 #define _MIDEND_COPYSTRUCTURES_H_
 
 #include "ir/ir.h"
+#include "ir/node_kinds.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 
 namespace P4 {
@@ -61,8 +62,11 @@ class DoCopyStructures : public Transform {
     bool errorOnMethodCall;
  public:
     explicit DoCopyStructures(TypeMap* typeMap, bool errorOnMethodCall) :
-            typeMap(typeMap), errorOnMethodCall(errorOnMethodCall)
-    { CHECK_NULL(typeMap); setName("DoCopyStructures"); }
+            typeMap(typeMap), errorOnMethodCall(errorOnMethodCall) {
+        CHECK_NULL(typeMap); setName("DoCopyStructures");
+        setKinds(NodeKinds::of<IR::AssignmentStatement>(),
+                 NodeKinds::of<IR::AssignmentStatement, IR::BlockStatement, IR::Member>());
+    }
     const IR::Node* postorder(IR::AssignmentStatement* statement) override;
 };
 
@@ -95,6 +99,7 @@ class RemoveAliases : public Transform {
             refMap(refMap), typeMap(typeMap) {
         CHECK_NULL(refMap); CHECK_NULL(typeMap);
         setName("RemoveAliases");
+        setKinds(NodeKinds::of<IR::AssignmentStatement>());
     }
 
     const IR::Node* postorder(IR::AssignmentStatement* statement) override;
@@ -6,9 +6,13 @@
 namespace P4 {
 
 unsigned SymbolicValue::crtid = 0;
+std::atomic<unsigned> ValueMap::crtVersion(0);
 
 SymbolicValue* SymbolicValueFactory::create(const IR::Type* type, bool uninitialized) const {
     type = typeMap->getType(type, true);
+    if (type->is<IR::Type_Type>())
+        // the type checker gives types this type
+        type = type->to<IR::Type_Type>()->type;
     if (type->is<IR::Type_Bits>())
         return new SymbolicInteger(ScalarValue::init(uninitialized), type->to<IR::Type_Bits>());
     if (type->is<IR::Type_Boolean>())
@@ -80,6 +84,9 @@ bool SymbolicValueFactory::isFixedWidth(const IR::Type* type) const {
 
 unsigned SymbolicValueFactory::getWidth(const IR::Type* type) const {
     type = typeMap->getType(type, true);
+    if (type->is<IR::Type_Type>())
+        // the type checker gives types this type
+        type = type->to<IR::Type_Type>()->type;
     if (type->is<IR::Type_Bits>())
         return type->to<IR::Type_Bits>()->size;
     if (type->is<IR::Type_Boolean>())
@@ -247,7 +254,8 @@ SymbolicStruct::SymbolicStruct(const IR::Type_StructLike* type, bool uninitializ
 SymbolicValue* SymbolicStruct::clone() const {
     auto result = new SymbolicStruct(type->to<IR::Type_StructLike>());
     for (auto f : fieldValue)
-        result->fieldValue[f.first] = f.second->clone();
+        f.second->share();
+    result->fieldValue = fieldValue;
     return result;
 }
 
@@ -255,31 +263,41 @@ void SymbolicStruct::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicStruct>(), "%1%: expected a struct", other);
     auto sv = other->to<SymbolicStruct>();
-    for (auto f : sv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
+    for (auto f : sv->fieldValue) {
+        auto& field = fieldValue[f.first];
+        if (field != f.second)
+            unshare(field)->assign(f.second);
+    }
 }
 
 bool SymbolicStruct::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicStruct>(), "%1%: expected a struct", other);
     auto sv = other->to<SymbolicStruct>();
     bool changes = false;
-    for (auto f : sv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
+    for (auto f : sv->fieldValue) {
+        auto& field = fieldValue[f.first];
+        if (field != f.second)
+            changes = changes || unshare(field)->merge(f.second);
+    }
     return changes;
 }
 
 void SymbolicStruct::setAllUnknown() {
     for (auto f : type->to<IR::Type_StructLike>()->fields)
-        fieldValue[f->name.name]->setAllUnknown();
+        unshare(fieldValue[f->name.name])->setAllUnknown();
 }
 
 bool SymbolicStruct::equals(const SymbolicValue* other) const {
+    if (other == this)
+        return true;
     if (!other->is<SymbolicStruct>())
         return false;
     auto sv = other->to<SymbolicStruct>();
-    for (auto f : sv->fieldValue)
-        if (!get(nullptr, f.first)->equals(f.second))
+    for (auto f : sv->fieldValue) {
+        auto field = get(nullptr, f.first);
+        if (field != f.second && !field->equals(f.second))
             return false;
+    }
     return true;
 }
 
@@ -326,14 +344,16 @@ SymbolicValue* SymbolicHeader::get(const IR::Node* node, cstring field) const {
 
 void SymbolicHeader::setAllUnknown() {
     SymbolicStruct::setAllUnknown();
-    valid->setAllUnknown();
+    unshare(valid)->setAllUnknown();
 }
 
 SymbolicValue* SymbolicHeader::clone() const {
     auto result = new SymbolicHeader(type->to<IR::Type_Header>());
     for (auto f : fieldValue)
-        result->fieldValue[f.first] = f.second->clone();
-    result->valid = valid->clone()->to<SymbolicBool>();
+        f.second->share();
+    result->fieldValue = fieldValue;
+    valid->share();
+    result->valid = valid;
     return result;
 }
 
@@ -341,22 +361,23 @@ void SymbolicHeader::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicHeader>(), "%1%: expected a header", other);
     auto hv = other->to<SymbolicHeader>();
-    for (auto f : hv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
-    valid->assign(hv->valid);
+    SymbolicStruct::assign(hv);
+    if (valid != hv->valid)
+        unshare(valid)->assign(hv->valid);
 }
 
 bool SymbolicHeader::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicHeader>(), "%1%: expected a header", other);
     auto hv = other->to<SymbolicHeader>();
-    bool changes = false;
-    for (auto f : hv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
-    changes = changes || valid->merge(hv->valid);
+    bool changes = SymbolicStruct::merge(hv);
+    if (valid != hv->valid)
+        changes = changes || unshare(valid)->merge(hv->valid);
     return changes;
 }
 
 bool SymbolicHeader::equals(const SymbolicValue* other) const {
+    if (other == this)
+        return true;
     if (!other->is<SymbolicHeader>())
         return false;
     auto sh = other->to<SymbolicHeader>();
@@ -393,16 +414,19 @@ SymbolicArray::SymbolicArray(const IR::Type_Stack* type, bool uninitialized,
 }
 
 void SymbolicArray::shift(int amount) {
+    // elements moved may still be in their old place as well
+    for (auto v : values)
+        v->share();
     if (amount < 0) {
         for (unsigned i = 0; i < values.size() + amount; i++)
             values[i] = values[i - amount];
         for (unsigned i = values.size() + amount; i < values.size(); i++)
-            values[i]->setValid(false);
+            unshare(values[i])->setValid(false);
     } else if (amount > 0) {
         for (unsigned i = 0; i < values.size() - amount; i++)
             values[values.size() - i - 1] = values[values.size() - i - amount - 1];
         for (unsigned i = 0; i < (unsigned)amount; i++)
-            values[i]->setValid(false);
+            unshare(values[i])->setValid(false);
     }
 }
 
@@ -412,7 +436,7 @@ SymbolicValue* SymbolicArray::next(const IR::Node* node) {
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (!v->valid->value)
-            return v;
+            return unshare(values.at(i));
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
@@ -424,44 +448,77 @@ SymbolicValue* SymbolicArray::last(const IR::Node* node) {
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (v->valid->value)
-            return v;
+            return unshare(values.at(index));
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
 
+int SymbolicArray::nextIndex() const {
+    for (unsigned i = 0; i < values.size(); i++) {
+        auto v = values.at(i);
+        if (v->valid->isUnknown() || v->valid->isUninitialized())
+            return -1;
+        if (!v->valid->value)
+            return i;
+    }
+    return -1;
+}
+
+int SymbolicArray::lastIndex() const {
+    for (unsigned i = 0; i < values.size(); i++) {
+        unsigned index = values.size() - i - 1;
+        auto v = values.at(index);
+        if (v->valid->isUnknown() || v->valid->isUninitialized())
+            return -1;
+        if (v->valid->value)
+            return index;
+    }
+    return -1;
+}
+
 void SymbolicArray::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        unshare(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicArray::clone() const {
     auto result = new SymbolicArray(type->to<IR::Type_Stack>());
-    for (unsigned i=0; i < values.size(); i++)
-        result->values.push_back(get(nullptr, i)->clone()->to<SymbolicHeader>());
+    for (auto v : values)
+        v->share();
+    result->values = values;
     return result;
 }
 
 void SymbolicArray::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
-    for (unsigned i=0; i < values.size(); i++)
-        values.at(i)->assign(other->to<SymbolicArray>()->get(nullptr, i));
+    for (unsigned i=0; i < values.size(); i++) {
+        auto value = other->to<SymbolicArray>()->get(nullptr, i);
+        if (values.at(i) != value)
+            unshare(values.at(i))->assign(value);
+    }
 }
 
 bool SymbolicArray::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
     bool changes = false;
-    for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(other->to<SymbolicArray>()->get(nullptr, i));
+    for (unsigned i=0; i < values.size(); i++) {
+        auto value = other->to<SymbolicArray>()->get(nullptr, i);
+        if (values.at(i) != value)
+            changes = changes || unshare(values.at(i))->merge(value);
+    }
     return changes;
 }
 
 bool SymbolicArray::equals(const SymbolicValue* other) const {
+    if (other == this)
+        return true;
     if (!other->is<SymbolicArray>())
         return false;
     auto sa = other->to<SymbolicArray>();
     for (unsigned i=0; i < values.size(); i++) {
-        if (!values.at(i)->equals(sa->get(nullptr, i)))
+        auto value = sa->get(nullptr, i);
+        if (values.at(i) != value && !values.at(i)->equals(value))
             return false;
     }
     return true;
@@ -517,13 +574,14 @@ SymbolicTuple::SymbolicTuple(const IR::Type_Tuple* type, bool uninitialized,
 
 void SymbolicTuple::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        unshare(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicTuple::clone() const {
     auto result = new SymbolicTuple(type->to<IR::Type_Tuple>());
-    for (unsigned i=0; i < values.size(); i++)
-        result->values.push_back(get(i)->clone());
+    for (auto v : values)
+        v->share();
+    result->values = values;
     return result;
 }
 
@@ -532,8 +590,10 @@ bool SymbolicTuple::merge(const SymbolicValue* other) {
     auto tpl = other->to<SymbolicTuple>();
     BUG_CHECK(values.size() == tpl->values.size(), "merging tuples with different sizes");
     bool changes = false;
-    for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(tpl->get(i));
+    for (unsigned i=0; i < values.size(); i++) {
+        if (values.at(i) != tpl->get(i))
+            changes = changes || unshare(values.at(i))->merge(tpl->get(i));
+    }
     return changes;
 }
 
@@ -772,7 +832,7 @@ void ExpressionEvaluator::postorder(const IR::Member* expression) {
         set(expression, v);
     } else {
         BUG_CHECK(l->is<SymbolicStruct>(), "%1%: expected a struct", l);
-        auto v = l->to<SymbolicStruct>()->get(expression, expression->member.name);
+        auto v = l->to<SymbolicStruct>()->getWritable(expression, expression->member.name);
         set(expression, v);
     }
 }
@@ -816,7 +876,7 @@ void ExpressionEvaluator::postorder(const IR::ArrayIndex* expression) {
     CHECK_NULL(lv);
     auto ix = r->to<SymbolicInteger>();
     CHECK_NULL(ix);
-    auto result = lv->get(expression, ix->constant->asInt());
+    auto result = lv->getWritable(expression, ix->constant->asInt());
     set(expression, result);
 }
 
@@ -827,7 +887,7 @@ void ExpressionEvaluator::postorder(const IR::PathExpression* expression) {
     if (type->is<IR::Type_Error>())
         result = new SymbolicEnum(type, decl->getName());
     else
-        result = valueMap->get(decl);
+        result = valueMap->getWritable(decl);
     set(expression, result);
 }
 
@@ -928,7 +988,7 @@ void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression)
                 }
 
                 auto decl = em->object;
-                auto obj = valueMap->get(decl);
+                auto obj = valueMap->getWritable(decl);
                 CHECK_NULL(obj);
                 if (obj->is<SymbolicError>()) {
                     set(expression, obj);
@@ -17,7 +17,9 @@ limitations under the License.
 #ifndef _MIDEND_INTERPRETER_H_
 #define _MIDEND_INTERPRETER_H_
 
+#include <atomic>
 #include "ir/ir.h"
+#include "lib/hamt.h"
 #include "frontends/common/resolveReferences/referenceMap.h"
 #include "frontends/p4/typeMap.h"
 #include "frontends/p4/coreLibrary.h"
@@ -31,6 +33,10 @@ class SymbolicValueFactory;
 // Base class for all abstract values
 class SymbolicValue {
     static unsigned crtid;
+    // Set when the value becomes reachable from more than one place, by
+    // cloning the value containing it.  A shared value is never changed again:
+    // its containers replace it with a clone first.
+    mutable bool shared = false;
 
  protected:
     explicit SymbolicValue(const IR::Type* type) : id(crtid++), type(type) {}
@@ -47,7 +53,15 @@ class SymbolicValue {
         auto result = dynamic_cast<const T*>(this);
         CHECK_NULL(result); return result; }
     template<typename T> bool is() const { return dynamic_cast<const T*>(this) != nullptr; }
+    // Clones are shallow: the components of a value are shared with its clone.
     virtual SymbolicValue* clone() const = 0;
+    void share() const { shared = true; }
+    bool isShared() const { return shared; }
+    // Replaces 'value' with a clone if it is shared, so that it can be changed.
+    template<typename T> static T* unshare(T*& value) {
+        if (value->shared)
+            value = value->clone()->template to<T>();
+        return value; }
     virtual void setAllUnknown() = 0;
     virtual void assign(const SymbolicValue* other) = 0;
     // Merging two symbolic values; values should form a lattice.
@@ -73,30 +87,72 @@ class SymbolicValueFactory {
     unsigned getWidth(const IR::Type* type) const;
 };
 
+// Values of the declarations at a program point.  The map is persistent, so
+// cloning it takes constant time: the clone shares the entries with the
+// original, and a value is copied by the first map that writes to it.
 class ValueMap final : public IHasDbPrint {
+    struct Entry {
+        SymbolicValue* value;
+        // The version of the map when the value was stored.  Cloning changes
+        // the versions of both maps, so entries from before the clone are
+        // copied before being written.
+        unsigned version;
+    };
+    hamt<const IR::IDeclaration*, Entry> map;
+    mutable unsigned version;
+    static std::atomic<unsigned> crtVersion;
+
  public:
-    std::map<const IR::IDeclaration*, SymbolicValue*> map;
+    class const_iterator {
+        hamt<const IR::IDeclaration*, Entry>::const_iterator it;
+     public:
+        explicit const_iterator(hamt<const IR::IDeclaration*, Entry>::const_iterator it) :
+                it(it) {}
+        std::pair<const IR::IDeclaration*, const SymbolicValue*> operator*() const
+        { return std::make_pair(it->first, it->second.value); }
+        const_iterator& operator++() { ++it; return *this; }
+        bool operator!=(const const_iterator& other) const { return it != other.it; }
+    };
+
+    ValueMap() : version(++crtVersion) {}
     ValueMap* clone() const {
-        auto result = new ValueMap();
-        for (auto v : map)
-            result->map.emplace(v.first, v.second->clone());
+        auto result = new ValueMap(*this);
+        result->version = ++crtVersion;
+        version = ++crtVersion;
         return result;
     }
     ValueMap* filter(std::function<bool(const IR::IDeclaration*, const SymbolicValue*)> filter) {
         auto result = new ValueMap();
         for (auto v : map)
-            if (filter(v.first, v.second))
-                result->map.emplace(v.first, v.second);
+            if (filter(v.first, v.second.value))
+                result->map.set(v.first, Entry{v.second.value, 0});  // shared
+        version = ++crtVersion;
         return result;
     }
     void set(const IR::IDeclaration* left, SymbolicValue* right)
-    { CHECK_NULL(left); CHECK_NULL(right); map[left] = right; }
-    SymbolicValue* get(const IR::IDeclaration* left) const
-    { CHECK_NULL(left); return ::get(map, left); }
+    { CHECK_NULL(left); CHECK_NULL(right); map.set(left, Entry{right, version}); }
+    const SymbolicValue* get(const IR::IDeclaration* left) const {
+        CHECK_NULL(left);
+        auto e = map.lookup(left);
+        return e ? e->value : nullptr; }
+    // Like get, but the value can be changed.
+    SymbolicValue* getWritable(const IR::IDeclaration* left) {
+        CHECK_NULL(left);
+        auto e = map.lookup(left);
+        if (e == nullptr)
+            return nullptr;
+        if (e->version == version)
+            return e->value;
+        auto value = e->value->clone();
+        map.set(left, Entry{value, version});
+        return value;
+    }
+    const_iterator begin() const { return const_iterator(map.begin()); }
+    const_iterator end() const { return const_iterator(map.end()); }
 
     void dbprint(std::ostream& out) const {
         bool first = true;
-        for (auto f : map) {
+        for (auto f : *this) {
             if (!first)
                 out << std::endl;
             out << f.first << "=>" << f.second;
@@ -106,22 +162,25 @@ class ValueMap final : public IHasDbPrint {
     bool merge(const ValueMap* other) {
         bool change = false;
         BUG_CHECK(map.size() == other->map.size(), "Merging incompatible maps?");
-        for (auto d : map) {
-            auto v = other->get(d.first);
-            CHECK_NULL(v);
-            change = change || d.second->merge(v);
-        }
+        // getWritable changes the map, so walk a copy of it
+        auto before = map;
+        before.for_each_unshared(other->map,
+            [this, &change](const std::pair<const IR::IDeclaration*, Entry>& d,
+                            const Entry* v) {
+                CHECK_NULL(v);
+                if (d.second.value != v->value)
+                    change = getWritable(d.first)->merge(v->value) || change;
+                return true;
+            });
         return change;
     }
     bool equals(const ValueMap* other) const {
         BUG_CHECK(map.size() == other->map.size(), "Incompatible maps compared");
-        for (auto v : map) {
-            auto ov = other->get(v.first);
-            CHECK_NULL(ov);
-            if (!v.second->equals(ov))
-                return false;
-        }
-        return true;
+        return map.for_each_unshared(other->map,
+            [](const std::pair<const IR::IDeclaration*, Entry>& v, const Entry* ov) {
+                CHECK_NULL(ov);
+                return v.second.value == ov->value || v.second.value->equals(ov->value);
+            });
     }
 };
 
@@ -376,6 +435,14 @@ class SymbolicStruct : public SymbolicValue {
         CHECK_NULL(r);
         return r;
     }
+    // Like get, but the field value can be changed.
+    SymbolicValue* getWritable(const IR::Node* node, cstring field) {
+        auto r = get(node, field);
+        auto it = fieldValue.find(field);
+        if (it != fieldValue.end() && it->second == r)
+            return unshare(it->second);
+        return r;  // an error
+    }
     void set(cstring field, SymbolicValue* value) {
         CHECK_NULL(value);
         fieldValue[field] = value;
@@ -423,6 +490,12 @@ class SymbolicArray final : public SymbolicValue {
             return new SymbolicStaticError(node, "Out of bounds");
         return values.at(index);
     }
+    // Like get, but the element can be changed.
+    SymbolicValue* getWritable(const IR::Node* node, size_t index) {
+        if (index >= values.size())
+            return new SymbolicStaticError(node, "Out of bounds");
+        return unshare(values.at(index));
+    }
     void shift(int amount);  // negative = shift left
     void set(size_t index, SymbolicHeader* value) {
         CHECK_NULL(value);
@@ -432,6 +505,10 @@ class SymbolicArray final : public SymbolicValue {
     SymbolicValue* clone() const override;
     SymbolicValue* next(const IR::Node* node);
     SymbolicValue* last(const IR::Node* node);
+    // Index of the element next (or last) refers to; -1 if we cannot
+    // tell statically, or if the access is out of bounds.
+    int nextIndex() const;
+    int lastIndex() const;
     bool isScalar() const override { return false; }
     void setAllUnknown() override;
     void assign(const SymbolicValue* other) override;
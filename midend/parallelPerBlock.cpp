@@ -0,0 +1,133 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "parallelPerBlock.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+#include "lib/thread_pool.h"
+
+namespace P4 {
+
+namespace {
+
+bool isBlock(const IR::Node *node) {
+    return node->is<IR::P4Control>() || node->is<IR::P4Parser>();
+}
+
+/// An empty block with the same name and signature as @block, so that the rest
+/// of the program still type-checks without it.
+const IR::Node *stub(const IR::Node *block) {
+    if (auto control = block->to<IR::P4Control>())
+        return new IR::P4Control(control->srcInfo, control->name, control->type,
+                                 control->constructorParams, {},
+                                 new IR::BlockStatement(control->body->srcInfo));
+    auto parser = block->to<IR::P4Parser>();
+    BUG_CHECK(parser, "%1%: not a block", block);
+    IR::IndexedVector<IR::ParserState> states;
+    states.push_back(new IR::ParserState(
+        IR::ParserState::start, new IR::PathExpression(IR::ParserState::accept)));
+    states.push_back(new IR::ParserState(IR::ParserState::accept, nullptr));
+    states.push_back(new IR::ParserState(IR::ParserState::reject, nullptr));
+    return new IR::P4Parser(parser->srcInfo, parser->name, parser->type,
+                            parser->constructorParams, {}, states);
+}
+
+bool unchanged(const IR::Node *before, const IR::Node *after) {
+    return before == after || before->equiv(*after);
+}
+
+}  // namespace
+
+const IR::Node *ParallelPerBlock::runWhole(const IR::Node *node) {
+    auto pipeline = makePipeline(refMap, typeMap);
+    return node->apply(*pipeline);
+}
+
+const IR::P4Program *ParallelPerBlock::runPerBlock(const IR::P4Program *program,
+                                                   const std::vector<size_t> &blocks) {
+    IR::Vector<IR::Node> stubbed = program->objects;
+    for (auto i : blocks)
+        stubbed[i] = stub(program->objects[i]);
+
+    std::vector<const IR::P4Program *> shards, results(blocks.size());
+    std::vector<ReferenceMap *> shardRefMaps(blocks.size());
+    std::vector<std::function<void()>> tasks;
+    for (size_t k = 0; k < blocks.size(); ++k) {
+        auto objects = stubbed;
+        objects[blocks[k]] = program->objects[blocks[k]];
+        shards.push_back(new IR::P4Program(program->srcInfo, objects));
+        tasks.emplace_back([this, k, &shards, &results, &shardRefMaps]() {
+            auto shardRefMap = shardRefMaps[k] = new ReferenceMap;
+            shardRefMap->setIsV1(refMap->isV1());
+            auto shardTypeMap = new TypeMap;
+            // resolve first so that names generated by the pipeline don't clash
+            // with the ones already used in the block
+            PassManager pipeline({
+                new ResolveReferences(shardRefMap),
+                makePipeline(shardRefMap, shardTypeMap) });
+            pipeline.setName(name());
+            auto result = shards[k]->apply(pipeline);
+            results[k] = result ? result->to<IR::P4Program>() : nullptr; }); }
+    Util::ThreadPool::get().run(tasks);
+
+    auto objects = program->objects;
+    for (size_t k = 0; k < blocks.size(); ++k) {
+        auto shard = shards[k], result = results[k];
+        if (!result || result->objects.size() != shard->objects.size()) return nullptr;
+        for (size_t i = 0; i < shard->objects.size(); ++i) {
+            if (i != blocks[k] && !unchanged(shard->objects[i], result->objects[i])) {
+                LOG2(name() << " changed " << shard->objects[i] << " while processing "
+                     << shard->objects[blocks[k]]);
+                return nullptr; } }
+        auto before = shard->objects[blocks[k]]->to<IR::Type_Declaration>();
+        auto after = result->objects[blocks[k]]->to<IR::Type_Declaration>();
+        if (!after || !isBlock(after) || before->name != after->name ||
+            !unchanged(before->to<IR::IApply>()->getApplyMethodType(),
+                       after->to<IR::IApply>()->getApplyMethodType()) ||
+            !unchanged(before->to<IR::IContainer>()->getConstructorParameters(),
+                       after->to<IR::IContainer>()->getConstructorParameters())) {
+            LOG2(name() << " changed the signature of " << before);
+            return nullptr; }
+        objects[blocks[k]] = after; }
+    if (objects == program->objects) return program;
+    // The names the shards generated are in the stitched program now, so later
+    // passes must not generate them again before the maps are recomputed.
+    for (auto shardRefMap : shardRefMaps)
+        refMap->addUsedNames(shardRefMap);
+    return new IR::P4Program(program->srcInfo, objects);
+}
+
+const IR::Node *ParallelPerBlock::apply_visitor(const IR::Node *node, const char *) {
+    auto program = node->to<IR::P4Program>();
+    if (!program || !Util::ThreadPool::get().enabled())
+        return runWhole(node);
+    std::vector<size_t> blocks;
+    for (size_t i = 0; i < program->objects.size(); ++i)
+        if (isBlock(program->objects[i]))
+            blocks.push_back(i);
+    if (blocks.size() < 2)
+        return runWhole(node);
+
+    unsigned errors = ::errorCount();
+    auto result = runPerBlock(program, blocks);
+    if (::errorCount() > errors)
+        // the errors have been reported already; don't report them again
+        return result ? result : program;
+    if (result) return result;
+    LOG1(name() << ": pipeline is not block-local, running it on the whole program");
+    return runWhole(node);
+}
+
+}  // namespace P4
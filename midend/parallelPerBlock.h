@@ -0,0 +1,68 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _MIDEND_PARALLELPERBLOCK_H_
+#define _MIDEND_PARALLELPERBLOCK_H_
+
+#include "ir/ir.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/typeMap.h"
+
+namespace P4 {
+
+/**
+ * Runs a pipeline of passes that only transform the insides of P4Control and
+ * P4Parser blocks (e.g. RemoveExits, Predication, LocalCopyPropagation) on each
+ * block separately, concurrently when the thread pool is enabled with --threads.
+ *
+ * Every block is processed in a copy of the program in which all the other
+ * blocks are replaced by empty stubs with the same name and signature, by a
+ * fresh instance of the pipeline with its own ReferenceMap and TypeMap.  The
+ * resulting blocks are then stitched back into a new P4Program, and the names
+ * the shards used or generated are added to the ReferenceMap given to the
+ * constructor, so that it does not generate them again.
+ *
+ * If the pipeline changes anything outside the block it is working on (e.g. it
+ * adds a top-level declaration or changes the signature of a block), the
+ * per-block results are discarded and the pipeline is rerun over the whole
+ * program with the maps given to the constructor.  That is also what happens
+ * when the thread pool is not enabled.
+ */
+class ParallelPerBlock : public Visitor {
+ public:
+    /// Builds a new instance of the pipeline, using the given maps.
+    typedef std::function<Visitor *(ReferenceMap *, TypeMap *)> PipelineFactory;
+
+ private:
+    ReferenceMap        *refMap;
+    TypeMap             *typeMap;
+    PipelineFactory     makePipeline;
+
+    const IR::Node *runWhole(const IR::Node *node);
+    const IR::P4Program *runPerBlock(const IR::P4Program *program,
+                                     const std::vector<size_t> &blocks);
+
+ public:
+    ParallelPerBlock(ReferenceMap *refMap, TypeMap *typeMap, PipelineFactory makePipeline)
+            : refMap(refMap), typeMap(typeMap), makePipeline(makePipeline) {
+        CHECK_NULL(refMap); CHECK_NULL(typeMap);
+        setName("ParallelPerBlock"); }
+    const IR::Node *apply_visitor(const IR::Node *node, const char * = 0) override;
+};
+
+}  // namespace P4
+
+#endif /* _MIDEND_PARALLELPERBLOCK_H_ */
@@ -42,6 +42,48 @@ struct AllDefinitions {
     std::map<const IR::Node*, Definitions*> perStatement;
 };
 
+// Replaces the .next and .last of header stacks with the index they refer to
+// when the variables have the specified values.
+class ConstantStackIndexes : public Transform {
+    ReferenceMap*   refMap;
+    TypeMap*        typeMap;
+    const ValueMap* values;
+
+ public:
+    bool failed = false;  // set if some index cannot be computed statically
+
+    ConstantStackIndexes(ReferenceMap* refMap, TypeMap* typeMap, const ValueMap* values) :
+            refMap(refMap), typeMap(typeMap), values(values) {
+        CHECK_NULL(refMap); CHECK_NULL(typeMap); CHECK_NULL(values);
+        setName("ConstantStackIndexes");
+    }
+
+    const IR::Node* postorder(IR::Member* expression) override {
+        bool last = expression->member.name == IR::Type_Stack::last;
+        if (!last && expression->member.name != IR::Type_Stack::next)
+            return expression;
+        auto orig = getOriginal<IR::Member>();
+        auto type = typeMap->getType(orig->expr, true);
+        if (!type->is<IR::Type_Stack>())
+            return expression;
+        // the evaluator may change the map it is given
+        ExpressionEvaluator ev(refMap, typeMap, values->clone());
+        auto value = ev.evaluate(orig->expr, true);
+        int index = -1;
+        if (value->is<SymbolicArray>()) {
+            auto array = value->to<SymbolicArray>();
+            index = last ? array->lastIndex() : array->nextIndex();
+        }
+        if (index < 0) {
+            LOG2("Cannot compute the index of " << orig);
+            failed = true;
+            return expression;
+        }
+        return new IR::ArrayIndex(expression->srcInfo, expression->expr,
+                                  new IR::Constant(index));
+    }
+};
+
 class ParserSymbolicInterpreter {
     ParserStructure*    structure;
     const IR::P4Parser* parser;
@@ -50,6 +92,7 @@ class ParserSymbolicInterpreter {
     SymbolicValueFactory* factory;
     ParserInfo*         synthesizedParser;  // output produced
     bool                unroll;
+    unsigned            maxStateCopies;
 
     ValueMap* initializeVariables() {
         ValueMap* result = new ValueMap();
@@ -86,13 +129,45 @@ class ParserSymbolicInterpreter {
         return result;
     }
 
+    static bool isPredecessor(const ParserStateInfo* state, const ParserStateInfo* of) {
+        for (auto crt = of; crt != nullptr; crt = crt->predecessor)
+            if (crt == state)
+                return true;
+        return false;
+    }
+
+    // Returns the state produced for stateName when reached with the specified
+    // values from predecessor; existing is set if this was produced before.
+    // Returns nullptr for accept and reject, and when there would be too many
+    // copies of stateName.
     ParserStateInfo* newStateInfo(const ParserStateInfo* predecessor,
-                                  cstring stateName, ValueMap* values) {
+                                  cstring stateName, ValueMap* values, bool& existing) {
+        existing = false;
         if (stateName == IR::ParserState::accept ||
             stateName == IR::ParserState::reject)
             return nullptr;
         auto state = structure->get(stateName);
-        auto pi = new ParserStateInfo(stateName, parser, state, predecessor, values->clone());
+        auto copies = synthesizedParser->get(stateName);
+        for (auto si : *copies) {
+            // Reaching one of our predecessors again with the same values is
+            // a loop that checkLoops has to report.
+            if (si->before->equals(values) && !isPredecessor(si, predecessor)) {
+                LOG2("Reusing " << si->name << " for " << stateName);
+                existing = true;
+                return si;
+            }
+        }
+        if (copies->size() >= maxStateCopies) {
+            if (unroll)
+                ::error("%1%: parser state would be unrolled more than %2% times\n%3%",
+                        state, maxStateCopies, stateChain(predecessor));
+            synthesizedParser->complete = false;
+            return nullptr;
+        }
+        cstring name = stateName;
+        if (unroll && !copies->empty())
+            name = refMap->newName(stateName);
+        auto pi = new ParserStateInfo(name, parser, state, predecessor, values->clone());
         synthesizedParser->add(pi);
         return pi;
     }
@@ -114,13 +189,14 @@ class ParserSymbolicInterpreter {
     }
 
     // Return false if an error can be detected statically
-    bool reportIfError(const ParserStateInfo* state, SymbolicValue* value) const {
+    bool reportIfError(ParserStateInfo* state, SymbolicValue* value) const {
         if (value->is<SymbolicException>()) {
             auto exc = value->to<SymbolicException>();
+            state->exception = exc;
 
             bool stateClone = false;
             auto orig = state->state;
-            auto crt = state;
+            const ParserStateInfo* crt = state;
             while (crt->predecessor != nullptr) {
                 crt = crt->predecessor;
                 if (crt->state == orig) {
@@ -147,7 +223,7 @@ class ParserSymbolicInterpreter {
     // Executes symbolically the specified statement.
     // Returns 'true' if execution completes successfully,
     // and 'false' if an error occurred.
-    bool executeStatement(const ParserStateInfo* state, const IR::StatOrDecl* sord,
+    bool executeStatement(ParserStateInfo* state, const IR::StatOrDecl* sord,
                           ValueMap* valueMap) const {
         ExpressionEvaluator ev(refMap, typeMap, valueMap);
 
@@ -174,30 +250,42 @@ class ParserSymbolicInterpreter {
         return success;
     }
 
-    std::vector<ParserStateInfo*>* evaluateSelect(const ParserStateInfo* state) {
-        // TODO: update next state map
+    // Adds to result the state produced for the successor called path,
+    // unless it was already produced.
+    void addSuccessor(ParserStateInfo* state, const IR::Path* path,
+                      std::vector<ParserStateInfo*>* result) {
+        auto next = refMap->getDeclaration(path);
+        BUG_CHECK(next->is<IR::ParserState>(), "%1%: expected a state", path);
+        cstring name = next->getName();
+        if (state->nextStates.count(name))
+            return;
+        bool existing;
+        auto nextInfo = newStateInfo(state, name, state->after, existing);
+        if (nextInfo == nullptr)
+            return;
+        state->nextStates.emplace(name, nextInfo);
+        if (!existing)
+            result->push_back(nextInfo);
+    }
+
+    std::vector<ParserStateInfo*>* evaluateSelect(ParserStateInfo* state) {
         auto select = state->state->selectExpression;
         if (select == nullptr)
             return nullptr;
+        if (unroll) {
+            ConstantStackIndexes csi(refMap, typeMap, state->after);
+            state->selectExpression = select->apply(csi);
+            if (csi.failed)
+                synthesizedParser->complete = false;
+        }
         auto result = new std::vector<ParserStateInfo*>();
         if (select->is<IR::PathExpression>()) {
-            auto path = select->to<IR::PathExpression>()->path;
-            auto next = refMap->getDeclaration(path);
-            BUG_CHECK(next->is<IR::ParserState>(), "%1%: expected a state", path);
-            auto nextInfo = newStateInfo(state, next->getName(), state->after);
-            if (nextInfo != nullptr)
-                result->push_back(nextInfo);
+            addSuccessor(state, select->to<IR::PathExpression>()->path, result);
         } else if (select->is<IR::SelectExpression>()) {
             // TODO: really try to match cases; today we are conservative
             auto se = select->to<IR::SelectExpression>();
-            for (auto c : se->selectCases) {
-                auto path = c->state->path;
-                auto next = refMap->getDeclaration(path);
-                BUG_CHECK(next->is<IR::ParserState>(), "%1%: expected a state", path);
-                auto nextInfo = newStateInfo(state, next->getName(), state->after);
-                if (nextInfo != nullptr)
-                    result->push_back(nextInfo);
-            }
+            for (auto c : se->selectCases)
+                addSuccessor(state, c->state->path, result);
         } else {
             BUG("%1%: unexpected expression", select);
         }
@@ -238,7 +326,7 @@ class ParserSymbolicInterpreter {
 
     // True if any header has changed its "validity" bit
     static bool headerValidityChange(const ValueMap* before, const ValueMap* after) {
-        for (auto v : before->map) {
+        for (auto v : *before) {
             auto value = v.second;
             if (headerValidityChanged(value, after->get(v.first)))
                 return true;
@@ -262,7 +350,7 @@ class ParserSymbolicInterpreter {
                 auto prevPackets = crt->before->filter(filter);
                 if (packets->equals(prevPackets)) {
                     bool conservative = false;
-                    for (auto p : state->before->map) {
+                    for (auto p : *state->before) {
                         auto pkt = p.second->to<SymbolicPacketIn>();
                         if (pkt->isConservative()) {
                             conservative = true;
@@ -297,9 +385,25 @@ class ParserSymbolicInterpreter {
         LOG1("Analyzing " << state->state);
         auto valueMap = state->before->clone();
         for (auto s : state->state->components) {
+            const IR::StatOrDecl* rewritten = s;
+            bool constantIndexes = true;
+            if (unroll) {
+                ConstantStackIndexes csi(refMap, typeMap, valueMap);
+                rewritten = s->apply(csi)->to<IR::StatOrDecl>();
+                constantIndexes = !csi.failed;
+            }
             bool success = executeStatement(state, s, valueMap);
-            if (!success)
+            if (!success) {
+                // The unrolled state raises StackOutOfBounds itself; other
+                // exceptions are not P4 errors, and errors have been reported.
+                if (state->exception == nullptr ||
+                    state->exception->exc != P4::StandardExceptions::StackOutOfBounds)
+                    synthesizedParser->complete = false;
                 return nullptr;
+            }
+            if (!constantIndexes)
+                synthesizedParser->complete = false;
+            state->components.push_back(rewritten);
         }
         state->after = valueMap;
         auto result = evaluateSelect(state);
@@ -308,9 +412,9 @@ class ParserSymbolicInterpreter {
 
  public:
     ParserSymbolicInterpreter(ParserStructure* structure, ReferenceMap* refMap,
-                              TypeMap* typeMap, bool unroll)
+                              TypeMap* typeMap, bool unroll, unsigned maxStateCopies)
             : structure(structure), refMap(refMap), typeMap(typeMap),
-              synthesizedParser(nullptr), unroll(unroll) {
+              synthesizedParser(nullptr), unroll(unroll), maxStateCopies(maxStateCopies) {
         CHECK_NULL(structure); CHECK_NULL(refMap); CHECK_NULL(typeMap);
         factory = new SymbolicValueFactory(typeMap);
         parser = structure->parser;
@@ -319,10 +423,13 @@ class ParserSymbolicInterpreter {
     ParserInfo* run() {
         synthesizedParser = new ParserInfo();
         auto initMap = initializeVariables();
-        if (initMap == nullptr)
+        if (initMap == nullptr) {
             // error during initializer evaluation
+            synthesizedParser->complete = false;
             return synthesizedParser;
-        auto startInfo = newStateInfo(nullptr, structure->start->name.name, initMap);
+        }
+        bool existing;
+        auto startInfo = newStateInfo(nullptr, structure->start->name.name, initMap, existing);
         std::vector<ParserStateInfo*> toRun;  // worklist
         toRun.push_back(startInfo);
 
@@ -331,9 +438,11 @@ class ParserSymbolicInterpreter {
             toRun.pop_back();
             LOG1("Symbolic evaluation of " << stateChain(stateInfo));
             bool infLoop = checkLoops(stateInfo);
-            if (infLoop)
+            if (infLoop) {
                 // don't evaluate successors anymore
+                synthesizedParser->complete = false;
                 continue;
+            }
             auto nextStates = evaluateState(stateInfo);
             if (nextStates == nullptr) {
                 LOG1("No next states");
@@ -347,9 +456,86 @@ class ParserSymbolicInterpreter {
 };
 }  // namespace ParserStructureImpl
 
-void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) {
-    ParserStructureImpl::ParserSymbolicInterpreter psi(this, refMap, typeMap, unroll);
+void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                              unsigned maxStateCopies) {
+    ParserStructureImpl::ParserSymbolicInterpreter psi(
+        this, refMap, typeMap, unroll, maxStateCopies);
     result = psi.run();
 }
 
+/////////////////////////////////////
+
+const IR::PathExpression* ParserUnroller::nextState(const ParserStateInfo* state,
+                                                    const IR::PathExpression* path) const {
+    auto next = ::get(state->nextStates, path->path->name.name);
+    if (next == nullptr)
+        // accept or reject
+        return path;
+    return new IR::PathExpression(path->srcInfo, new IR::Path(IR::ID(path->srcInfo, next->name)));
+}
+
+const IR::ParserState* ParserUnroller::unrolled(const ParserStateInfo* state) const {
+    auto components = state->components;
+    const IR::Expression* select;
+    if (state->exception != nullptr) {
+        // verify(false, error.exception); transition reject;
+        auto args = new IR::Vector<IR::Argument>();
+        args->push_back(new IR::Argument(new IR::BoolLiteral(false)));
+        args->push_back(new IR::Argument(new IR::Member(
+            new IR::TypeNameExpression(IR::Type_Error::error),
+            IR::ID(state->exception->message()))));
+        auto verify = new IR::MethodCallExpression(
+            state->exception->errorPosition->srcInfo,
+            new IR::PathExpression(IR::ID(IR::ParserState::verify)), args);
+        components.push_back(new IR::MethodCallStatement(verify->srcInfo, verify));
+        select = new IR::PathExpression(IR::ID(IR::ParserState::reject));
+    } else if (state->selectExpression == nullptr) {
+        select = nullptr;
+    } else if (auto path = state->selectExpression->to<IR::PathExpression>()) {
+        select = nextState(state, path);
+    } else {
+        auto se = state->selectExpression->to<IR::SelectExpression>()->clone();
+        IR::Vector<IR::SelectCase> cases;
+        for (auto c : se->selectCases)
+            cases.push_back(new IR::SelectCase(c->srcInfo, c->keyset, nextState(state, c->state)));
+        se->selectCases = cases;
+        select = se;
+    }
+
+    auto annotations = state->state->annotations;
+    if (state->name != state->state->name.name)
+        // the copies are not the state the name refers to
+        annotations = annotations->where([](const IR::Annotation* a) {
+            return a->name != IR::Annotation::nameAnnotation; });
+    LOG2("Unrolled state " << state->name << " from " << state->state);
+    return new IR::ParserState(state->state->srcInfo,
+                               IR::ID(state->state->name.srcInfo, state->name),
+                               annotations, components, select);
+}
+
+const IR::Node* ParserUnroller::preorder(IR::P4Parser* parserNode) {
+    prune();
+    auto result = parser->result;
+    if (result == nullptr || !result->complete) {
+        LOG1("Not unrolling " << parserNode);
+        return parserNode;
+    }
+    IR::IndexedVector<IR::ParserState> states;
+    for (auto s : parserNode->states) {
+        if (s->isBuiltin()) {
+            states.push_back(s);
+            continue;
+        }
+        auto copies = result->find(s->name);
+        if (copies == nullptr) {
+            LOG1("Removing unreachable state " << s);
+            continue;
+        }
+        for (auto si : *copies)
+            states.push_back(unrolled(si));
+    }
+    parserNode->states = states;
+    return parserNode;
+}
+
 }  // namespace P4
@@ -37,11 +37,21 @@ struct ParserStateInfo {
     cstring                name;  // new state name
     ValueMap*              before;
     ValueMap*              after;
+    // The states produced for the successors of this state, indexed by the
+    // name of the original successor; accept and reject do not appear.
+    std::map<cstring, const ParserStateInfo*> nextStates;
+    // The following are only computed when unrolling.
+    // Statements and select expression with header stack accesses made constant.
+    IR::IndexedVector<IR::StatOrDecl> components;
+    const IR::Expression*  selectExpression;
+    // If not null, evaluation stops with this exception after 'components'.
+    const SymbolicException* exception;
 
     ParserStateInfo(cstring name, const IR::P4Parser* parser, const IR::ParserState* state,
                     const ParserStateInfo* predecessor, ValueMap* before) :
             parser(parser), state(state), predecessor(predecessor),
-            name(name), before(before), after(nullptr)
+            name(name), before(before), after(nullptr),
+            selectExpression(nullptr), exception(nullptr)
     { CHECK_NULL(parser); CHECK_NULL(state); CHECK_NULL(before); }
 };
 
@@ -61,11 +71,15 @@ class ParserInfo {
         }
         return vec;
     }
+    const std::vector<ParserStateInfo*>* find(cstring origState) const
+    { return ::get(states, origState); }
     void add(ParserStateInfo* si) {
         cstring origState = si->state->name.name;
         auto vec = get(origState);
         vec->push_back(si);
     }
+    // False if some state could not be evaluated or unrolled
+    bool complete = true;
 };
 
 typedef CallGraph<const IR::ParserState*> StateCallGraph;
@@ -78,6 +92,8 @@ class ParserStructure {
     const IR::P4Parser*    parser;
     const IR::ParserState* start;
     const ParserInfo*      result;
+    // Default bound on the number of states produced from a single state
+    static const unsigned defaultMaxStateCopies = 128;
     void setParser(const IR::P4Parser* parser) {
         CHECK_NULL(parser);
         callGraph = new StateCallGraph(parser->name);
@@ -91,7 +107,11 @@ class ParserStructure {
     void calls(const IR::ParserState* caller, const IR::ParserState* callee)
     { callGraph->calls(caller, callee); }
 
-    void analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll);
+    // When unroll is true this also computes what is needed to unroll
+    // the parser, and it is an error to produce more than maxStateCopies
+    // states from one state.
+    void analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                 unsigned maxStateCopies = defaultMaxStateCopies);
 };
 
 class AnalyzeParser : public Inspector {
@@ -108,11 +128,19 @@ class AnalyzeParser : public Inspector {
     void postorder(const IR::PathExpression* expression) override;
 };
 
-#if 0
+// Replaces the states of a parser with the states produced by
+// ParserStructure::analyze, where each state has a copy for each distinct set
+// of values of the variables it can be reached with.  The parser is left
+// unchanged if the analysis could not compute all states.
 class ParserUnroller : public Transform {
     ReferenceMap*    refMap;
     TypeMap*         typeMap;
     ParserStructure* parser;
+
+    const IR::PathExpression* nextState(const ParserStateInfo* state,
+                                        const IR::PathExpression* path) const;
+    const IR::ParserState* unrolled(const ParserStateInfo* state) const;
+
  public:
     ParserUnroller(ReferenceMap* refMap, TypeMap* typeMap, ParserStructure* parser) :
             refMap(refMap), typeMap(typeMap), parser(parser) {
@@ -120,31 +148,31 @@ class ParserUnroller : public Transform {
         setName("ParserUnroller");
         visitDagOnce = false;
     }
+    const IR::Node* preorder(IR::P4Parser* parser) override;
 };
-#endif
 
 // Applied to a P4Parser object.
 class ParserRewriter : public PassManager {
     ParserStructure  current;
  public:
-    ParserRewriter(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) {
+    ParserRewriter(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                   unsigned maxStateCopies) {
         CHECK_NULL(refMap); CHECK_NULL(typeMap);
         passes.push_back(new AnalyzeParser(refMap, &current));
         passes.push_back(new VisitFunctor (
-            [this, refMap, typeMap, unroll](const IR::Node* root) -> const IR::Node* {
-                current.analyze(refMap, typeMap, unroll);
+            [this, refMap, typeMap, unroll, maxStateCopies](const IR::Node* root)
+                    -> const IR::Node* {
+                current.analyze(refMap, typeMap, unroll, maxStateCopies);
                 return root;
             }));
-#if 0
         if (unroll)
             passes.push_back(new ParserUnroller(refMap, typeMap, &current));
-#endif
     }
     Visitor::profile_t init_apply(const IR::Node* node) override {
         LOG1("Scanning " << node);
         BUG_CHECK(node->is<IR::P4Parser>(), "%1%: expected a parser", node);
         current.parser = node->to<IR::P4Parser>();
-        return Visitor::init_apply(node);
+        return PassManager::init_apply(node);
     }
 };
 
@@ -155,21 +183,30 @@ class RewriteAllParsers : public Transform {
     ReferenceMap* refMap;
     TypeMap*      typeMap;
     bool          unroll;
+    unsigned      maxStateCopies;
  public:
-    RewriteAllParsers(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) :
-            refMap(refMap), typeMap(typeMap), unroll(unroll)
+    RewriteAllParsers(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                      unsigned maxStateCopies) :
+            refMap(refMap), typeMap(typeMap), unroll(unroll), maxStateCopies(maxStateCopies)
     { CHECK_NULL(refMap); CHECK_NULL(typeMap); }
     const IR::Node* postorder(IR::P4Parser* parser) override {
-        ParserRewriter rewriter(refMap, typeMap, unroll);
+        ParserRewriter rewriter(refMap, typeMap, unroll, maxStateCopies);
         return parser->apply(rewriter);
     }
 };
 
+/// Symbolically evaluates all parsers, reporting errors that can be detected
+/// statically.  If unroll is true also unrolls the loops of the parsers: each
+/// state is copied for each distinct set of values of the variables it can be
+/// reached with (symbolic states that are equal share one copy), and the
+/// .next and .last of header stacks become constant indexes.  It is an error
+/// for a state to need more than maxStateCopies copies.
 class ParsersUnroll : public PassManager {
  public:
-    ParsersUnroll(bool unroll, ReferenceMap* refMap, TypeMap* typeMap) {
+    ParsersUnroll(bool unroll, ReferenceMap* refMap, TypeMap* typeMap,
+                  unsigned maxStateCopies = ParserStructure::defaultMaxStateCopies) {
         passes.push_back(new TypeChecking(refMap, typeMap));
-        passes.push_back(new RewriteAllParsers(refMap, typeMap, unroll));
+        passes.push_back(new RewriteAllParsers(refMap, typeMap, unroll, maxStateCopies));
         setName("ParsersUnroll");
     }
 };
@@ -0,0 +1,731 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "stfRunner.h"
+
+#include <algorithm>
+#include <sstream>
+#include "frontends/p4/coreLibrary.h"
+#include "frontends/p4/fromv1.0/v1model.h"
+
+namespace P4 {
+
+namespace {
+
+// Values of the standard metadata fields, as simple_switch uses them
+const unsigned dropPort = 511;
+const unsigned instanceTypeNormal = 0;
+const unsigned instanceTypeReplication = 5;
+
+void setField(ConcreteValue* value, cstring field, const big_int& v) {
+    auto f = value->getField(field);
+    BUG_CHECK(f != nullptr, "no field %1%", field);
+    f->value = v;
+}
+
+big_int getField(const ConcreteValue& value, cstring field) {
+    auto f = value.getField(field);
+    BUG_CHECK(f != nullptr, "no field %1%", field);
+    return f->value;
+}
+
+big_int crc(const std::vector<uint8_t>& data, unsigned width, uint32_t poly, uint32_t init,
+            uint32_t xorOut) {
+    uint32_t crc = init;
+    for (auto byte : data) {
+        crc ^= byte;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+    }
+    crc ^= xorOut;
+    return width == 32 ? crc : crc & 0xffff;
+}
+
+}  // namespace
+
+V1SwitchInterpreter::V1SwitchInterpreter(ReferenceMap* refMap, TypeMap* typeMap,
+                                         const IR::ToplevelBlock* toplevel) :
+        ConcreteInterpreter(refMap, typeMap) {
+    auto& v1model = P4V1::V1Model::instance;
+    auto main = toplevel->getMain();
+    if (main == nullptr || main->type->name != v1model.sw.name)
+        throw ExecutionError("%1%: the program does not instantiate %2%",
+                             toplevel->getProgram(), v1model.sw.name);
+    auto p = main->getParameterValue(v1model.sw.parser.name)->to<IR::ParserBlock>();
+    BUG_CHECK(p != nullptr, "%1%: expected a parser", main);
+    parser = p->container;
+    verify = getControl(toplevel, v1model.sw.verify.name);
+    ingress = getControl(toplevel, v1model.sw.ingress.name);
+    egress = getControl(toplevel, v1model.sw.egress.name);
+    compute = getControl(toplevel, v1model.sw.compute.name);
+    deparser = getControl(toplevel, v1model.sw.deparser.name);
+
+    for (auto obj : toplevel->getProgram()->objects) {
+        if (auto control = obj->to<IR::P4Control>()) {
+            for (auto d : control->controlLocals)
+                if (auto table = d->to<IR::P4Table>())
+                    allTables.push_back(table);
+        }
+    }
+}
+
+const IR::P4Control* V1SwitchInterpreter::getControl(const IR::ToplevelBlock* toplevel,
+                                                     cstring parameter) {
+    auto block = toplevel->getMain()->getParameterValue(parameter)->to<IR::ControlBlock>();
+    BUG_CHECK(block != nullptr, "%1%: expected a control", parameter);
+    return block->container;
+}
+
+unsigned V1SwitchInterpreter::addMulticastNode(unsigned rid, std::vector<unsigned> ports) {
+    nodes.push_back(Node{rid, std::move(ports)});
+    return nodes.size() - 1;
+}
+
+bool V1SwitchInterpreter::associate(unsigned group, unsigned node) {
+    auto it = groups.find(group);
+    if (it == groups.end() || node >= nodes.size())
+        return false;
+    it->second.push_back(node);
+    return true;
+}
+
+std::vector<V1SwitchInterpreter::Output>
+V1SwitchInterpreter::process(unsigned port, const std::vector<uint8_t>& data) {
+    auto params = parser->getApplyParameters()->parameters;
+    BUG_CHECK(params.size() == 4, "%1%: expected 4 parameters", parser);
+    auto hdr = create(typeMap->getType(params.at(1), true));
+    auto meta = create(typeMap->getType(params.at(2), true));
+    auto sm = create(typeMap->getType(params.at(3), true));
+    auto& fields = P4V1::V1Model::instance.standardMetadataType;
+    setField(&sm, "ingress_port", port);
+    setField(&sm, "packet_length", data.size());
+    truncateLength = 0;
+    checksumError = false;
+
+    ConcretePacket packet(data);
+    standardMetadata = params.at(3);
+    auto error = runParser(parser, &packet, { &hdr, &meta, &sm });
+    sm.getField("parser_error")->member = error;
+    payload = packet.payload();
+
+    standardMetadata = nullptr;
+    runControl(verify, nullptr, { &hdr, &meta });
+    if (checksumError)
+        setField(&sm, "checksum_error", 1);
+
+    standardMetadata = ingress->getApplyParameters()->parameters.at(2);
+    runControl(ingress, nullptr, { &hdr, &meta, &sm });
+
+    // The copies of the packet that go to the egress pipeline
+    std::vector<std::pair<unsigned, unsigned>> copies;  // port, rid
+    unsigned instanceType = instanceTypeNormal;
+    auto group = getField(sm, "mcast_grp");
+    if (group != 0) {
+        instanceType = instanceTypeReplication;
+        auto it = groups.find(static_cast<unsigned>(group));
+        if (it != groups.end()) {
+            for (auto n : it->second)
+                for (auto p : nodes.at(n).ports)
+                    copies.emplace_back(p, nodes.at(n).rid);
+        }
+    } else {
+        auto egressSpec = getField(sm, fields.egress_spec.name);
+        if (egressSpec == dropPort)
+            return {};
+        copies.emplace_back(static_cast<unsigned>(egressSpec), 0);
+    }
+
+    std::vector<Output> outputs;
+    for (auto copy : copies) {
+        auto h = hdr, m = meta, s = sm;
+        setField(&s, "egress_port", copy.first);
+        setField(&s, "egress_rid", copy.second);
+        setField(&s, "instance_type", instanceType);
+        standardMetadata = egress->getApplyParameters()->parameters.at(2);
+        runControl(egress, nullptr, { &h, &m, &s });
+        if (getField(s, fields.egress_spec.name) == dropPort)
+            continue;
+        outputs.push_back(Output{copy.first, deparse(&h, &m)});
+    }
+    standardMetadata = nullptr;
+    return outputs;
+}
+
+std::vector<uint8_t> V1SwitchInterpreter::deparse(ConcreteValue* hdr, ConcreteValue* meta) {
+    standardMetadata = nullptr;
+    runControl(compute, nullptr, { hdr, meta });
+    ConcretePacket out({});
+    runControl(deparser, &out, { hdr });
+    auto rv = out.deparsed();
+    rv.insert(rv.end(), payload.begin(), payload.end());
+    if (truncateLength != 0 && rv.size() > truncateLength)
+        rv.resize(truncateLength);
+    return rv;
+}
+
+std::vector<uint8_t> V1SwitchInterpreter::serializeData(const ConcreteValue& data,
+                                                        bool withPayload) const {
+    ConcretePacket bits({});
+    serialize(data, &bits);
+    auto rv = bits.deparsed();
+    if (withPayload)
+        rv.insert(rv.end(), payload.begin(), payload.end());
+    return rv;
+}
+
+big_int V1SwitchInterpreter::hash(cstring algorithm, const std::vector<uint8_t>& data) const {
+    auto& algorithms = P4V1::V1Model::instance.algorithm;
+    if (algorithm == algorithms.crc32.name || algorithm == algorithms.crc32_custom.name)
+        return crc(data, 32, 0xEDB88320, 0xFFFFFFFF, 0xFFFFFFFF);
+    if (algorithm == algorithms.crc16.name || algorithm == algorithms.crc16_custom.name)
+        return crc(data, 16, 0xA001, 0, 0);
+    if (algorithm == algorithms.csum16.name || algorithm == algorithms.xor16.name) {
+        bool csum = algorithm == algorithms.csum16.name;
+        uint32_t sum = 0;
+        for (size_t i = 0; i < data.size(); i += 2) {
+            uint32_t word = data[i] << 8 | (i + 1 < data.size() ? data[i + 1] : 0);
+            if (csum) {
+                sum += word;
+                sum = (sum & 0xffff) + (sum >> 16);
+            } else {
+                sum ^= word;
+            }
+        }
+        return csum ? ~sum & 0xffff : sum;
+    }
+    if (algorithm == algorithms.identity.name) {
+        big_int rv = 0;
+        for (auto byte : data)
+            rv = (rv << 8) | byte;
+        return rv;
+    }
+    if (algorithm == algorithms.random.name)
+        return 0;
+    throw ExecutionError("unsupported hash algorithm %1%", algorithm);
+}
+
+bool V1SwitchInterpreter::callExtern(const MethodInstance* mi, ConcreteValue* result) {
+    auto& v1model = P4V1::V1Model::instance;
+    if (auto ef = mi->to<ExternFunction>()) {
+        auto name = ef->method->name.name;
+        if (name == v1model.drop.name) {
+            ConcreteValue* sm;
+            if (mi->substitution.lookupByName("standard_metadata") != nullptr)
+                sm = argumentLocation(mi, "standard_metadata");
+            else if (standardMetadata != nullptr)
+                sm = &values.at(standardMetadata);
+            else
+                throw ExecutionError("%1%: no standard metadata", mi->expr);
+            setField(sm, v1model.standardMetadataType.egress_spec.name, dropPort);
+            setField(sm, "mcast_grp", 0);
+            return true;
+        }
+        if (name == v1model.hash.name) {
+            auto data = serializeData(argument(mi, "data"), false);
+            auto h = hash(argument(mi, "algo").member, data);
+            auto base = argument(mi, "base").value;
+            auto max = argument(mi, "max").value;
+            auto dest = argumentLocation(mi, "result");
+            *dest = fromInteger(dest->type, max == 0 ? base : big_int(base + h % max));
+            return true;
+        }
+        if (name == v1model.verify_checksum.name ||
+            name == v1model.verify_checksum_with_payload.name ||
+            name == v1model.update_checksum.name ||
+            name == v1model.update_checksum_with_payload.name) {
+            if (!argument(mi, "condition").isTrue())
+                return true;
+            bool withPayload = name == v1model.verify_checksum_with_payload.name ||
+                    name == v1model.update_checksum_with_payload.name;
+            auto data = serializeData(argument(mi, "data"), withPayload);
+            auto checksum = argumentLocation(mi, "checksum");
+            auto computed = fromInteger(checksum->type,
+                                        hash(argument(mi, "algo").member, data));
+            if (name == v1model.update_checksum.name ||
+                name == v1model.update_checksum_with_payload.name)
+                *checksum = computed;
+            else if (computed.value != checksum->value)
+                checksumError = true;
+            return true;
+        }
+        if (name == v1model.random.name) {
+            auto dest = argumentLocation(mi, "result");
+            *dest = fromInteger(dest->type, argument(mi, "lo").value);
+            return true;
+        }
+        if (name == "truncate") {
+            truncateLength = static_cast<unsigned>(argument(mi, "length").value);
+            return true;
+        }
+        if (name == "assert" || name == "assume") {
+            if (!argument(mi, "check").isTrue())
+                throw ExecutionError("%1%: %2% failed", mi->expr, name);
+            return true;
+        }
+        if (name == v1model.digest_receiver.name || name == v1model.log_msg.name)
+            return true;
+        if (name == v1model.clone.name || name == v1model.clone.clone3.name ||
+            name == v1model.resubmit.name || name == v1model.recirculate.name)
+            throw ExecutionError("%1%: %2% is not supported", mi->expr, name);
+        return false;
+    }
+
+    auto em = mi->to<ExternMethod>();
+    if (em == nullptr)
+        return false;
+    auto type = em->originalExternType->name.name;
+    auto method = em->method->name.name;
+    if (type == v1model.registers.name) {
+        auto& cells = registers[em->object];
+        if (cells.empty()) {
+            auto inst = em->object->to<IR::Declaration_Instance>();
+            auto size = evaluate(inst->arguments->at(0)->expression).value;
+            cells.resize(static_cast<size_t>(size));
+        }
+        auto index = argument(mi, "index").value;
+        bool inRange = index >= 0 && index < cells.size();
+        if (method == v1model.registers.read.name) {
+            auto dest = argumentLocation(mi, "result");
+            auto& cell = cells[inRange ? static_cast<size_t>(index) : 0];
+            *dest = inRange && cell.type != nullptr ? cell : create(dest->type);
+        } else if (method == v1model.registers.write.name) {
+            if (inRange)
+                cells[static_cast<size_t>(index)] = argument(mi, "value");
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (type == v1model.counter.name || type == v1model.directCounter.name)
+        return true;
+    if (type == v1model.meter.name || type == v1model.directMeter.name) {
+        auto dest = argumentLocation(mi, "result");
+        *dest = fromInteger(dest->type, 0);  // GREEN
+        return true;
+    }
+    if (type == "Checksum16") {
+        auto data = serializeData(argument(mi, "data"), false);
+        *result = fromInteger(typeMap->getType(mi->expr, true),
+                              hash(v1model.algorithm.csum16.name, data));
+        return true;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+std::string trim(const std::string& s) {
+    auto start = s.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos)
+        return "";
+    auto end = s.find_last_not_of(" \t\r\n");
+    return s.substr(start, end - start + 1);
+}
+
+// Removes the text up to the first 'separator' from 'text' and returns it.
+std::string nextWord(std::string* text, char separator = ' ') {
+    auto s = trim(*text);
+    size_t pos = separator == ' ' ? s.find_first_of(" \t") : s.find(separator);
+    if (pos == std::string::npos) {
+        *text = "";
+        return s;
+    }
+    *text = s.substr(pos + 1);
+    return trim(s.substr(0, pos));
+}
+
+// A number as STF files write them: decimal, or with a 0x, 0o or 0b prefix
+// and '*' for digits that match anything.
+struct Number {
+    big_int value = 0;
+    big_int mask = 0;    // the digits written, without wildcards
+    unsigned bits = 0;   // the bits of the digits written, with wildcards
+    unsigned wildcardBits = 0;
+    bool decimal = false;
+};
+
+bool parseNumber(std::string text, Number* n) {
+    unsigned base = 10, digitBits = 0;
+    if (text.size() > 2 && text[0] == '0' && isalpha(static_cast<unsigned char>(text[1]))) {
+        switch (tolower(text[1])) {
+            case 'x': base = 16; digitBits = 4; break;
+            case 'o': base = 8; digitBits = 3; break;
+            case 'b': base = 2; digitBits = 1; break;
+            case 'd': base = 10; break;
+            default: return false;
+        }
+        text = text.substr(2);
+    }
+    if (text.empty())
+        return false;
+    for (char c : text) {
+        if (c == '_')
+            continue;
+        if (c == '*') {
+            if (digitBits == 0)
+                return false;
+            n->value = n->value << digitBits;
+            n->mask = n->mask << digitBits;
+            n->bits += digitBits;
+            n->wildcardBits += digitBits;
+            continue;
+        }
+        unsigned digit;
+        if (isdigit(static_cast<unsigned char>(c)))
+            digit = c - '0';
+        else if (isxdigit(static_cast<unsigned char>(c)))
+            digit = tolower(c) - 'a' + 10;
+        else
+            return false;
+        if (digit >= base)
+            return false;
+        n->value = n->value * base + digit;
+        if (digitBits != 0) {
+            n->mask = (n->mask << digitBits) | ((1 << digitBits) - 1);
+            n->bits += digitBits;
+        }
+    }
+    n->decimal = digitBits == 0;
+    return true;
+}
+
+big_int parseNumber(const std::string& text) {
+    Number n;
+    if (!parseNumber(text, &n) || n.wildcardBits != 0)
+        throw ExecutionError("%1%: invalid number", text);
+    return n.value;
+}
+
+bool parseBytes(const std::string& text, std::vector<uint8_t>* bytes) {
+    std::string digits;
+    for (char c : text)
+        if (!isspace(static_cast<unsigned char>(c)))
+            digits += c;
+    if (digits.size() % 2 != 0)
+        return false;
+    for (size_t i = 0; i < digits.size(); i += 2) {
+        if (!isxdigit(static_cast<unsigned char>(digits[i])) ||
+            !isxdigit(static_cast<unsigned char>(digits[i + 1])))
+            return false;
+        bytes->push_back(static_cast<uint8_t>(std::stoi(digits.substr(i, 2), nullptr, 16)));
+    }
+    return true;
+}
+
+std::string toHex(const std::vector<uint8_t>& bytes) {
+    static const char* digits = "0123456789ABCDEF";
+    std::string rv;
+    for (auto b : bytes) {
+        rv += digits[b >> 4];
+        rv += digits[b & 0xf];
+    }
+    return rv;
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() &&
+            s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Finds the name equal to 'name', or else the only one ending with it.
+template <typename T>
+const T* findByName(const std::vector<const T*>& objects, cstring name) {
+    const T* candidate = nullptr;
+    for (auto o : objects) {
+        auto n = o->controlPlaneName();
+        if (n == name)
+            return o;
+        if (endsWith(n.c_str(), name.c_str())) {
+            if (candidate != nullptr)
+                throw ExecutionError("%1%: ambiguous name", name);
+            candidate = o;
+        }
+    }
+    return candidate;
+}
+
+}  // namespace
+
+const IR::P4Table* StfRunner::findTable(cstring name) const {
+    auto table = findByName(target->getTables(), name);
+    if (table == nullptr)
+        throw ExecutionError("%1%: no such table", name);
+    return table;
+}
+
+const IR::P4Action* StfRunner::findAction(const IR::P4Table* table, cstring name) const {
+    auto refMap = target->getRefMap();
+    std::vector<const IR::P4Action*> actions;
+    for (auto ale : table->getActionList()->actionList)
+        actions.push_back(refMap->getDeclaration(ale->getPath(), true)->to<IR::P4Action>());
+    auto action = findByName(actions, name);
+    if (action == nullptr)
+        throw ExecutionError("%1%: no such action in table %2%", name, table->controlPlaneName());
+    return action;
+}
+
+int StfRunner::findKey(const ConcreteTable* table, std::string name) const {
+    // bmv2 names stack elements name$index
+    for (size_t pos; (pos = name.find('$')) != std::string::npos &&
+                     pos + 1 < name.size() && isdigit(static_cast<unsigned char>(name[pos + 1]));) {
+        size_t end = pos + 1;
+        while (end < name.size() && isdigit(static_cast<unsigned char>(name[end])))
+            end++;
+        name = name.substr(0, pos) + "[" + name.substr(pos + 1, end - pos - 1) + "]" +
+                name.substr(end);
+    }
+    std::vector<std::string> names = { name, name + ".$valid$" };
+    if (endsWith(name, ".valid"))
+        names.push_back(name.substr(0, name.size() - 5) + "$valid$");
+    const auto& keys = table->keyNames;
+    for (auto& n : names)
+        for (size_t i = 0; i < keys.size(); i++)
+            if (n == keys[i].c_str())
+                return i;
+    int candidate = -1;
+    for (size_t i = 0; i < keys.size(); i++) {
+        std::string key = keys[i].c_str();
+        if (endsWith(key, "." + name) || endsWith(key, "." + name + "$") ||
+            (name == "valid" && endsWith(key, ".$valid$"))) {
+            if (candidate >= 0)
+                throw ExecutionError("%1%: ambiguous key", name);
+            candidate = i;
+        }
+    }
+    if (candidate < 0)
+        throw ExecutionError("%1%: no such key in table %2%", name,
+                             table->table->controlPlaneName());
+    return candidate;
+}
+
+std::vector<big_int> StfRunner::actionData(const IR::P4Action* action, const std::string& args) {
+    std::map<std::string, big_int> values;
+    std::string rest = args;
+    while (!trim(rest).empty()) {
+        auto arg = nextWord(&rest, ',');
+        auto name = nextWord(&arg, ':');
+        values[name] = parseNumber(trim(arg));
+    }
+    std::vector<big_int> data;
+    for (auto p : action->parameters->parameters) {
+        if (p->direction != IR::Direction::None)
+            continue;
+        auto it = values.find(p->name.name.c_str());
+        if (it == values.end())
+            throw ExecutionError("%1%: no value for parameter %2%", action->controlPlaneName(),
+                                 p->name);
+        data.push_back(it->second);
+    }
+    return data;
+}
+
+void StfRunner::add(const std::string& command) {
+    std::string rest = command;
+    auto table = findTable(nextWord(&rest));
+    auto ct = target->getTable(table);
+
+    // The optional priority; higher ones win.
+    int priority = 10000;
+    std::string words = trim(rest);
+    auto first = words.substr(0, words.find_first_of(" \t"));
+    if (!first.empty() && first.find_first_not_of("0123456789") == std::string::npos) {
+        priority = 10000 - std::stoi(first);
+        nextWord(&rest);
+    }
+
+    // The keys, up to the word with the action call.
+    auto paren = rest.find('(');
+    std::string keys = rest.substr(0, paren), args;
+    if (paren != std::string::npos) {
+        auto close = rest.rfind(')');
+        if (close == std::string::npos || close < paren)
+            throw ExecutionError("%1%: missing ')'", command);
+        args = rest.substr(paren + 1, close - paren - 1);
+    } else {
+        auto eq = keys.find('=');
+        keys = keys.substr(0, eq);
+    }
+    keys = trim(keys);
+    auto space = keys.find_last_of(" \t");
+    std::string actionName = space == std::string::npos ? keys : keys.substr(space + 1);
+    keys = space == std::string::npos ? "" : keys.substr(0, space);
+    auto action = findAction(table, actionName);
+
+    std::vector<ConcreteTable::KeyMatch> matches(ct->keyNames.size());
+    std::vector<bool> seen(matches.size());
+    while (!trim(keys).empty()) {
+        auto word = nextWord(&keys);
+        auto colon = word.rfind(':');
+        if (colon == std::string::npos)
+            throw ExecutionError("%1%: expected key:value", word);
+        auto index = findKey(ct, word.substr(0, colon));
+        auto value = word.substr(colon + 1);
+        auto kind = ct->matchKinds.at(index);
+        auto width = ct->widths.at(index);
+        auto& match = matches.at(index);
+        seen.at(index) = true;
+        Number n;
+        if (kind == "range") {
+            auto arrow = value.find("->");
+            if (arrow == std::string::npos)
+                throw ExecutionError("%1%: expected low->high", value);
+            match.value = parseNumber(value.substr(0, arrow));
+            match.high = parseNumber(value.substr(arrow + 2));
+        } else if (value.find("&&&") != std::string::npos) {
+            auto pos = value.find("&&&");
+            match.mask = parseNumber(value.substr(pos + 3)) & Util::mask(width);
+            match.value = parseNumber(value.substr(0, pos)) & match.mask;
+        } else if (kind == P4CoreLibrary::instance.lpmMatch.name) {
+            unsigned prefix = width;
+            auto slash = value.find('/');
+            if (slash != std::string::npos) {
+                prefix = static_cast<unsigned>(parseNumber(value.substr(slash + 1)));
+                value = value.substr(0, slash);
+                if (!parseNumber(value, &n))
+                    throw ExecutionError("%1%: invalid number", value);
+            } else if (!parseNumber(value, &n)) {
+                throw ExecutionError("%1%: invalid number", value);
+            } else if (!n.decimal) {
+                prefix = n.bits - n.wildcardBits;
+            }
+            prefix = std::min(prefix, width);
+            match.mask = Util::mask(width) ^ Util::mask(width - prefix);
+            match.value = n.value & match.mask;
+        } else if (kind == P4CoreLibrary::instance.exactMatch.name) {
+            match.value = parseNumber(value) & Util::mask(width);
+            match.mask = Util::mask(width);
+        } else {
+            if (!parseNumber(value, &n))
+                throw ExecutionError("%1%: invalid number", value);
+            match.mask = (n.decimal ? Util::mask(width) : n.mask) & Util::mask(width);
+            match.value = n.value & match.mask;
+        }
+    }
+    for (size_t i = 0; i < seen.size(); i++) {
+        if (seen[i])
+            continue;
+        if (ct->matchKinds[i] == P4CoreLibrary::instance.exactMatch.name)
+            throw ExecutionError("%1%: no value for key %2%", command, ct->keyNames[i]);
+        matches[i].high = Util::mask(ct->widths[i]);  // don't care
+    }
+
+    if (!target->addEntry(ct, matches, priority, action, actionData(action, args)))
+        throw ExecutionError("%1%: duplicate entry", command);
+}
+
+void StfRunner::setDefault(const std::string& command) {
+    std::string rest = command;
+    auto table = findTable(nextWord(&rest));
+    auto actionName = nextWord(&rest, '(');
+    auto close = rest.rfind(')');
+    auto args = close == std::string::npos ? rest : rest.substr(0, close);
+    auto action = findAction(table, actionName);
+    target->setDefaultAction(target->getTable(table), action, actionData(action, args));
+}
+
+void StfRunner::execute(const std::string& line) {
+    std::string rest = line.substr(0, line.find('#'));
+    auto command = nextWord(&rest);
+    std::transform(command.begin(), command.end(), command.begin(), ::tolower);
+    if (command.empty()) {
+        return;
+    } else if (command == "add") {
+        add(rest);
+    } else if (command == "setdefault") {
+        setDefault(rest);
+    } else if (command == "packet") {
+        auto port = static_cast<unsigned>(parseNumber(nextWord(&rest)));
+        std::vector<uint8_t> data;
+        if (!parseBytes(rest, &data))
+            throw ExecutionError("%1%: invalid packet data", rest);
+        ports.emplace(port);
+        for (auto& out : target->process(port, data))
+            received[out.port].push_back(out.data);
+    } else if (command == "expect") {
+        auto port = static_cast<unsigned>(parseNumber(nextWord(&rest)));
+        ports.emplace(port);
+        std::string data;
+        for (char c : rest)
+            if (!isspace(static_cast<unsigned char>(c)))
+                data += toupper(c);
+        if (data.empty())
+            expectAny.emplace(port);
+        else
+            expected[port].push_back(data);
+    } else if (command == "mc_mgrp_create") {
+        target->addMulticastGroup(static_cast<unsigned>(parseNumber(nextWord(&rest))));
+    } else if (command == "mc_node_create") {
+        auto rid = static_cast<unsigned>(parseNumber(nextWord(&rest)));
+        std::vector<unsigned> nodePorts;
+        while (!trim(rest).empty())
+            nodePorts.push_back(static_cast<unsigned>(parseNumber(nextWord(&rest))));
+        target->addMulticastNode(rid, nodePorts);
+    } else if (command == "mc_node_associate") {
+        auto group = static_cast<unsigned>(parseNumber(nextWord(&rest)));
+        auto node = static_cast<unsigned>(parseNumber(nextWord(&rest)));
+        if (!target->associate(group, node))
+            throw ExecutionError("%1%: no such group or node", line);
+    }
+    // Other commands, such as wait and mirroring_add, do not apply here.
+}
+
+void StfRunner::compare() {
+    for (auto port : ports) {
+        if (expectAny.count(port))
+            continue;
+        auto& exp = expected[port];
+        auto& got = received[port];
+        if (exp.size() != got.size()) {
+            std::stringstream message;
+            message << "Expected " << exp.size() << " packets on port " << port << ", got "
+                    << got.size();
+            failures.push_back(message.str());
+            continue;
+        }
+        for (size_t i = 0; i < exp.size(); i++) {
+            auto e = exp[i];
+            bool strict = !e.empty() && e.back() == '$';
+            if (strict)
+                e.pop_back();
+            auto r = toHex(got[i]);
+            bool ok = r.size() >= e.size() && (!strict || r.size() == e.size());
+            for (size_t j = 0; ok && j < e.size(); j++)
+                ok = e[j] == '*' || e[j] == r[j];
+            if (!ok)
+                failures.push_back("Packet " + Util::toString(i) + " on port " +
+                                   Util::toString(port) + ": expected " + e + ", got " + r);
+        }
+    }
+}
+
+bool StfRunner::run(std::istream& stf) {
+    std::string line;
+    unsigned lineNumber = 0;
+    while (std::getline(stf, line)) {
+        lineNumber++;
+        try {
+            execute(line);
+        } catch (ExecutionError& e) {
+            failures.push_back("line " + Util::toString(lineNumber) + ": " + e.what());
+        }
+    }
+    compare();
+    return failures.empty();
+}
+
+}  // namespace P4
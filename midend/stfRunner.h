@@ -0,0 +1,114 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _MIDEND_STFRUNNER_H_
+#define _MIDEND_STFRUNNER_H_
+
+#include <istream>
+#include <set>
+#include "concreteInterpreter.h"
+
+// Runs STF tests (see backends/bmv2/bmv2stf.py) of v1model programs on the
+// concrete interpreter, without starting a switch.
+
+namespace P4 {
+
+// The packet processing of the v1model V1Switch package, as simple_switch
+// does it.  clone, resubmit and recirculate are not supported; counters do
+// not count, and meters always return GREEN.
+class V1SwitchInterpreter : public ConcreteInterpreter {
+    const IR::P4Parser*  parser;
+    const IR::P4Control* verify;
+    const IR::P4Control* ingress;
+    const IR::P4Control* egress;
+    const IR::P4Control* compute;
+    const IR::P4Control* deparser;
+    std::vector<const IR::P4Table*> allTables;
+
+    std::map<const IR::IDeclaration*, std::vector<ConcreteValue>> registers;
+    struct Node {
+        unsigned rid;
+        std::vector<unsigned> ports;
+    };
+    std::vector<Node> nodes;
+    std::map<unsigned, std::vector<unsigned>> groups;
+
+    // The standard metadata parameter of the block running, if it has one.
+    const IR::Parameter* standardMetadata = nullptr;
+    std::vector<uint8_t> payload;  // of the packet being processed
+    bool checksumError = false;
+    unsigned truncateLength = 0;
+
+    const IR::P4Control* getControl(const IR::ToplevelBlock* toplevel, cstring parameter);
+    std::vector<uint8_t> serializeData(const ConcreteValue& data, bool withPayload) const;
+    big_int hash(cstring algorithm, const std::vector<uint8_t>& data) const;
+    std::vector<uint8_t> deparse(ConcreteValue* hdr, ConcreteValue* meta);
+
+ protected:
+    bool callExtern(const MethodInstance* mi, ConcreteValue* result) override;
+
+ public:
+    V1SwitchInterpreter(ReferenceMap* refMap, TypeMap* typeMap,
+                        const IR::ToplevelBlock* toplevel);
+
+    // The tables of the program, whose control-plane names STF files use.
+    const std::vector<const IR::P4Table*>& getTables() const { return allTables; }
+
+    void addMulticastGroup(unsigned group) { groups[group]; }
+    // Returns the handle of the new node.
+    unsigned addMulticastNode(unsigned rid, std::vector<unsigned> ports);
+    // False if the group or the node does not exist.
+    bool associate(unsigned group, unsigned node);
+
+    struct Output {
+        unsigned port;
+        std::vector<uint8_t> data;
+    };
+    // The packets sent when one is received on 'port'.
+    std::vector<Output> process(unsigned port, const std::vector<uint8_t>& data);
+};
+
+// Runs the commands of an STF file, and compares the packets they send
+// through the switch with the ones they expect.
+class StfRunner {
+    V1SwitchInterpreter* target;
+    std::vector<cstring> failures;
+    std::map<unsigned, std::vector<std::string>> expected;
+    std::set<unsigned> expectAny;
+    std::map<unsigned, std::vector<std::vector<uint8_t>>> received;
+    std::set<unsigned> ports;
+
+    const IR::P4Table* findTable(cstring name) const;
+    const IR::P4Action* findAction(const IR::P4Table* table, cstring name) const;
+    int findKey(const ConcreteTable* table, std::string name) const;
+    std::vector<big_int> actionData(const IR::P4Action* action, const std::string& args);
+    void add(const std::string& command);
+    void setDefault(const std::string& command);
+    void compare();
+
+ public:
+    explicit StfRunner(V1SwitchInterpreter* target) : target(target) { CHECK_NULL(target); }
+    // Runs one command.
+    void execute(const std::string& line);
+    // Runs all commands of 'stf' and compares the packets; true on success.
+    bool run(std::istream& stf);
+    // The description of each failure.
+    const std::vector<cstring>& getFailures() const { return failures; }
+};
+
+}  // namespace P4
+
+#endif /* _MIDEND_STFRUNNER_H_ */
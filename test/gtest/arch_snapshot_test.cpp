@@ -0,0 +1,178 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "frontends/common/archSnapshot.h"
+#include "frontends/p4/frontend.h"
+#include "frontends/p4/toP4/toP4.h"
+#include "frontends/parsers/parserDriver.h"
+#include "lib/error.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+class ArchSnapshotTest : public P4CTest {
+ protected:
+    std::string dir;
+
+    void SetUp() override {
+        auto tmp = getenv("TMPDIR");
+        std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") +
+            "/p4c-arch-snapshot-test-XXXXXX";
+        ASSERT_TRUE(mkdtemp(&pattern[0]) != nullptr);
+        dir = pattern;
+    }
+
+    void TearDown() override {
+        if (auto d = opendir(dir.c_str())) {
+            while (auto entry = readdir(d)) {
+                std::string name = entry->d_name;
+                if (name != "." && name != "..")
+                    unlink((dir + "/" + name).c_str());
+            }
+            closedir(d);
+        }
+        rmdir(dir.c_str());
+    }
+
+    unsigned snapshots() const {
+        unsigned count = 0;
+        if (auto d = opendir(dir.c_str())) {
+            while (auto entry = readdir(d))
+                if (entry->d_name[0] != '.')
+                    ++count;
+            closedir(d);
+        }
+        return count;
+    }
+};
+
+/// The program as the preprocessor leaves it, with core.p4 included from
+/// the P4 include path.
+std::string preprocessed() {
+    // without the #line that the test environment adds
+    auto core = P4CTestEnvironment::get()->coreP4();
+    core = core.substr(core.find('\n') + 1);
+    std::stringstream text;
+    text << "# 1 \"prog.p4\"\n"
+         << "# 1 \"" << p4includePath << "/core.p4\" 1\n"
+         << core
+         << "# 2 \"prog.p4\" 2\n"
+         << R"(
+header h_t { bit<8> f; }
+struct s_t { h_t h; }
+parser p(packet_in pk, out s_t s) {
+    state start {
+        pk.extract(s.h);
+        transition accept;
+    }
+}
+control c(inout s_t s) {
+    apply {
+        if (s.h.isValid())
+            s.h.f = s.h.f + 8w1;
+    }
+}
+parser P<T>(packet_in pk, out T t);
+control C<T>(inout T t);
+package top<T>(P<T> pp, C<T> cc);
+top(p(), c()) main;
+)";
+    return text.str();
+}
+
+const IR::P4Program *parse(const CompilerOptions &options) {
+    auto text = preprocessed();
+    FILE *in = tmpfile();
+    fwrite(text.data(), 1, text.size(), in);
+    rewind(in);
+    auto program = options.archSnapshotDir ? ArchSnapshot::parse(in, options)
+                                           : P4ParserDriver::parse(in, options.file);
+    fclose(in);
+    return program;
+}
+
+std::string toP4(const IR::P4Program *program) {
+    std::stringstream out;
+    program->apply(ToP4(&out, false));
+    return out.str();
+}
+
+}  // namespace
+
+TEST_F(ArchSnapshotTest, sameProgram) {
+    CompilerOptions options;
+    options.file = "prog.p4";
+    auto plain = parse(options);
+    ASSERT_TRUE(plain != nullptr);
+
+    options.archSnapshotDir = dir;
+    auto first = parse(options);
+    EXPECT_EQ(1u, snapshots());
+    auto second = parse(options);
+    EXPECT_EQ(1u, snapshots());
+    ASSERT_EQ(0u, ::errorCount());
+    ASSERT_TRUE(first != nullptr && second != nullptr);
+
+    for (auto program : { first, second }) {
+        EXPECT_TRUE(plain->equiv(*program));
+        ASSERT_EQ(plain->objects.size(), program->objects.size());
+        // the declarations of core.p4 keep their positions
+        auto parsed = plain->objects.at(0), loaded = program->objects.at(0);
+        ASSERT_TRUE(loaded->srcInfo.isValid());
+        EXPECT_EQ(parsed->srcInfo.toPositionString(), loaded->srcInfo.toPositionString());
+        EXPECT_EQ(parsed->srcInfo.toSourceFragment(), loaded->srcInfo.toSourceFragment());
+
+        // and come first, as when parsing the whole program
+        int preludeIds = 0, programIds = -1;
+        for (auto obj : program->objects) {
+            auto decl = obj->to<IR::Type_Declaration>();
+            if (decl == nullptr || !decl->srcInfo.isValid()) continue;
+            if (decl->srcInfo.getSourceFile() == "prog.p4") {
+                if (programIds < 0 || decl->declid < programIds)
+                    programIds = decl->declid;
+            } else if (decl->declid > preludeIds) {
+                preludeIds = decl->declid;
+            }
+        }
+        EXPECT_LT(preludeIds, programIds);
+    }
+
+    auto expected = toP4(plain);
+    EXPECT_NE(std::string::npos, expected.find("#include <core.p4>"));
+    EXPECT_EQ(expected, toP4(first));
+    EXPECT_EQ(expected, toP4(second));
+
+    auto plainOut = FrontEnd().run(options, plain);
+    auto secondOut = FrontEnd().run(options, second);
+    ASSERT_EQ(0u, ::errorCount());
+    ASSERT_TRUE(plainOut != nullptr && secondOut != nullptr);
+    EXPECT_EQ(toP4(plainOut), toP4(secondOut));
+}
+
+}  // namespace Test
@@ -0,0 +1,120 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <vector>
+
+#include "config.h"
+#if HAVE_LIBGC
+#include <gc/gc.h>
+#endif  /* HAVE_LIBGC */
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "lib/arena.h"
+#include "lib/compile_context.h"
+
+namespace Test {
+
+namespace {
+
+struct ArenaContext : public BaseCompileContext {
+    ArenaContext() { useArena(4096); }
+};
+
+std::vector<int> finalized;
+void finalize(void *p) { finalized.push_back(*static_cast<int *>(p)); }
+
+}  // namespace
+
+TEST(Arena, allocate) {
+    Arena arena(1024);
+    EXPECT_EQ(Arena::owner(&arena), nullptr);
+
+    int *a = static_cast<int *>(arena.allocate(sizeof(int)));
+    int *b = static_cast<int *>(arena.allocate(sizeof(int)));
+    *a = 1;
+    *b = 2;
+    EXPECT_EQ(Arena::owner(a), &arena);
+    EXPECT_EQ(Arena::owner(b), &arena);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % alignof(std::max_align_t), 0u);
+    EXPECT_EQ(arena.bytesReserved(), 1024u);
+
+    // a large block gets a chunk of its own, and small ones go on in the first
+    char *big = static_cast<char *>(arena.allocate(4000));
+    EXPECT_EQ(Arena::owner(big + 3999), &arena);
+    int *c = static_cast<int *>(arena.allocate(sizeof(int)));
+    EXPECT_EQ(reinterpret_cast<char *>(c) - reinterpret_cast<char *>(b),
+              reinterpret_cast<char *>(b) - reinterpret_cast<char *>(a));
+
+    arena.addFinalizer(finalize, a);
+    arena.addFinalizer(finalize, b);
+    arena.addFinalizer(finalize, c);
+    arena.removeFinalizer(c);
+    finalized.clear();
+    arena.reset();
+    EXPECT_EQ(finalized, std::vector<int>({ 2, 1 }));
+    EXPECT_EQ(Arena::owner(a), nullptr);
+    EXPECT_EQ(arena.bytesAllocated(), 0u);
+    EXPECT_EQ(arena.bytesReserved(), 0u);
+}
+
+#if HAVE_LIBGC
+TEST(Arena, collectedChunks) {
+    Arena arena(1024);
+    int *a = static_cast<int *>(arena.allocate(sizeof(int)));
+    *a = 42;
+    arena.reset();
+    EXPECT_EQ(Arena::owner(a), nullptr);
+    // the collector keeps the chunk while something points into it
+    GC_gcollect();
+    EXPECT_EQ(*a, 42);
+    Arena::dealloc(a);
+    EXPECT_EQ(*a, 42);
+}
+#endif  /* HAVE_LIBGC */
+
+TEST(Arena, compileContext) {
+    auto *t = IR::Type_Bits::get(8);
+    const IR::Node *outside = new IR::Constant(t, 1);
+    EXPECT_EQ(Arena::current(), nullptr);
+
+    auto *context = new ArenaContext;
+    {
+        AutoCompileContext autoContext(context);
+        Arena *arena = context->arena();
+        ASSERT_TRUE(arena != nullptr);
+        EXPECT_EQ(Arena::current(), arena);
+
+        auto *vec = new IR::Vector<IR::Expression>();
+        for (int i = 0; i < 100; ++i)
+            vec->push_back(new IR::Constant(t, i));
+        EXPECT_EQ(Arena::owner(vec), arena);
+        EXPECT_EQ(Arena::owner(vec->at(99)), arena);
+        EXPECT_EQ(Arena::owner(&*vec->begin()), arena);
+        EXPECT_EQ(Arena::owner(outside), nullptr);
+        EXPECT_GT(arena->bytesAllocated(), 100 * sizeof(IR::Constant));
+
+        // the cached types outlive the compilation
+        auto *t2 = IR::Type_Bits::get(9);
+        EXPECT_EQ(Arena::owner(t2), nullptr);
+    }
+    EXPECT_EQ(Arena::current(), nullptr);
+    delete context;
+    EXPECT_EQ(IR::Type_Bits::get(9)->size, 9);
+    EXPECT_TRUE(outside->is<IR::Constant>());
+}
+
+}  // namespace Test
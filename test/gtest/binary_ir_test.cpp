@@ -0,0 +1,135 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "ir/binary_loader.h"
+#include "ir/binary_writer.h"
+#include "ir/json_generator.h"
+#include "lib/error.h"
+
+namespace Test {
+
+namespace {
+
+const IR::P4Program *makeProgram() {
+    auto type = IR::Type_Bits::get(72);
+    auto big = new IR::Constant(type, big_int("0x123456789abcdef012"));
+    auto sum = new IR::Add(Util::SourceInfo("test.p4", 3, 5, "a + a"), type, big, big);
+    auto field = new IR::StructField(IR::ID("f"), new IR::Annotations(), type);
+    IR::IndexedVector<IR::StructField> fields;
+    fields.push_back(field);
+    auto header = new IR::Type_Header(IR::ID("h_t", "orig_h_t"), fields);
+    IR::Vector<IR::Node> objects;
+    objects.push_back(header);
+    objects.push_back(new IR::Declaration_Constant(IR::ID("c"), type, sum));
+    return new IR::P4Program(objects);
+}
+
+cstring toJSON(const IR::Node *node) {
+    std::stringstream out;
+    JSONGenerator(out, true) << node << std::endl;
+    return out.str();
+}
+
+}  // namespace
+
+TEST(BinaryIR, roundTrip) {
+    auto program = makeProgram();
+    std::stringstream image;
+    BinaryWriter(image, true) << program;
+
+    BinaryLoader loader(image);
+    const IR::Node *node = nullptr;
+    loader >> node;
+    ASSERT_TRUE(loader.valid());
+    ASSERT_TRUE(node != nullptr && node->is<IR::P4Program>());
+    EXPECT_EQ(toJSON(program), toJSON(node));
+
+    auto loaded = node->to<IR::P4Program>();
+    auto header = loaded->objects.at(0)->to<IR::Type_Header>();
+    ASSERT_TRUE(header != nullptr);
+    EXPECT_EQ(header->name.originalName, "orig_h_t");
+    EXPECT_TRUE(header->fields.getDeclaration("f") != nullptr);
+
+    // the DAG is kept
+    auto sum = loaded->objects.at(1)->to<IR::Declaration_Constant>()->initializer;
+    ASSERT_TRUE(sum->is<IR::Add>());
+    EXPECT_EQ(sum->to<IR::Add>()->left, sum->to<IR::Add>()->right);
+    EXPECT_EQ(sum->srcInfo.line, 3);
+    EXPECT_EQ(sum->srcInfo.srcBrief, "a + a");
+}
+
+TEST(BinaryIR, malformed) {
+    std::stringstream image;
+    BinaryWriter(image) << makeProgram();
+    auto truncated = image.str();
+    truncated.resize(truncated.size() / 2);
+    std::stringstream in(truncated);
+
+    auto errors = ::errorCount();
+    BinaryLoader loader(in);
+    const IR::Node *node = nullptr;
+    loader >> node;
+    EXPECT_FALSE(loader.valid());
+    EXPECT_GT(::errorCount(), errors);
+}
+
+TEST(BinaryIR, declarationIds) {
+    // as if the file came from a process which had made more declarations
+    auto type = IR::Type_Bits::get(8);
+    auto decl = new IR::Declaration_Constant(IR::ID("c"), type, new IR::Constant(type, 1));
+    decl->declid += 1000;
+    auto var = new IR::Type_Var(IR::ID("T"));
+    var->declid += 1000;
+    IR::Vector<IR::Node> objects;
+    objects.push_back(decl);
+    objects.push_back(new IR::Type_Typedef(IR::ID("t"), var));
+    auto tmp = getenv("TMPDIR");
+    std::string file = std::string(tmp && *tmp ? tmp : "/tmp") +
+        "/p4c-binary-ir-test-" + std::to_string(getpid());
+    {
+        std::ofstream out(file);
+        BinaryWriter(out) << new IR::P4Program(objects);
+    }
+
+    BinaryLoader loader(file.c_str());
+    const IR::Node *node = nullptr;
+    loader >> node;
+    unlink(file.c_str());
+    ASSERT_TRUE(loader.valid());
+    ASSERT_TRUE(node != nullptr && node->is<IR::P4Program>());
+    auto loaded = node->to<IR::P4Program>();
+    auto loadedDecl = loaded->objects.at(0)->to<IR::Declaration_Constant>();
+    auto loadedVar = loaded->objects.at(1)->to<IR::Type_Typedef>()->type->to<IR::Type_Var>();
+    ASSERT_TRUE(loadedDecl != nullptr && loadedVar != nullptr);
+    EXPECT_EQ(decl->declid, loadedDecl->declid);
+    EXPECT_EQ(var->declid, loadedVar->declid);
+
+    // new declarations come after the loaded ones
+    auto fresh = new IR::Declaration_Constant(IR::ID("d"), type, new IR::Constant(type, 2));
+    EXPECT_GT(fresh->declid, loadedDecl->declid);
+    auto freshVar = new IR::Type_Var(IR::ID("T"));
+    EXPECT_GT(freshVar->declid, loadedVar->declid);
+}
+
+}  // namespace Test
@@ -0,0 +1,156 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "lib/arena.h"
+#include "lib/log.h"
+#include "frontends/common/compileServer.h"
+#include "frontends/common/options.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+using TestContext = P4CContextWithOptions<CompilerOptions>;
+
+// Prints its arguments, and copies the program to the output file given with -o.
+int copyProgram(int argc, char *const argv[]) {
+    AutoCompileContext context(new TestContext);
+    std::cout << "args";
+    for (int i = 1; i < argc; ++i)
+        std::cout << " " << argv[i];
+    std::cerr << "copying" << std::endl;
+    std::ifstream in(argv[argc - 1]);
+    std::string text;
+    std::getline(in, text);
+    std::ofstream(argv[2]) << text;
+    return 3;
+}
+
+}  // namespace
+
+TEST(CompileServer, Compile) {
+    CompileServer server("p4c-test", copyProgram);
+    CompileServer::Request request;
+    request.args = { "-o", "out.json" };
+    request.sourceName = "prog.p4";
+    request.source = "control c() { apply {} }";
+
+    auto response = server.compile(request);
+    EXPECT_EQ(3, response.status);
+    EXPECT_EQ("args -o out.json prog.p4", response.output);
+    EXPECT_EQ("copying\n", response.diagnostics);
+    ASSERT_EQ(1u, response.files.size());
+    EXPECT_EQ("out.json", response.files[0].first);
+    EXPECT_EQ(request.source, response.files[0].second);
+
+    request.args = { "--version" };
+    response = server.compile(request);
+    EXPECT_EQ(1, response.status);
+    EXPECT_TRUE(response.files.empty());
+    EXPECT_NE(std::string::npos, response.diagnostics.find("not supported"));
+}
+
+TEST(CompileServer, ResetsState) {
+    std::vector<int> ids, errors, verbosity;
+    int resets = 0;
+    CompileServer server("p4c-test", [&](int argc, char *const argv[]) {
+        AutoCompileContext context(new TestContext);
+        TestContext::get().options().process(argc, argv);
+        verbosity.push_back(Log::verbosity());
+        ids.push_back((new IR::Constant(1))->id);
+        ::error("%1%: no good", argv[argc - 1]);
+        errors.push_back(::errorCount());
+        return ::errorCount() > 0;
+    });
+    server.addResetHook([&]() { ++resets; });
+
+    CompileServer::Request request;
+    request.args = { "-v" };
+    auto response = server.compile(request);
+    EXPECT_EQ(1, response.status);
+    EXPECT_NE(std::string::npos, response.diagnostics.find("program.p4: no good"));
+
+    request.args.clear();
+    server.compile(request);
+    EXPECT_EQ(2, resets);
+    EXPECT_EQ(std::vector<int>({ 1, 0 }), verbosity);
+    EXPECT_EQ(std::vector<int>({ 1, 1 }), errors);
+    ASSERT_EQ(2u, ids.size());
+    EXPECT_EQ(ids[0], ids[1]);
+}
+
+TEST(CompileServer, Arena) {
+    Arena *arena = nullptr;
+    bool inArena = false;
+    CompileServer server("p4c-test", [&](int, char *const[]) {
+        AutoCompileContext context(new TestContext);
+        arena = Arena::current();
+        inArena = arena != nullptr && Arena::owner(new IR::Constant(1)) == arena;
+        return 0;
+    });
+    auto response = server.compile(CompileServer::Request());
+    EXPECT_EQ(0, response.status);
+    EXPECT_TRUE(inArena);
+    // freed with the compilation
+    EXPECT_EQ(nullptr, Arena::current());
+}
+
+TEST(CompileServer, Socket) {
+    auto tmp = getenv("TMPDIR");
+    std::string socketPath = std::string(tmp && *tmp ? tmp : "/tmp") +
+        "/p4c-server-test-" + std::to_string(getpid());
+    CompileServer::Request request;
+    request.args = { "-o", "out.json" };
+    request.source = "header h {}";
+    CompileServer::Response response;
+    EXPECT_FALSE(CompileServer::send(socketPath.c_str(), request, &response));
+    EXPECT_EQ(1, response.status);
+
+    pid_t server = fork();
+    ASSERT_GE(server, 0);
+    if (server == 0) {
+        CompileServer compileServer("p4c-test", copyProgram);
+        _exit(compileServer.serve(socketPath.c_str()));
+    }
+    bool sent = false;
+    for (int attempt = 0; attempt < 100 && !sent; ++attempt) {
+        sent = CompileServer::send(socketPath.c_str(), request, &response);
+        if (!sent)
+            usleep(20000);
+    }
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    unlink(socketPath.c_str());
+
+    ASSERT_TRUE(sent);
+    EXPECT_EQ(3, response.status);
+    EXPECT_EQ("args -o out.json program.p4", response.output);
+    ASSERT_EQ(1u, response.files.size());
+    EXPECT_EQ("header h {}", response.files[0].second);
+}
+
+}  // namespace Test
@@ -14,8 +14,18 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "lib/cstring.h"
+#include "lib/thread_pool.h"
 
 namespace Test {
 
@@ -110,4 +120,92 @@ TEST(cstring, replace) {
     EXPECT_EQ(c.replace("i", ""), "Orgnal");
 }
 
+namespace {
+
+/// 1, 2, 4, ... up to the number of cores (only 1 without MULTITHREAD).
+std::vector<unsigned> threadCounts() {
+    unsigned maxThreads = 1;
+#ifdef MULTITHREAD
+    maxThreads = std::max(1U, std::thread::hardware_concurrency());
+#endif  // MULTITHREAD
+    std::vector<unsigned> rv;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        rv.push_back(threads);
+    rv.push_back(maxThreads);
+    return rv;
+}
+
+}  // namespace
+
+// Interns strings with 1 up to N threads (more than one only in MULTITHREAD
+// builds), and checks that all threads get the same interned strings.
+TEST(cstring, concurrentIntern) {
+    const int count = 20000, rounds = 10;
+    std::vector<std::string> names;
+    std::vector<const char *> interned;
+    for (int i = 0; i < count; ++i) {
+        names.push_back("intern_throughput_" + std::to_string(i));
+        interned.push_back(cstring(names.back()).c_str()); }
+
+    for (auto threads : threadCounts()) {
+        Util::ThreadPool::get().setThreads(threads);
+        std::atomic<int> mismatches(0);
+        std::vector<std::vector<const char *>> fresh(threads);
+        std::vector<std::function<void()>> tasks;
+        for (unsigned t = 0; t < threads; ++t) {
+            tasks.emplace_back([&, t]() {
+                // strings that are already interned
+                for (int r = 0; r < rounds; ++r)
+                    for (int i = 0; i < count; ++i)
+                        if (cstring(names[i]).c_str() != interned[i]) ++mismatches;
+                // strings that all the threads intern concurrently for the first time
+                for (int i = 0; i < count; ++i)
+                    fresh[t].push_back(
+                        cstring(names[i] + "_" + std::to_string(threads)).c_str()); }); }
+        Util::ThreadPool::get().run(tasks);
+        EXPECT_EQ(0, mismatches.load());
+        for (unsigned t = 1; t < threads; ++t)
+            EXPECT_EQ(fresh[0], fresh[t]); }
+    Util::ThreadPool::get().setThreads(1);
+}
+
+// Reports the interning throughput with 1 up to N threads, for strings that
+// are already interned and for new ones.  Run with
+// --gtest_also_run_disabled_tests.
+TEST(cstring, DISABLED_internThroughput) {
+    const int count = 20000, rounds = 10;
+    std::vector<std::string> names;
+    for (int i = 0; i < count; ++i) {
+        names.push_back("intern_benchmark_" + std::to_string(i));
+        cstring(names.back()); }
+
+    for (auto threads : threadCounts()) {
+        Util::ThreadPool::get().setThreads(threads);
+        std::vector<std::string> fresh;
+        for (int i = 0; i < count; ++i)
+            fresh.push_back(names[i] + "_" + std::to_string(threads));
+        std::vector<std::function<void()>> existing, created;
+        for (unsigned t = 0; t < threads; ++t) {
+            existing.emplace_back([&]() {
+                for (int r = 0; r < rounds; ++r)
+                    for (auto &name : names)
+                        cstring(name); });
+            created.emplace_back([&]() {
+                for (auto &name : fresh)
+                    cstring(name); }); }
+
+        auto start = std::chrono::steady_clock::now();
+        Util::ThreadPool::get().run(existing);
+        auto middle = std::chrono::steady_clock::now();
+        Util::ThreadPool::get().run(created);
+        auto end = std::chrono::steady_clock::now();
+        std::chrono::duration<double> lookups = middle - start, inserts = end - middle;
+        std::cout << threads << " thread(s): "
+                  << threads * count * rounds / lookups.count() / 1e6
+                  << "M interned strings/s, "
+                  << threads * count / inserts.count() / 1e6
+                  << "M new strings/s" << std::endl; }
+    Util::ThreadPool::get().setThreads(1);
+}
+
 }  // namespace Test
@@ -0,0 +1,111 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "frontends/p4/def_use.h"
+
+namespace Test {
+
+using namespace P4;
+
+namespace {
+
+std::vector<cstring> names(const LocationSet* set) {
+    std::vector<cstring> rv;
+    for (auto l : *set)
+        rv.push_back(l->name);
+    return rv;
+}
+
+}  // namespace
+
+TEST(DefUse, locationSet) {
+    auto typeMap = new TypeMap;
+    auto bit8 = IR::Type_Bits::get(8);
+    auto hdr = new IR::Type_Header("h", {
+        new IR::StructField("a", bit8), new IR::StructField("b", bit8) });
+    typeMap->setType(hdr, new IR::Type_Type(hdr));
+    StorageFactory factory(typeMap);
+
+    auto x = factory.create(bit8, "x");
+    auto h = factory.create(hdr, "h");
+    auto y = factory.create(bit8, "y");
+    // the fields and the valid bit are created before the header itself
+    EXPECT_EQ(factory.getLocations().size(), 6u);
+    EXPECT_EQ(x->getId(), 0u);
+    EXPECT_EQ(h->getId(), 4u);
+    EXPECT_EQ(y->getId(), 5u);
+    EXPECT_EQ(factory.getBaseLocations().popcount(), 5);
+
+    auto sx = new LocationSet(x);
+    auto sy = new LocationSet(y);
+    auto sh = new LocationSet(h);
+    auto join = sy->join(sx);
+    EXPECT_EQ(names(join), std::vector<cstring>({ "x", "y" }));
+    EXPECT_EQ(join->canonicalize(), join);
+    EXPECT_TRUE(join->overlaps(sy));
+    EXPECT_FALSE(sx->overlaps(sy));
+    EXPECT_FALSE(sx->overlaps(LocationSet::empty));
+
+    auto canon = sh->canonicalize();
+    EXPECT_EQ(names(canon), std::vector<cstring>({ "h.a", "h.b", "h.$valid" }));
+    EXPECT_EQ(names(sh->getValidField()), std::vector<cstring>({ "h.$valid" }));
+    EXPECT_TRUE(canon->overlaps(sh->getField("b")));
+    EXPECT_FALSE(canon->overlaps(join));
+}
+
+TEST(DefUse, definitions) {
+    auto typeMap = new TypeMap;
+    auto bit8 = IR::Type_Bits::get(8);
+    StorageFactory factory(typeMap);
+    auto x = factory.create(bit8, "x")->to<BaseLocation>();
+    auto y = factory.create(bit8, "y")->to<BaseLocation>();
+
+    ProgramPointTable table;
+    auto s1 = new IR::EmptyStatement();
+    auto s2 = new IR::EmptyStatement();
+    auto uninit = table.singleton(ProgramPoint::beforeStart);
+    auto p1 = table.singleton(ProgramPoint(s1));
+    EXPECT_EQ(table.singleton(ProgramPoint(s1)), p1);
+    EXPECT_TRUE(uninit->containsBeforeStart());
+    EXPECT_FALSE(p1->containsBeforeStart());
+
+    Definitions start;
+    start.setDefinition(x, uninit);
+    start.setDefinition(y, uninit);
+    auto left = start.writes(p1, new LocationSet(x));
+    auto right = start.writes(table.singleton(ProgramPoint(s2)), new LocationSet(x));
+    auto join = left->joinDefinitions(right);
+    EXPECT_EQ(join->getPoints(y), uninit);
+    EXPECT_EQ(join->getPoints(x)->size(), 2u);
+    EXPECT_EQ(join->getPoints(x)->merge(p1), join->getPoints(x));
+    std::vector<const IR::Node*> last;
+    for (auto &p : *join->getPoints(x))
+        last.push_back(p.last());
+    EXPECT_EQ(last, std::vector<const IR::Node*>({ s1, s2 }));
+
+    EXPECT_TRUE(*left->joinDefinitions(left) == *left);
+    EXPECT_FALSE(*join == *left);
+    join->removeLocation(x);
+    EXPECT_FALSE(join->hasLocation(x));
+    EXPECT_TRUE(join->hasLocation(y));
+    EXPECT_FALSE(join->empty());
+}
+
+}  // namespace Test
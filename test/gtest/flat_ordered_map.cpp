@@ -0,0 +1,187 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/cstring.h"
+#include "lib/flat_ordered_map.h"
+#include "lib/ordered_map.h"
+
+namespace Test {
+
+namespace {
+
+template<class MAP>
+std::vector<typename MAP::key_type> keys(const MAP &m) {
+    std::vector<typename MAP::key_type> rv;
+    for (auto &el : m)
+        rv.push_back(el.first);
+    return rv;
+}
+
+}  // namespace
+
+TEST(flat_ordered_map, insertion_order) {
+    // enough entries to go through the hash index; all numbers below 101 but 64
+    flat_ordered_map<std::string, unsigned> a;
+    ordered_map<std::string, unsigned> b;
+    for (unsigned i = 0; i < 100; ++i) {
+        auto k = std::to_string((i * 37) % 101);
+        a[k] = i;
+        b[k] = i;
+    }
+    EXPECT_EQ(a.size(), 100u);
+    EXPECT_EQ(keys(a), keys(b));
+    for (auto &el : b)
+        EXPECT_EQ(a.at(el.first), el.second);
+    EXPECT_EQ(a.count("64"), 0u);
+    EXPECT_TRUE(a.find("64") == a.end());
+
+    // erasing keeps the other iterators and the order of what is left
+    auto it = a.find("37");
+    auto last = --a.end();
+    for (unsigned i = 0; i < 100; i += 3) {
+        auto k = std::to_string((i * 37) % 101);
+        if (k == "37" || k == last->first) continue;
+        EXPECT_EQ(a.erase(k), 1u);
+        b.erase(k);
+    }
+    EXPECT_EQ(it->first, "37");
+    EXPECT_EQ(last->second, 99u);
+    EXPECT_EQ(keys(a), keys(b));
+    EXPECT_EQ(a.erase("64"), 0u);
+
+    // and inserting reuses the erased space
+    a.emplace("x", 1);
+    b.emplace("x", 1);
+    EXPECT_EQ(keys(a), keys(b));
+    EXPECT_EQ(a.rbegin()->first, "x");
+    EXPECT_EQ(a.size(), b.size());
+
+    flat_ordered_map<std::string, unsigned> c(a);
+    EXPECT_TRUE(a == c);
+    c.erase(c.begin());
+    EXPECT_TRUE(a != c);
+}
+
+TEST(flat_ordered_map, map_equal) {
+    flat_ordered_map<unsigned, unsigned> a;
+    flat_ordered_map<unsigned, unsigned> b;
+
+    EXPECT_TRUE(a == b);
+
+    a[1] = 111;
+    a[2] = 222;
+    a[3] = 333;
+    b[3] = 333;
+    b[2] = 222;
+    b[1] = 111;
+
+    EXPECT_TRUE(a != b);
+
+    b.sort([](const std::pair<const unsigned, unsigned> &x,
+              const std::pair<const unsigned, unsigned> &y) { return x.first < y.first; });
+    EXPECT_TRUE(a == b);
+
+    a.erase(2);
+    b.erase(b.find(2));
+    EXPECT_TRUE(a == b);
+
+    a.clear();
+    EXPECT_TRUE(a.empty());
+    EXPECT_TRUE(a.begin() == a.end());
+}
+
+TEST(flat_ordered_map, insert_before) {
+    flat_ordered_map<cstring, int> a = { { "a", 1 }, { "c", 3 } };
+    auto r = a.insert(a.find("c"), std::make_pair(cstring("b"), 2));
+    EXPECT_TRUE(r.second);
+    EXPECT_EQ(r.first->second, 2);
+    EXPECT_EQ(keys(a), std::vector<cstring>({ "a", "b", "c" }));
+    EXPECT_EQ(a.lower_bound("b")->second, 2);
+    EXPECT_EQ(a.upper_bound("b")->second, 3);
+    EXPECT_EQ(a.upper_bound_pred("bb")->second, 2);
+    EXPECT_TRUE(a.upper_bound("c") == a.end());
+    EXPECT_EQ(get(a, "c"), 3);
+    EXPECT_EQ(get(a, "d", -1), -1);
+}
+
+namespace {
+
+template<class MAP>
+size_t fillLarge(MAP &map, const std::vector<cstring> &names) {
+    size_t sum = 0;
+    for (int rep = 0; rep < 10; ++rep) {
+        map.clear();
+        for (size_t i = 0; i < names.size(); ++i)
+            map.emplace(names[i], i);
+        for (auto n : names)
+            sum += map.find(n)->second;
+        for (auto &el : map)
+            sum += el.second;
+    }
+    return sum;
+}
+
+// most maps are small, like the members of a JSON object
+template<class MAP>
+size_t fillSmall(MAP &map, const std::vector<cstring> &names) {
+    size_t sum = 0;
+    for (size_t i = 0; i + 6 < names.size(); ++i) {
+        map.clear();
+        for (size_t j = i; j < i + 6; ++j)
+            map.emplace(names[j], j);
+        sum += map.find(names[i + 3])->second;
+        for (auto &el : map)
+            sum += el.second;
+    }
+    return sum;
+}
+
+template<class MAP>
+void timeIt(const char *what, size_t (*fn)(MAP &, const std::vector<cstring> &),
+            const std::vector<cstring> &names) {
+    MAP map;
+    auto start = std::chrono::steady_clock::now();
+    size_t check = fn(map, names);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << what << ": "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
+              << " us (" << check << ")" << std::endl;
+}
+
+}  // namespace
+
+// Compares the time taken by ordered_map and flat_ordered_map for the
+// common uses.  Run with --gtest_also_run_disabled_tests.
+TEST(flat_ordered_map, DISABLED_benchmark) {
+    typedef ordered_map<cstring, size_t> om;
+    typedef flat_ordered_map<cstring, size_t> fm;
+    std::vector<cstring> names;
+    for (int i = 0; i < 100000; ++i)
+        names.push_back(cstring("name_") + std::to_string(i));
+
+    timeIt<om>("ordered_map, 100000 entries", &fillLarge<om>, names);
+    timeIt<fm>("flat_ordered_map, 100000 entries", &fillLarge<fm>, names);
+    timeIt<om>("ordered_map, 6 entries", &fillSmall<om>, names);
+    timeIt<fm>("flat_ordered_map, 6 entries", &fillSmall<fm>, names);
+}
+
+}  // namespace Test
@@ -0,0 +1,104 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/hamt.h"
+
+namespace Test {
+
+namespace {
+
+// all keys collide, to exercise the lists at the bottom of the trie
+struct BadHash {
+    size_t operator()(int k) const { return k % 3; }
+};
+
+}  // namespace
+
+TEST(hamt, set_lookup) {
+    hamt<int, int> m;
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(m.lookup(1), nullptr);
+
+    std::map<int, int> ref;
+    for (int i = 0; i < 5000; ++i) {
+        int k = (i * 7919) % 3001;
+        m.set(k, i);
+        ref[k] = i; }
+    EXPECT_EQ(m.size(), ref.size());
+    for (auto &r : ref) {
+        ASSERT_NE(m.lookup(r.first), nullptr);
+        EXPECT_EQ(*m.lookup(r.first), r.second); }
+    EXPECT_EQ(m.lookup(5000), nullptr);
+    EXPECT_EQ(m.count(17), 1u);
+    EXPECT_THROW(m.at(-1), std::out_of_range);
+
+    std::map<int, int> seen;
+    for (auto &e : m)
+        EXPECT_TRUE(seen.emplace(e.first, e.second).second);
+    EXPECT_EQ(seen, ref);
+}
+
+TEST(hamt, collisions) {
+    hamt<int, int, BadHash> m;
+    for (int i = 0; i < 30; ++i)
+        m.set(i, i);
+    m.set(4, 40);
+    EXPECT_EQ(m.size(), 30u);
+    EXPECT_EQ(m.at(4), 40);
+    EXPECT_EQ(m.at(29), 29);
+    EXPECT_EQ(m.lookup(30), nullptr);
+    size_t n = 0;
+    for (auto it = m.begin(); it != m.end(); ++it) ++n;
+    EXPECT_EQ(n, 30u);
+}
+
+TEST(hamt, persistent) {
+    hamt<int, int> a;
+    for (int i = 0; i < 1000; ++i)
+        a.set(i, i);
+    hamt<int, int> b = a;
+    EXPECT_TRUE(a.same(b));
+    b.set(10, -10);
+    b.set(2000, 2000);
+    EXPECT_FALSE(a.same(b));
+    EXPECT_EQ(a.at(10), 10);
+    EXPECT_EQ(a.lookup(2000), nullptr);
+    EXPECT_EQ(a.size(), 1000u);
+    EXPECT_EQ(b.at(10), -10);
+    EXPECT_EQ(b.size(), 1001u);
+
+    // only the entries on the paths copied by the two sets are visited
+    std::set<int> visited, differ;
+    b.for_each_unshared(a, [&](const std::pair<int, int> &e, const int *other) {
+        visited.insert(e.first);
+        if (!other || *other != e.second)
+            differ.insert(e.first);
+        return true; });
+    EXPECT_EQ(differ, std::set<int>({ 10, 2000 }));
+    EXPECT_LT(visited.size(), 200u);
+
+    EXPECT_TRUE(a.for_each_unshared(a, [](const std::pair<int, int> &, const int *) {
+        return false; }));
+    EXPECT_FALSE(b.for_each_unshared(a, [](const std::pair<int, int> &, const int *) {
+        return false; }));
+}
+
+}  // namespace Test
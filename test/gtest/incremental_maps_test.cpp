@@ -0,0 +1,260 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+#include "frontends/p4/changedDeclarations.h"
+#include "frontends/p4/specialize.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+const IR::Declaration_Constant* constant(const IR::P4Program* program, cstring name) {
+    for (auto obj : program->objects) {
+        auto decl = obj->to<IR::Declaration_Constant>();
+        if (decl != nullptr && decl->name == name)
+            return decl;
+    }
+    return nullptr;
+}
+
+/// Replaces the initializer of constant @p name with @p init.
+const IR::P4Program* replace(const IR::P4Program* program, cstring name,
+                             const IR::Type* type, const IR::Expression* init) {
+    auto objects = program->objects;
+    for (auto& obj : objects) {
+        auto decl = obj->to<IR::Declaration_Constant>();
+        if (decl != nullptr && decl->name == name)
+            obj = new IR::Declaration_Constant(decl->srcInfo, decl->name, decl->annotations,
+                                               type, init);
+    }
+    return new IR::P4Program(program->srcInfo, objects);
+}
+
+/// Type-checks @p program with the given maps, which may still hold the
+/// results for a previous version of the program.
+void typeCheck(const IR::P4Program* program, ReferenceMap* refMap, TypeMap* typeMap) {
+    PassManager passes({
+        new ResolveReferences(refMap),
+        new ClearTypeMap(typeMap),
+        new TypeInference(refMap, typeMap, true)
+    });
+    program->apply(passes);
+}
+
+/// Checks that the maps agree with maps computed from scratch.
+void checkMaps(const IR::P4Program* program, ReferenceMap* refMap, TypeMap* typeMap) {
+    ReferenceMap freshRefMap;
+    TypeMap freshTypeMap;
+    typeCheck(program, &freshRefMap, &freshTypeMap);
+    ASSERT_EQ(::errorCount(), 0u);
+    for (auto obj : program->objects) {
+        auto decl = obj->to<IR::Declaration_Constant>();
+        if (decl == nullptr) continue;
+        auto init = decl->initializer;
+        if (auto cast = init->to<IR::Cast>())
+            init = cast->expr;
+        if (auto path = init->to<IR::PathExpression>()) {
+            EXPECT_NE(refMap->getDeclaration(path->path), nullptr);
+            EXPECT_EQ(refMap->getDeclaration(path->path),
+                      freshRefMap.getDeclaration(path->path));
+        }
+        auto type = typeMap->getType(decl->initializer);
+        auto freshType = freshTypeMap.getType(decl->initializer);
+        ASSERT_TRUE(type != nullptr && freshType != nullptr);
+        EXPECT_TRUE(TypeMap::equivalent(type, freshType));
+    }
+}
+
+}  // namespace
+
+class IncrementalMaps : public P4CTest { };
+
+TEST_F(IncrementalMaps, changedObjects) {
+    std::string source = P4_SOURCE(R"(
+        const bit<8> a = 8w1;
+        const bit<8> b = a;
+        const bit<8> c = 8w2;
+        const bit<8> d = b;
+        const bit<8> e = 8w3;
+        const bit<8> f = 8w4;
+        const bit<8> g = 8w5;
+    )");
+    auto program = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    typeCheck(program, &refMap, &typeMap);
+    ASSERT_EQ(::errorCount(), 0u);
+    auto dType = typeMap.getType(constant(program, "d")->initializer);
+
+    // nothing refers to c
+    program = replace(program, "c", IR::Type_Bits::get(8),
+                      new IR::Constant(IR::Type_Bits::get(8), 7));
+    typeCheck(program, &refMap, &typeMap);
+    checkMaps(program, &refMap, &typeMap);
+    EXPECT_EQ(typeMap.getType(constant(program, "d")->initializer), dType);
+
+    // b and d depend on a
+    program = replace(program, "a", IR::Type_Bits::get(16),
+                      new IR::Constant(IR::Type_Bits::get(16), 1));
+    program = replace(program, "b", IR::Type_Bits::get(8),
+                      new IR::Cast(IR::Type_Bits::get(8),
+                                   new IR::PathExpression(IR::ID("a"))));
+    typeCheck(program, &refMap, &typeMap);
+    checkMaps(program, &refMap, &typeMap);
+}
+
+TEST_F(IncrementalMaps, resolveTwice) {
+    std::string source = P4_SOURCE(R"(
+        const bit<8> a = 8w1;
+        const bit<8> b = a;
+        const bit<8> c = 8w2;
+        const bit<8> d = 8w3;
+        const bit<8> e = 8w4;
+    )");
+    auto program = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    // the second time the maps are up-to-date
+    typeCheck(program, &refMap, &typeMap);
+    typeCheck(program, &refMap, &typeMap);
+    ASSERT_EQ(::errorCount(), 0u);
+
+    // the reference from b to a has to be dropped
+    program = replace(program, "a", IR::Type_Bits::get(8),
+                      new IR::Constant(IR::Type_Bits::get(8), 5));
+    typeCheck(program, &refMap, &typeMap);
+    checkMaps(program, &refMap, &typeMap);
+    auto init = constant(program, "b")->initializer->to<IR::PathExpression>();
+    ASSERT_NE(nullptr, init);
+    EXPECT_EQ(constant(program, "a"), refMap.getDeclaration(init->path));
+}
+
+TEST_F(IncrementalMaps, sharedPath) {
+    std::string source = P4_SOURCE(R"(
+        const bit<8> a = 8w1;
+        const bit<8> b = a;
+        const bit<8> c = 8w2;
+        const bit<8> d = 8w3;
+        const bit<8> e = 8w4;
+    )");
+    auto parsed = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(parsed != nullptr && ::errorCount() == 0);
+    // c shares the path of b, as passes that copy code leave it
+    auto shared = constant(parsed, "b")->initializer;
+    const IR::P4Program* program = replace(parsed, "c", IR::Type_Bits::get(8), shared);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    // the second time the maps are up-to-date
+    typeCheck(program, &refMap, &typeMap);
+    typeCheck(program, &refMap, &typeMap);
+    ASSERT_EQ(::errorCount(), 0u);
+
+    // removing b must not forget the path that c still holds
+    IR::Vector<IR::Node> objects;
+    for (auto obj : program->objects)
+        if (obj != constant(program, "b"))
+            objects.push_back(obj);
+    program = new IR::P4Program(program->srcInfo, objects);
+    typeCheck(program, &refMap, &typeMap);
+    checkMaps(program, &refMap, &typeMap);
+    auto init = constant(program, "c")->initializer->to<IR::PathExpression>();
+    ASSERT_NE(nullptr, init);
+    EXPECT_EQ(constant(program, "a"), refMap.getDeclaration(init->path));
+}
+
+TEST_F(IncrementalMaps, changedDeclarations) {
+    std::string source = P4_SOURCE(R"(
+        const bit<8> a = 8w1;
+        const bit<8> b = a;
+        const bit<8> c = 8w2;
+        const bit<8> d = b;
+        const bit<8> e = 8w3;
+        const bit<8> f = 8w4;
+        const bit<8> g = 8w5;
+    )");
+    auto program = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+
+    ChangedDeclarations changes;
+    EXPECT_TRUE(changes.everything());
+    auto next = replace(program, "c", IR::Type_Bits::get(8),
+                        new IR::Constant(IR::Type_Bits::get(8), 7));
+    changes.update(program, next);
+    ASSERT_FALSE(changes.everything());
+    EXPECT_EQ(1u, changes.size());
+    EXPECT_TRUE(changes.contains(constant(next, "c")));
+    EXPECT_FALSE(changes.contains(constant(next, "a")));
+
+    // b refers to a, and d to b
+    auto last = replace(next, "a", IR::Type_Bits::get(16),
+                        new IR::Constant(IR::Type_Bits::get(16), 1));
+    changes.update(next, last);
+    ASSERT_FALSE(changes.everything());
+    EXPECT_EQ(3u, changes.size());
+    for (auto name : { "a", "b", "d" })
+        EXPECT_TRUE(changes.contains(constant(last, name)));
+    EXPECT_FALSE(changes.contains(constant(last, "c")));
+
+    changes.reset();
+    EXPECT_TRUE(changes.everything());
+}
+
+TEST_F(IncrementalMaps, specializeNested) {
+    // Each iteration of SpecializeAll only specializes one level.
+    std::string source = P4_SOURCE(R"(
+        control inner(inout bit<8> x)(bit<8> v) { apply { x = v; } }
+        control middle(inout bit<8> x)(bit<8> v) { inner(v) i; apply { i.apply(x); } }
+        control outer(inout bit<8> x) { middle(8w1) m; apply { m.apply(x); } }
+        control other(inout bit<8> x) { apply { x = 8w2; } }
+        control last(inout bit<8> x) { inner(8w3) i; apply { i.apply(x); } }
+        control proto(inout bit<8> x);
+        package top(proto a, proto b, proto c);
+        top(outer(), other(), last()) main;
+    )");
+    auto program = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = program->apply(SpecializeAll(&refMap, &typeMap));
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    unsigned controls = 0;
+    for (auto obj : program->objects) {
+        auto control = obj->to<IR::P4Control>();
+        if (control == nullptr)
+            continue;
+        EXPECT_TRUE(control->getConstructorParameters()->empty()) << control;
+        ++controls;
+    }
+    // outer, other, last and the specializations of middle and of inner twice
+    EXPECT_EQ(6u, controls);
+}
+
+}  // namespace Test
@@ -71,4 +71,37 @@ TEST(Util, Json) {
               obj->toString());
 }
 
+TEST(Util, JsonWriter) {
+    auto arr = new JsonArray();
+    arr->append(5);
+    arr->append(new JsonArray());
+    auto obj = new JsonObject();
+    obj->emplace("x", "x");
+    obj->emplace("y", arr);
+    obj->emplace("z", new JsonObject());
+
+    std::stringstream str;
+    {
+        JsonWriter writer(str);
+        writer.beginObject();
+        writer.key("x").value("x");
+        writer.key("y").beginArray().value(5).beginArray(true).endArray().endArray();
+        writer.key("z").beginObject().endObject();
+        writer.endObject();
+    }
+    EXPECT_EQ(obj->toString(), str.str());
+
+    auto fragment = new JsonFragment();
+    fragment->writer().beginArray().value(big_int(-1)).beginArray(true).value(true).null()
+            .endArray().endArray();
+    EXPECT_EQ("[\n  -1,\n  [true, null]\n]", fragment->toString());
+    obj->emplace("f", fragment);
+    EXPECT_EQ("{\n  \"x\" : \"x\",\n  \"y\" : [\n    5,\n    []\n  ],\n  \"z\" : {\n  },\n"
+              "  \"f\" : [\n    -1,\n    [true, null]\n  ]\n}", obj->toString());
+
+    JsonWriter unbalanced;
+    unbalanced.beginObject();
+    EXPECT_THROW(unbalanced.endArray(), std::logic_error);
+}
+
 }  // namespace Util
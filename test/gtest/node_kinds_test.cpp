@@ -0,0 +1,144 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "ir/node_kinds.h"
+#include "frontends/common/parseInput.h"
+
+namespace Test {
+
+namespace {
+
+const char *source = R"(
+action a() { bit<8> x = 1; x = x + 1; }
+action b() { bit<8> y = 2; }
+control c() { apply { if (true) {} } }
+)";
+
+const IR::P4Program *parse() {
+    return P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+}
+
+/// Counts its runs.  With @change, also turns additions into multiplications.
+class Count : public Transform {
+    int &runs;
+    bool change;
+
+ public:
+    Count(int &runs, const NodeKinds &kinds, bool change = false) : runs(runs), change(change) {
+        if (change)
+            setKinds(kinds, NodeKinds::of<IR::Mul>());
+        else
+            setKinds(kinds); }
+    profile_t init_apply(const IR::Node *root) override {
+        ++runs;
+        return Transform::init_apply(root); }
+    const IR::Node *postorder(IR::Add *add) override {
+        if (change)
+            return new IR::Mul(add->srcInfo, add->left, add->right);
+        return add; }
+};
+
+}  // namespace
+
+class NodeKindsTest : public P4CTest { };
+
+TEST_F(NodeKindsTest, Subclasses) {
+    auto binary = NodeKinds::of<IR::Operation_Binary>();
+    EXPECT_TRUE(binary.intersects(NodeKinds::of<IR::Add>()));
+    EXPECT_TRUE(binary.intersects(NodeKinds::of<IR::Equ>()));
+    EXPECT_FALSE(binary.intersects(NodeKinds::of<IR::Neg>()));
+    EXPECT_FALSE(NodeKinds::of<IR::Add>().intersects(NodeKinds::of<IR::Sub>()));
+    EXPECT_TRUE(NodeKinds().empty());
+
+    auto expr = new IR::Neg(new IR::Add(new IR::Constant(1), new IR::Constant(2)));
+    auto kinds = NodeKinds::in(expr);
+    EXPECT_TRUE(kinds.intersects(NodeKinds::of<IR::Constant>()));
+    EXPECT_TRUE(kinds.intersects(binary));
+    EXPECT_FALSE(kinds.intersects(NodeKinds::of<IR::Sub>()));
+    EXPECT_TRUE((NodeKinds::of<IR::Add>() == NodeKinds::of<IR::Add, IR::Add>()));
+}
+
+TEST_F(NodeKindsTest, Census) {
+    auto program = parse();
+    ASSERT_NE(nullptr, program);
+    NodeKindCensus census;
+    auto held = census.holding(program, NodeKinds::of<IR::Declaration_Variable>());
+    ASSERT_EQ(2u, held.size());
+    EXPECT_EQ(program->objects.at(0), held[0]);
+    EXPECT_EQ(program->objects.at(1), held[1]);
+    EXPECT_EQ(1u, census.holding(program, NodeKinds::of<IR::IfStatement>()).size());
+    EXPECT_TRUE(census.holding(program, NodeKinds::of<IR::SwitchStatement>()).empty());
+}
+
+TEST_F(NodeKindsTest, SkipsPassesWithoutInput) {
+    auto program = parse();
+    ASSERT_NE(nullptr, program);
+    int switches = 0, ifs = 0;
+    PassManager passes({ new Count(switches, NodeKinds::of<IR::SwitchStatement>()),
+                         new Count(ifs, NodeKinds::of<IR::IfStatement>()) });
+    int hooks = 0;
+    passes.addDebugHook([&](const char *, unsigned, const char *, const IR::Node *) { ++hooks; });
+    EXPECT_EQ(program, program->apply(passes));
+    EXPECT_EQ(0, switches);
+    EXPECT_EQ(1, ifs);
+    // skipped passes still count for the debug hooks
+    EXPECT_EQ(2, hooks);
+}
+
+TEST_F(NodeKindsTest, SkipsUnchangedDeclarations) {
+    auto program = parse();
+    ASSERT_NE(nullptr, program);
+    int adds = 0, changes = 0, muls = 0;
+    auto countAdds = new Count(adds, NodeKinds::of<IR::Add>());
+    auto countMuls = new Count(muls, NodeKinds::of<IR::Mul>());
+    // the nested manager shares the census of the outer one
+    PassManager passes({ countAdds, countMuls, new PassManager({ countAdds }),
+                         new Count(changes, NodeKinds::of<IR::Add>(), true),
+                         countAdds, countMuls, countMuls });
+    auto result = program->apply(passes);
+    ASSERT_NE(nullptr, result);
+    EXPECT_NE(program, result);
+    EXPECT_EQ(1, changes);
+    // again after the change, which is a new declaration
+    EXPECT_EQ(2, adds);
+    // only once the change created multiplications
+    EXPECT_EQ(1, muls);
+}
+
+TEST_F(NodeKindsTest, UndeclaredPassesRun) {
+    auto program = parse();
+    ASSERT_NE(nullptr, program);
+    int ifs = 0, functors = 0;
+    auto inner = new PassManager({ new Count(ifs, NodeKinds::of<IR::IfStatement>()),
+                                   new VisitFunctor([&]() { ++functors; }) });
+    EXPECT_EQ(nullptr, inner->inputKinds());
+    PassManager passes({ inner, inner });
+    program->apply(passes);
+    EXPECT_EQ(2, functors);
+    EXPECT_EQ(1, ifs);
+
+    auto declared = new PassManager({ new Count(ifs, NodeKinds::of<IR::IfStatement>()),
+                                      new Count(ifs, NodeKinds::of<IR::Add>()) });
+    ASSERT_NE(nullptr, declared->inputKinds());
+    EXPECT_TRUE(declared->inputKinds()->intersects(NodeKinds::of<IR::Add>()));
+    // its outputs are unknown, as the passes do not declare theirs
+    EXPECT_EQ(nullptr, declared->outputKinds());
+}
+
+}  // namespace Test
@@ -17,6 +17,7 @@ limitations under the License.
 #include "gtest/gtest.h"
 #include "ir/ir.h"
 #include "ir/visitor.h"
+#include "frontends/p4/typeMap.h"
 #include "lib/exceptions.h"
 
 TEST(IR, OperatorEq) {
@@ -69,3 +70,51 @@ TEST(IR, OperatorEq) {
     EXPECT_NE(*static_cast<IR::Node *>(p1), *static_cast<IR::Vector<IR::Node> *>(p3));
     EXPECT_NE(*static_cast<IR::Node *>(p1), *static_cast<IR::Node *>(p3));
 }
+
+TEST(IR, TypeTags) {
+    auto *t = IR::Type::Bits::get(16);
+    const IR::Node *a = new IR::Add(new IR::Constant(t, 1), new IR::Constant(t, 2));
+    const IR::Node *s = new IR::EmptyStatement();
+    const IR::Node *v = new IR::Vector<IR::Expression>();
+
+    EXPECT_TRUE(a->is<IR::Add>());
+    EXPECT_TRUE(a->is<IR::Operation_Binary>());
+    EXPECT_TRUE(a->is<IR::Expression>());
+    EXPECT_TRUE(a->is<IR::Node>());
+    EXPECT_FALSE(a->is<IR::Sub>());
+    EXPECT_FALSE(a->is<IR::Operation_Unary>());
+    EXPECT_FALSE(a->is<IR::Statement>());
+    EXPECT_EQ(a->to<IR::Operation_Binary>(), dynamic_cast<const IR::Operation_Binary *>(a));
+    EXPECT_EQ(&a->as<IR::Expression>(), dynamic_cast<const IR::Expression *>(a));
+    EXPECT_THROW(a->as<IR::Statement>(), std::bad_cast);
+
+    EXPECT_TRUE(s->is<IR::Statement>());
+    EXPECT_TRUE(s->is<IR::StatOrDecl>());
+    EXPECT_FALSE(s->is<IR::Expression>());
+
+    // templates and interfaces are not numbered
+    EXPECT_TRUE(v->is<IR::Vector<IR::Expression>>());
+    EXPECT_TRUE(v->is<IR::VectorBase>());
+    EXPECT_FALSE(v->is<IR::Expression>());
+    EXPECT_FALSE(v->is<IR::Vector<IR::Type>>());
+    EXPECT_TRUE(IR::Type_Header(IR::ID("h")).is<IR::IDeclaration>());
+    EXPECT_FALSE(a->is<IR::IDeclaration>());
+
+    EXPECT_NE(a->node_type_tag(), s->node_type_tag());
+    EXPECT_FALSE(a->equiv(*s));
+    EXPECT_FALSE(*a == *s);
+    EXPECT_TRUE(a->equiv(*a->clone()));
+}
+
+TEST(IR, TypeTagsOfNull) {
+    P4::TypeMap typeMap;
+    auto *e = new IR::Constant(IR::Type::Bits::get(8), 1);
+    // a non-strict lookup of an expression that was not type checked
+    EXPECT_EQ(typeMap.getType(e), nullptr);
+    EXPECT_EQ(typeMap.getType(e)->to<IR::Type_Bits>(), nullptr);
+    EXPECT_FALSE(typeMap.getType(e)->is<IR::Type_Bits>());
+    EXPECT_FALSE(typeMap.getType(e)->is<IR::Node>());
+
+    typeMap.setType(e, IR::Type::Bits::get(8));
+    EXPECT_EQ(typeMap.getType(e)->to<IR::Type_Bits>(), IR::Type::Bits::get(8));
+}
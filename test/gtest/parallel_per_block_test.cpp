@@ -0,0 +1,195 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <atomic>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "frontends/common/constantFolding.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+#include "frontends/p4/simplify.h"
+#include "frontends/p4/toP4/toP4.h"
+#include "lib/thread_pool.h"
+#include "midend/local_copyprop.h"
+#include "midend/parallelPerBlock.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+/// Adds a local variable with a fresh name to every control that does something.
+class AddLocal : public Transform {
+    ReferenceMap *refMap;
+
+ public:
+    explicit AddLocal(ReferenceMap *refMap) : refMap(refMap) { setName("AddLocal"); }
+    const IR::Node *postorder(IR::P4Control *control) override {
+        if (control->body->components.empty()) return control;
+        control->controlLocals.push_back(new IR::Declaration_Variable(
+            IR::ID(refMap->newName("tmp")), IR::Type_Bits::get(8)));
+        return control; }
+};
+
+/// Adds a field to every header, which is outside of the blocks.
+class AddField : public Transform {
+ public:
+    AddField() { setName("AddField"); }
+    const IR::Node *postorder(IR::Type_Header *header) override {
+        header->fields.push_back(new IR::StructField(IR::ID("g"), IR::Type_Bits::get(8)));
+        return header; }
+};
+
+const IR::P4Program *makeProgram() {
+    auto source = P4_SOURCE(P4Headers::CORE, R"(
+        header h_t { bit<8> f; }
+        control c1(inout h_t h) {
+            apply {
+                bit<8> x = h.f;
+                bit<8> y = x + 8w1;
+                h.f = y;
+            }
+        }
+        parser p(packet_in pk, out h_t h) {
+            state start {
+                pk.extract(h);
+                transition accept;
+            }
+        }
+        control c2(inout h_t h) {
+            apply {
+                bit<8> z = h.f;
+                if (z == 8w3)
+                    h.f = z;
+            }
+        }
+        parser P(packet_in pk, out h_t h);
+        control C(inout h_t h);
+        package top(P pp, C a, C b);
+        top(p(), c1(), c2()) main;
+    )");
+    auto test = FrontendTestCase::create(source);
+    return test ? test->program : nullptr;
+}
+
+std::string toP4(const IR::Node *program) {
+    std::stringstream out;
+    program->apply(ToP4(&out, false));
+    return out.str();
+}
+
+class ParallelPerBlockTest : public P4CTest {
+ protected:
+    void TearDown() override { Util::ThreadPool::get().setThreads(1); }
+
+    /// Applies a ParallelPerBlock running the pipeline built by @p make.
+    /// @returns the number of times the pipeline was built for the whole program.
+    static int run(const IR::P4Program *&program, unsigned threads,
+                   ParallelPerBlock::PipelineFactory make,
+                   ReferenceMap *refMap = new ReferenceMap) {
+        Util::ThreadPool::get().setThreads(threads);
+        auto typeMap = new TypeMap;
+        std::atomic<int> wholeRuns(0);
+        ParallelPerBlock pass(refMap, typeMap,
+            [&](ReferenceMap *maps, TypeMap *types) -> Visitor * {
+                if (maps == refMap) ++wholeRuns;
+                return make(maps, types); });
+        auto result = program->apply(pass);
+        program = result ? result->to<IR::P4Program>() : nullptr;
+        return wholeRuns.load();
+    }
+};
+
+}  // namespace
+
+TEST_F(ParallelPerBlockTest, sameAsSerial) {
+    auto program = makeProgram();
+    ASSERT_TRUE(program != nullptr);
+    auto pipeline = [](ReferenceMap *refMap, TypeMap *typeMap) -> Visitor * {
+        return new PassManager({
+            new ConstantFolding(refMap, typeMap),
+            new LocalCopyPropagation(refMap, typeMap),
+            new SimplifyControlFlow(refMap, typeMap) }); };
+
+    auto serial = program, threaded = program;
+    EXPECT_EQ(1, run(serial, 1, pipeline));
+    EXPECT_EQ(0, run(threaded, 4, pipeline));
+    ASSERT_EQ(0u, ::errorCount());
+    ASSERT_TRUE(serial != nullptr && threaded != nullptr);
+    EXPECT_NE(program, serial);
+    EXPECT_EQ(toP4(serial), toP4(threaded));
+
+    // the blocks are stitched in place, and the rest of the program is kept as is
+    ASSERT_EQ(program->objects.size(), threaded->objects.size());
+    for (size_t i = 0; i < program->objects.size(); ++i) {
+        auto obj = program->objects[i];
+        if (obj->is<IR::P4Control>() || obj->is<IR::P4Parser>())
+            EXPECT_TRUE(threaded->objects[i]->is<IR::Type_Declaration>() &&
+                        threaded->objects[i]->to<IR::Type_Declaration>()->name ==
+                            obj->to<IR::Type_Declaration>()->name);
+        else
+            EXPECT_EQ(obj, threaded->objects[i]);
+    }
+}
+
+TEST_F(ParallelPerBlockTest, generatedNames) {
+    auto program = makeProgram();
+    ASSERT_TRUE(program != nullptr);
+    auto refMap = new ReferenceMap;
+    program = program->apply(ResolveReferences(refMap));
+    ASSERT_TRUE(program != nullptr);
+
+    EXPECT_EQ(0, run(program, 4, [](ReferenceMap *refMap, TypeMap *) -> Visitor * {
+        return new AddLocal(refMap); }, refMap));
+    ASSERT_EQ(0u, ::errorCount());
+    ASSERT_TRUE(program != nullptr);
+    std::set<cstring> locals;
+    for (auto obj : program->objects)
+        if (auto control = obj->to<IR::P4Control>())
+            for (auto decl : control->controlLocals)
+                if (decl->is<IR::Declaration_Variable>())
+                    locals.insert(decl->name);
+    EXPECT_EQ(1u, locals.count("tmp"));
+
+    // the outer map knows the names the shards generated
+    auto fresh = refMap->newName("tmp");
+    EXPECT_EQ(0u, locals.count(fresh));
+}
+
+TEST_F(ParallelPerBlockTest, notBlockLocal) {
+    auto program = makeProgram();
+    ASSERT_TRUE(program != nullptr);
+    auto pipeline = [](ReferenceMap *refMap, TypeMap *) -> Visitor * {
+        return new PassManager({ new AddField(), new AddLocal(refMap) }); };
+
+    auto serial = program, threaded = program;
+    EXPECT_EQ(1, run(serial, 1, pipeline));
+    // the per-block results are dropped, and the pipeline is run once more
+    EXPECT_EQ(1, run(threaded, 4, pipeline));
+    ASSERT_EQ(0u, ::errorCount());
+    ASSERT_TRUE(serial != nullptr && threaded != nullptr);
+    EXPECT_EQ(toP4(serial), toP4(threaded));
+    auto text = toP4(threaded);
+    EXPECT_NE(std::string::npos, text.find("tmp_0"));
+    EXPECT_NE(std::string::npos, text.find("bit<8> g;"));
+}
+
+}  // namespace Test
@@ -0,0 +1,242 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <boost/algorithm/string/replace.hpp>
+#include <set>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+#include "lib/log.h"
+
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/typeMap.h"
+#include "midend/parserUnroll.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+// The parsers are those of testdata/p4_16_samples/stack_complex-bmv2.p4 and
+// header-stack-ops-bmv2.p4, and variations on them.
+boost::optional<FrontendTestCase>
+createParserUnrollTestCase(const std::string &parserSource) {
+    std::string source = P4_SOURCE(P4Headers::V1MODEL, R"(
+header h1_t {
+    bit<8>  hdr_type;
+    bit<8>  next_hdr_type;
+}
+
+header h2_t {
+    bit<8>  hdr_type;
+    bit<8>  next_hdr_type;
+}
+
+struct Headers {
+    h1_t h1;
+    h2_t[3] h2;
+    h2_t[8] big;
+    h1_t h3;
+}
+struct Metadata { bit<8> v; }
+error { BadHeaderType }
+
+%PARSER%
+
+control verifyChecksum(inout Headers h, inout Metadata m) { apply { } }
+control ingress(inout Headers h, inout Metadata m, inout standard_metadata_t sm) { apply { } }
+control egress(inout Headers h, inout Metadata m, inout standard_metadata_t sm) { apply { } }
+control computeChecksum(inout Headers h, inout Metadata m) { apply { } }
+control deparse(packet_out packet, in Headers h) { apply { packet.emit(h); } }
+
+V1Switch(parse(), verifyChecksum(), ingress(), egress(),
+    computeChecksum(), deparse()) main;
+    )");
+
+    boost::replace_first(source, "%PARSER%", parserSource);
+    return FrontendTestCase::create(source, CompilerOptions::FrontendVersion::P4_16);
+}
+
+// Counts the states of the parser, and the .next and .last left in it.
+class CountStates : public Inspector {
+ public:
+    unsigned states = 0;
+    unsigned stackAccesses = 0;
+    unsigned verifyCalls = 0;
+    std::set<cstring> names;
+
+    bool preorder(const IR::ParserState* state) override {
+        if (!state->isBuiltin()) {
+            states++;
+            names.insert(state->name);
+        }
+        return true;
+    }
+    void postorder(const IR::Member* member) override {
+        if (member->member.name == IR::Type_Stack::next ||
+            member->member.name == IR::Type_Stack::last)
+            stackAccesses++;
+    }
+    void postorder(const IR::PathExpression* path) override {
+        if (path->path->name.name == IR::ParserState::verify)
+            verifyCalls++;
+    }
+};
+
+const IR::P4Program* unroll(const IR::P4Program* program, CountStates* count,
+                            unsigned maxStateCopies = ParserStructure::defaultMaxStateCopies) {
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    PassManager passes = {
+        new ParsersUnroll(true, &refMap, &typeMap, maxStateCopies),
+        new TypeChecking(&refMap, &typeMap),
+        count
+    };
+    return program->apply(passes);
+}
+
+}  // namespace
+
+class ParserUnrollTest : public P4CTest { };
+
+TEST_F(ParserUnrollTest, StackLoop) {
+    auto test = createParserUnrollTestCase(P4_SOURCE(R"(
+parser parse(packet_in b, out Headers h, inout Metadata m, inout standard_metadata_t sm) {
+    state start {
+        b.extract(h.h2.next);
+        m.v = h.h2.last.hdr_type;
+        m.v = m.v + h.h2.last.hdr_type;
+        transition select(h.h2.last.next_hdr_type) {
+            0: start;
+            _: accept;
+        }
+    }
+}
+    )"));
+    ASSERT_TRUE(test);
+
+    CountStates count;
+    auto program = unroll(test->program, &count);
+    ASSERT_TRUE(program != nullptr);
+    EXPECT_EQ(0u, ::errorCount());
+    // one state for each element, and one raising StackOutOfBounds
+    EXPECT_EQ(4u, count.states);
+    EXPECT_EQ(1u, count.names.count(IR::ParserState::start));
+    EXPECT_EQ(0u, count.stackAccesses);
+    EXPECT_EQ(1u, count.verifyCalls);
+}
+
+TEST_F(ParserUnrollTest, HeaderStackOps) {
+    auto test = createParserUnrollTestCase(P4_SOURCE(R"(
+parser parse(packet_in pkt, out Headers hdr, inout Metadata meta,
+             inout standard_metadata_t stdmeta) {
+    state start {
+        pkt.extract(hdr.h1);
+        verify(hdr.h1.hdr_type == 1, error.BadHeaderType);
+        transition select(hdr.h1.next_hdr_type) {
+            2: parse_h2;
+            3: parse_h3;
+            default: accept;
+        }
+    }
+    state parse_h2 {
+        pkt.extract(hdr.h2.next);
+        verify(hdr.h2.last.hdr_type == 2, error.BadHeaderType);
+        transition select(hdr.h2.last.next_hdr_type) {
+            2: parse_h2;
+            3: parse_h3;
+            default: accept;
+        }
+    }
+    state parse_h3 {
+        pkt.extract(hdr.h3);
+        verify(hdr.h3.hdr_type == 3, error.BadHeaderType);
+        transition accept;
+    }
+}
+    )"));
+    ASSERT_TRUE(test);
+
+    CountStates count;
+    auto program = unroll(test->program, &count);
+    ASSERT_TRUE(program != nullptr);
+    EXPECT_EQ(0u, ::errorCount());
+    // start; parse_h2 for each element, and once more to raise StackOutOfBounds;
+    // parse_h3 after start and after each copy of parse_h2 that extracts,
+    // since the packet offset is different each time.
+    EXPECT_EQ(1u + 4u + 4u, count.states);
+    EXPECT_EQ(0u, count.stackAccesses);
+}
+
+TEST_F(ParserUnrollTest, SharedStates) {
+    auto test = createParserUnrollTestCase(P4_SOURCE(R"(
+parser parse(packet_in b, out Headers h, inout Metadata m, inout standard_metadata_t sm) {
+    state start {
+        b.extract(h.h1);
+        transition select(h.h1.next_hdr_type) {
+            1: left;
+            2: right;
+            3: left;
+            _: accept;
+        }
+    }
+    state left {
+        b.extract(h.h2.next);
+        transition join;
+    }
+    state right {
+        b.extract(h.h2.next);
+        transition join;
+    }
+    state join {
+        b.extract(h.h2.next);
+        transition accept;
+    }
+}
+    )"));
+    ASSERT_TRUE(test);
+
+    CountStates count;
+    auto program = unroll(test->program, &count);
+    ASSERT_TRUE(program != nullptr);
+    EXPECT_EQ(0u, ::errorCount());
+    // join is reached with the same values from left and right
+    EXPECT_EQ(4u, count.states);
+    EXPECT_EQ(0u, count.stackAccesses);
+}
+
+TEST_F(ParserUnrollTest, Bound) {
+    auto test = createParserUnrollTestCase(P4_SOURCE(R"(
+parser parse(packet_in b, out Headers h, inout Metadata m, inout standard_metadata_t sm) {
+    state start {
+        b.extract(h.big.next);
+        transition select(h.big.last.next_hdr_type) {
+            0: start;
+            _: accept;
+        }
+    }
+}
+    )"));
+    ASSERT_TRUE(test);
+
+    CountStates count;
+    unroll(test->program, &count, 4);
+    EXPECT_EQ(1u, ::errorCount());
+}
+
+}  // namespace Test
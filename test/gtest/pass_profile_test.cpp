@@ -0,0 +1,117 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "ir/json_parser.h"
+#include "ir/pass_manager.h"
+#include "ir/pass_profile.h"
+#include "lib/gc.h"
+
+namespace Test {
+
+namespace {
+
+class Named : public Inspector {
+ public:
+    explicit Named(const char *name) { setName(name); }
+};
+
+const JsonData *field(const JsonData *object, const std::string &name) {
+    auto obj = object->to<JsonObject>();
+    auto it = obj->find(name);
+    return it == obj->end() ? nullptr : it->second;
+}
+
+/// The pass @p name nested directly in @p parent in the JSON report.
+const JsonData *pass(const JsonData *parent, const std::string &name) {
+    auto passes = field(parent, "passes");
+    if (passes == nullptr) return nullptr;
+    for (auto p : *passes->to<JsonVector>())
+        if (*field(p, "name")->to<JsonString>() == name)
+            return p;
+    return nullptr;
+}
+
+int calls(const JsonData *pass) {
+    return *field(pass, "calls")->to<JsonNumber>();
+}
+
+}  // namespace
+
+TEST(PassProfile, nestedPasses) {
+    auto tmp = getenv("TMPDIR");
+    std::string file = std::string(tmp && *tmp ? tmp : "/tmp") +
+        "/p4c-pass-profile-test-" + std::to_string(getpid()) + ".json";
+    PassProfile::enable(file);
+
+    auto inner = new PassManager({ new Named("second") });
+    inner->setName("inner");
+    PassManager outer({ new Named("first"), inner });
+    outer.setName("outer");
+    auto program = new IR::P4Program(IR::Vector<IR::Node>());
+    program->apply(outer);
+    program->apply(outer);
+
+    // the report is written at exit, which can be called from any thread,
+    // even with passes still running
+    PassProfile::start("unfinished", PassProfile::Counts());
+    gc_allow_threads();
+    std::thread exiting([]() {
+        gc_register_thread();
+        PassProfile::writeReport();
+        gc_unregister_thread(); });
+    exiting.join();
+    EXPECT_FALSE(PassProfile::enabled());
+
+    std::ifstream json(file);
+    JsonData *report = nullptr;
+    json >> report;
+    std::ifstream summary(file + ".txt");
+    std::stringstream text;
+    text << summary.rdbuf();
+    unlink(file.c_str());
+    unlink((file + ".txt").c_str());
+
+    ASSERT_TRUE(report != nullptr && report->is<JsonObject>());
+    auto outerPass = pass(report, "outer");
+    ASSERT_TRUE(outerPass != nullptr);
+    EXPECT_EQ(2, calls(outerPass));
+    auto firstPass = pass(outerPass, "first");
+    auto innerPass = pass(outerPass, "inner");
+    ASSERT_TRUE(firstPass != nullptr && innerPass != nullptr);
+    EXPECT_EQ(2, calls(firstPass));
+    auto secondPass = pass(innerPass, "second");
+    ASSERT_TRUE(secondPass != nullptr);
+    EXPECT_EQ(2, calls(secondPass));
+    // not nested in the pass managers that ran it
+    EXPECT_EQ(nullptr, pass(report, "second"));
+    auto unfinished = pass(report, "unfinished");
+    ASSERT_TRUE(unfinished != nullptr);
+    EXPECT_EQ(1, calls(unfinished));
+
+    for (auto name : { "outer", "first", "inner", "second", "unfinished" })
+        EXPECT_NE(std::string::npos, text.str().find(std::string("  ") + name + "\n"));
+}
+
+}  // namespace Test
@@ -0,0 +1,291 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+#include "lib/log.h"
+
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/evaluator/evaluator.h"
+#include "frontends/p4/typeMap.h"
+#include "midend/stfRunner.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+// Routes IPv4 packets by longest prefix, and drops the ones an ACL denies.
+// The identification field of each packet is set to the number of packets
+// before it, which a register counts.
+const std::string switchSource = P4_SOURCE(P4Headers::V1MODEL, R"(
+header ethernet_t {
+    bit<48> dstAddr;
+    bit<48> srcAddr;
+    bit<16> etherType;
+}
+
+header ipv4_t {
+    bit<4>  version;
+    bit<4>  ihl;
+    bit<8>  diffserv;
+    bit<16> totalLen;
+    bit<16> identification;
+    bit<3>  flags;
+    bit<13> fragOffset;
+    bit<8>  ttl;
+    bit<8>  protocol;
+    bit<16> hdrChecksum;
+    bit<32> srcAddr;
+    bit<32> dstAddr;
+}
+
+struct Headers {
+    ethernet_t eth;
+    ipv4_t     ipv4;
+}
+struct Metadata { }
+
+parser parse(packet_in b, out Headers h, inout Metadata m, inout standard_metadata_t sm) {
+    state start {
+        b.extract(h.eth);
+        transition select(h.eth.etherType) {
+            0x0800: parse_ipv4;
+            default: accept;
+        }
+    }
+    state parse_ipv4 {
+        b.extract(h.ipv4);
+        transition accept;
+    }
+}
+
+control verifyChecksum(inout Headers h, inout Metadata m) {
+    apply {
+        verify_checksum(h.ipv4.isValid(),
+            { h.ipv4.version, h.ipv4.ihl, h.ipv4.diffserv, h.ipv4.totalLen,
+              h.ipv4.identification, h.ipv4.flags, h.ipv4.fragOffset, h.ipv4.ttl,
+              h.ipv4.protocol, h.ipv4.srcAddr, h.ipv4.dstAddr },
+            h.ipv4.hdrChecksum, HashAlgorithm.csum16);
+    }
+}
+
+control ingress(inout Headers h, inout Metadata m, inout standard_metadata_t sm) {
+    register<bit<16>>(1) packets;
+    action drop() { mark_to_drop(sm); }
+    action forward(bit<9> port) {
+        sm.egress_spec = port;
+        h.ipv4.ttl = h.ipv4.ttl - 1;
+    }
+    action broadcast(bit<16> group) { sm.mcast_grp = group; }
+    table routes {
+        key = { h.ipv4.dstAddr : lpm; }
+        actions = { forward; broadcast; drop; }
+        default_action = drop();
+    }
+    table acl {
+        key = {
+            h.ipv4.protocol : ternary;
+            h.ipv4.srcAddr  : ternary;
+        }
+        actions = { drop; NoAction; }
+        default_action = NoAction();
+    }
+    apply {
+        if (sm.parser_error != error.NoError || sm.checksum_error == 1 || !h.ipv4.isValid()) {
+            drop();
+            exit;
+        }
+        bit<16> count;
+        packets.read(count, 0);
+        packets.write(0, count + 1);
+        h.ipv4.identification = count;
+        if (routes.apply().hit)
+            acl.apply();
+    }
+}
+
+control egress(inout Headers h, inout Metadata m, inout standard_metadata_t sm) {
+    action set_source(bit<48> mac) { h.eth.srcAddr = mac; }
+    table ports {
+        key = { sm.egress_port : exact; }
+        actions = { set_source; NoAction; }
+        default_action = NoAction();
+    }
+    apply {
+        ports.apply();
+        if (sm.instance_type == 5)
+            h.eth.dstAddr = (bit<48>)sm.egress_rid;
+    }
+}
+
+control computeChecksum(inout Headers h, inout Metadata m) {
+    apply {
+        update_checksum(h.ipv4.isValid(),
+            { h.ipv4.version, h.ipv4.ihl, h.ipv4.diffserv, h.ipv4.totalLen,
+              h.ipv4.identification, h.ipv4.flags, h.ipv4.fragOffset, h.ipv4.ttl,
+              h.ipv4.protocol, h.ipv4.srcAddr, h.ipv4.dstAddr },
+            h.ipv4.hdrChecksum, HashAlgorithm.csum16);
+    }
+}
+
+control deparse(packet_out b, in Headers h) {
+    apply {
+        b.emit(h.eth);
+        b.emit(h.ipv4);
+    }
+}
+
+V1Switch(parse(), verifyChecksum(), ingress(), egress(),
+    computeChecksum(), deparse()) main;
+)");
+
+// The switch, compiled by the frontend.
+struct Switch {
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    V1SwitchInterpreter* target = nullptr;
+
+    bool compile() {
+        auto test = FrontendTestCase::create(switchSource);
+        if (!test)
+            return false;
+        EvaluatorPass evaluator(&refMap, &typeMap);
+        test->program->apply(evaluator);
+        if (::errorCount() > 0)
+            return false;
+        target = new V1SwitchInterpreter(&refMap, &typeMap, evaluator.getToplevelBlock());
+        return true;
+    }
+};
+
+std::vector<uint8_t> bytes(const std::string& hex) {
+    std::vector<uint8_t> rv;
+    std::string digits;
+    for (char c : hex)
+        if (!isspace(c))
+            digits += c;
+    for (size_t i = 0; i + 1 < digits.size(); i += 2)
+        rv.push_back(static_cast<uint8_t>(std::stoi(digits.substr(i, 2), nullptr, 16)));
+    return rv;
+}
+
+}  // namespace
+
+class StfRunnerTest : public P4CTest { };
+
+TEST_F(StfRunnerTest, Forwarding) {
+    Switch sw;
+    ASSERT_TRUE(sw.compile());
+    StfRunner runner(sw.target);
+    std::stringstream stf(R"(
+# the longest prefix wins
+add routes h.ipv4.dstAddr:0x0a000000/8 ingress.forward(port:1)
+add routes ipv4.dstAddr:0x0a01**** forward(port:2)
+add ports sm.egress_port:2 set_source(mac:0xaa)
+
+packet 0 000000000001 000000000002 0800 4500001400000000400664e00a0000010a010203 c0ffee
+expect 2 000000000001 0000000000aa 0800 45000014000000003f0665e00a0000010a010203 c0ffee $
+packet 0 000000000001 000000000002 0800 450000140000000040065dd20a0000010a090909
+expect 1 000000000001 000000000002 0800 45000014000100003f065ed10a0000010a090909
+)");
+    EXPECT_TRUE(runner.run(stf));
+    for (auto& f : runner.getFailures())
+        ADD_FAILURE() << f;
+}
+
+TEST_F(StfRunnerTest, Drops) {
+    Switch sw;
+    ASSERT_TRUE(sw.compile());
+    StfRunner runner(sw.target);
+    runner.execute("add routes h.ipv4.dstAddr:0x0a000000/8 forward(port:1)");
+
+    auto good = "000000000001 000000000002 0800 450000140000000040065dd20a0000010a090909";
+    EXPECT_EQ(1u, sw.target->process(0, bytes(good)).size());
+    // a wrong checksum
+    auto bad = "000000000001 000000000002 0800 450000140000000040065dd30a0000010a090909";
+    EXPECT_EQ(0u, sw.target->process(0, bytes(bad)).size());
+    // too short for the IPv4 header
+    auto shortPacket = "000000000001 000000000002 0800 4500001400000000";
+    EXPECT_EQ(0u, sw.target->process(0, bytes(shortPacket)).size());
+    // no route
+    auto unrouted = "000000000001 000000000002 0800 4500001400000000400663e00a0000010b010203";
+    EXPECT_EQ(0u, sw.target->process(0, bytes(unrouted)).size());
+}
+
+TEST_F(StfRunnerTest, TernaryPriorities) {
+    Switch sw;
+    ASSERT_TRUE(sw.compile());
+    StfRunner runner(sw.target);
+    std::stringstream stf(R"(
+add routes h.ipv4.dstAddr:0x0a000000/8 forward(port:1)
+add acl 1 h.ipv4.protocol:0x06 h.ipv4.srcAddr:0x0a0000** drop()
+add acl 2 h.ipv4.protocol:0x06 h.ipv4.srcAddr:0x0a000001 NoAction()
+
+packet 0 000000000001 000000000002 0800 450000140000000040065dd20a0000010a090909
+packet 0 000000000001 000000000002 0800 450000140000000040065dd10a0000020a090909
+packet 0 000000000001 000000000002 0800 450000140000000040115dc70a0000010a090909
+expect 1 000000000001 000000000002 0800 45000014000000003f065ed20a0000010a090909
+expect 1 000000000001 000000000002 0800 45000014000200003f115ec50a0000010a090909
+)");
+    EXPECT_TRUE(runner.run(stf));
+    for (auto& f : runner.getFailures())
+        ADD_FAILURE() << f;
+}
+
+TEST_F(StfRunnerTest, Multicast) {
+    Switch sw;
+    ASSERT_TRUE(sw.compile());
+    StfRunner runner(sw.target);
+    std::stringstream stf(R"(
+add routes h.ipv4.dstAddr:0xe0000000/4 broadcast(group:1)
+mc_mgrp_create 1
+mc_node_create 7 1 2
+mc_node_associate 1 0
+
+packet 0 000000000001 000000000002 0800 4500001400000000400690e20a000001e0000001
+expect 1 000000000007 000000000002 0800 4500001400000000400690e20a000001e0000001
+expect 2 000000000007 000000000002 0800 4500001400000000400690e20a000001e0000001
+)");
+    EXPECT_TRUE(runner.run(stf));
+    for (auto& f : runner.getFailures())
+        ADD_FAILURE() << f;
+}
+
+TEST_F(StfRunnerTest, ReportsDifferences) {
+    Switch sw;
+    ASSERT_TRUE(sw.compile());
+    StfRunner runner(sw.target);
+    std::stringstream stf(R"(
+add routes h.ipv4.dstAddr:0x0a000000/8 forward(port:1)
+add routes h.ipv4.dstAddr:0x0a010203/32 no_such_action()
+packet 0 000000000001 000000000002 0800 450000140000000040065dd20a0000010a090909
+packet 0 000000000001 000000000002 0800 450000140000000040065dd20a0000010a090909
+expect 1 ************ 000000000002 0800 45000014000000003f06****0a0000010a090909
+expect 1 000000000001 000000000002 0800 45000014000000003f06****0a0000010a090909
+)");
+    EXPECT_FALSE(runner.run(stf));
+    // the unknown action, and the identification of the second packet
+    ASSERT_EQ(2u, runner.getFailures().size());
+    EXPECT_NE(nullptr, strstr(runner.getFailures()[0].c_str(), "no_such_action"));
+    EXPECT_NE(nullptr, strstr(runner.getFailures()[1].c_str(), "Packet 1 on port 1"));
+}
+
+}  // namespace Test
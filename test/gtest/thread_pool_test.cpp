@@ -0,0 +1,136 @@
+/*
+Copyright 2018 VMware, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "lib/thread_pool.h"
+
+namespace Test {
+
+namespace {
+
+/// Records the variables assigned in each branch of the switch statements,
+/// along with the cases leading to them.
+class Writes : public Inspector, public ControlFlowVisitor {
+    cstring path = "";
+    std::vector<cstring> writes;
+
+ public:
+    explicit Writes(bool threaded) { threadedFlows = threaded; setName("Writes"); }
+    Writes *clone() const override { return new Writes(*this); }
+    bool threaded() const { return threaded_parallel_visit(2); }
+    const std::vector<cstring> &result() const { return writes; }
+
+    bool preorder(const IR::SwitchCase *c) override {
+        path = path + "/" + c->label->toString() + "#" +
+            std::to_string(getContext()->child_index);
+        return true; }
+    bool preorder(const IR::AssignmentStatement *s) override {
+        writes.push_back(path + " " + s->left->toString());
+        return false; }
+    void flow_merge(Visitor &other) override {
+        for (auto w : dynamic_cast<Writes &>(other).writes)
+            if (std::find(writes.begin(), writes.end(), w) == writes.end())
+                writes.push_back(w); }
+};
+
+const IR::SwitchStatement *makeSwitch(int depth, int width, int &counter) {
+    IR::Vector<IR::SwitchCase> cases;
+    for (int i = 0; i < width; ++i) {
+        IR::IndexedVector<IR::StatOrDecl> body;
+        body.push_back(new IR::AssignmentStatement(
+            new IR::PathExpression(IR::ID("x" + std::to_string(counter++ % 7))),
+            new IR::Constant(i)));
+        if (depth > 0)
+            body.push_back(makeSwitch(depth - 1, width, counter));
+        cases.push_back(new IR::SwitchCase(
+            new IR::PathExpression(IR::ID("a" + std::to_string(i))),
+            new IR::BlockStatement(body))); }
+    return new IR::SwitchStatement(new IR::PathExpression(IR::ID("t")), cases);
+}
+
+}  // namespace
+
+class ThreadPool : public ::testing::Test {
+ protected:
+    void SetUp() override { Util::ThreadPool::get().setThreads(4); }
+    void TearDown() override { Util::ThreadPool::get().setThreads(1); }
+};
+
+TEST_F(ThreadPool, RunsEveryTask) {
+    std::vector<int> results(100, 0);
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < 100; ++i)
+        tasks.emplace_back([&results, i]() { results[i] = i * i; });
+    Util::ThreadPool::get().run(tasks);
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(i * i, results[i]);
+}
+
+TEST_F(ThreadPool, NestedRun) {
+    std::atomic<int> count(0);
+    std::vector<std::function<void()>> outer;
+    for (int i = 0; i < 8; ++i) {
+        outer.emplace_back([&count]() {
+            std::vector<std::function<void()>> inner;
+            for (int j = 0; j < 8; ++j)
+                inner.emplace_back([&count]() { ++count; });
+            Util::ThreadPool::get().run(inner); }); }
+    Util::ThreadPool::get().run(outer);
+    EXPECT_EQ(64, count.load());
+}
+
+TEST_F(ThreadPool, RethrowsFirstException) {
+    std::atomic<int> count(0);
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < 10; ++i)
+        tasks.emplace_back([&count, i]() {
+            ++count;
+            if (i == 3) throw std::runtime_error("three");
+            if (i == 7) throw std::runtime_error("seven"); });
+    try {
+        Util::ThreadPool::get().run(tasks);
+        FAIL() << "exception not propagated";
+    } catch (std::runtime_error &e) {
+        EXPECT_STREQ("three", e.what());
+    }
+    // the rest of the batch still runs
+    EXPECT_EQ(10, count.load());
+}
+
+TEST_F(ThreadPool, ThreadedFlows) {
+    int counter = 0;
+    auto root = makeSwitch(2, 8, counter);
+
+    Writes serial(false), threaded(true);
+#ifdef MULTITHREAD
+    EXPECT_TRUE(threaded.threaded());
+#endif  // MULTITHREAD
+    root->apply(serial);
+    root->apply(threaded);
+    // every branch, merged back in the same order as a sequential visit
+    EXPECT_EQ(size_t(counter), serial.result().size());
+    EXPECT_EQ(serial.result(), threaded.result());
+}
+
+}  // namespace Test
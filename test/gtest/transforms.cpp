@@ -14,9 +14,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <chrono>
+#include <iostream>
+
 #include "gtest/gtest.h"
 #include "helpers.h"
 #include "ir/ir.h"
+#include "ir/node_id_table.h"
 #include "ir/visitor.h"
 #include "lib/source_file.h"
 
@@ -43,4 +47,106 @@ TEST_F(P4C_IR, Transform) {
     EXPECT_EQ(e, n);
 }
 
+TEST_F(P4C_IR, LazyClone) {
+    struct NoChange : public Transform {
+        NoChange() { lazyClone = true; }
+        const IR::Node* postorder(IR::Constant* c) override {
+            EXPECT_EQ(getOriginal(), c);
+            return c;
+        }
+    };
+    struct Increment : public Transform {
+        Increment() { lazyClone = true; }
+        const IR::Node* postorder(IR::Constant* c) override {
+            if (c->value == 3)
+                mutate(c)->value = 4;
+            return c;
+        }
+    };
+
+    auto left = new IR::Add(new IR::Constant(1), new IR::Constant(2));
+    auto three = new IR::Constant(3);
+    auto right = new IR::Neg(three);
+    const IR::Expression* e = new IR::Sub(left, right);
+
+    auto count = IR::Node::nodeCount();
+    EXPECT_EQ(e, e->apply(NoChange()));
+    EXPECT_EQ(count, IR::Node::nodeCount());
+
+    auto n = e->apply(Increment())->to<IR::Sub>();
+    ASSERT_NE(nullptr, n);
+    EXPECT_NE(e, n);
+    EXPECT_EQ(left, n->left);
+    auto neg = n->right->to<IR::Neg>();
+    ASSERT_NE(nullptr, neg);
+    EXPECT_NE(right, neg);
+    EXPECT_EQ(4, neg->expr->to<IR::Constant>()->asInt());
+    // only the changed path was copied, and the original is as it was
+    EXPECT_EQ(count + 3, IR::Node::nodeCount());
+    EXPECT_EQ(three, right->expr);
+    EXPECT_EQ(3, three->asInt());
+}
+
+TEST_F(P4C_IR, NodeIdTable) {
+    NodeIdTable<int> table;
+    auto a = new IR::Constant(1);
+    auto b = a->clone();
+    b->id = a->id;  // as when the same IR is read back twice
+    auto c = new IR::Constant(2);
+    c->id = 3;      // far below the others
+    EXPECT_TRUE(table.emplace(a, 1).second);
+    EXPECT_TRUE(table.emplace(b, 2).second);
+    EXPECT_FALSE(table.emplace(a, 3).second);
+    EXPECT_TRUE(table.emplace(c, 4).second);
+    EXPECT_EQ(3u, table.size());
+    EXPECT_EQ(1, *table.find(a));
+    EXPECT_EQ(2, *table.find(b));
+    EXPECT_EQ(4, *table.find(c));
+
+    table.erase_if([](const IR::Node *, const int &v) { return v == 1; });
+    EXPECT_EQ(nullptr, table.find(a));
+    EXPECT_EQ(2, *table.find(b));
+    EXPECT_FALSE(table.emplace(b, 5).second);
+    EXPECT_EQ(2u, table.size());
+}
+
+namespace {
+
+template<class VISITOR>
+void timeVisits(const char *what, const IR::Node *root) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i) {
+        VISITOR v;
+        root->apply(v); }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << what << ": "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10
+              << " us per pass" << std::endl;
+}
+
+}  // namespace
+
+// The cost of the visitor infrastructure itself, with passes that do nothing.
+// Run with --gtest_also_run_disabled_tests.
+TEST_F(P4C_IR, DISABLED_VisitorBenchmark) {
+    struct NullInspector : public Inspector {};
+    struct NullModifier : public Modifier {};
+    struct NullTransform : public Transform {};
+    struct LazyTransform : public Transform { LazyTransform() { lazyClone = true; } };
+
+    auto root = new IR::Vector<IR::StatOrDecl>();
+    for (int i = 0; i < 50000; ++i) {
+        auto x = new IR::PathExpression(IR::ID(cstring("x") + std::to_string(i % 100)));
+        auto y = new IR::PathExpression(IR::ID("y"));
+        auto sum = new IR::Add(new IR::Mul(x, y), new IR::Constant(i));
+        root->push_back(new IR::AssignmentStatement(x, sum));
+        // the nodes made by earlier passes leave gaps in the ids of a program
+        for (int j = 0; j < 4; ++j) new IR::Constant(j); }
+
+    timeVisits<NullInspector>("Inspector", root);
+    timeVisits<NullModifier>("Modifier", root);
+    timeVisits<NullTransform>("Transform", root);
+    timeVisits<LazyTransform>("Transform with lazyClone", root);
+}
+
 }  // namespace Test
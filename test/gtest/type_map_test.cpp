@@ -0,0 +1,130 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "frontends/p4/typeMap.h"
+#include "lib/error.h"
+
+using namespace P4;
+
+namespace Test {
+
+namespace {
+
+const IR::Type_Header *header() {
+    IR::IndexedVector<IR::StructField> fields;
+    fields.push_back(new IR::StructField(IR::ID("f"), IR::Type_Bits::get(8)));
+    return new IR::Type_Header(IR::ID("h_t"), fields);
+}
+
+const IR::Type_Enum *enumType(cstring name) {
+    IR::IndexedVector<IR::Declaration_ID> members;
+    members.push_back(new IR::Declaration_ID(IR::ID("A")));
+    members.push_back(new IR::Declaration_ID(IR::ID("B")));
+    return new IR::Type_Enum(IR::ID(name), members);
+}
+
+IR::Vector<IR::Type> components(const IR::Type *last) {
+    IR::Vector<IR::Type> rv;
+    rv.push_back(IR::Type_Bits::get(8));
+    rv.push_back(IR::Type_Boolean::get());
+    rv.push_back(last);
+    return rv;
+}
+
+/// Equivalent types must have the same hash.
+void expectConsistent(const IR::Type *left, const IR::Type *right) {
+    if (TypeMap::equivalent(left, right))
+        EXPECT_EQ(TypeMap::structuralHash(left), TypeMap::structuralHash(right))
+            << left << " and " << right;
+}
+
+}  // namespace
+
+TEST(TypeMap, canonicalTuplesAndLists) {
+    TypeMap typeMap;
+    auto h = header();
+    auto tuple = new IR::Type_Tuple(components(h));
+    auto sameTuple = new IR::Type_Tuple(components(h));
+    auto otherTuple = new IR::Type_Tuple(components(IR::Type_Bits::get(16)));
+    auto list = new IR::Type_List(components(h));
+    auto sameList = new IR::Type_List(components(h));
+
+    EXPECT_EQ(TypeMap::structuralHash(tuple), TypeMap::structuralHash(sameTuple));
+    EXPECT_EQ(tuple, typeMap.getCanonical(tuple));
+    EXPECT_EQ(tuple, typeMap.getCanonical(sameTuple));
+    EXPECT_EQ(otherTuple, typeMap.getCanonical(otherTuple));
+    EXPECT_EQ(list, typeMap.getCanonical(list));
+    EXPECT_EQ(list, typeMap.getCanonical(sameList));
+    // a list is never the same type as a tuple
+    EXPECT_NE(typeMap.getCanonical(tuple), typeMap.getCanonical(list));
+}
+
+TEST(TypeMap, canonicalStacks) {
+    TypeMap typeMap;
+    auto h = header();
+    auto stack = new IR::Type_Stack(h, new IR::Constant(4));
+    auto sameStack = new IR::Type_Stack(h, new IR::Constant(4));
+    auto biggerStack = new IR::Type_Stack(h, new IR::Constant(8));
+
+    EXPECT_EQ(stack, typeMap.getCanonical(stack));
+    EXPECT_EQ(stack, typeMap.getCanonical(sameStack));
+    // same hash, as the size is left out of it, but a different type
+    EXPECT_EQ(TypeMap::structuralHash(stack), TypeMap::structuralHash(biggerStack));
+    EXPECT_EQ(biggerStack, typeMap.getCanonical(biggerStack));
+    EXPECT_EQ(stack, typeMap.getCanonical(new IR::Type_Stack(h, new IR::Constant(4))));
+    EXPECT_EQ(biggerStack, typeMap.getCanonical(new IR::Type_Stack(h, new IR::Constant(8))));
+    EXPECT_EQ(0u, ::errorCount());
+}
+
+TEST(TypeMap, hashAgreesWithEquivalence) {
+    auto e = enumType("E");
+    auto sameEnum = enumType("E");
+    EXPECT_TRUE(TypeMap::equivalent(e, sameEnum));
+    expectConsistent(e, sameEnum);
+    EXPECT_FALSE(TypeMap::equivalent(e, enumType("F")));
+
+    auto newtype = new IR::Type_Newtype(IR::ID("N"), IR::Type_Bits::get(8));
+    auto copy = new IR::Type_Newtype(*newtype);
+    EXPECT_TRUE(TypeMap::equivalent(newtype, copy));
+    expectConsistent(newtype, copy);
+    expectConsistent(newtype, new IR::Type_Newtype(IR::ID("N"), IR::Type_Bits::get(8)));
+    EXPECT_FALSE(TypeMap::equivalent(newtype,
+                                     new IR::Type_Newtype(IR::ID("M"), IR::Type_Bits::get(8))));
+
+    auto var = new IR::Type_Var(IR::ID("T"));
+    auto sameVar = new IR::Type_Var(*var);
+    EXPECT_TRUE(TypeMap::equivalent(var, sameVar));
+    expectConsistent(var, sameVar);
+    // another declaration with the same name
+    EXPECT_FALSE(TypeMap::equivalent(var, new IR::Type_Var(IR::ID("T"))));
+
+    // and so do the tuples made of them
+    TypeMap typeMap;
+    typedef std::pair<const IR::Type *, const IR::Type *> TypePair;
+    for (auto pair : { TypePair(e, sameEnum), TypePair(newtype, copy), TypePair(var, sameVar) }) {
+        auto tuple = new IR::Type_Tuple(components(pair.first));
+        auto sameTuple = new IR::Type_Tuple(components(pair.second));
+        expectConsistent(tuple, sameTuple);
+        EXPECT_EQ(tuple, typeMap.getCanonical(tuple));
+        EXPECT_EQ(tuple, typeMap.getCanonical(sameTuple));
+    }
+}
+
+}  // namespace Test
@@ -108,15 +108,22 @@ void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &i
 
     impl << "#include \"ir/ir.h\"\n"
          << "#include \"ir/visitor.h\"\n"
-         << "#include \"ir/json_loader.h\"\n" << std::endl;
+         << "#include \"ir/json_loader.h\"\n"
+         << "#include \"ir/binary_loader.h\"\n" << std::endl;
 
     out << "#include <map>\n"
         << "#include <functional>\n" << std::endl
         << "class JSONLoader;\n"
         << "using NodeFactoryFn = IR::Node*(*)(JSONLoader&);\n"
+        << "class BinaryLoader;\n"
+        << "using BinaryFactoryFn = IR::Node*(*)(BinaryLoader&);\n"
         << std::endl
         << "namespace IR {\n"
         << "extern std::map<cstring, NodeFactoryFn> unpacker_table;\n"
+        << "extern std::map<cstring, BinaryFactoryFn> binary_unpacker_table;\n"
+        << "/// Changes whenever the fields of some class change, as binary IR files\n"
+        << "/// can only be read by a compiler with the same IR classes.\n"
+        << "extern const uint64_t binary_ir_schema;\n"
         << "}\n";
 
     impl << "std::map<cstring, NodeFactoryFn> IR::unpacker_table = {\n";
@@ -134,6 +141,35 @@ void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &i
             impl << cls->name << "::fromJSON)}"; } }
     impl << " };\n" << std::endl;
 
+    impl << "std::map<cstring, BinaryFactoryFn> IR::binary_unpacker_table = {\n";
+    first = true;
+    for (auto cls : *getClasses()) {
+        if (cls->kind == NodeKind::Concrete) {
+            if (first)
+                first = false;
+            else
+                impl << ",\n";
+            impl << "{\"" << cls->name << "\", BinaryFactoryFn(&IR::";
+            if (cls->containedIn && cls->containedIn->name)
+                impl << cls->containedIn->name << "::";
+            impl << cls->name << "::fromBinary)}"; } }
+    impl << " };\n" << std::endl;
+
+    // FNV-1a, so that it does not depend on the standard library
+    uint64_t schema = 14695981039346656037ULL;
+    auto hash = [&schema](cstring text) {
+        for (const char *p = text; *p; ++p)
+            schema = (schema ^ static_cast<unsigned char>(*p)) * 1099511628211ULL;
+        schema = (schema ^ ';') * 1099511628211ULL; };
+    for (auto cls : *getClasses()) {
+        hash(cls->containedIn && cls->containedIn->name ? cls->containedIn->name : "");
+        hash(cls->name);
+        if (auto parent = cls->getParent()) hash(parent->name);
+        for (auto f : *cls->getFields()) {
+            hash(f->type->toString());
+            hash(f->name); } }
+    impl << "const uint64_t IR::binary_ir_schema = " << schema << "ULL;\n" << std::endl;
+
     for (auto e : elements) {
         e->generate_hdr(out);
         e->generate_impl(impl); }
@@ -174,9 +210,32 @@ void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &i
         cls->declare(t);
         exit_namespace(t, cls->containedIn);
     }
+    t << std::endl;
+
+    // Number the classes in preorder, so the tags of the subclasses of each
+    // class are the range following its own.
+    std::map<const IrClass *, std::vector<const IrClass *>> subclasses;
+    for (auto cls : *getClasses())
+        if (cls->kind != NodeKind::Interface && cls->kind != NodeKind::Nested)
+            subclasses[cls->getParent()].push_back(cls);
+    int tag = 0;
+    t << "class Node;" << std::endl
+      << "template<class T> struct NodeTypeTags { enum { known = false }; };" << std::endl;
+    generateTypeTags(t, IrClass::nodeClass(), subclasses, tag);
     t << "}  // namespace IR" << std::endl;
 }
 
+void IrDefinitions::generateTypeTags(
+        std::ostream &t, const IrClass *cls,
+        std::map<const IrClass *, std::vector<const IrClass *>> &subclasses, int &tag) {
+    int first = tag++;
+    for (auto sub : subclasses[cls])
+        generateTypeTags(t, sub, subclasses, tag);
+    t << "template<> struct NodeTypeTags<" << cls->containedIn << cls->name << "> { "
+      << "enum { known = true, first = " << first << ", last = " << tag - 1 << " }; };"
+      << std::endl;
+}
+
 void IrClass::generateTreeMacro(std::ostream &out) const {
     for (auto p = this; p != nodeClass(); p = p->getParent())
         out << "  ";
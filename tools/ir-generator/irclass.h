@@ -275,6 +275,9 @@ class IrClass : public IrElement {
 class IrDefinitions {
     std::vector<IrElement*> elements;
     Util::Enumerator<IrClass*>* getClasses() const;
+    static void generateTypeTags(
+        std::ostream &t, const IrClass *cls,
+        std::map<const IrClass *, std::vector<const IrClass *>> &subclasses, int &tag);
 
  public:
     explicit IrDefinitions(std::vector<IrElement*> classes) : elements(classes) {}
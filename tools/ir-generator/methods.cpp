@@ -40,7 +40,7 @@ const ordered_map<cstring, IrMethod::info_t> IrMethod::Generate = {
         bool first = true;
         if (auto parent = cl->getParent()) {
             if (parent->name == "Node")
-                buf << "typeid(*this) == typeid(a)";
+                buf << "node_type_tag() == a.node_type_tag()";
             else
                 buf << parent->name << "::operator==(static_cast<const "
                     << parent->name << " &>(a))";
@@ -66,7 +66,7 @@ const ordered_map<cstring, IrMethod::info_t> IrMethod::Generate = {
             << "if (static_cast<const Node *>(this) == &a_) return true;\n";
         if (auto parent = cl->getParent()) {
             if (parent->name == "Node") {
-                buf << cl->indent << cl->indent << "if (typeid(*this) != typeid(a_)) "
+                buf << cl->indent << cl->indent << "if (node_type_tag() != a_.node_type_tag()) "
                                                    "return false;\n";
             } else {
                 buf << cl->indent << cl->indent << "if (!" << parent->name
@@ -154,6 +154,11 @@ const ordered_map<cstring, IrMethod::info_t> IrMethod::Generate = {
         std::stringstream buf;
         buf << "{ return \"" << cl->containedIn << cl->name << "\"; }";
         return buf.str(); } } },
+{ "node_type_tag", { &NamedType::Int(), {}, CONST + OVERRIDE,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << "{ return NodeTypeTags<" << cl->name << ">::first; }";
+        return buf.str(); } } },
 { "dbprint", { &NamedType::Void(), { new IrField(&ReferenceType::OstreamRef, "out") },
   CONST + IN_IMPL + OVERRIDE + CONCRETE_ONLY,
     [](IrClass *, Util::SourceInfo, cstring) -> cstring {
@@ -213,6 +218,40 @@ const ordered_map<cstring, IrMethod::info_t> IrMethod::Generate = {
         buf << "{ return new " << cl->name << "(json); }";
         return buf.str();
     } } },
+{ "toBinary", { &NamedType::Void(), {
+        new IrField(new ReferenceType(&NamedType::BinaryWriter()), "bin")
+    }, CONST + IN_IMPL + OVERRIDE + INCL_NESTED,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << "{" << std::endl;
+        if (auto parent = cl->getParent())
+            buf << cl->indent << parent->name << "::toBinary(bin);" << std::endl;
+        for (auto f : *cl->getFields()) {
+            if (*f->type == NamedType::SourceInfo()) continue;  // FIXME -- deal with SourcInfo
+            buf << cl->indent << "bin << this->" << f->name << ";" << std::endl; }
+        buf << "}";
+        return buf.str(); } } },
+// the fields are read back in the order toBinary wrote them
+{ "BinaryLoader", { nullptr, { new IrField(new ReferenceType(&NamedType::BinaryLoader()), "bin")
+    }, IN_IMPL + CONSTRUCTOR + INCL_NESTED,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        if (auto parent = cl->getParent())
+            buf << ": " << parent->name << "(bin)";
+        buf << " {" << std::endl;
+        for (auto f : *cl->getFields()) {
+            if (*f->type == NamedType::SourceInfo()) continue;  // FIXME -- deal with SourcInfo
+            buf << cl->indent << "bin >> " << f->name << ";" << std::endl; }
+        buf << "}";
+        return buf.str(); } } },
+{ "fromBinary", { nullptr, {
+        new IrField(new ReferenceType(&NamedType::BinaryLoader()), "bin"),
+    }, FACTORY + IN_IMPL + CONCRETE_ONLY + INCL_NESTED,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << "{ return new " << cl->name << "(bin); }";
+        return buf.str();
+    } } },
 { "toString", { &NamedType::Cstring(), {}, CONST + IN_IMPL + OVERRIDE + NOT_DEFAULT,
     [](IrClass *, Util::SourceInfo, cstring) -> cstring { return cstring(); } } },
 };
@@ -283,7 +322,7 @@ void IrClass::generateMethods() {
         if (!IrMethod::Generate.count(m->name))
             throw Util::CompilationError("Unrecognized predefined method %1%", m->name);
         auto &info = IrMethod::Generate.at(m->name);
-        if (m->name) {
+        if (!(info.flags & CONSTRUCTOR)) {
             if (info.rtype) {
                 // This predefined method has an explicit return type.
                 m->rtype = info.rtype;
@@ -98,6 +98,16 @@ NamedType& NamedType::JSONLoader() {
     return nt;
 }
 
+NamedType& NamedType::BinaryWriter() {
+    static NamedType nt("BinaryWriter");
+    return nt;
+}
+
+NamedType& NamedType::BinaryLoader() {
+    static NamedType nt("BinaryLoader");
+    return nt;
+}
+
 NamedType& NamedType::JSONObject() {
     static NamedType nt("JSONObject");
     return nt;
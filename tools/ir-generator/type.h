@@ -98,6 +98,8 @@ class NamedType : public Type {
     static NamedType& JSONGenerator();
     static NamedType& JSONLoader();
     static NamedType& JSONObject();
+    static NamedType& BinaryWriter();
+    static NamedType& BinaryLoader();
     static NamedType& SourceInfo();
 };
 